@@ -2,12 +2,27 @@
 
 #include "Config.h"
 
+#include "Core/Log.h"
 #include "Core/Parser.h"
 #include "Core/Function.h"
 #include "Core/Allocators/StackAllocator.h"
 
 #include "Math/Math.h"
 
+#include "Renderer/Integrators/BatchSize.h"
+#include "Renderer/Integrators/GeometryAggregation.h"
+#include "Renderer/Integrators/RayReorder.h"
+#include "Renderer/GeometryCache.h"
+
+#include "Util/Check.h"
+#include "Util/PMJ02.h"
+#include "Util/ThreadPool.h"
+#include "Util/LogBenchmark.h"
+#include "Util/SortBenchmark.h"
+#include "Util/HashMapBenchmark.h"
+#include "Util/ThreadPoolBenchmark.h"
+#include "Util/VirtualTextureBenchmark.h"
+
 static int parse_arg_int(StringView str) {
 	return Parser(str).parse_int();
 }
@@ -16,6 +31,15 @@ static float parse_arg_float(StringView str) {
 	return Parser(str).parse_float();
 }
 
+static Log::Severity parse_arg_severity(StringView str) {
+	Log::Severity severity;
+	if (!Log::parse_severity(str, severity)) {
+		IO::print("'{}' is not a recognized log level! Supported options: debug, info, warning, error\n"_sv, str);
+		IO::exit(1);
+	}
+	return severity;
+}
+
 static bool parse_arg_bool(StringView str) {
 	if (
 		str == "true" ||
@@ -49,6 +73,8 @@ struct Option {
 static void parse_args(const Array<StringView> & args, Allocator * allocator) {
 	Array<Option> options(allocator);
 
+	StringView check_name = { }; // Checks run once all arguments are parsed, so that options like --pmj and --sky apply regardless of their order
+
 	options.emplace_back("I"_sv, "integrator"_sv, "Choose the interagor type. Supported options: pathtracer, ao"_sv, 1, [](const Array<StringView> & args, size_t i) {
 		if (args[i + 1] == "pathtracer") {
 			cpu_config.integrator = IntegratorType::PATHTRACER;
@@ -86,7 +112,10 @@ static void parse_args(const Array<StringView> & args, Allocator * allocator) {
 
 	options.emplace_back(StringView { }, "nee"_sv, "Enables or disables Next Event Estimation"_sv,        1, [](const Array<StringView> & args, size_t i) { gpu_config.enable_next_event_estimation        = parse_arg_bool(args[i + 1]); });
 	options.emplace_back(StringView { }, "mis"_sv, "Enables or disables Multiple Importance Sampling"_sv, 1, [](const Array<StringView> & args, size_t i) { gpu_config.enable_multiple_importance_sampling = parse_arg_bool(args[i + 1]); });
+	options.emplace_back(StringView { }, "light-bvh"_sv, "Enables or disables importance sampling of lights using a light BVH"_sv, 1, [](const Array<StringView> & args, size_t i) { gpu_config.enable_light_bvh = parse_arg_bool(args[i + 1]); });
+	options.emplace_back(StringView { }, "sky-is"_sv, "Enables or disables importance sampling of the Sky in Next Event Estimation"_sv, 1, [](const Array<StringView> & args, size_t i) { gpu_config.enable_sky_importance_sampling = parse_arg_bool(args[i + 1]); });
 
+	options.emplace_back(StringView { }, "progressive"_sv, "Starts rendering immediately, Meshes and Textures appear as they finish loading"_sv, 0, [](const Array<StringView> & args, size_t i) { cpu_config.enable_progressive_loading = true; });
 	options.emplace_back(StringView { }, "force-rebuild"_sv, "BVH will not be loaded from disk but rebuild from scratch"_sv, 0, [](const Array<StringView> & args, size_t i) { cpu_config.bvh_force_rebuild = true; });
 
 	options.emplace_back("O"_sv,  "optimize"_sv,    "Enables or disables BVH optimzation post-processing step"_sv,               1, [](const Array<StringView> & args, size_t i) { cpu_config.enable_bvh_optimization       = parse_arg_bool(args[i + 1]); });
@@ -112,6 +141,101 @@ static void parse_args(const Array<StringView> & args, Allocator * allocator) {
 	});
 	options.emplace_back("c"_sv, "compress"_sv, "Enables or disables texture block compression"_sv, 1, [](const Array<StringView> & args, size_t i) { cpu_config.enable_block_compression = parse_arg_bool(args[i + 1]); });
 
+	options.emplace_back(StringView { }, "batch-size"_sv,   "Sets a fixed number of pixels rendered per batch. By default it is chosen based on resolution and free Device memory"_sv, 1, [](const Array<StringView> & args, size_t i) { cpu_config.batch_size          = Math::max(parse_arg_int(args[i + 1]), 0); });
+	options.emplace_back(StringView { }, "batch-budget"_sv, "Sets the fraction of free Device memory that the ray buffers may use when the batch size is chosen automatically"_sv, 1, [](const Array<StringView> & args, size_t i) { cpu_config.batch_memory_budget = Math::clamp(parse_arg_float(args[i + 1]), 0.0f, 1.0f); });
+	options.emplace_back(StringView { }, "batch-calc"_sv,   "Prints the batch size and ray buffer memory that would be used for the given resolution and free Device memory (in MB) and exits. Usage: --batch-calc <width> <height> <MB>"_sv, 3, [](const Array<StringView> & args, size_t i) {
+		BatchSize::print_report(parse_arg_int(args[i + 1]), parse_arg_int(args[i + 2]), size_t(parse_arg_int(args[i + 3])) << 20);
+		IO::exit(EXIT_SUCCESS);
+	});
+
+	options.emplace_back(StringView { }, "geometry-streaming"_sv, "Enables or disables keeping the triangles of loaded meshes in cluster files on disk instead of in memory"_sv, 1, [](const Array<StringView> & args, size_t i) { cpu_config.enable_geometry_streaming = parse_arg_bool(args[i + 1]); });
+	options.emplace_back(StringView { }, "geometry-budget"_sv,    "Sets the Host memory (in MB) that geometry streaming may use for resident clusters"_sv,                                        1, [](const Array<StringView> & args, size_t i) { cpu_config.geometry_cache_budget     = Math::max(parse_arg_int(args[i + 1]), 1); });
+
+	options.emplace_back(StringView { }, "device-pool"_sv, "Enables or disables sub-allocating Device memory from a pool instead of allocating every buffer from the driver"_sv, 1, [](const Array<StringView> & args, size_t i) { cpu_config.enable_device_memory_pool = parse_arg_bool(args[i + 1]); });
+
+	options.emplace_back(StringView { }, "kernel-specialization"_sv, "Enables or disables compiling the Pathtracer kernels for only the features (Material types, Lights, Media, Textures) the Scene uses"_sv, 1, [](const Array<StringView> & args, size_t i) { cpu_config.enable_kernel_specialization = parse_arg_bool(args[i + 1]); });
+	options.emplace_back(StringView { }, "kernel-cache"_sv,       "Sets the directory where compiled kernels are cached"_sv, 1, [](const Array<StringView> & args, size_t i) { cpu_config.kernel_cache_directory = args[i + 1]; });
+
+	options.emplace_back(StringView { }, "ray-reordering"_sv, "Enables or disables sorting the Rays of every bounce after the first by direction and origin before they are traced"_sv, 1, [](const Array<StringView> & args, size_t i) { gpu_config.enable_ray_reordering = parse_arg_bool(args[i + 1]); });
+
+#if ENABLE_RAY_STATS
+	options.emplace_back(StringView { }, "ray-stats"_sv, "Writes per bounce ray statistics of the last frames to the given file on exit, as CSV if the extension is .csv and JSON otherwise"_sv, 1, [](const Array<StringView> & args, size_t i) { cpu_config.ray_stats_filename = args[i + 1]; });
+#endif
+
+	options.emplace_back(StringView { }, "memory-report"_sv, "Writes a JSON report of memory usage per subsystem to the given file once loading is done"_sv, 1, [](const Array<StringView> & args, size_t i) { cpu_config.memory_report_filename = args[i + 1]; });
+
+	options.emplace_back(StringView { }, "pmj"_sv, "Sets path to the table of PMJ02 sequences, see --pmj-generate"_sv, 1, [](const Array<StringView> & args, size_t i) { cpu_config.pmj_filename = args[i + 1]; });
+	options.emplace_back(StringView { }, "pmj-generate"_sv, "Generates a table of PMJ02 sequences with the given number of samples per sequence (power of two, at least 4096), writes it to the given file and exits. Usage: --pmj-generate <file> <samples>"_sv, 2, [](const Array<StringView> & args, size_t i) {
+		bool success = PMJ02::generate_table(args[i + 1], parse_arg_int(args[i + 2]), ThreadPool::get_shared());
+		IO::exit(success ? EXIT_SUCCESS : EXIT_FAILURE);
+	});
+
+	options.emplace_back(StringView { }, "check"_sv, "Runs the self check with the given name (or all of them) on the CPU and exits, see --check-list"_sv, 1, [&check_name](const Array<StringView> & args, size_t i) { check_name = args[i + 1]; });
+	options.emplace_back(StringView { }, "check-list"_sv, "Lists the self checks that can be run with --check and exits"_sv, 0, [](const Array<StringView> & args, size_t i) {
+		Check::print_checks();
+		IO::exit(EXIT_SUCCESS);
+	});
+
+	options.emplace_back(StringView { }, "log-level"_sv,  "Sets the minimum severity of log messages. Supported options: debug, info, warning, error"_sv, 1, [](const Array<StringView> & args, size_t i) { Log::set_min_severity(parse_arg_severity(args[i + 1])); });
+	options.emplace_back(StringView { }, "log-filter"_sv, "Sets the minimum severity of log messages for one category, formatted as <category>:<level>. Categories: general, assets, bvh, cuda, renderer"_sv, 1, [](const Array<StringView> & args, size_t i) {
+		StringView filter = args[i + 1];
+
+		const char * separator = filter.start;
+		while (separator < filter.end && *separator != ':') separator++;
+
+		Log::Category category;
+		if (separator == filter.end || !Log::parse_category(StringView { filter.start, separator }, category)) {
+			IO::print("'{}' is not a valid log filter! Expected <category>:<level>\n"_sv, filter);
+			IO::exit(1);
+		}
+		Log::set_min_severity(category, parse_arg_severity(StringView { separator + 1, filter.end }));
+	});
+	options.emplace_back(StringView { }, "log-json"_sv, "Additionally writes all log messages as JSON lines to the given file"_sv, 1, [](const Array<StringView> & args, size_t i) {
+		if (!Log::open_json_file(args[i + 1])) {
+			IO::exit(1);
+		}
+	});
+
+	options.emplace_back(StringView { }, "bench-log"_sv, "Runs the logging benchmark and exits"_sv, 0, [](const Array<StringView> & args, size_t i) {
+		LogBenchmark::run();
+		IO::exit(EXIT_SUCCESS);
+	});
+
+	options.emplace_back(StringView { }, "bench-threadpool"_sv, "Runs the ThreadPool microbenchmark and exits"_sv, 0, [](const Array<StringView> & args, size_t i) {
+		ThreadPoolBenchmark::run();
+		IO::exit(EXIT_SUCCESS);
+	});
+
+	options.emplace_back(StringView { }, "bench-hashmap"_sv, "Runs the HashMap microbenchmark and exits"_sv, 0, [](const Array<StringView> & args, size_t i) {
+		HashMapBenchmark::run();
+		IO::exit(EXIT_SUCCESS);
+	});
+
+	options.emplace_back(StringView { }, "bench-sort"_sv, "Runs the sorting benchmark and exits"_sv, 0, [](const Array<StringView> & args, size_t i) {
+		SortBenchmark::run();
+		IO::exit(EXIT_SUCCESS);
+	});
+
+	options.emplace_back(StringView { }, "bench-reorder"_sv, "Runs the ray reordering locality benchmark on Rays recorded from a synthetic Scene and exits"_sv, 0, [](const Array<StringView> & args, size_t i) {
+		RayReorder::run_benchmark();
+		IO::exit(EXIT_SUCCESS);
+	});
+
+	options.emplace_back(StringView { }, "bench-geometry"_sv, "Runs the geometry aggregation benchmark and exits"_sv, 0, [](const Array<StringView> & args, size_t i) {
+		GeometryAggregation::run_benchmark();
+		IO::exit(EXIT_SUCCESS);
+	});
+
+	options.emplace_back(StringView { }, "bench-geometry-streaming"_sv, "Replays synthetic cluster access traces against the out-of-core geometry cache, prints peak resident memory and stall time and exits"_sv, 0, [](const Array<StringView> & args, size_t i) {
+		GeometryStreaming::run_benchmark();
+		IO::exit(EXIT_SUCCESS);
+	});
+
+	options.emplace_back(StringView { }, "bench-tile-cache"_sv, "Replays a synthetic tile access trace against the virtual texture TileCache for several memory budgets, prints the hit rate and exits"_sv, 0, [](const Array<StringView> & args, size_t i) {
+		VirtualTextureBenchmark::run();
+		IO::exit(EXIT_SUCCESS);
+	});
+
 	options.emplace_back("h"_sv, "help"_sv, "Displays this message"_sv, 0, [&options](const Array<StringView> & args, size_t i) {
 		for (int o = 0; o < options.size(); o++) {
 			const Option & option = options[o];
@@ -166,6 +290,10 @@ static void parse_args(const Array<StringView> & args, Allocator * allocator) {
 			cpu_config.scene_filenames.push_back(arg);
 		}
 	}
+
+	if (!check_name.is_empty()) {
+		IO::exit(Check::run(check_name) ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
 }
 
 void Args::parse(int num_args, char ** args) {
@@ -1,11 +1,17 @@
 #include "AssetManager.h"
 
+#include <thread>
+
 #include "Core/IO.h"
+#include "Core/Log.h"
 #include "Core/Timer.h"
+#include "Core/Format.h"
+#include "Core/Random.h"
 
 #include "Math/Vector4.h"
 
 #include "BVHLoader.h"
+#include "ClusterFile.h"
 #include "TextureLoader.h"
 
 #include "Util/Util.h"
@@ -13,6 +19,47 @@
 #include "Util/ThreadPool.h"
 #include "Util/Geometry.h"
 
+// Stand-in for a MeshData that is still loading, a single Triangle with all vertices at the origin.
+// Rays never hit it as it has zero area, and as a light it has zero power
+static MeshData create_placeholder_mesh_data() {
+	Triangle triangle = { };
+	triangle.normal_0 = Vector3(0.0f, 0.0f, 1.0f);
+	triangle.normal_1 = Vector3(0.0f, 0.0f, 1.0f);
+	triangle.normal_2 = Vector3(0.0f, 0.0f, 1.0f);
+	triangle.init();
+
+	// The BVH is constructed directly, in the layout the builders produce for a single Triangle (a leaf root followed by a dummy Node)
+	BVH2 bvh = { };
+	bvh.indices = { 0 };
+	bvh.nodes.resize(2);
+	bvh.nodes[0].aabb  = triangle.aabb;
+	bvh.nodes[0].first = 0;
+	bvh.nodes[0].count = 1;
+	bvh.nodes[0].axis  = 0;
+
+	MeshData mesh_data = { };
+	mesh_data.triangles = { triangle };
+	mesh_data.aabb      = triangle.aabb;
+	mesh_data.bvh       = BVH::create_from_bvh2(std::move(bvh));
+
+	return mesh_data;
+}
+
+// Stand-in for a Texture that is still loading, a single grey texel
+static Texture create_placeholder_texture() {
+	Texture texture = { };
+	texture.data.resize(sizeof(Vector4));
+	new (texture.data.data()) Vector4(0.5f, 0.5f, 0.5f, 1.0f);
+
+	texture.format   = Texture::Format::RGBA;
+	texture.width    = 1;
+	texture.height   = 1;
+	texture.channels = 4;
+	texture.mip_offsets = { 0 };
+
+	return texture;
+}
+
 AssetManager::AssetManager(Allocator * allocator) : mesh_datas(allocator), materials(allocator), media(allocator), textures(allocator), mesh_data_cache(allocator), texture_cache(allocator), thread_pool(make_owned<ThreadPool>()) {
 	Material default_material = { };
 	default_material.name    = "Default";
@@ -29,19 +76,64 @@ AssetManager::AssetManager(Allocator * allocator) : mesh_datas(allocator), mater
 AssetManager::~AssetManager() = default;
 
 MeshDataHandle AssetManager::new_mesh_data() {
+	MeshData placeholder = create_placeholder_mesh_data();
+
 	MutexLock lock(mesh_datas_mutex);
 	MeshDataHandle mesh_data_handle = { mesh_datas.size() };
-	mesh_datas.emplace_back();
+	mesh_datas.push_back(std::move(placeholder));
+	mesh_datas_loaded.push_back(false);
+	loading_count++;
 	return mesh_data_handle;
 }
 
 TextureHandle AssetManager::new_texture() {
+	Texture placeholder = create_placeholder_texture();
+
 	MutexLock lock(textures_mutex);
 	TextureHandle texture_handle = { textures.size() };
-	textures.emplace_back();
+	textures.push_back(std::move(placeholder));
+	textures_loaded.push_back(false);
+	loading_count++;
 	return texture_handle;
 }
 
+void AssetManager::complete(Completion && completion) {
+	MutexLock lock(completions_mutex);
+	completions.push(std::move(completion));
+}
+
+bool AssetManager::poll_loaded(LoadedAsset & loaded_asset) {
+	Completion completion;
+	{
+		MutexLock lock(completions_mutex);
+		if (completions.is_empty()) return false;
+
+		completion = completions.pop();
+	}
+
+	switch (completion.asset.type) {
+		case LoadedAsset::Type::MESH_DATA: {
+			MutexLock lock(mesh_datas_mutex);
+			mesh_datas       [completion.asset.handle] = std::move(completion.mesh_data);
+			mesh_datas_loaded[completion.asset.handle] = true;
+			break;
+		}
+		case LoadedAsset::Type::TEXTURE: {
+			MutexLock lock(textures_mutex);
+			textures       [completion.asset.handle] = std::move(completion.texture);
+			textures_loaded[completion.asset.handle] = true;
+			break;
+		}
+		default: ASSERT_UNREACHABLE();
+	}
+
+	loading_count--;
+	ASSERT(loading_count >= 0);
+
+	loaded_asset = completion.asset;
+	return true;
+}
+
 MeshDataHandle AssetManager::add_mesh_data(String filename, FallbackLoader fallback_loader) {
 	String bvh_filename = BVHLoader::get_bvh_filename(filename.view(), nullptr);
 	return add_mesh_data(std::move(filename), std::move(bvh_filename), std::move(fallback_loader));
@@ -60,7 +152,8 @@ MeshDataHandle AssetManager::add_mesh_data(String filename, String bvh_filename,
 
 		bool bvh_loaded = BVHLoader::try_to_load(filename, bvh_filename, &mesh_data, &bvh);
 		if (!bvh_loaded) {
-			mesh_data.triangles = fallback_loader(filename, nullptr);
+			// Loaders only use the allocator for scratch memory, the returned Triangles live on the heap
+			mesh_data.triangles = fallback_loader(filename, ThreadPool::get_worker_arena());
 
 			if (mesh_data.triangles.size() == 0) {
 				// FIXME: Right now empty MeshData is handled by inserting a dummy Triangle
@@ -86,12 +179,22 @@ MeshDataHandle AssetManager::add_mesh_data(String filename, String bvh_filename,
 			BVHCollapser::collapse(bvh);
 		}
 
-		mesh_data.bvh = BVH::create_from_bvh2(std::move(bvh));
+		// The root of the BVH bounds all triangles, this also holds for BVHs loaded from disk
+		mesh_data.aabb = bvh.nodes[0].aabb;
+		mesh_data.bvh  = BVH::create_from_bvh2(std::move(bvh));
 
-		{
-			MutexLock lock(mesh_datas_mutex);
-			get_mesh_data(mesh_data_handle) = std::move(mesh_data);
+		// With geometry streaming the Triangles only live on disk from here on, the cluster file is rewritten whenever the BVH file is
+		if (cpu_config.enable_geometry_streaming) {
+			String cluster_filename = ClusterFile::get_cluster_filename(filename.view(), nullptr);
+
+			bool force_write = !bvh_loaded || (IO::file_exists(cluster_filename.view()) && IO::file_is_newer(cluster_filename.view(), bvh_filename.view()));
+			ClusterFile::move_triangles(cluster_filename, mesh_data, force_write);
 		}
+
+		Completion completion = { };
+		completion.asset     = { LoadedAsset::Type::MESH_DATA, mesh_data_handle.handle };
+		completion.mesh_data = std::move(mesh_data);
+		complete(std::move(completion));
 	});
 
 	return mesh_data_handle;
@@ -105,12 +208,13 @@ MeshDataHandle AssetManager::add_mesh_data(Array<Triangle> triangles) {
 
 		MeshData mesh_data = { };
 		mesh_data.triangles = std::move(triangles);
-		mesh_data.bvh = BVH::create_from_bvh2(std::move(bvh));
+		mesh_data.aabb      = bvh.nodes[0].aabb;
+		mesh_data.bvh       = BVH::create_from_bvh2(std::move(bvh));
 
-		{
-			MutexLock mutex(mesh_datas_mutex);
-			get_mesh_data(mesh_data_handle) = std::move(mesh_data);
-		}
+		Completion completion = { };
+		completion.asset     = { LoadedAsset::Type::MESH_DATA, mesh_data_handle.handle };
+		completion.mesh_data = std::move(mesh_data);
+		complete(std::move(completion));
 	});
 
 	return mesh_data_handle;
@@ -138,6 +242,7 @@ TextureHandle AssetManager::add_texture(String filename, String name) {
 
 	// Otherwise, create new Texture and load it from disk
 	texture_handle = new_texture();
+	get_texture(texture_handle).name = name;
 
 	thread_pool->submit([this, filename = std::move(filename), name = std::move(name), texture_handle]() mutable {
 		Texture texture = { };
@@ -148,14 +253,14 @@ TextureHandle AssetManager::add_texture(String filename, String name) {
 		StringView file_extension = Util::get_file_extension(filename.view());
 		if (!file_extension.is_empty()) {
 			if (file_extension == "dds") {
-				success = TextureLoader::load_dds(filename, &texture); // DDS is loaded using custom code
+				success = TextureLoader::load_dds(filename, &texture, ThreadPool::get_worker_arena()); // DDS is loaded using custom code
 			} else {
-				success = TextureLoader::load_stb(filename, &texture); // other file formats use stb_image
+				success = TextureLoader::load_stb(filename, &texture, ThreadPool::get_worker_arena()); // other file formats use stb_image
 			}
 		}
 
 		if (!success) {
-			IO::print("WARNING: Failed to load Texture '{}'!\n"_sv, filename);
+			Log::warning(Log::Category::ASSETS, "Failed to load Texture '{}'!\n"_sv, filename);
 
 			// Use a default 1x1 pink Texture
 			texture.data.resize(sizeof(Vector4));
@@ -168,10 +273,10 @@ TextureHandle AssetManager::add_texture(String filename, String name) {
 			texture.mip_offsets = { 0 };
 		}
 
-		{
-			MutexLock lock(textures_mutex);
-			get_texture(texture_handle) = std::move(texture);
-		}
+		Completion completion = { };
+		completion.asset   = { LoadedAsset::Type::TEXTURE, texture_handle.handle };
+		completion.texture = std::move(texture);
+		complete(std::move(completion));
 	});
 
 	return texture_handle;
@@ -183,8 +288,132 @@ void AssetManager::wait_until_loaded() {
 	thread_pool->sync();
 	thread_pool.release();
 
+	LoadedAsset loaded_asset;
+	while (poll_loaded(loaded_asset)) { }
+
+	ASSERT(loading_count == 0);
+
 	mesh_data_cache.clear();
 	texture_cache  .clear();
 
 	assets_loaded = true;
 }
+
+bool AssetManager::run_check() {
+	constexpr int MESH_DATA_COUNT = 64;
+	constexpr int TEXTURE_COUNT   = 16;
+
+	AssetManager asset_manager(nullptr);
+
+	RNG rng(1234);
+
+	Array<int> triangle_counts(MESH_DATA_COUNT);
+
+	for (int m = 0; m < MESH_DATA_COUNT; m++) {
+		triangle_counts[m] = 1 + rng.get_uint32(5000);
+
+		Array<Triangle> triangles(triangle_counts[m]);
+		for (int t = 0; t < triangle_counts[m]; t++) {
+			Triangle & triangle = triangles[t];
+			triangle.position_0 = Vector3(rng.get_float(), rng.get_float(), rng.get_float());
+			triangle.position_1 = triangle.position_0 + Vector3(rng.get_float(), 0.0f, 0.0f);
+			triangle.position_2 = triangle.position_0 + Vector3(0.0f, rng.get_float(), 0.0f);
+			triangle.init();
+		}
+
+		MeshDataHandle handle = asset_manager.add_mesh_data(std::move(triangles));
+		ASSERT(handle.handle == m);
+	}
+
+	// The files do not exist, so the loading jobs fall back to the default (pink) Texture
+	for (int t = 0; t < TEXTURE_COUNT; t++) {
+		String filename = Format().format("__asset_check_{}.png"_sv, t);
+
+		TextureHandle handle = asset_manager.add_texture(filename, filename);
+		ASSERT(handle.handle == t);
+	}
+
+	bool success = true;
+
+	auto check_placeholders = [&]() {
+		for (int m = 0; m < MESH_DATA_COUNT; m++) {
+			const MeshData & mesh_data = asset_manager.get_mesh_data(MeshDataHandle { m });
+
+			bool is_loaded = asset_manager.is_loaded(MeshDataHandle { m });
+			int  expected  = is_loaded ? triangle_counts[m] : 1;
+
+			if (mesh_data.triangles.size() != expected || mesh_data.bvh.get() == nullptr) {
+				IO::print("MeshData {} has {} triangles, expected {} (loaded: {})\n"_sv, m, mesh_data.triangles.size(), expected, is_loaded);
+				success = false;
+			}
+		}
+		for (int t = 0; t < TEXTURE_COUNT; t++) {
+			const Texture & texture = asset_manager.get_texture(TextureHandle { t });
+
+			bool is_loaded = asset_manager.is_loaded(TextureHandle { t });
+			float expected = is_loaded ? 0.0f : 0.5f; // Green channel of the default Texture or placeholder
+
+			if (texture.width != 1 || texture.height != 1 || reinterpret_cast<const Vector4 *>(texture.data.data())->y != expected) {
+				IO::print("Texture {} does not match expected contents (loaded: {})\n"_sv, t, is_loaded);
+				success = false;
+			}
+		}
+	};
+
+	Array<int> mesh_data_poll_counts(MESH_DATA_COUNT);
+	Array<int> texture_poll_counts  (TEXTURE_COUNT);
+
+	int poll_count = 0;
+
+	while (asset_manager.is_loading()) {
+		check_placeholders();
+
+		LoadedAsset loaded_asset;
+		if (!asset_manager.poll_loaded(loaded_asset)) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		switch (loaded_asset.type) {
+			case LoadedAsset::Type::MESH_DATA: mesh_data_poll_counts[loaded_asset.handle]++; break;
+			case LoadedAsset::Type::TEXTURE:   texture_poll_counts  [loaded_asset.handle]++; break;
+		}
+		poll_count++;
+	}
+
+	check_placeholders();
+
+	for (int m = 0; m < MESH_DATA_COUNT; m++) {
+		if (mesh_data_poll_counts[m] != 1) {
+			IO::print("MeshData {} was polled {} times!\n"_sv, m, mesh_data_poll_counts[m]);
+			success = false;
+		}
+		const MeshData & mesh_data = asset_manager.get_mesh_data(MeshDataHandle { m });
+		for (size_t t = 0; t < mesh_data.triangles.size(); t++) {
+			const AABB & aabb = mesh_data.triangles[t].aabb;
+			if (aabb.min.x < mesh_data.aabb.min.x || aabb.min.y < mesh_data.aabb.min.y || aabb.min.z < mesh_data.aabb.min.z ||
+				aabb.max.x > mesh_data.aabb.max.x || aabb.max.y > mesh_data.aabb.max.y || aabb.max.z > mesh_data.aabb.max.z) {
+				IO::print("AABB of MeshData {} does not contain Triangle {}!\n"_sv, m, t);
+				success = false;
+				break;
+			}
+		}
+	}
+	for (int t = 0; t < TEXTURE_COUNT; t++) {
+		if (texture_poll_counts[t] != 1) {
+			IO::print("Texture {} was polled {} times!\n"_sv, t, texture_poll_counts[t]);
+			success = false;
+		}
+	}
+
+	// Nothing should be left for wait_until_loaded
+	LoadedAsset loaded_asset;
+	if (asset_manager.poll_loaded(loaded_asset)) {
+		IO::print("Completion queue not empty after all assets were loaded!\n"_sv);
+		success = false;
+	}
+	asset_manager.wait_until_loaded();
+
+	IO::print("Polled {} assets: {}\n"_sv, poll_count, success ? "OK"_sv : "FAILED"_sv);
+	return success;
+}
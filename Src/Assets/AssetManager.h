@@ -1,6 +1,7 @@
 #pragma once
 #include "Core/Array.h"
-#include "Core/HashMap.h"
+#include "Core/Queue.h"
+#include "Core/RobinHoodHashMap.h"
 #include "Core/String.h"
 #include "Core/Mutex.h"
 #include "Core/Function.h"
@@ -17,6 +18,10 @@
 
 struct ThreadPool;
 
+// MeshDatas and Textures are loaded by jobs on a ThreadPool. Until its job finishes, an asset is a placeholder:
+// MeshDatas consist of a single degenerate Triangle that rays never hit and Textures are a single grey texel.
+// Finished jobs push their asset onto a completion queue, and the asset only replaces its placeholder once
+// the queue is polled. This way the thread that polls the queue (the render thread) owns all assets at all times
 struct AssetManager {
 	Array<MeshData> mesh_datas;
 	Array<Material> materials;
@@ -26,13 +31,36 @@ struct AssetManager {
 	AssetManager(Allocator * allocator);
 	~AssetManager();
 
+	struct LoadedAsset {
+		enum struct Type {
+			MESH_DATA,
+			TEXTURE
+		} type;
+
+		int handle;
+	};
+
 private:
-	HashMap<String, MeshDataHandle> mesh_data_cache;
-	HashMap<String, TextureHandle>  texture_cache;
+	RobinHoodHashMap<String, MeshDataHandle> mesh_data_cache;
+	RobinHoodHashMap<String, TextureHandle>  texture_cache;
 
 	Mutex mesh_datas_mutex;
 	Mutex textures_mutex;
 
+	struct Completion {
+		LoadedAsset asset;
+
+		MeshData mesh_data;
+		Texture  texture;
+	};
+	Queue<Completion> completions;
+	Mutex             completions_mutex;
+
+	Array<bool> mesh_datas_loaded;
+	Array<bool> textures_loaded;
+
+	int loading_count = 0; // Number of jobs whose asset has not been polled yet
+
 	OwnPtr<ThreadPool> thread_pool;
 
 	bool assets_loaded = false;
@@ -40,6 +68,8 @@ private:
 	MeshDataHandle new_mesh_data();
 	TextureHandle  new_texture();
 
+	void complete(Completion && completion);
+
 public:
 	using FallbackLoader = Function<Array<Triangle>(const String & filename, Allocator * allocator)>;
 
@@ -53,8 +83,21 @@ public:
 
 	TextureHandle add_texture(String filename, String name);
 
+	// Moves the asset of the next finished job into place, returns false if no job has finished since the last poll. Does not block
+	bool poll_loaded(LoadedAsset & loaded_asset);
+
+	// Blocks until all jobs have finished and moves all their assets into place
 	void wait_until_loaded();
 
+	bool is_loading() const { return loading_count > 0; }
+
+	bool is_loaded(MeshDataHandle handle) const { return mesh_datas_loaded[handle.handle]; }
+	bool is_loaded(TextureHandle  handle) const { return textures_loaded  [handle.handle]; }
+
+	// Loads synthetic MeshDatas and Textures, and checks that polling the completion queue yields every asset exactly once,
+	// with the placeholders in place until then
+	static bool run_check();
+
 	MeshData & get_mesh_data(MeshDataHandle handle) { return mesh_datas[handle.handle]; }
 	Material & get_material (MaterialHandle handle) { return materials [handle.handle]; }
 	Medium   & get_medium   (MediumHandle   handle) { return media     [handle.handle]; }
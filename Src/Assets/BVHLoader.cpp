@@ -4,6 +4,7 @@
 #include <string.h>
 
 #include "Core/IO.h"
+#include "Core/Log.h"
 #include "Core/Parser.h"
 #include "Core/Allocators/StackAllocator.h"
 
@@ -41,7 +42,7 @@ bool BVHLoader::try_to_load(const String & filename, const String & bvh_filename
 	BVHFileHeader header = parser.parse_binary<BVHFileHeader>();
 
 	if (strcmp(header.filetype_identifier, "BVH") != 0) {
-		IO::print("WARNING: BVH file '{}' has an invalid header!\n"_sv, bvh_filename);
+		Log::warning(Log::Category::BVH, "BVH file '{}' has an invalid header!\n"_sv, bvh_filename);
 		return false;
 	}
 
@@ -53,7 +54,7 @@ bool BVHLoader::try_to_load(const String & filename, const String & bvh_filename
 		header.sah_cost_node       != cpu_config.sah_cost_node ||
 		header.sah_cost_leaf       != cpu_config.sah_cost_leaf
 	) {
-		IO::print("BVH file '{}' was created with different settings, rebuiling BVH from scratch.\n"_sv, bvh_filename);
+		Log::info(Log::Category::BVH, "BVH file '{}' was created with different settings, rebuiling BVH from scratch.\n"_sv, bvh_filename);
 		return false;
 	}
 
@@ -67,7 +68,7 @@ bool BVHLoader::try_to_load(const String & filename, const String & bvh_filename
 
 	ASSERT(parser.reached_end());
 
-	IO::print("Loaded BVH '{}' from disk\n"_sv, bvh_filename);
+	Log::info(Log::Category::BVH, "Loaded BVH '{}' from disk\n"_sv, bvh_filename);
 	return true;
 }
 
@@ -76,7 +77,7 @@ bool BVHLoader::save(const String & bvh_filename, const MeshData & mesh_data, co
 	fopen_s(&file, bvh_filename.data(), "wb");
 
 	if (!file) {
-		IO::print("WARNING: Unable to open BVH file '{}' for writing!\n"_sv, bvh_filename);
+		Log::warning(Log::Category::BVH, "Unable to open BVH file '{}' for writing!\n"_sv, bvh_filename);
 		return false;
 	}
 
@@ -105,7 +106,7 @@ bool BVHLoader::save(const String & bvh_filename, const MeshData & mesh_data, co
 	fclose(file);
 
 	if (!header_written || num_triangles_written < mesh_data.triangles.size() || num_bvh_nodes_written < bvh.nodes.size() || num_indices_written < bvh.indices.size()) {
-		IO::print("WARNING: Unable to successfully write to BVH file '{}'!\n"_sv, bvh_filename);
+		Log::warning(Log::Category::BVH, "Unable to successfully write to BVH file '{}'!\n"_sv, bvh_filename);
 		return false;
 	}
 
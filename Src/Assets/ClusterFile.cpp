@@ -0,0 +1,161 @@
+#include "ClusterFile.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "Core/IO.h"
+#include "Core/Log.h"
+#include "Core/Hash.h"
+
+#include "Renderer/MeshData.h"
+#include "Renderer/Integrators/GeometryAggregation.h"
+
+#include "Util/StringUtil.h"
+
+String ClusterFile::get_cluster_filename(StringView filename, Allocator * allocator) {
+	return Util::combine_stringviews(filename, StringView::from_c_str(CLUSTER_FILE_EXTENSION), allocator);
+}
+
+struct ClusterFileHeader {
+	char filetype_identifier[4];
+	char filetype_version;
+
+	int num_clusters;
+	int num_triangles;
+
+	size_t order_hash;
+};
+
+size_t ClusterFile::hash_order(const int order[], int triangle_count) {
+	return FNVHash::hash(reinterpret_cast<const char *>(order), triangle_count * sizeof(int));
+}
+
+bool ClusterFile::save(const String & cluster_filename, const Triangle triangles[], const int order[], int triangle_count) {
+	FILE * file = nullptr;
+	fopen_s(&file, cluster_filename.data(), "wb");
+
+	if (!file) {
+		Log::warning(Log::Category::ASSETS, "Unable to open cluster file '{}' for writing!\n"_sv, cluster_filename);
+		return false;
+	}
+
+	int num_clusters = Math::divide_round_up(triangle_count, CLUSTER_SIZE);
+
+	Array<ClusterInfo> clusters       (num_clusters);
+	Array<Triangle>    triangles_stored(triangle_count);
+
+	for (int c = 0; c < num_clusters; c++) {
+		ClusterInfo & cluster = clusters[c];
+		cluster.aabb           = AABB::create_empty();
+		cluster.first_triangle = c * CLUSTER_SIZE;
+		cluster.num_triangles  = Math::min(CLUSTER_SIZE, triangle_count - cluster.first_triangle);
+
+		for (int i = cluster.first_triangle; i < cluster.first_triangle + cluster.num_triangles; i++) {
+			triangles_stored[i] = triangles[order[i]];
+			cluster.aabb.expand(triangles_stored[i].aabb);
+		}
+	}
+
+	ClusterFileHeader header = { };
+	header.filetype_identifier[0] = 'C';
+	header.filetype_identifier[1] = 'L';
+	header.filetype_identifier[2] = 'U';
+	header.filetype_identifier[3] = '\0';
+	header.filetype_version = CLUSTER_FILETYPE_VERSION;
+
+	header.num_clusters  = num_clusters;
+	header.num_triangles = triangle_count;
+	header.order_hash    = hash_order(order, triangle_count);
+
+	size_t header_written        = fwrite(&header,                 sizeof(header),      1,              file);
+	size_t num_clusters_written  = fwrite(clusters        .data(), sizeof(ClusterInfo), num_clusters,   file);
+	size_t num_triangles_written = fwrite(triangles_stored.data(), sizeof(Triangle),    triangle_count, file);
+
+	fclose(file);
+
+	if (!header_written || num_clusters_written < num_clusters || num_triangles_written < triangle_count) {
+		Log::warning(Log::Category::ASSETS, "Unable to successfully write to cluster file '{}'!\n"_sv, cluster_filename);
+		return false;
+	}
+
+	return true;
+}
+
+bool ClusterFile::Reader::open(const String & cluster_filename) {
+	if (!file.open(cluster_filename)) return false;
+
+	if (file.size < sizeof(ClusterFileHeader)) {
+		Log::warning(Log::Category::ASSETS, "Cluster file '{}' is too small!\n"_sv, cluster_filename);
+		file.close();
+		return false;
+	}
+
+	ClusterFileHeader header = { };
+	memcpy(&header, file.data, sizeof(header));
+
+	if (strcmp(header.filetype_identifier, "CLU") != 0) {
+		Log::warning(Log::Category::ASSETS, "Cluster file '{}' has an invalid header!\n"_sv, cluster_filename);
+		file.close();
+		return false;
+	}
+
+	// Cluster files of an older version are silently rewritten
+	if (header.filetype_version != CLUSTER_FILETYPE_VERSION) {
+		file.close();
+		return false;
+	}
+
+	size_t expected_size = sizeof(ClusterFileHeader) + header.num_clusters * sizeof(ClusterInfo) + header.num_triangles * sizeof(Triangle);
+	if (file.size < expected_size) {
+		Log::warning(Log::Category::ASSETS, "Cluster file '{}' is truncated!\n"_sv, cluster_filename);
+		file.close();
+		return false;
+	}
+
+	num_clusters  = header.num_clusters;
+	num_triangles = header.num_triangles;
+	order_hash    = header.order_hash;
+
+	clusters  = reinterpret_cast<const ClusterInfo *>(file.data + sizeof(ClusterFileHeader));
+	triangles = reinterpret_cast<const Triangle    *>(file.data + sizeof(ClusterFileHeader) + num_clusters * sizeof(ClusterInfo));
+
+	return true;
+}
+
+void ClusterFile::Reader::read_triangles(const int order[], Triangle dst[]) const {
+	for (int i = 0; i < num_triangles; i++) {
+		dst[order[i]] = triangles[i];
+	}
+}
+
+bool ClusterFile::move_triangles(const String & cluster_filename, MeshData & mesh_data, bool force_write) {
+	int triangle_count = int(mesh_data.triangles.size());
+
+	Array<int> order(triangle_count);
+	Array<int> rank (triangle_count);
+	GeometryAggregation::calc_triangle_order(mesh_data, order.data(), rank.data());
+
+	OwnPtr<Reader> reader = make_owned<Reader>();
+
+	bool reuse =
+		!force_write &&
+		IO::file_exists(cluster_filename.view()) &&
+		reader->open(cluster_filename) &&
+		reader->num_triangles == triangle_count &&
+		reader->order_hash    == hash_order(order.data(), triangle_count);
+
+	if (reuse) {
+		Log::info(Log::Category::ASSETS, "Loaded cluster file '{}' from disk\n"_sv, cluster_filename);
+	} else {
+		reader->file.close(); // A mapped file cannot be overwritten
+		if (!save(cluster_filename, mesh_data.triangles.data(), order.data(), triangle_count) || !reader->open(cluster_filename)) {
+			Log::warning(Log::Category::ASSETS, "Triangles of '{}' are kept in memory instead\n"_sv, cluster_filename);
+			return false;
+		}
+	}
+
+	mesh_data.triangles = Array<Triangle>();
+	mesh_data.clusters  = std::move(reader);
+
+	return true;
+}
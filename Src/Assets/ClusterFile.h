@@ -0,0 +1,60 @@
+#pragma once
+#include "Core/String.h"
+
+#include "Math/AABB.h"
+
+#include "Renderer/Triangle.h"
+
+#include "Util/MappedFile.h"
+
+struct MeshData;
+
+// Cluster files store the Triangles of a MeshData in the order in which they are stored on the GPU (see GeometryAggregation::calc_triangle_order),
+// which follows the order in which the BVH first references them, split into fixed size clusters.
+// Triangles that are close together in the BVH end up in the same cluster, which makes clusters a good granularity for streaming
+namespace ClusterFile {
+	inline constexpr const char * CLUSTER_FILE_EXTENSION = ".clu";
+	inline constexpr int          CLUSTER_FILETYPE_VERSION = 2;
+
+	inline constexpr int CLUSTER_SIZE = 256; // Maximum number of Triangles per cluster
+
+	struct ClusterInfo {
+		AABB aabb;
+
+		int first_triangle;
+		int num_triangles;
+	};
+
+	String get_cluster_filename(StringView filename, Allocator * allocator);
+
+	// Identifies the order of the Triangles in a cluster file, so that a cluster file can be reused as long as the BVH it was written for does not change
+	size_t hash_order(const int order[], int triangle_count);
+
+	// Writes the Triangles such that Triangle order[i] is stored at position i
+	bool save(const String & cluster_filename, const Triangle triangles[], const int order[], int triangle_count);
+
+	struct Reader {
+		MappedFile file;
+
+		int    num_clusters  = 0;
+		int    num_triangles = 0;
+		size_t order_hash    = 0;
+
+		const ClusterInfo * clusters  = nullptr;
+		const Triangle    * triangles = nullptr;
+
+		bool open(const String & cluster_filename);
+
+		inline const Triangle * get_cluster_triangles(int cluster_index) const {
+			return triangles + clusters[cluster_index].first_triangle;
+		}
+
+		// Copies the Triangles back to their original positions, order has to be the order the cluster file was saved with
+		void read_triangles(const int order[], Triangle dst[]) const;
+	};
+
+	// Moves the Triangles of the MeshData to the cluster file, afterwards they are only accessible through MeshData::clusters.
+	// An existing cluster file is reused if it was written for the current BVH of the MeshData, unless force_write is set.
+	// If the cluster file cannot be written the Triangles stay in memory and false is returned
+	bool move_triangles(const String & cluster_filename, MeshData & mesh_data, bool force_write);
+}
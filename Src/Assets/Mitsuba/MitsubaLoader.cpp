@@ -5,7 +5,7 @@
 #include <stdlib.h>
 
 #include "Core/Array.h"
-#include "Core/HashMap.h"
+#include "Core/RobinHoodHashMap.h"
 #include "Core/Format.h"
 #include "Core/Parser.h"
 #include "Core/StringView.h"
@@ -29,9 +29,9 @@ struct ShapeGroup {
 	MaterialHandle material_handle;
 };
 
-using ShapeGroupMap = HashMap<String, ShapeGroup>;
-using MaterialMap   = HashMap<String, MaterialHandle>;
-using TextureMap    = HashMap<String, TextureHandle>;
+using ShapeGroupMap = RobinHoodHashMap<String, ShapeGroup>;
+using MaterialMap   = RobinHoodHashMap<String, MaterialHandle>;
+using TextureMap    = RobinHoodHashMap<String, TextureHandle>;
 
 static TextureHandle parse_texture(const XMLNode * node, TextureMap & texture_map, StringView path, Scene & scene, Vector3 * rgb) {
 	StringView type = node->get_attribute_value("type");
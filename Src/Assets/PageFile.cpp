@@ -0,0 +1,139 @@
+#include "PageFile.h"
+
+#include <string.h>
+
+#include "Core/IO.h"
+#include "Core/Allocators/StackAllocator.h"
+
+#include "Util/StringUtil.h"
+
+String PageFile::get_page_filename(StringView filename, Allocator * allocator) {
+	return Util::combine_stringviews(filename, StringView::from_c_str(PAGE_FILE_EXTENSION), allocator);
+}
+
+struct PageFileHeader {
+	char filetype_identifier[4];
+	char filetype_version;
+
+	char format;
+	int  channels;
+	int  width;
+	int  height;
+	int  num_levels;
+
+	int tile_dim;
+	int tile_bytes;
+	int num_tiles;
+};
+
+bool PageFile::save(const String & page_filename, const Texture & texture) {
+	FILE * file = nullptr;
+	fopen_s(&file, page_filename.data(), "wb");
+
+	if (!file) {
+		IO::print("WARNING: Unable to open page file '{}' for writing!\n"_sv, page_filename);
+		return false;
+	}
+
+	StackAllocator<KILOBYTES(1)> allocator;
+	VirtualTexture::TileLayout layout = VirtualTexture::TileLayout::from_texture(texture, &allocator);
+
+	PageFileHeader header = { };
+	header.filetype_identifier[0] = 'V';
+	header.filetype_identifier[1] = 'T';
+	header.filetype_identifier[2] = 'P';
+	header.filetype_identifier[3] = '\0';
+	header.filetype_version = PAGE_FILETYPE_VERSION;
+
+	header.format     = char(layout.format);
+	header.channels   = layout.channels;
+	header.width      = layout.width;
+	header.height     = layout.height;
+	header.num_levels = layout.levels.size();
+	header.tile_dim   = layout.tile_dim;
+	header.tile_bytes = layout.tile_bytes;
+	header.num_tiles  = layout.num_tiles;
+
+	size_t header_written = fwrite(&header, sizeof(header), 1, file);
+	size_t num_tiles_written = 0;
+
+	Array<unsigned char> tile(layout.tile_bytes);
+
+	for (int level = 0; level < layout.levels.size(); level++) {
+		const VirtualTexture::LevelLayout & level_layout = layout.levels[level];
+
+		for (int y = 0; y < level_layout.height_in_tiles; y++) {
+			for (int x = 0; x < level_layout.width_in_tiles; x++) {
+				layout.extract_tile(texture, level, x, y, tile.data());
+				num_tiles_written += fwrite(tile.data(), layout.tile_bytes, 1, file);
+			}
+		}
+	}
+
+	fclose(file);
+
+	if (!header_written || num_tiles_written < layout.num_tiles) {
+		IO::print("WARNING: Unable to successfully write to page file '{}'!\n"_sv, page_filename);
+		return false;
+	}
+
+	return true;
+}
+
+bool PageFile::Reader::open(const String & page_filename) {
+	close();
+
+	fopen_s(&file, page_filename.data(), "rb");
+	if (!file) {
+		IO::print("WARNING: Unable to open page file '{}'!\n"_sv, page_filename);
+		return false;
+	}
+
+	PageFileHeader header = { };
+	if (fread(&header, sizeof(header), 1, file) != 1 || strcmp(header.filetype_identifier, "VTP") != 0) {
+		IO::print("WARNING: Page file '{}' has an invalid header!\n"_sv, page_filename);
+		close();
+		return false;
+	}
+
+	if (header.filetype_version != PAGE_FILETYPE_VERSION) {
+		IO::print("WARNING: Page file '{}' has an unsupported version!\n"_sv, page_filename);
+		close();
+		return false;
+	}
+
+	// Reconstruct the layout from a Texture with only its metadata filled in
+	Texture texture;
+	texture.format   = Texture::Format(header.format);
+	texture.channels = header.channels;
+	texture.width    = header.width;
+	texture.height   = header.height;
+	texture.mip_offsets.resize(header.num_levels);
+
+	layout = VirtualTexture::TileLayout::from_texture(texture, layout.levels.allocator);
+
+	if (layout.tile_dim != header.tile_dim || layout.tile_bytes != header.tile_bytes || layout.num_tiles != header.num_tiles) {
+		IO::print("WARNING: Page file '{}' was created with a different tile layout!\n"_sv, page_filename);
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void PageFile::Reader::close() {
+	if (file) {
+		fclose(file);
+		file = nullptr;
+	}
+}
+
+bool PageFile::Reader::read_tile(int level, int x, int y, unsigned char * dst) const {
+	ASSERT(file);
+
+	long long offset = sizeof(PageFileHeader) + (long long)layout.tile_index(level, x, y) * layout.tile_bytes;
+
+	if (_fseeki64(file, offset, SEEK_SET) != 0) return false;
+
+	return fread(dst, layout.tile_bytes, 1, file) == 1;
+}
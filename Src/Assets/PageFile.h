@@ -0,0 +1,37 @@
+#pragma once
+#include <stdio.h>
+
+#include "Core/String.h"
+
+#include "Renderer/VirtualTexture.h"
+
+// Page files store a Texture as a flat sequence of fixed size tiles (see Renderer/VirtualTexture.h),
+// ordered by mip level, then row major. This allows any single tile to be read with one seek
+namespace PageFile {
+	inline constexpr const char * PAGE_FILE_EXTENSION = ".vtp";
+	inline constexpr int          PAGE_FILETYPE_VERSION = 1;
+
+	String get_page_filename(StringView filename, Allocator * allocator);
+
+	bool save(const String & page_filename, const Texture & texture);
+
+	struct Reader {
+		FILE * file = nullptr;
+
+		VirtualTexture::TileLayout layout;
+
+		Reader(Allocator * allocator = nullptr) : layout(allocator) { }
+
+		NON_COPYABLE(Reader);
+		NON_MOVEABLE(Reader);
+
+		~Reader() {
+			close();
+		}
+
+		bool open(const String & page_filename);
+		void close();
+
+		bool read_tile(int level, int x, int y, unsigned char * dst) const;
+	};
+}
@@ -12,13 +12,14 @@
 
 #include "Core/Parser.h"
 #include "Core/Allocators/StackAllocator.h"
+#include "Core/Allocators/TrackingAllocator.h"
 
 #include "Math/Mipmap.h"
 #include "Util/Util.h"
 
-bool TextureLoader::load_dds(const String & filename, Texture * texture) {
-	StackAllocator<KILOBYTES(8)> allocator;
-	String file = IO::file_read(filename, &allocator);
+bool TextureLoader::load_dds(const String & filename, Texture * texture, Allocator * allocator) {
+	StackAllocator<KILOBYTES(8)> stack_allocator(allocator);
+	String file = IO::file_read(filename, &stack_allocator);
 	Parser parser(file.view(), filename.view());
 
 	// Based on: https://docs.microsoft.com/en-us/windows/win32/direct3ddds/dds-header
@@ -126,7 +127,7 @@ static void mip_count(int width, int height, int & mip_levels, int & pixel_count
 	}
 }
 
-bool TextureLoader::load_stb(const String & filename, Texture * texture) {
+bool TextureLoader::load_stb(const String & filename, Texture * texture, Allocator * allocator) {
 	unsigned char * data = stbi_load(filename.data(), &texture->width, &texture->height, &texture->channels, STBI_rgb_alpha);
 
 	if (data == nullptr || texture->width == 0 || texture->height == 0) {
@@ -139,8 +140,9 @@ bool TextureLoader::load_stb(const String & filename, Texture * texture) {
 	int pixel_count = 0;
 	mip_count(texture->width, texture->height, mip_levels, pixel_count);
 
-	LinearAllocator<MEGABYTES(8)> allocator;
-	Array<Vector4> data_rgba(pixel_count, &allocator);
+	TrackingAllocator scratch_allocator("Texture Processing"_sv, allocator);
+
+	Array<Vector4> data_rgba(pixel_count, &scratch_allocator);
 
 	// Copy the data over into Mipmap level 0, and convert it to linear colour space
 	for (int i = 0; i < texture->width * texture->height; i++) {
@@ -168,7 +170,7 @@ bool TextureLoader::load_stb(const String & filename, Texture * texture) {
 
 		int level = 1;
 
-		Array<Vector4> temp((texture->width / 2) * texture->height, &allocator); // Intermediate storage used when performing seperable filtering
+		Array<Vector4> temp((texture->width / 2) * texture->height, &scratch_allocator); // Intermediate storage used when performing seperable filtering
 
 		while (true) {
 			if (cpu_config.mipmap_filter == MipmapFilterType::BOX) {
@@ -3,7 +3,8 @@
 
 #include "Renderer/Texture.h"
 
+// The allocator is only used for scratch memory, the resulting Texture data is always allocated on the heap
 namespace TextureLoader {
-	bool load_dds(const String & filename, Texture * texture);
-	bool load_stb(const String & filename, Texture * texture);
+	bool load_dds(const String & filename, Texture * texture, Allocator * allocator = nullptr);
+	bool load_stb(const String & filename, Texture * texture, Allocator * allocator = nullptr);
 }
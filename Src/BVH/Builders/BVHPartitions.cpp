@@ -4,8 +4,9 @@
 #include "Renderer/Triangle.h"
 
 // Evaluates SAH for every object for every dimension to determine splitting candidate
+// The AABBs are first gathered into SoA layout, so that the left and right sweeps can use the vectorized AABBSoA kernels
 template<typename GetAABB>
-ObjectSplit partition_sah_impl(GetAABB get_aabb, int first_index, int index_count, float * sah) {
+ObjectSplit partition_sah_impl(GetAABB get_aabb, int first_index, int index_count, BVHPartitions::SAHScratch & scratch) {
 	ObjectSplit split = { };
 	split.cost = INFINITY;
 	split.index     = -1;
@@ -13,62 +14,67 @@ ObjectSplit partition_sah_impl(GetAABB get_aabb, int first_index, int index_coun
 	split.aabb_left  = AABB::create_empty();
 	split.aabb_right = AABB::create_empty();
 
+	scratch.reserve(index_count);
+
+	float * surface_areas_left  = scratch.surface_areas_left .data();
+	float * surface_areas_right = scratch.surface_areas_right.data();
+
 	// Check splits along all 3 dimensions
 	for (int dimension = 0; dimension < 3; dimension++) {
-		AABB aabb_left  = AABB::create_empty();
-		AABB aabb_right = AABB::create_empty();
+		for (int i = 0; i < index_count; i++) {
+			scratch.aabbs.set(i, get_aabb(dimension, first_index + i));
+		}
 
-		// First traverse left to right along the current dimension to evaluate first half of the SAH
-		for (int i = 1; i < index_count; i++) {
-			aabb_left.expand(get_aabb(dimension, first_index + i - 1));
+		// surface_areas_left[i] contains the surface area of the first i + 1 AABBs, surface_areas_right[i] that of the last index_count - i AABBs
+		scratch.aabbs.prefix_surface_areas(index_count, surface_areas_left);
+		scratch.aabbs.suffix_surface_areas(index_count, surface_areas_right);
 
-			sah[i] = aabb_left.surface_area() * float(i);
-		}
+		int best_index = -1;
 
-		// Then traverse right to left along the current dimension to evaluate second half of the SAH
+		// Traverse right to left along the current dimension, ties are resolved the same way as in a scalar right to left sweep
 		for (int i = index_count - 1; i > 0; i--) {
-			aabb_right.expand(get_aabb(dimension, first_index + i));
-
-			float cost = sah[i] + aabb_right.surface_area() * float(index_count - i);
+			float cost = surface_areas_left[i - 1] * float(i) + surface_areas_right[i] * float(index_count - i);
 			if (cost <= split.cost) {
 				split.cost = cost;
 				split.index = first_index + i;
 				split.dimension = dimension;
-				split.aabb_right = aabb_right;
+
+				best_index = i;
 			}
 		}
 
-		ASSERT(!aabb_left .is_empty());
-		ASSERT(!aabb_right.is_empty());
-	}
+		// The SoA AABBs are overwritten by the next dimension, so calculate the child AABBs now
+		if (best_index != -1) {
+			split.aabb_left  = scratch.aabbs.unify(0, best_index);
+			split.aabb_right = scratch.aabbs.unify(best_index, index_count);
 
-	// Calculate left AABB, right AABB was already calculated above
-	for (int i = first_index; i < split.index; i++) {
-		split.aabb_left.expand(get_aabb(split.dimension, i));
+			ASSERT(!split.aabb_left .is_empty());
+			ASSERT(!split.aabb_right.is_empty());
+		}
 	}
 
 	return split;
 }
 
-ObjectSplit BVHPartitions::partition_sah(const Array<Triangle> & triangles, int * indices[3], int first_index, int index_count, float * sah) {
+ObjectSplit BVHPartitions::partition_sah(const Array<Triangle> & triangles, int * indices[3], int first_index, int index_count, SAHScratch & scratch) {
 	auto get_aabb = [&triangles, &indices](int dimension, int index) {
 		return triangles[indices[dimension][index]].aabb;
 	};
-	return partition_sah_impl(get_aabb, first_index, index_count, sah);
+	return partition_sah_impl(get_aabb, first_index, index_count, scratch);
 }
 
-ObjectSplit BVHPartitions::partition_sah(const Array<Mesh> & meshes, int * indices[3], int first_index, int index_count, float * sah) {
+ObjectSplit BVHPartitions::partition_sah(const Array<Mesh> & meshes, int * indices[3], int first_index, int index_count, SAHScratch & scratch) {
 	auto get_aabb = [&meshes, &indices](int dimension, int index) {
 		return meshes[indices[dimension][index]].aabb;
 	};
-	return partition_sah_impl(get_aabb, first_index, index_count, sah);
+	return partition_sah_impl(get_aabb, first_index, index_count, scratch);
 }
 
-ObjectSplit BVHPartitions::partition_sah(Array<PrimitiveRef> primitive_refs[3], int first_index, int index_count, float * sah) {
+ObjectSplit BVHPartitions::partition_sah(Array<PrimitiveRef> primitive_refs[3], int first_index, int index_count, SAHScratch & scratch) {
 	auto get_aabb = [&primitive_refs](int dimension, int index) {
 		return primitive_refs[dimension][index].aabb;
 	};
-	return partition_sah_impl(get_aabb, first_index, index_count, sah);
+	return partition_sah_impl(get_aabb, first_index, index_count, scratch);
 }
 
 void BVHPartitions::triangle_intersect_plane(Vector3 vertices[3], int dimension, float plane, Vector3 intersections[], int * intersection_count) {
@@ -3,6 +3,7 @@
 
 #include "Math/Math.h"
 #include "Math/AABB.h"
+#include "Math/AABBSoA.h"
 
 #include "Util/Util.h"
 
@@ -41,10 +42,32 @@ struct SpatialSplit {
 namespace BVHPartitions {
 	inline constexpr int SBVH_BIN_COUNT = 256;
 
-	ObjectSplit partition_sah(const Array<Triangle> & triangles, int * indices[3], int first_index, int index_count, float * sah);
-	ObjectSplit partition_sah(const Array<Mesh>     & meshes,    int * indices[3], int first_index, int index_count, float * sah);
+	// Scratch memory used by partition_sah, grows as needed
+	struct SAHScratch {
+		AABBSoA aabbs; // AABBs of the primitives that are being partitioned, in sorted order along the current dimension
 
-	ObjectSplit partition_sah(Array<PrimitiveRef> primitive_refs[3], int first_index, int index_count, float * sah);
+		Array<float> surface_areas_left;
+		Array<float> surface_areas_right;
+
+		SAHScratch(size_t primitive_count = 0, Allocator * allocator = nullptr) :
+			aabbs              (primitive_count, allocator),
+			surface_areas_left (primitive_count, allocator),
+			surface_areas_right(primitive_count, allocator)
+		{ }
+
+		void reserve(size_t count) {
+			if (aabbs.size() >= count) return;
+
+			aabbs.resize(count);
+			surface_areas_left .resize(count);
+			surface_areas_right.resize(count);
+		}
+	};
+
+	ObjectSplit partition_sah(const Array<Triangle> & triangles, int * indices[3], int first_index, int index_count, SAHScratch & scratch);
+	ObjectSplit partition_sah(const Array<Mesh>     & meshes,    int * indices[3], int first_index, int index_count, SAHScratch & scratch);
+
+	ObjectSplit partition_sah(Array<PrimitiveRef> primitive_refs[3], int first_index, int index_count, SAHScratch & scratch);
 
 	void triangle_intersect_plane(Vector3 vertices[3], int dimension, float plane, Vector3 intersections[], int * intersection_count);
 
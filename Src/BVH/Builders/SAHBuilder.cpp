@@ -1,7 +1,5 @@
 #include "SAHBuilder.h"
 
-#include <new>
-
 #include "Core/Sort.h"
 
 #include "BVH/BVH.h"
@@ -22,7 +20,7 @@ static void build_bvh_recursive(SAHBuilder & builder, BVHNode2 & node, const Arr
 		return;
 	}
 
-	ObjectSplit split = BVHPartitions::partition_sah(primitives, indices, first_index, index_count, new(builder.scratch.data()) float[index_count]);
+	ObjectSplit split = BVHPartitions::partition_sah(primitives, indices, first_index, index_count, builder.sah_scratch);
 
 	for (int i = first_index; i < split.index;               i++) builder.indices_going_left[indices[split.dimension][i]] = true;
 	for (int i = split.index; i < first_index + index_count; i++) builder.indices_going_left[indices[split.dimension][i]] = false;
@@ -32,7 +30,7 @@ static void build_bvh_recursive(SAHBuilder & builder, BVHNode2 & node, const Arr
 
 		int left  = 0;
 		int right = split.index - first_index;
-		int * temp = new(builder.scratch.data()) int[index_count];
+		int * temp = builder.scratch.data();
 
 		for (int i = first_index; i < first_index + index_count; i++) {
 			int index = indices[dim][i];
@@ -79,12 +77,22 @@ static void build_bvh_impl(SAHBuilder & builder, const Array<Primitive> & primit
 	}
 	builder.bvh.nodes[0].aabb = root_aabb;
 
-	Sort::quick_sort(builder.indices_x.begin(), builder.indices_x.end(), [&primitives](int a, int b) { return primitives[a].get_center().x < primitives[b].get_center().x; });
-	Sort::quick_sort(builder.indices_y.begin(), builder.indices_y.end(), [&primitives](int a, int b) { return primitives[a].get_center().y < primitives[b].get_center().y; });
-	Sort::quick_sort(builder.indices_z.begin(), builder.indices_z.end(), [&primitives](int a, int b) { return primitives[a].get_center().z < primitives[b].get_center().z; });
-
 	int * indices[3] = { builder.indices_x.data(), builder.indices_y.data(), builder.indices_z.data() };
 
+	// Sort indices along each axis by centroid, using radix sort on order preserving integer keys
+	{
+		Array<unsigned> keys       (primitives.size());
+		Array<unsigned> tmp_keys   (primitives.size());
+		Array<int>      tmp_indices(primitives.size());
+
+		for (int dimension = 0; dimension < 3; dimension++) {
+			for (size_t i = 0; i < primitives.size(); i++) {
+				keys[i] = Sort::float_to_radix_key(primitives[indices[dimension][i]].get_center()[dimension]);
+			}
+			Sort::radix_sort(keys.data(), indices[dimension], tmp_keys.data(), tmp_indices.data(), primitives.size());
+		}
+	}
+
 	build_bvh_recursive(builder, builder.bvh.nodes[0], primitives, indices, 0, primitives.size());
 	ASSERT(builder.bvh.nodes.size() <= 2 * primitives.size());
 
@@ -1,7 +1,9 @@
 #pragma once
 #include "Core/BitArray.h"
+#include "Core/MemoryTracker.h"
 
 #include "BVH/BVH.h"
+#include "BVHPartitions.h"
 
 struct Triangle;
 struct Mesh;
@@ -13,7 +15,9 @@ struct SAHBuilder {
 	Array<int> indices_y;
 	Array<int> indices_z;
 
-	Array<char> scratch; // Used to store intermediate SAH results and reorder indices
+	BVHPartitions::SAHScratch sah_scratch;
+
+	Array<int> scratch; // Used to reorder indices
 	BitArray indices_going_left;
 
 	SAHBuilder(BVH2 & bvh, size_t primitive_count) :
@@ -21,7 +25,8 @@ struct SAHBuilder {
 		indices_x(primitive_count),
 		indices_y(primitive_count),
 		indices_z(primitive_count),
-		scratch(primitive_count * Math::max(sizeof(float), sizeof(int))),
+		sah_scratch(primitive_count, MemoryTracker::get_allocator("BVH Build"_sv)),
+		scratch    (primitive_count, MemoryTracker::get_allocator("BVH Build"_sv)),
 		indices_going_left(primitive_count)
 	{
 		for (int i = 0; i < primitive_count; i++) {
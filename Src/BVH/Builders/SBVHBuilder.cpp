@@ -39,9 +39,29 @@ void SBVHBuilder::build(const Array<Triangle> & triangles) {
 
 	inv_root_surface_area = 1.0f / root_aabb.surface_area();
 
-	Sort::quick_sort(indices[0].begin(), indices[0].end(), [](const PrimitiveRef & a, const PrimitiveRef & b) { return a.aabb.get_center().x < b.aabb.get_center().x; });
-	Sort::quick_sort(indices[1].begin(), indices[1].end(), [](const PrimitiveRef & a, const PrimitiveRef & b) { return a.aabb.get_center().y < b.aabb.get_center().y; });
-	Sort::quick_sort(indices[2].begin(), indices[2].end(), [](const PrimitiveRef & a, const PrimitiveRef & b) { return a.aabb.get_center().z < b.aabb.get_center().z; });
+	// Sort along each axis by centroid, using radix sort on order preserving integer keys
+	{
+		size_t triangle_count = triangles.size();
+
+		AABBSoA aabbs(triangle_count, indices[0].allocator);
+		for (size_t i = 0; i < triangle_count; i++) {
+			aabbs.set(i, indices[0][i].aabb);
+		}
+
+		Array<float> centers[3] = { Array<float>(triangle_count), Array<float>(triangle_count), Array<float>(triangle_count) };
+		aabbs.calc_centers(triangle_count, centers[0].data(), centers[1].data(), centers[2].data());
+
+		Array<unsigned>     keys    (triangle_count);
+		Array<unsigned>     tmp_keys(triangle_count);
+		Array<PrimitiveRef> tmp_refs(triangle_count);
+
+		for (int dimension = 0; dimension < 3; dimension++) {
+			for (size_t i = 0; i < triangle_count; i++) {
+				keys[i] = Sort::float_to_radix_key(centers[dimension][i]);
+			}
+			Sort::radix_sort(keys.data(), indices[dimension].data(), tmp_keys.data(), tmp_refs.data(), triangle_count);
+		}
+	}
 
 	sbvh.nodes.clear();
 	sbvh.nodes.reserve(2 * triangles.size());
@@ -73,7 +93,7 @@ int SBVHBuilder::build_sbvh(int node_index, const Array<Triangle> & triangles, i
 	}
 
 	// Object Split information
-	ObjectSplit object_split = BVHPartitions::partition_sah(indices, first_index, index_count, sah.data());
+	ObjectSplit object_split = BVHPartitions::partition_sah(indices, first_index, index_count, sah_scratch);
 	ASSERT(object_split.index != INVALID);
 
 	// Calculate the overlap between the child bounding boxes resulting from the Object Split
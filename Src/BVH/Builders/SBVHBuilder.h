@@ -4,6 +4,7 @@
 
 #include "Core/Array.h"
 #include "Core/BitArray.h"
+#include "Core/MemoryTracker.h"
 
 struct PrimitiveRef;
 
@@ -13,12 +14,19 @@ struct SBVHBuilder {
 	Array<PrimitiveRef> indices[3];
 
 	// Scatch memory
+	BVHPartitions::SAHScratch sah_scratch;
 	Array<float> sah;
 	BitArray indices_going_left;
 
 	float inv_root_surface_area;
 
-	SBVHBuilder(BVH2 & sbvh, size_t triangle_count) : sbvh(sbvh), sah(triangle_count), indices_going_left(triangle_count) { }
+	SBVHBuilder(BVH2 & sbvh, size_t triangle_count, Allocator * allocator = MemoryTracker::get_allocator("BVH Build"_sv)) :
+		sbvh(sbvh),
+		indices { Array<PrimitiveRef>(allocator), Array<PrimitiveRef>(allocator), Array<PrimitiveRef>(allocator) },
+		sah_scratch(triangle_count, allocator),
+		sah(triangle_count, allocator),
+		indices_going_left(triangle_count)
+	{ }
 
 	void build(const Array<Triangle> & triangles); // SAH-based object + spatial splits, Stich et al. 2009 (Triangles only)
 
@@ -0,0 +1,620 @@
+#include "LightBVH.h"
+
+#include <math.h>
+
+#include "Core/IO.h"
+#include "Core/Random.h"
+#include "Core/Timer.h"
+#include "Core/MemoryTracker.h"
+
+#include "Math/Math.h"
+
+#include "Renderer/Triangle.h"
+
+#include "Util/Util.h"
+#include "Util/Check.h"
+
+static constexpr int NUM_BUCKETS = 12;
+
+static float safe_sqrt(float x) {
+	return sqrtf(Math::max(x, 0.0f));
+}
+
+static float safe_acos(float x) {
+	return acosf(Math::clamp(x, -1.0f, 1.0f));
+}
+
+// Cone of directions that bounds the normals of a set of emitters
+struct NormalCone {
+	Vector3 axis;
+	float   cos_theta = INFINITY; // INFINITY indicates an empty cone
+	float   theta     = INFINITY; // Cached, as the angle is required by every union
+
+	static NormalCone make(const Vector3 & axis, float cos_theta) {
+		return { axis, cos_theta, safe_acos(cos_theta) };
+	}
+
+	inline bool is_empty() const {
+		return cos_theta == INFINITY;
+	}
+
+	static NormalCone unify(const NormalCone & a, const NormalCone & b) {
+		if (a.is_empty()) return b;
+		if (b.is_empty()) return a;
+
+		float cos_theta_d = Vector3::dot(a.axis, b.axis);
+
+		// Common case of a single direction that is already contained in a
+		if (b.cos_theta == 1.0f && cos_theta_d >= a.cos_theta) return a;
+
+		float theta_d = safe_acos(cos_theta_d);
+
+		// Check if one cone already contains the other
+		if (Math::min(theta_d + b.theta, PI) <= a.theta) return a;
+		if (Math::min(theta_d + a.theta, PI) <= b.theta) return b;
+
+		float theta_o = 0.5f * (a.theta + theta_d + b.theta);
+		if (theta_o >= PI) return { a.axis, -1.0f, PI };
+
+		Vector3 rotation_axis = Vector3::cross(a.axis, b.axis);
+		if (Vector3::length_squared(rotation_axis) == 0.0f) return { a.axis, -1.0f, PI };
+
+		// Rotate the axis of a towards the axis of b (Rodrigues' formula, the rotation axis is perpendicular to a.axis)
+		float theta_r = theta_o - a.theta;
+		Vector3 k = Vector3::normalize(rotation_axis);
+		Vector3 axis = a.axis * cosf(theta_r) + Vector3::cross(k, a.axis) * sinf(theta_r);
+
+		return { Vector3::normalize(axis), cosf(theta_o), theta_o };
+	}
+};
+
+struct BuildPrimitive {
+	AABB       aabb;
+	Vector3    centroid;
+	NormalCone cone;
+	float      power;
+	int        index;
+};
+
+struct LightBucket {
+	AABB       aabb = AABB::create_empty();
+	NormalCone cone;
+	float      power = 0.0f;
+	int        count = 0;
+
+	void expand(const BuildPrimitive & primitive) {
+		aabb.expand(primitive.aabb);
+		cone   = NormalCone::unify(cone, primitive.cone);
+		power += primitive.power;
+		count++;
+	}
+
+	void expand(const LightBucket & bucket) {
+		aabb.expand(bucket.aabb);
+		cone   = NormalCone::unify(cone, bucket.cone);
+		power += bucket.power;
+		count += bucket.count;
+	}
+};
+
+// Unlike AABB::surface_area this allows AABBs that are flat along some dimension, which is common for lights
+static float surface_area(const AABB & aabb) {
+	Vector3 diff = aabb.max - aabb.min;
+	return 2.0f * (diff.x * diff.y + diff.y * diff.z + diff.z * diff.x);
+}
+
+// Integral of the cosine weighted directions that a cone of normals with emission angle theta_e = pi/2 can emit in (M_Omega in the paper)
+static float orientation_measure(const NormalCone & cone) {
+	float theta_o     = cone.theta;
+	float cos_theta_o = cone.cos_theta;
+	float theta_w = Math::min(theta_o + 0.5f * PI, PI);
+	float sin_theta_o = safe_sqrt(1.0f - cos_theta_o * cos_theta_o);
+
+	return TWO_PI * (1.0f - cos_theta_o) + 0.5f * PI * (2.0f * theta_w * sin_theta_o - cosf(theta_o - 2.0f * theta_w) - 2.0f * theta_o * sin_theta_o + cos_theta_o);
+}
+
+static float saoh_cost(const LightBucket & bucket, float regularization) {
+	if (bucket.count == 0) return 0.0f;
+
+	return bucket.power * orientation_measure(bucket.cone) * surface_area(bucket.aabb) * regularization;
+}
+
+LightBVH::LightBVH() : nodes(MemoryTracker::get_allocator("Light BVH"_sv)), leaves(MemoryTracker::get_allocator("Light BVH"_sv)) { }
+
+void LightBVH::build(const Triangle triangles[], int triangle_count) {
+	Array<LightBVHPrimitive> primitives(triangle_count, MemoryTracker::get_allocator("Light BVH"_sv));
+
+	for (int i = 0; i < triangle_count; i++) {
+		const Triangle & triangle = triangles[i];
+
+		Vector3 cross = Vector3::cross(
+			triangle.position_1 - triangle.position_0,
+			triangle.position_2 - triangle.position_0
+		);
+		float cross_length = Vector3::length(cross);
+
+		// Lights are shaded using interpolated vertex normals, the cone needs to bound those as well as the geometric normal
+		Vector3 normals[4] = { triangle.normal_0, triangle.normal_1, triangle.normal_2, cross / cross_length };
+		int num_normals = cross_length > 0.0f ? 4 : 3;
+
+		NormalCone cone;
+		for (int n = 0; n < num_normals; n++) {
+			cone = NormalCone::unify(cone, NormalCone::make(Vector3::normalize(normals[n]), 1.0f));
+		}
+		// Interpolated normals are only guaranteed to stay within cones narrower than a hemisphere
+		if (cone.cos_theta < 0.0f) {
+			cone = NormalCone::make(cone.axis, -1.0f);
+		}
+
+		primitives[i].aabb        = triangle.aabb;
+		primitives[i].axis        = cone.axis;
+		primitives[i].cos_theta_o = cone.cos_theta;
+		primitives[i].power       = 0.5f * cross_length;
+	}
+
+	build(primitives.data(), triangle_count);
+}
+
+void LightBVH::build(const LightBVHPrimitive light_primitives[], int primitive_count) {
+	ASSERT(primitive_count > 0);
+
+	Allocator * allocator = MemoryTracker::get_allocator("Light BVH"_sv);
+
+	// Primitives are partitioned in place, rather than through an index array, to keep the sweeps over them coherent in memory
+	Array<BuildPrimitive> primitives(primitive_count, allocator);
+
+	for (int i = 0; i < primitive_count; i++) {
+		primitives[i].aabb     = light_primitives[i].aabb;
+		primitives[i].centroid = light_primitives[i].aabb.get_center();
+		primitives[i].cone     = NormalCone::make(light_primitives[i].axis, light_primitives[i].cos_theta_o);
+		primitives[i].power    = light_primitives[i].power;
+
+		primitives[i].index    = i;
+	}
+
+	nodes.clear();
+	nodes.reserve(2 * primitive_count - 1);
+	leaves.resize(primitive_count);
+
+	struct Task {
+		int node_index;
+		int first;
+		int count;
+	};
+	Array<Task> stack(allocator);
+
+	LightBVHNode & root = nodes.emplace_back();
+	root.parent = INVALID;
+
+	stack.push_back({ 0, 0, primitive_count });
+
+	while (stack.size() > 0) {
+		Task task = stack.back();
+		stack.pop_back();
+
+		if (task.count == 1) {
+			const BuildPrimitive & primitive = primitives[task.first];
+
+			LightBVHNode & node = nodes[task.node_index];
+			node.aabb        = primitive.aabb;
+			node.axis        = primitive.cone.axis;
+			node.cos_theta_o = primitive.cone.cos_theta;
+			node.power       = primitive.power;
+			node.left        = INVALID;
+			node.index       = primitive.index;
+
+			leaves[primitive.index] = task.node_index;
+			continue;
+		}
+
+		AABB aabb           = AABB::create_empty();
+		AABB aabb_centroids = AABB::create_empty();
+		for (int i = task.first; i < task.first + task.count; i++) {
+			aabb          .expand(primitives[i].aabb);
+			aabb_centroids.expand(primitives[i].centroid);
+		}
+
+		Vector3 extent = aabb.max - aabb.min;
+		float max_extent = Math::max(Math::max(extent.x, extent.y), extent.z);
+
+		float best_cost      = INFINITY;
+		int   best_dimension = -1;
+		int   best_bucket    = -1;
+
+		auto get_bucket_index = [&](const BuildPrimitive & primitive, int dimension) {
+			float min    = aabb_centroids.min[dimension];
+			float extent = aabb_centroids.max[dimension] - min;
+			return Math::min(int(float(NUM_BUCKETS) * (primitive.centroid[dimension] - min) / extent), NUM_BUCKETS - 1);
+		};
+
+		for (int dimension = 0; dimension < 3; dimension++) {
+			if (aabb_centroids.max[dimension] <= aabb_centroids.min[dimension]) continue;
+
+			LightBucket buckets[NUM_BUCKETS];
+			for (int i = task.first; i < task.first + task.count; i++) {
+				const BuildPrimitive & primitive = primitives[i];
+				buckets[get_bucket_index(primitive, dimension)].expand(primitive);
+			}
+
+			// Penalizes thin Nodes when splitting along their short dimensions
+			float regularization = max_extent / extent[dimension];
+
+			float cost_right[NUM_BUCKETS - 1];
+			LightBucket right;
+			for (int b = NUM_BUCKETS - 1; b > 0; b--) {
+				right.expand(buckets[b]);
+				cost_right[b - 1] = right.count > 0 ? saoh_cost(right, regularization) : INFINITY;
+			}
+
+			LightBucket left;
+			for (int b = 0; b < NUM_BUCKETS - 1; b++) {
+				left.expand(buckets[b]);
+				if (left.count == 0) continue;
+
+				float cost = saoh_cost(left, regularization) + cost_right[b];
+				if (cost < best_cost) {
+					best_cost      = cost;
+					best_dimension = dimension;
+					best_bucket    = b;
+				}
+			}
+		}
+
+		int split_count;
+		if (best_dimension == -1) {
+			// All centroids coincide, split in the middle
+			split_count = task.count / 2;
+		} else {
+			BuildPrimitive * first = primitives.data() + task.first;
+			BuildPrimitive * last  = primitives.data() + task.first + task.count;
+			while (first < last) {
+				if (get_bucket_index(*first, best_dimension) <= best_bucket) {
+					first++;
+				} else {
+					last--;
+					Util::swap(*first, *last);
+				}
+			}
+			split_count = int(first - (primitives.data() + task.first));
+		}
+		ASSERT(split_count > 0 && split_count < task.count);
+
+		int left = int(nodes.size());
+		nodes.emplace_back().parent = task.node_index;
+		nodes.emplace_back().parent = task.node_index;
+
+		nodes[task.node_index].left     = left;
+		nodes[task.node_index].index    = INVALID;
+
+		stack.push_back({ left + 1, task.first + split_count, task.count - split_count });
+		stack.push_back({ left,     task.first,               split_count });
+	}
+
+	// Children are always located after their parent, so a reverse sweep visits them first
+	for (int i = int(nodes.size()) - 1; i >= 0; i--) {
+		LightBVHNode & node = nodes[i];
+		if (node.is_leaf()) continue;
+
+		const LightBVHNode & child_left  = nodes[node.left];
+		const LightBVHNode & child_right = nodes[node.left + 1];
+
+		NormalCone cone = NormalCone::unify(
+			NormalCone::make(child_left .axis, child_left .cos_theta_o),
+			NormalCone::make(child_right.axis, child_right.cos_theta_o)
+		);
+
+		node.aabb        = AABB::unify(child_left.aabb, child_right.aabb);
+		node.axis        = cone.axis;
+		node.cos_theta_o = cone.cos_theta;
+		node.power       = child_left.power + child_right.power;
+	}
+}
+
+// cos(max(0, a - b)) and sin(max(0, a - b)) given the sines and cosines of a and b
+static float cos_sub_clamped(float sin_a, float cos_a, float sin_b, float cos_b) {
+	if (cos_a > cos_b) return 1.0f;
+	return cos_a * cos_b + sin_a * sin_b;
+}
+
+static float sin_sub_clamped(float sin_a, float cos_a, float sin_b, float cos_b) {
+	if (cos_a > cos_b) return 0.0f;
+	return sin_a * cos_b - cos_a * sin_b;
+}
+
+// Conservative bound on the contribution of the Node to the given point, must match light_bvh_importance in CUDA/LightBVH.h
+static float importance(const LightBVHNode & node, const Vector3 & point) {
+	Vector3 to_point = point - node.aabb.get_center();
+
+	float distance_squared = Vector3::length_squared(to_point);
+	float radius_squared   = 0.25f * Vector3::length_squared(node.aabb.max - node.aabb.min);
+
+	// Lights are two-sided, so the angle to the axis is folded into [0, pi/2]
+	float cos_theta_w = distance_squared > 0.0f ? Math::min(fabsf(Vector3::dot(node.axis, to_point)) / sqrtf(distance_squared), 1.0f) : 1.0f;
+	float sin_theta_w = safe_sqrt(1.0f - cos_theta_w * cos_theta_w);
+
+	float cos_theta_o = node.cos_theta_o;
+	float sin_theta_o = safe_sqrt(1.0f - cos_theta_o * cos_theta_o);
+
+	// Angle subtended by the bounding sphere of the Node, if the point is inside it all directions are possible
+	float cos_theta_b = -1.0f;
+	float sin_theta_b =  0.0f;
+	if (distance_squared > radius_squared) {
+		float sin_squared_theta_b = radius_squared / distance_squared;
+		cos_theta_b = safe_sqrt(1.0f - sin_squared_theta_b);
+		sin_theta_b = sqrtf(sin_squared_theta_b);
+	}
+
+	float cos_theta_x = cos_sub_clamped(sin_theta_w, cos_theta_w, sin_theta_o, cos_theta_o);
+	float sin_theta_x = sin_sub_clamped(sin_theta_w, cos_theta_w, sin_theta_o, cos_theta_o);
+	float cos_theta_p = cos_sub_clamped(sin_theta_x, cos_theta_x, sin_theta_b, cos_theta_b);
+
+	// Triangles emit into a hemisphere (theta_e = pi/2)
+	if (cos_theta_p <= 0.0f) return 0.0f;
+
+	return node.power * cos_theta_p / Math::max(distance_squared, radius_squared);
+}
+
+static bool probability_left(const LightBVHNode nodes[], int left, const Vector3 & point, float & probability) {
+	float importance_left  = importance(nodes[left],     point);
+	float importance_right = importance(nodes[left + 1], point);
+
+	float importance_total = importance_left + importance_right;
+	if (!(importance_total > 0.0f)) return false;
+
+	probability = importance_left / importance_total;
+	return true;
+}
+
+int LightBVH::sample(const Vector3 & point, float u, float & probability) const {
+	probability = 1.0f;
+
+	int node_index = 0;
+	while (!nodes[node_index].is_leaf()) {
+		int left = nodes[node_index].left;
+
+		float probability_left;
+		if (!::probability_left(nodes.data(), left, point, probability_left)) return INVALID;
+
+		if (u < probability_left) {
+			u = Math::min(u / probability_left, ONE_MINUS_EPSILON);
+			node_index = left;
+			probability *= probability_left;
+		} else {
+			u = Math::min((u - probability_left) / (1.0f - probability_left), ONE_MINUS_EPSILON);
+			node_index = left + 1;
+			probability *= 1.0f - probability_left;
+		}
+	}
+
+	return nodes[node_index].index;
+}
+
+float LightBVH::probability(const Vector3 & point, int primitive) const {
+	float probability = 1.0f;
+
+	int node_index = leaves[primitive];
+	while (nodes[node_index].parent != INVALID) {
+		int parent = nodes[node_index].parent;
+		int left   = nodes[parent].left;
+
+		float probability_left;
+		if (!::probability_left(nodes.data(), left, point, probability_left)) return 0.0f;
+
+		probability *= node_index == left ? probability_left : 1.0f - probability_left;
+		node_index = parent;
+	}
+
+	return probability;
+}
+
+static Triangle make_triangle(const Vector3 & p0, const Vector3 & p1, const Vector3 & p2, const Vector3 & n0, const Vector3 & n1, const Vector3 & n2) {
+	Triangle triangle = { };
+	triangle.position_0 = p0;
+	triangle.position_1 = p1;
+	triangle.position_2 = p2;
+	triangle.normal_0 = n0;
+	triangle.normal_1 = n1;
+	triangle.normal_2 = n2;
+	triangle.init();
+	return triangle;
+}
+
+// Contribution of a triangle to a point, approximating the triangle by a point light at its centroid with the interpolated normal
+static double contribution(const Triangle & triangle, const Vector3 & point) {
+	Vector3 to_point = point - triangle.get_center();
+	float distance_squared = Vector3::length_squared(to_point);
+
+	Vector3 normal = Vector3::normalize(triangle.normal_0 + triangle.normal_1 + triangle.normal_2);
+	float area = 0.5f * Vector3::length(Vector3::cross(triangle.position_1 - triangle.position_0, triangle.position_2 - triangle.position_0));
+
+	return double(area) * fabs(double(Vector3::dot(normal, to_point))) / pow(double(distance_squared), 1.5);
+}
+
+static bool check_scene(StringView name, const Array<Triangle> & triangles, const Array<Vector3> & points, RNG & rng) {
+	constexpr int NUM_SAMPLES = 1000000;
+
+	int triangle_count = int(triangles.size());
+
+	LightBVH light_bvh;
+	{
+		ScopeTimer timer("Light BVH build"_sv);
+		light_bvh.build(triangles.data(), triangle_count);
+	}
+
+	bool success = true;
+
+	double total_area = 0.0;
+	for (int t = 0; t < triangle_count; t++) {
+		total_area += double(light_bvh.nodes[light_bvh.leaves[t]].power);
+	}
+
+	for (size_t p = 0; p < points.size(); p++) {
+		const Vector3 & point = points[p];
+
+		String point_name = Format().format("{} point {}"_sv, name, p);
+
+		// The probabilities of all triangles should sum to one, and be non-zero for every triangle that contributes
+		Array<double> probabilities(triangle_count);
+		Array<double> contributions(triangle_count);
+
+		double sum_probabilities = 0.0;
+		double irradiance        = 0.0;
+		for (int t = 0; t < triangle_count; t++) {
+			probabilities[t] = double(light_bvh.probability(point, t));
+			contributions[t] = contribution(triangles[t], point);
+
+			sum_probabilities += probabilities[t];
+			irradiance        += contributions[t];
+
+			if (contributions[t] > 0.0 && probabilities[t] == 0.0) {
+				IO::print("FAILED  Light BVH '{}': triangle {} contributes but can not be sampled\n"_sv, point_name, t);
+				success = false;
+			}
+		}
+
+		if (fabs(sum_probabilities - 1.0) > 1e-3) {
+			IO::print("FAILED  Light BVH '{}': probabilities sum to {}\n"_sv, point_name, float(sum_probabilities));
+			success = false;
+			continue;
+		}
+
+		// Sample frequencies should match the probabilities, and the probabilities returned by sample should match probability()
+		Array<int>    observed(triangle_count);
+		Array<double> expected(triangle_count);
+		for (int t = 0; t < triangle_count; t++) {
+			observed[t] = 0;
+			expected[t] = probabilities[t] * double(NUM_SAMPLES);
+		}
+
+		double estimate_sum         = 0.0;
+		double estimate_sum_squared = 0.0;
+		float  max_probability_error = 0.0f;
+
+		for (int s = 0; s < NUM_SAMPLES; s++) {
+			float probability;
+			int triangle = light_bvh.sample(point, Check::random_float(rng), probability);
+			if (triangle == INVALID) continue;
+
+			observed[triangle]++;
+			max_probability_error = Math::max(max_probability_error, fabsf(probability - float(probabilities[triangle])) / float(probabilities[triangle]));
+
+			double estimate = contributions[triangle] / double(probability);
+			estimate_sum         += estimate;
+			estimate_sum_squared += estimate * estimate;
+		}
+
+		if (max_probability_error > 1e-3f) {
+			IO::print("FAILED  Light BVH '{}': sampled probability deviates from probability() by {}\n"_sv, point_name, max_probability_error);
+			success = false;
+		}
+
+		success &= Check::chi_squared("Light BVH"_sv, point_name.view(), observed, expected);
+
+		// The estimator of the irradiance should be unbiased, its mean should be within a few standard errors of the exact value
+		double mean           = estimate_sum / double(NUM_SAMPLES);
+		double variance       = Math::max(estimate_sum_squared / double(NUM_SAMPLES) - mean * mean, 0.0);
+		double standard_error = sqrt(variance / double(NUM_SAMPLES));
+
+		bool unbiased = fabs(mean - irradiance) <= 5.0 * standard_error + 1e-6 * irradiance;
+		success &= unbiased;
+
+		// Compare against the variance of sampling proportional to area, which is what the alias tables do
+		double second_moment_area = 0.0;
+		for (int t = 0; t < triangle_count; t++) {
+			double probability_area = double(light_bvh.nodes[light_bvh.leaves[t]].power) / total_area;
+			if (probability_area > 0.0) {
+				second_moment_area += contributions[t] * contributions[t] / probability_area;
+			}
+		}
+		double variance_area = Math::max(second_moment_area - irradiance * irradiance, 0.0);
+
+		IO::print("{} Light BVH '{}': mean {} vs exact {} (standard error {}), variance {} vs {} with area sampling\n"_sv,
+			unbiased ? "OK     "_sv : "FAILED "_sv, point_name, float(mean), float(irradiance), float(standard_error), float(variance), float(variance_area)
+		);
+	}
+
+	return success;
+}
+
+bool LightBVH::run_check() {
+	RNG rng(1234);
+
+	bool success = true;
+
+	// Single triangle
+	{
+		Array<Triangle> triangles;
+		triangles.push_back(make_triangle(Vector3(0.0f, 0.0f, 0.0f), Vector3(1.0f, 0.0f, 0.0f), Vector3(0.0f, 1.0f, 0.0f), Vector3(0.0f, 0.0f, 1.0f), Vector3(0.0f, 0.0f, 1.0f), Vector3(0.0f, 0.0f, 1.0f)));
+
+		Array<Vector3> points;
+		points.push_back(Vector3(0.2f, 0.2f, 1.0f));
+		points.push_back(Vector3(0.2f, 0.2f, -3.0f));
+
+		success &= check_scene("single"_sv, triangles, points, rng);
+	}
+
+	// LED wall, a grid of small flat emitters
+	{
+		constexpr int GRID_SIZE = 48;
+		constexpr float CELL_SIZE = 0.1f;
+
+		Array<Triangle> triangles;
+		for (int y = 0; y < GRID_SIZE; y++) {
+			for (int x = 0; x < GRID_SIZE; x++) {
+				Vector3 p0(float(x) * CELL_SIZE, float(y) * CELL_SIZE, 0.0f);
+				Vector3 p1 = p0 + Vector3(0.5f * CELL_SIZE, 0.0f, 0.0f);
+				Vector3 p2 = p0 + Vector3(0.0f, 0.5f * CELL_SIZE, 0.0f);
+				Vector3 p3 = p0 + Vector3(0.5f * CELL_SIZE, 0.5f * CELL_SIZE, 0.0f);
+				Vector3 n(0.0f, 0.0f, 1.0f);
+
+				triangles.push_back(make_triangle(p0, p1, p2, n, n, n));
+				triangles.push_back(make_triangle(p1, p3, p2, n, n, n));
+			}
+		}
+
+		Array<Vector3> points;
+		points.push_back(Vector3(0.5f, 0.5f, 0.2f));   // Close to a corner of the wall
+		points.push_back(Vector3(2.4f, 2.4f, 10.0f));  // Far away
+		points.push_back(Vector3(2.4f, 2.4f, -0.5f));  // Behind the wall
+		points.push_back(Vector3(7.0f, 2.4f, 0.0f));   // In the plane of the wall
+
+		success &= check_scene("LED wall"_sv, triangles, points, rng);
+	}
+
+	// Randomly oriented triangles of varying sizes with smooth normals, scattered in clusters
+	{
+		constexpr int NUM_CLUSTERS  = 16;
+		constexpr int NUM_TRIANGLES = 4000;
+
+		Vector3 cluster_centers[NUM_CLUSTERS];
+		for (int c = 0; c < NUM_CLUSTERS; c++) {
+			cluster_centers[c] = 10.0f * Vector3(Check::random_float(rng), Check::random_float(rng), Check::random_float(rng));
+		}
+
+		Array<Triangle> triangles;
+		for (int t = 0; t < NUM_TRIANGLES; t++) {
+			Vector3 center = cluster_centers[rng.get_uint32(NUM_CLUSTERS)] + Check::random_direction(rng) * Check::random_float(rng);
+			float size = 0.01f + 0.2f * Check::random_float(rng) * Check::random_float(rng);
+
+			Vector3 p0 = center + size * Check::random_direction(rng);
+			Vector3 p1 = center + size * Check::random_direction(rng);
+			Vector3 p2 = center + size * Check::random_direction(rng);
+
+			Vector3 normal = Vector3::normalize(Vector3::cross(p1 - p0, p2 - p0));
+			auto perturb = [&](const Vector3 & normal) {
+				return Vector3::normalize(normal + 0.3f * Check::random_direction(rng));
+			};
+			triangles.push_back(make_triangle(p0, p1, p2, perturb(normal), perturb(normal), perturb(normal)));
+		}
+
+		Array<Vector3> points;
+		points.push_back(cluster_centers[0]); // Inside a cluster
+		points.push_back(Vector3(5.0f, 5.0f, 5.0f));
+		points.push_back(Vector3(-20.0f, 5.0f, 3.0f));
+
+		success &= check_scene("clusters"_sv, triangles, points, rng);
+	}
+
+	IO::print(success ? "All light BVH checks passed\n"_sv : "WARNING: Some light BVH checks failed!\n"_sv);
+	return success;
+}
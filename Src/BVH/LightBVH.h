@@ -0,0 +1,63 @@
+#pragma once
+#include "CUDA/Common.h"
+
+#include "Core/Array.h"
+
+#include "Math/AABB.h"
+#include "Math/Vector3.h"
+
+struct Triangle;
+
+// Node of a light BVH, see CUDA/LightBVH.h for the Device counterpart
+struct LightBVHNode {
+	AABB aabb;
+
+	Vector3 axis;        // Axis of a cone that bounds the normals of all emitters in the Node
+	float   cos_theta_o; // Cosine of the half angle of the normal cone
+
+	float power;
+
+	int left;   // Index of the left child, the right child directly follows it. INVALID for leaves
+	int index;  // Only valid for leaves, index of the primitive the BVH was built over
+	int parent; // INVALID for the root
+
+	inline bool is_leaf() const {
+		return left == INVALID;
+	}
+};
+
+static_assert(sizeof(LightBVHNode) == 56);
+
+struct LightBVHPrimitive {
+	AABB aabb;
+
+	Vector3 axis;
+	float   cos_theta_o;
+
+	float power;
+};
+
+// BVH over emitters for importance sampling of many lights
+// Based on: Conty Estevez and Kulla - Importance Sampling of Many Lights with Adaptive Tree Splitting (2018)
+// Sampling traverses the BVH stochastically, choosing between children proportional to a conservative bound on their contribution.
+// The Pathtracer uses two levels: a BVH over the triangles of every light MeshData in object space (with the triangle areas as power,
+// since the emission of a Light is constant over its Mesh), and a BVH over the light Meshes in world space
+struct LightBVH {
+	Array<LightBVHNode> nodes;  // Root at index 0, n primitives result in 2n - 1 Nodes
+	Array<int>          leaves; // For every primitive the index of the leaf Node that contains it
+
+	LightBVH();
+
+	// Builds the BVH using the Surface Area Orientation Heuristic (SAOH)
+	void build(const LightBVHPrimitive primitives[], int primitive_count);
+	void build(const Triangle          triangles [], int triangle_count);
+
+	// Host reference of the sampling routines in CUDA/LightBVH.h
+	// Returns the index of the sampled primitive, or INVALID if no primitive can contribute to the given point
+	int   sample     (const Vector3 & point, float u, float & probability) const;
+	float probability(const Vector3 & point, int primitive) const;
+
+	// Checks that the sampling probabilities of every triangle sum to one, that sampled frequencies match them,
+	// and that the resulting estimator of the irradiance from all lights is unbiased. Reports the variance compared to area sampling
+	static bool run_check();
+};
@@ -55,7 +55,7 @@ struct BSDFDiffuse {
 	}
 
 	__device__ bool has_texture() const {
-		return material.texture_id != INVALID;
+		return SCENE_HAS_TEXTURES && material.texture_id != INVALID;
 	}
 
 	__device__ bool allow_nee() const {
@@ -199,7 +199,7 @@ struct BSDFPlastic {
 	}
 
 	__device__ bool has_texture() const {
-		return material.texture_id != INVALID;
+		return SCENE_HAS_TEXTURES && material.texture_id != INVALID;
 	}
 
 	__device__ bool allow_nee() const {
@@ -312,7 +312,7 @@ struct BSDFDielectric {
 			// Update the Medium based on whether we are transmitting into or out of the Material
 			bool entering_material = eta < 1.0f;
 			if (entering_material) {
-				medium_id = material.medium_id;
+				medium_id = SCENE_HAS_MEDIA ? material.medium_id : INVALID;
 			} else {
 				medium_id = INVALID;
 			}
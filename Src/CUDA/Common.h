@@ -9,6 +9,8 @@
 #define TWO_PI          6.28318530718f
 #define ONE_OVER_TWO_PI 0.15915494309f
 
+#define ONE_MINUS_EPSILON 0x1.fffffep-1f // Largest float below 1
+
 #define INVALID -1
 
 
@@ -49,10 +51,13 @@ struct GPUConfig {
 	bool enable_mipmapping                   = true;
 	bool enable_next_event_estimation        = true;
 	bool enable_multiple_importance_sampling = true;
+	bool enable_light_bvh                    = true;
+	bool enable_sky_importance_sampling      = true;
 	bool enable_russian_roulette             = true;
 	bool enable_svgf                         = false;
 	bool enable_spatial_variance             = true;
 	bool enable_taa                          = true;
+	bool enable_ray_reordering               = false;
 
 
 	// SVGF
@@ -66,24 +71,114 @@ struct GPUConfig {
 	float sigma_l = 10.0f;
 };
 
-// Rendering is performance in batches of BATCH_SIZE pixels
-// Larger batches are more efficient, but also require more GPU memory
-#define BATCH_SIZE (1080 * 720)
-
-
 // Raytracing
 #define EPSILON 0.0001f
 #define MAX_BOUNCES 128
 
 
+// Ray statistics
+// Counters per bounce written by the Pathtracer kernels and read back by the Host, see Renderer/Integrators/RayStats.h.
+// When 0 the counters are removed from both the kernels and the Host. Disabled by default, as the atomics and the
+// per frame readback are not free; define ENABLE_RAY_STATS=1 in the preprocessor definitions of a profiling build to enable
+#ifndef ENABLE_RAY_STATS
+#define ENABLE_RAY_STATS 0
+#endif
+
+enum struct RayStat {
+	ACTIVE,           // Rays traced at this bounce
+	MISSED,           // Rays that escaped to the Sky
+	HIT_LIGHT,        // Rays that hit a Light
+	DIFFUSE,          // Rays that hit a Material of the given type
+	PLASTIC,
+	DIELECTRIC,
+	CONDUCTOR,
+	MEDIUM_SCATTER,   // Rays that scattered inside a Medium before reaching the surface
+	RUSSIAN_ROULETTE, // Paths terminated by Russian Roulette
+	LAST_BOUNCE,      // Paths terminated because they reached the last bounce
+	ABSORBED,         // Paths terminated because the BSDF did not produce a valid sample
+	SHADOW,           // Shadow Rays generated by Next Event Estimation
+
+	COUNT
+};
+
+// Accumulated over all batches of a frame
+struct RayStats {
+	unsigned counts[MAX_BOUNCES][int(RayStat::COUNT)];
+};
+
+
+// Ray reordering
+// Before every bounce after the first the Rays are sorted by a coherence key, see Renderer/Integrators/RayReorder.h.
+// The key consists of the octant of the Ray direction in the most significant bits,
+// followed by the Morton code of the Ray origin quantized to a grid over the Scene bounds
+#define RAY_REORDER_ORIGIN_BITS 4 // Per axis
+#define RAY_REORDER_KEY_BITS    (3 + 3 * RAY_REORDER_ORIGIN_BITS)
+#define RAY_REORDER_NUM_BUCKETS (1 << RAY_REORDER_KEY_BITS)
+
+#ifdef __CUDACC__
+#define HOST_DEVICE __host__ __device__
+#else
+#define HOST_DEVICE
+#endif
+
+struct RayReorderBounds {
+	float min_x,   min_y,   min_z;
+	float scale_x, scale_y, scale_z; // Number of grid cells per unit of distance along each axis
+};
+
+// Inserts two zero bits between each of the lowest 10 bits
+HOST_DEVICE inline unsigned ray_reorder_expand_bits(unsigned x) {
+	x &= 0x3ff;
+	x = (x | x << 16) & 0x030000ff;
+	x = (x | x <<  8) & 0x0300f00f;
+	x = (x | x <<  4) & 0x030c30c3;
+	x = (x | x <<  2) & 0x09249249;
+	return x;
+}
+
+// Only uses scalar floats and comparisons, so that the Host and the Device compute the exact same key.
+// Origins outside the Scene bounds (or NaN) are clamped to the grid
+HOST_DEVICE inline unsigned ray_reorder_quantize(float x, float grid_min, float grid_scale) {
+	constexpr unsigned GRID_SIZE = 1u << RAY_REORDER_ORIGIN_BITS;
+
+	float cell = (x - grid_min) * grid_scale;
+	if (!(cell > 0.0f))           return 0;
+	if (cell >= float(GRID_SIZE)) return GRID_SIZE - 1;
+	return unsigned(cell);
+}
+
+HOST_DEVICE inline unsigned ray_reorder_key(const RayReorderBounds & bounds, float origin_x, float origin_y, float origin_z, float direction_x, float direction_y, float direction_z) {
+	unsigned octant =
+		unsigned(direction_x < 0.0f)      |
+		unsigned(direction_y < 0.0f) << 1 |
+		unsigned(direction_z < 0.0f) << 2;
+
+	unsigned morton =
+		ray_reorder_expand_bits(ray_reorder_quantize(origin_x, bounds.min_x, bounds.scale_x))      |
+		ray_reorder_expand_bits(ray_reorder_quantize(origin_y, bounds.min_y, bounds.scale_y)) << 1 |
+		ray_reorder_expand_bits(ray_reorder_quantize(origin_z, bounds.min_z, bounds.scale_z)) << 2;
+
+	return octant << (3 * RAY_REORDER_ORIGIN_BITS) | morton;
+}
+
+
 // RNG
 #define PMJ_NUM_SEQUENCES 64
-#define PMJ_NUM_SAMPLES_PER_SEQUENCE 4096
+#define PMJ_NUM_SAMPLES_PER_SEQUENCE 4096 // Length of the built-in sequences, longer sequences can be loaded at runtime (see PMJ02.h)
 
 #define BLUE_NOISE_NUM_TEXTURES 16
 #define BLUE_NOISE_TEXTURE_DIM 128
 
 
+// Light sampling
+// Entry of an alias table (Vose), bin i is selected with probability 1/n,
+// after which i is returned with the given probability and the alias otherwise
+struct AliasEntry {
+	float probability;
+	int   alias; // Relative to the start of the table
+};
+
+
 // SVGF
 #define MAX_ATROUS_ITERATIONS 10
 
@@ -5,4 +5,30 @@ __device__ __constant__ int screen_width;
 __device__ __constant__ int screen_pitch;
 __device__ __constant__ int screen_height;
 
+__device__ __constant__ int batch_size; // Capacity of the ray buffers, see Renderer/Integrators/BatchSize.h
+
 __device__ __constant__ GPUConfig config;
+
+// Scene features the kernels are specialized for, passed as -D defines by the Host (see Renderer/SceneFeatures.h).
+// A feature that is not defined is assumed to be present, which results in the generic kernels that can render any Scene
+#ifndef SCENE_HAS_DIFFUSE
+#define SCENE_HAS_DIFFUSE 1
+#endif
+#ifndef SCENE_HAS_PLASTIC
+#define SCENE_HAS_PLASTIC 1
+#endif
+#ifndef SCENE_HAS_DIELECTRIC
+#define SCENE_HAS_DIELECTRIC 1
+#endif
+#ifndef SCENE_HAS_CONDUCTOR
+#define SCENE_HAS_CONDUCTOR 1
+#endif
+#ifndef SCENE_HAS_LIGHTS
+#define SCENE_HAS_LIGHTS 1
+#endif
+#ifndef SCENE_HAS_MEDIA
+#define SCENE_HAS_MEDIA 1
+#endif
+#ifndef SCENE_HAS_TEXTURES
+#define SCENE_HAS_TEXTURES 1
+#endif
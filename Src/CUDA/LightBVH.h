@@ -0,0 +1,181 @@
+#pragma once
+#include "Sampling.h"
+
+#include "Raytracing/BVH2.h"
+#include "Raytracing/Mesh.h"
+
+// Device counterpart of LightBVHNode in BVH/LightBVH.h
+struct LightBVHNode {
+	AABB aabb;
+
+	float3 axis;
+	float  cos_theta_o;
+
+	float power;
+
+	int left;
+	int index;
+	int parent;
+
+	__device__ inline bool is_leaf() const {
+		return left == INVALID;
+	}
+};
+
+// Object space BVHs over the triangles of every light MeshData, the BVH of a MeshData starts at Node 2 * light_mesh_triangle_span.x
+__device__ __constant__ const LightBVHNode * light_bvh_nodes;
+__device__ __constant__ const int          * light_bvh_leaves; // For every triangle the leaf Node that contains it, INVALID if its MeshData is not a Light
+
+// World space BVH over all light Meshes, leaves index into the 'light_mesh_*' arrays
+__device__ __constant__ const LightBVHNode * light_mesh_bvh_nodes;
+__device__ __constant__ const int          * light_mesh_bvh_leaves; // For every Mesh the leaf Node that contains it, INVALID if the Mesh is not a Light
+
+// cos(max(0, a - b)) and sin(max(0, a - b)) given the sines and cosines of a and b
+__device__ inline float cos_sub_clamped(float sin_a, float cos_a, float sin_b, float cos_b) {
+	if (cos_a > cos_b) return 1.0f;
+	return cos_a * cos_b + sin_a * sin_b;
+}
+
+__device__ inline float sin_sub_clamped(float sin_a, float cos_a, float sin_b, float cos_b) {
+	if (cos_a > cos_b) return 0.0f;
+	return sin_a * cos_b - cos_a * sin_b;
+}
+
+// Conservative bound on the contribution of the Node to the given point, see importance() in BVH/LightBVH.cpp
+__device__ inline float light_bvh_importance(const LightBVHNode & node, const float3 & point) {
+	float3 to_point = point - 0.5f * (node.aabb.min + node.aabb.max);
+
+	float3 diagonal = node.aabb.max - node.aabb.min;
+
+	float distance_squared = dot(to_point, to_point);
+	float radius_squared   = 0.25f * dot(diagonal, diagonal);
+
+	// Lights are two-sided, so the angle to the axis is folded into [0, pi/2]
+	float cos_theta_w = distance_squared > 0.0f ? fminf(fabsf(dot(node.axis, to_point)) / sqrtf(distance_squared), 1.0f) : 1.0f;
+	float sin_theta_w = safe_sqrt(1.0f - cos_theta_w * cos_theta_w);
+
+	float cos_theta_o = node.cos_theta_o;
+	float sin_theta_o = safe_sqrt(1.0f - cos_theta_o * cos_theta_o);
+
+	// Angle subtended by the bounding sphere of the Node, if the point is inside it all directions are possible
+	float cos_theta_b = -1.0f;
+	float sin_theta_b =  0.0f;
+	if (distance_squared > radius_squared) {
+		float sin_squared_theta_b = radius_squared / distance_squared;
+		cos_theta_b = safe_sqrt(1.0f - sin_squared_theta_b);
+		sin_theta_b = sqrtf(sin_squared_theta_b);
+	}
+
+	float cos_theta_x = cos_sub_clamped(sin_theta_w, cos_theta_w, sin_theta_o, cos_theta_o);
+	float sin_theta_x = sin_sub_clamped(sin_theta_w, cos_theta_w, sin_theta_o, cos_theta_o);
+	float cos_theta_p = cos_sub_clamped(sin_theta_x, cos_theta_x, sin_theta_b, cos_theta_b);
+
+	// Triangles emit into a hemisphere (theta_e = pi/2)
+	if (cos_theta_p <= 0.0f) return 0.0f;
+
+	return node.power * cos_theta_p / fmaxf(distance_squared, radius_squared);
+}
+
+__device__ inline bool light_bvh_probability_left(const LightBVHNode nodes[], int left, const float3 & point, float & probability) {
+	float importance_left  = light_bvh_importance(nodes[left],     point);
+	float importance_right = light_bvh_importance(nodes[left + 1], point);
+
+	float importance_total = importance_left + importance_right;
+	if (!(importance_total > 0.0f)) return false;
+
+	probability = importance_left / importance_total;
+	return true;
+}
+
+// Stochastically traverses the BVH starting at the given root, u is remapped at every level so it can be reused.
+// Returns the index of the sampled leaf, or INVALID if nothing in the BVH can contribute to the point.
+// The resulting pdf_scale is the selection probability relative to selecting proportional to power
+__device__ inline int light_bvh_sample(const LightBVHNode nodes[], int root, const float3 & point, float & u, float & pdf_scale) {
+	LightBVHNode node = nodes[root];
+	float root_power = node.power;
+
+	float probability = 1.0f;
+
+	while (!node.is_leaf()) {
+		float probability_left;
+		if (!light_bvh_probability_left(nodes, node.left, point, probability_left)) return INVALID;
+
+		int node_index;
+		if (u < probability_left) {
+			u = fminf(u / probability_left, ONE_MINUS_EPSILON);
+			node_index = node.left;
+			probability *= probability_left;
+		} else {
+			u = fminf((u - probability_left) / (1.0f - probability_left), ONE_MINUS_EPSILON);
+			node_index = node.left + 1;
+			probability *= 1.0f - probability_left;
+		}
+		node = nodes[node_index];
+	}
+
+	pdf_scale = probability * root_power / node.power;
+	return node.index;
+}
+
+// Walks from the leaf up to the root to find the probability of light_bvh_sample selecting the leaf
+__device__ inline float light_bvh_pdf_scale(const LightBVHNode nodes[], int leaf, const float3 & point) {
+	int node_index = leaf;
+	LightBVHNode node = nodes[node_index];
+	float leaf_power = node.power;
+
+	float probability = 1.0f;
+
+	while (node.parent != INVALID) {
+		LightBVHNode parent = nodes[node.parent];
+
+		float probability_left;
+		if (!light_bvh_probability_left(nodes, parent.left, point, probability_left)) return 0.0f;
+
+		probability *= node_index == parent.left ? probability_left : 1.0f - probability_left;
+
+		node_index = node.parent;
+		node       = parent;
+	}
+
+	return probability * node.power / leaf_power;
+}
+
+// Two level light BVH equivalent of sample_light in Sampling.h. The resulting light pdf is pdf_scale times the pdf of sample_light
+__device__ int sample_light_bvh(float u1, float u2, const float3 & point, int & transform_id, float & pdf_scale) {
+	// Pick light emitting Mesh
+	float pdf_scale_mesh;
+	int light_mesh_id = light_bvh_sample(light_mesh_bvh_nodes, 0, point, u1, pdf_scale_mesh);
+	if (light_mesh_id == INVALID) return INVALID;
+
+	transform_id = light_mesh_transform_indices[light_mesh_id];
+
+	// Pick light emitting Triangle on the Mesh, the BVH of its MeshData is in object space
+	float3 point_local = point;
+	matrix3x4_transform_position(mesh_get_transform_inv(transform_id), point_local);
+
+	int2 triangle_span = light_mesh_triangle_span[light_mesh_id];
+
+	float pdf_scale_triangle;
+	int light_triangle_id = light_bvh_sample(light_bvh_nodes, 2 * triangle_span.x, point_local, u2, pdf_scale_triangle);
+	if (light_triangle_id == INVALID) return INVALID;
+
+	pdf_scale = pdf_scale_mesh * pdf_scale_triangle;
+	return light_triangle_indices[triangle_span.x + light_triangle_id];
+}
+
+// The pdf_scale that sample_light_bvh would produce when selecting the given triangle of the given Mesh from the given point
+// Light Meshes without power are not part of the light BVHs, sample_light_bvh never selects them so their pdf_scale is 0
+__device__ float light_bvh_pdf_scale(int mesh_id, int triangle_id, const float3 & point) {
+	int mesh_leaf     = light_mesh_bvh_leaves[mesh_id];
+	int triangle_leaf = light_bvh_leaves[triangle_id];
+	if (mesh_leaf == INVALID || triangle_leaf == INVALID) return 0.0f;
+
+	float pdf_scale_mesh = light_bvh_pdf_scale(light_mesh_bvh_nodes, mesh_leaf, point);
+
+	float3 point_local = point;
+	matrix3x4_transform_position(mesh_get_transform_inv(mesh_id), point_local);
+
+	float pdf_scale_triangle = light_bvh_pdf_scale(light_bvh_nodes, triangle_leaf, point_local);
+
+	return pdf_scale_mesh * pdf_scale_triangle;
+}
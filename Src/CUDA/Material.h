@@ -118,21 +118,21 @@ __device__ inline MaterialConductor material_as_conductor(int material_id) {
 }
 
 __device__ inline float3 material_get_albedo(const float3 & diffuse, int texture_id, float s, float t) {
-	if (texture_id == INVALID) return diffuse;
+	if (!SCENE_HAS_TEXTURES || texture_id == INVALID) return diffuse;
 
 	float4 tex_colour = textures[texture_id].get(s, t);
 	return diffuse * make_float3(tex_colour);
 }
 
 __device__ inline float3 material_get_albedo(const float3 & diffuse, int texture_id, float s, float t, float lod) {
-	if (texture_id == INVALID) return diffuse;
+	if (!SCENE_HAS_TEXTURES || texture_id == INVALID) return diffuse;
 
 	float4 tex_colour = textures[texture_id].get_lod(s, t, lod);
 	return diffuse * make_float3(tex_colour);
 }
 
 __device__ inline float3 material_get_albedo(const float3 & diffuse, int texture_id, float s, float t, float2 dx, float2 dy) {
-	if (texture_id == INVALID) return diffuse;
+	if (!SCENE_HAS_TEXTURES || texture_id == INVALID) return diffuse;
 
 	float4 tex_colour = textures[texture_id].get_grad(s, t, dx, dy);
 	return diffuse * make_float3(tex_colour);
@@ -16,6 +16,7 @@
 #include "Raytracing/BVH8.h"
 
 #include "Sampling.h"
+#include "LightBVH.h"
 #include "Camera.h"
 
 #include "SVGF/SVGF.h"
@@ -87,14 +88,25 @@ __device__ inline MaterialBufferAllocation get_material_buffer(PackedMaterialBuf
 	};
 }
 
+// Without ray reordering the two TraceBuffers are ping-ponged between bounces.
+// With ray reordering the Rays of every bounce are traced from buffer 0 and the Rays for the next bounce are emitted into buffer 1,
+// kernel_reorder_scatter then moves them back into buffer 0 in sorted order
 __device__ inline TraceBuffer * get_ray_buffer_trace(int bounce) {
-	if (bounce & 1) {
+	if ((bounce & 1) && !config.enable_ray_reordering) {
 		return &ray_buffer_trace_1;
 	} else {
 		return &ray_buffer_trace_0;
 	}
 }
 
+__device__ inline TraceBuffer * get_ray_buffer_trace_next(int bounce) {
+	if (config.enable_ray_reordering) {
+		return &ray_buffer_trace_1;
+	} else {
+		return get_ray_buffer_trace(bounce + 1);
+	}
+}
+
 // Number of elements in each Buffer
 // Sizes are stored for ALL bounces so we only have to reset these
 // values back to 0 after every frame, instead of after every bounce
@@ -113,6 +125,22 @@ struct BufferSizes {
 
 __device__ BufferSizes buffer_sizes;
 
+#if ENABLE_RAY_STATS
+__device__ RayStats ray_stats;
+
+// Warp aggregated, only the first active thread issues an atomic for all threads of the warp that are currently active
+__device__ inline void ray_stats_add(int bounce, RayStat stat) {
+	unsigned mask   = __activemask();
+	int      leader = __ffs(mask) - 1;
+
+	if ((threadIdx.x & (WARP_SIZE - 1)) == leader) {
+		atomicAdd(&ray_stats.counts[bounce][int(stat)], __popc(mask));
+	}
+}
+#else
+__device__ inline void ray_stats_add(int bounce, RayStat stat) { }
+#endif
+
 __device__ __constant__ Camera camera;
 
 __device__ PixelQuery pixel_query = { INVALID, INVALID, INVALID };
@@ -136,6 +164,100 @@ extern "C" __global__ void kernel_generate(int sample_index, int pixel_offset, i
 	ray_buffer_trace->pixel_index_and_flags[index] = pixel_index;
 }
 
+// Ray reordering, a counting sort on ray_reorder_key (see CUDA/Common.h) over the Rays emitted for the given bounce.
+// The histogram is cleared by the Host before kernel_reorder_keys
+extern "C" __global__ void kernel_reorder_keys(int bounce, RayReorderBounds bounds, unsigned * keys, int * histogram) {
+	int index = blockIdx.x * blockDim.x + threadIdx.x;
+	if (index >= buffer_sizes.trace[bounce]) return;
+
+	float3 ray_origin    = ray_buffer_trace_1.traversal_data.ray_origin   .get(index);
+	float3 ray_direction = ray_buffer_trace_1.traversal_data.ray_direction.get(index);
+
+	unsigned key = ray_reorder_key(bounds, ray_origin.x, ray_origin.y, ray_origin.z, ray_direction.x, ray_direction.y, ray_direction.z);
+
+	keys[index] = key;
+	atomicAdd(&histogram[key], 1);
+}
+
+// Exclusive prefix sum over the histogram in place, launched as a single block
+extern "C" __global__ void kernel_reorder_scan(int * histogram) {
+	constexpr int BLOCK_SIZE         = 1024;
+	constexpr int BUCKETS_PER_THREAD = RAY_REORDER_NUM_BUCKETS / BLOCK_SIZE;
+	static_assert(RAY_REORDER_NUM_BUCKETS % BLOCK_SIZE == 0, "Number of buckets must be a multiple of the block size");
+
+	__shared__ int warp_sums[BLOCK_SIZE / WARP_SIZE];
+
+	int thread = threadIdx.x;
+	int lane   = thread & (WARP_SIZE - 1);
+	int warp   = thread / WARP_SIZE;
+
+	int * buckets = histogram + thread * BUCKETS_PER_THREAD;
+
+	int thread_sum = 0;
+	for (int i = 0; i < BUCKETS_PER_THREAD; i++) {
+		thread_sum += buckets[i];
+	}
+
+	// Inclusive scan of the thread sums within the warp
+	int scan = thread_sum;
+	for (int offset = 1; offset < WARP_SIZE; offset *= 2) {
+		int value = __shfl_up_sync(0xffffffff, scan, offset);
+		if (lane >= offset) scan += value;
+	}
+
+	if (lane == WARP_SIZE - 1) {
+		warp_sums[warp] = scan;
+	}
+	__syncthreads();
+
+	// Exclusive scan of the warp sums by the first warp
+	if (warp == 0) {
+		int warp_sum  = warp_sums[lane];
+		int warp_scan = warp_sum;
+		for (int offset = 1; offset < WARP_SIZE; offset *= 2) {
+			int value = __shfl_up_sync(0xffffffff, warp_scan, offset);
+			if (lane >= offset) warp_scan += value;
+		}
+		warp_sums[lane] = warp_scan - warp_sum;
+	}
+	__syncthreads();
+
+	int offset = warp_sums[warp] + scan - thread_sum;
+	for (int i = 0; i < BUCKETS_PER_THREAD; i++) {
+		int count = buckets[i];
+		buckets[i] = offset;
+		offset += count;
+	}
+}
+
+// Moves every Ray from buffer 1 into its sorted position in buffer 0. Rays within the same bucket are placed in arbitrary order
+extern "C" __global__ void kernel_reorder_scatter(int bounce, const unsigned * keys, int * offsets) {
+	int index = blockIdx.x * blockDim.x + threadIdx.x;
+	if (index >= buffer_sizes.trace[bounce]) return;
+
+	int index_out = atomicAdd(&offsets[keys[index]], 1);
+
+	const TraceBuffer & src = ray_buffer_trace_1;
+	const TraceBuffer & dst = ray_buffer_trace_0;
+
+	dst.traversal_data.ray_origin   .set(index_out, src.traversal_data.ray_origin   .get(index));
+	dst.traversal_data.ray_direction.set(index_out, src.traversal_data.ray_direction.get(index));
+
+	unsigned pixel_index_and_flags = src.pixel_index_and_flags[index];
+	dst.pixel_index_and_flags[index_out] = pixel_index_and_flags;
+	dst.throughput.set(index_out, src.throughput.get(index));
+
+	if (config.enable_mipmapping) {
+		dst.cone[index_out] = src.cone[index];
+	}
+	if (SCENE_HAS_MEDIA && (pixel_index_and_flags & FLAG_INSIDE_MEDIUM)) {
+		dst.medium[index_out] = src.medium[index];
+	}
+	if (pixel_index_and_flags & FLAG_ALLOW_NEE) {
+		dst.last_pdf[index_out] = src.last_pdf[index];
+	}
+}
+
 extern "C" __global__ void kernel_trace_bvh2(int bounce) {
 	bvh2_trace(&get_ray_buffer_trace(bounce)->traversal_data, buffer_sizes.trace[bounce], &buffer_sizes.rays_retired[bounce]);
 }
@@ -196,6 +318,7 @@ extern "C" __global__ void kernel_trace_shadow_bvh8(int bounce) {
 // Returns true if the path should terminate
 __device__ bool russian_roulette(int pixel_index, int bounce, int sample_index, float3 & throughput) {
 	if (bounce == config.num_bounces - 1) {
+		ray_stats_add(bounce, RayStat::LAST_BOUNCE);
 		return true;
 	}
 	if (config.enable_russian_roulette && bounce > 0) {
@@ -208,6 +331,7 @@ __device__ bool russian_roulette(int pixel_index, int bounce, int sample_index,
 		float rand_russian_roulette = random<SampleDimension::RUSSIAN_ROULETTE>(pixel_index, bounce, sample_index).x;
 
 		if (rand_russian_roulette > survival_probability) {
+			ray_stats_add(bounce, RayStat::RUSSIAN_ROULETTE);
 			return true;
 		}
 		throughput /= survival_probability;
@@ -219,6 +343,8 @@ extern "C" __global__ void kernel_sort(int bounce, int sample_index) {
 	int index = blockIdx.x * blockDim.x + threadIdx.x;
 	if (index >= buffer_sizes.trace[bounce]) return;
 
+	ray_stats_add(bounce, RayStat::ACTIVE);
+
 	const TraceBuffer * ray_buffer_trace = get_ray_buffer_trace(bounce);
 
 	float3 ray_direction = ray_buffer_trace->traversal_data.ray_direction.get(index);
@@ -246,7 +372,7 @@ extern "C" __global__ void kernel_sort(int bounce, int sample_index) {
 	}
 
 	int medium_id = INVALID;
-	if (inside_medium) {
+	if (SCENE_HAS_MEDIA && inside_medium) {
 		medium_id = ray_buffer_trace->medium[index];
 		HomogeneousMedium medium = medium_as_homogeneous(medium_id);
 
@@ -279,6 +405,8 @@ extern "C" __global__ void kernel_sort(int bounce, int sample_index) {
 				float3 pdf = wavelength_pdf * sigma_t * transmittance;
 				throughput *= medium.sigma_s * transmittance / (pdf.x + pdf.y + pdf.z);
 
+				ray_stats_add(bounce, RayStat::MEDIUM_SCATTER);
+
 				if (russian_roulette(pixel_index, bounce, sample_index, throughput)) return;
 
 				float3 direction_out = sample_henyey_greenstein(-ray_direction, medium.g, rand_phase.x, rand_phase.y);
@@ -289,7 +417,7 @@ extern "C" __global__ void kernel_sort(int bounce, int sample_index) {
 				// Emit scattered Ray
 				int index_out = atomicAdd(&buffer_sizes.trace[bounce + 1], 1);
 
-				TraceBuffer * ray_buffer_trace_next = get_ray_buffer_trace(bounce + 1);
+				TraceBuffer * ray_buffer_trace_next = get_ray_buffer_trace_next(bounce);
 
 				ray_buffer_trace_next->traversal_data.ray_origin   .set(index_out, origin_out);
 				ray_buffer_trace_next->traversal_data.ray_direction.set(index_out, direction_out);
@@ -323,7 +451,23 @@ extern "C" __global__ void kernel_sort(int bounce, int sample_index) {
 
 	// If we didn't hit anything, sample the Sky
 	if (hit.triangle_id == INVALID) {
-		float3 illumination = throughput * sample_sky(ray_direction);
+		ray_stats_add(bounce, RayStat::MISSED);
+
+		float3 sky_radiance = sample_sky(ray_direction);
+
+		// If the Sky was also importance sampled by Next Event Estimation, apply MIS or skip it entirely
+		float sky_nee_probability = sky_get_nee_probability();
+
+		if (config.enable_next_event_estimation && allow_nee && sky_nee_probability > 0.0f) {
+			if (!config.enable_multiple_importance_sampling) return;
+
+			float brdf_pdf = ray_buffer_trace->last_pdf[index];
+			float sky_pdf_nee = sky_nee_probability * sky_pdf(sky_radiance);
+
+			sky_radiance *= power_heuristic(brdf_pdf, sky_pdf_nee);
+		}
+
+		float3 illumination = throughput * sky_radiance;
 
 		if (bounce == 0) {
 			aov_framebuffer_set(AOVType::ALBEDO,          pixel_index, make_float4(1.0f));
@@ -348,7 +492,9 @@ extern "C" __global__ void kernel_sort(int bounce, int sample_index) {
 	int material_id = mesh_get_material_id(hit.mesh_id);
 	MaterialType material_type = material_get_type(material_id);
 
-	if (material_type == MaterialType::LIGHT) {
+	if (SCENE_HAS_LIGHTS && material_type == MaterialType::LIGHT) {
+		ray_stats_add(bounce, RayStat::HIT_LIGHT);
+
 		// Obtain the Light's position and normal
 		TrianglePosNor light = triangle_get_positions_and_normals(hit.triangle_id);
 
@@ -399,7 +545,13 @@ extern "C" __global__ void kernel_sort(int bounce, int sample_index) {
 			float brdf_pdf = ray_buffer_trace->last_pdf[index];
 
 			float light_power = luminance(material_light.emission.x, material_light.emission.y, material_light.emission.z);
-			float light_pdf   = light_power * distance_to_light_squared / (cos_theta_light * lights_total_weight);
+			float light_pdf   = light_power * distance_to_light_squared / (cos_theta_light * lights_total_weight) * (1.0f - sky_get_nee_probability());
+
+			if (config.enable_light_bvh) {
+				// The light BVH was traversed from the previous hit point, which the Ray origin only differs from by an epsilon offset
+				float3 ray_origin = ray_buffer_trace->traversal_data.ray_origin.get(index);
+				light_pdf *= light_bvh_pdf_scale(hit.mesh_id, hit.triangle_id, ray_origin);
+			}
 
 			if (!pdf_is_valid(light_pdf)) return;
 
@@ -436,7 +588,7 @@ extern "C" __global__ void kernel_sort(int bounce, int sample_index) {
 
 		int index_out = atomicAdd(buffer_size, 1);
 		if (material_buffer.reversed) {
-			index_out = (BATCH_SIZE - 1) - index_out;
+			index_out = (batch_size - 1) - index_out;
 		}
 
 		material_buffer.buffer->ray_direction.set(index_out, ray_direction);
@@ -459,18 +611,26 @@ extern "C" __global__ void kernel_sort(int bounce, int sample_index) {
 
 	switch (material_type) {
 		case MaterialType::DIFFUSE: {
+			if (!SCENE_HAS_DIFFUSE) break;
+			ray_stats_add(bounce, RayStat::DIFFUSE);
 			material_buffer_write(bounce, material_buffer_diffuse, &buffer_sizes.diffuse[bounce], ray_direction, medium_id, ray_cone, hit, pixel_index | flags, throughput);
 			break;
 		}
 		case MaterialType::PLASTIC: {
+			if (!SCENE_HAS_PLASTIC) break;
+			ray_stats_add(bounce, RayStat::PLASTIC);
 			material_buffer_write(bounce, material_buffer_plastic, &buffer_sizes.plastic[bounce], ray_direction, medium_id, ray_cone, hit, pixel_index | flags, throughput);
 			break;
 		}
 		case MaterialType::DIELECTRIC: {
+			if (!SCENE_HAS_DIELECTRIC) break;
+			ray_stats_add(bounce, RayStat::DIELECTRIC);
 			material_buffer_write(bounce, material_buffer_dielectric, &buffer_sizes.dielectric[bounce], ray_direction, medium_id, ray_cone, hit, pixel_index | flags, throughput);
 			break;
 		}
 		case MaterialType::CONDUCTOR: {
+			if (!SCENE_HAS_CONDUCTOR) break;
+			ray_stats_add(bounce, RayStat::CONDUCTOR);
 			material_buffer_write(bounce, material_buffer_conductor, &buffer_sizes.conductor[bounce], ray_direction, medium_id, ray_cone, hit, pixel_index | flags, throughput);
 			break;
 		}
@@ -492,48 +652,81 @@ __device__ void next_event_estimation(
 	float2 rand_light    = random<SampleDimension::NEE_LIGHT>   (pixel_index, bounce, sample_index);
 	float2 rand_triangle = random<SampleDimension::NEE_TRIANGLE>(pixel_index, bounce, sample_index);
 
-	// Pick random Light
-	int light_mesh_id;
-	int light_triangle_id = sample_light(rand_light.x, rand_light.y, light_mesh_id);
+	float3 to_light;
+	float  distance_to_light;
+	float3 light_emission;
+	float  light_pdf;
 
-	// Pick random point on the Light
-	float2 light_uv = sample_triangle(rand_triangle.x, rand_triangle.y);
+	// Decide between the Sky and the Lights in the Scene, the random number is remapped so it can be reused
+	float sky_nee_probability = sky_get_nee_probability();
 
-	// Obtain the Light's position and normal
-	TrianglePosNor light = triangle_get_positions_and_normals(light_triangle_id);
+	if (!SCENE_HAS_LIGHTS || rand_light.x < sky_nee_probability) {
+		rand_light.x = fminf(rand_light.x / sky_nee_probability, ONE_MINUS_EPSILON);
 
-	float3 light_point;
-	float3 light_normal;
-	triangle_barycentric(light, light_uv.x, light_uv.y, light_point, light_normal);
+		// Pick random direction proportional to the luminance of the Sky
+		to_light          = sky_sample_direction(rand_light.x, rand_light.y, rand_triangle.x, rand_triangle.y);
+		distance_to_light = INFINITY;
 
-	// Transform into world space
-	Matrix3x4 light_world = mesh_get_transform(light_mesh_id);
-	matrix3x4_transform_position (light_world, light_point);
-	matrix3x4_transform_direction(light_world, light_normal);
+		// The pdf is based on the texel the direction maps to, same as when the Sky is hit by BSDF sampling
+		light_emission = sample_sky(to_light);
+		light_pdf      = sky_nee_probability * sky_pdf(light_emission);
+	} else {
+		rand_light.x = fminf((rand_light.x - sky_nee_probability) / (1.0f - sky_nee_probability), ONE_MINUS_EPSILON);
 
-	light_normal = normalize(light_normal);
+		// Pick random Light
+		int   light_mesh_id;
+		int   light_triangle_id;
+		float light_pdf_scale = 1.0f;
 
-	float3 to_light = light_point - hit_point;
-	float distance_to_light_squared = dot(to_light, to_light);
-	float distance_to_light         = sqrtf(distance_to_light_squared);
+		if (config.enable_light_bvh) {
+			light_triangle_id = sample_light_bvh(rand_light.x, rand_light.y, hit_point, light_mesh_id, light_pdf_scale);
+			if (light_triangle_id == INVALID) return;
+		} else {
+			light_triangle_id = sample_light(rand_light.x, rand_light.y, light_mesh_id);
+		}
 
-	// Normalize the vector to the light
-	to_light /= distance_to_light;
+		// Pick random point on the Light
+		float2 light_uv = sample_triangle(rand_triangle.x, rand_triangle.y);
 
-	float cos_theta_light = fabsf(dot(to_light, light_normal));
-	float cos_theta_hit = dot(to_light, normal);
+		// Obtain the Light's position and normal
+		TrianglePosNor light = triangle_get_positions_and_normals(light_triangle_id);
+
+		float3 light_point;
+		float3 light_normal;
+		triangle_barycentric(light, light_uv.x, light_uv.y, light_point, light_normal);
+
+		// Transform into world space
+		Matrix3x4 light_world = mesh_get_transform(light_mesh_id);
+		matrix3x4_transform_position (light_world, light_point);
+		matrix3x4_transform_direction(light_world, light_normal);
+
+		light_normal = normalize(light_normal);
+
+		to_light = light_point - hit_point;
+		float distance_to_light_squared = dot(to_light, to_light);
+		distance_to_light = sqrtf(distance_to_light_squared);
+
+		// Normalize the vector to the light
+		to_light /= distance_to_light;
+
+		float cos_theta_light = fabsf(dot(to_light, light_normal));
 
-	int light_material_id = mesh_get_material_id(light_mesh_id);
-	MaterialLight material_light = material_as_light(light_material_id);
+		int light_material_id = mesh_get_material_id(light_mesh_id);
+		MaterialLight material_light = material_as_light(light_material_id);
+
+		light_emission = material_light.emission;
+
+		float light_power = luminance(material_light.emission.x, material_light.emission.y, material_light.emission.z);
+		light_pdf = light_power * distance_to_light_squared / (cos_theta_light * lights_total_weight) * light_pdf_scale * (1.0f - sky_nee_probability);
+	}
+
+	float cos_theta_hit = dot(to_light, normal);
 
 	float3 bsdf_value;
 	float  bsdf_pdf;
 	bool valid = bsdf.eval(to_light, cos_theta_hit, bsdf_value, bsdf_pdf);
 	if (!valid) return;
 
-	float light_power = luminance(material_light.emission.x, material_light.emission.y, material_light.emission.z);
-	float light_pdf   = light_power * distance_to_light_squared / (cos_theta_light * lights_total_weight);
-
 	if (!pdf_is_valid(light_pdf)) return;
 
 	float mis_weight;
@@ -543,10 +736,10 @@ __device__ void next_event_estimation(
 		mis_weight = 1.0f;
 	}
 
-	float3 illumination = throughput * bsdf_value * material_light.emission * mis_weight / light_pdf;
+	float3 illumination = throughput * bsdf_value * light_emission * mis_weight / light_pdf;
 
 	// If inside a Medium, apply absorption and out-scattering
-	if (medium_id != INVALID) {
+	if (SCENE_HAS_MEDIA && medium_id != INVALID) {
 		HomogeneousMedium medium = medium_as_homogeneous(medium_id);
 		float3 sigma_t = medium.sigma_a + medium.sigma_s;
 		illumination *= beer_lambert(sigma_t, distance_to_light);
@@ -554,6 +747,7 @@ __device__ void next_event_estimation(
 
 	// Emit Shadow Ray
 	int shadow_ray_index = atomicAdd(&buffer_sizes.shadow[bounce], 1);
+	ray_stats_add(bounce, RayStat::SHADOW);
 
 	ray_buffer_shadow.traversal_data.ray_origin   .set(shadow_ray_index, ray_origin_epsilon_offset(hit_point, to_light, geometric_normal));
 	ray_buffer_shadow.traversal_data.ray_direction.set(shadow_ray_index, to_light);
@@ -576,7 +770,7 @@ __device__ void shade_material(int bounce, int sample_index, int buffer_size) {
 	// Material Buffers can be shared by 2 different Materials, one growing left to right, one growing right to left
 	// If this Material is right to left, reverse the index into the buffers
 	if (material_buffer.reversed) {
-		index = (BATCH_SIZE - 1) - index;
+		index = (batch_size - 1) - index;
 	}
 
 	float3 ray_direction = material_buffer.buffer->ray_direction.get(index);
@@ -588,7 +782,7 @@ __device__ void shade_material(int bounce, int sample_index, int buffer_size) {
 	bool inside_medium = pixel_index_and_flags & FLAG_INSIDE_MEDIUM;
 
 	int medium_id = INVALID;
-	if (inside_medium) {
+	if (SCENE_HAS_MEDIA && inside_medium) {
 		medium_id = material_buffer.buffer->medium[index];
 	}
 
@@ -728,7 +922,7 @@ __device__ void shade_material(int bounce, int sample_index, int buffer_size) {
 	}
 
 	// Next Event Estimation
-	if (config.enable_next_event_estimation && lights_total_weight > 0.0f && bsdf.allow_nee()) {
+	if (config.enable_next_event_estimation && ((SCENE_HAS_LIGHTS && lights_total_weight > 0.0f) || sky_get_nee_probability() > 0.0f) && bsdf.allow_nee()) {
 		next_event_estimation(pixel_index, bounce, sample_index, bsdf, medium_id, hit_point, normal, geometric_normal, throughput);
 	}
 
@@ -737,14 +931,17 @@ __device__ void shade_material(int bounce, int sample_index, int buffer_size) {
 	float pdf;
 	bool valid = bsdf.sample(throughput, medium_id, direction_out, pdf);
 
-	if (!valid) return;
+	if (!valid) {
+		ray_stats_add(bounce, RayStat::ABSORBED);
+		return;
+	}
 
 	float3 origin_out = ray_origin_epsilon_offset(hit_point, direction_out, geometric_normal);
 
 	// Emit next Ray
 	int index_out = atomicAdd(&buffer_sizes.trace[bounce + 1], 1);
 
-	TraceBuffer * ray_buffer_trace = get_ray_buffer_trace(bounce + 1);
+	TraceBuffer * ray_buffer_trace = get_ray_buffer_trace_next(bounce);
 
 	ray_buffer_trace->traversal_data.ray_origin   .set(index_out, origin_out);
 	ray_buffer_trace->traversal_data.ray_direction.set(index_out, direction_out);
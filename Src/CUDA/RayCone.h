@@ -16,7 +16,7 @@ __device__ inline bool use_anisotropic_texture_sampling(int bounce) {
 }
 
 __device__ inline float3 sample_albedo(int bounce, const float3 & diffuse, int texture_id, float2 tex_coord, const TextureLOD & lod) {
-	if (config.enable_mipmapping && texture_id != INVALID) {
+	if (SCENE_HAS_TEXTURES && config.enable_mipmapping && texture_id != INVALID) {
 		if (use_anisotropic_texture_sampling(bounce)) {
 			return material_get_albedo(diffuse, texture_id, tex_coord.x, tex_coord.y, lod.aniso.gradient_1, lod.aniso.gradient_2);
 		} else {
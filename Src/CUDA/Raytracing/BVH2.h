@@ -111,7 +111,7 @@ __device__ void bvh2_trace(TraversalData * traversal_data, int ray_count, int *
 						stack_push(shared_stack_bvh2, stack, stack_size, root_index);
 					} else {
 						for (int i = node.first; i < node.first + node.count; i++) {
-							triangle_intersect(mesh_id, i, ray, ray_hit);
+							triangle_intersect(mesh_id, triangle_get_index(i), ray, ray_hit);
 						}
 					}
 				} else {
@@ -208,7 +208,7 @@ __device__ void bvh2_trace_shadow(ShadowTraversalData * traveral_data, int ray_c
 					} else {
 						bool hit = false;
 						for (int i = node.first; i < node.first + node.count; i++) {
-							if (triangle_intersect_shadow(i, ray, max_distance)) {
+							if (triangle_intersect_shadow(triangle_get_index(i), ray, max_distance)) {
 								hit = true;
 								break;
 							}
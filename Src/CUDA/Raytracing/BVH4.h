@@ -153,7 +153,7 @@ __device__ inline void bvh4_trace(TraversalData * traversal_data, int ray_count,
 					stack_push(shared_stack_bvh4, stack, stack_size, root_index);
 				} else {
 					for (int j = index; j < index + count; j++) {
-						triangle_intersect(mesh_id, j, ray, ray_hit);
+						triangle_intersect(mesh_id, triangle_get_index(j), ray, ray_hit);
 					}
 				}
 			} else {
@@ -258,7 +258,7 @@ __device__ inline void bvh4_trace_shadow(ShadowTraversalData * traversal_data, i
 					bool hit = false;
 
 					for (int j = index; j < index + count; j++) {
-						if (triangle_intersect_shadow(j, ray, max_distance)) {
+						if (triangle_intersect_shadow(triangle_get_index(j), ray, max_distance)) {
 							hit = true;
 
 							break;
@@ -238,7 +238,7 @@ __device__ inline void bvh8_trace(TraversalData * traversal_data, int ray_count,
 					int triangle_index = msb(triangle_group.y);
 					triangle_group.y &= ~(1 << triangle_index);
 
-					triangle_intersect(mesh_id, triangle_group.x + triangle_index, ray, ray_hit);
+					triangle_intersect(mesh_id, triangle_get_index(triangle_group.x + triangle_index), ray, ray_hit);
 				}
 			}
 
@@ -400,7 +400,7 @@ __device__ inline void bvh8_trace_shadow(ShadowTraversalData * traversal_data, i
 					int triangle_index = msb(triangle_group.y);
 					triangle_group.y &= ~(1 << triangle_index);
 
-					if (triangle_intersect_shadow(triangle_group.x + triangle_index, ray, max_distance)) {
+					if (triangle_intersect_shadow(triangle_get_index(triangle_group.x + triangle_index), ray, max_distance)) {
 						hit = true;
 						break;
 					}
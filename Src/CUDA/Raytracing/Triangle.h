@@ -12,6 +12,16 @@ struct Triangle {
 
 __device__ __constant__ const Triangle * triangles;
 
+// BVH leaves index triangles through these references when the BVH references some triangles multiple times (SBVH),
+// so that the triangles themselves are not duplicated. nullptr if every reference is the index of its triangle
+__device__ __constant__ const int * triangle_references;
+
+__device__ inline int triangle_get_index(int reference) {
+	if (triangle_references == nullptr) return reference;
+
+	return __ldg(&triangle_references[reference]);
+}
+
 struct TrianglePos {
 	float3 position_0;
 	float3 position_edge_1;
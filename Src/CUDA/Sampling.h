@@ -3,17 +3,18 @@
 #include "Config.h"
 
 __device__ __constant__ float2 * pmj_samples;
+__device__ __constant__ unsigned pmj_num_samples_per_sequence; // Power of two, at least PMJ_NUM_SAMPLES_PER_SEQUENCE
 __device__ __constant__ uchar2 * blue_noise_textures;
 
 __device__ __constant__ float lights_total_weight;
 
-__device__ __constant__ const int   * light_triangle_indices;
-__device__ __constant__ const float * light_triangle_cumulative_probability;
+__device__ __constant__ const int        * light_triangle_indices;
+__device__ __constant__ const AliasEntry * light_triangle_alias_table; // One table per light Mesh, located at the start of its triangle span
 
-__device__ __constant__ int           light_mesh_count;
-__device__ __constant__ const float * light_mesh_cumulative_probability;
-__device__ __constant__ const int2  * light_mesh_triangle_span; // First and last index into 'light_mesh_area_cumulative' array
-__device__ __constant__ const int   * light_mesh_transform_indices;
+__device__ __constant__ int                light_mesh_count;
+__device__ __constant__ const AliasEntry * light_mesh_alias_table;
+__device__ __constant__ const int2       * light_mesh_triangle_span; // First and last index into 'light_triangle_indices' and 'light_triangle_alias_table'
+__device__ __constant__ const int        * light_mesh_transform_indices;
 
 __device__ inline bool pdf_is_valid(float pdf) {
 	return isfinite(pdf) && pdf > 1e-4f;
@@ -44,7 +45,7 @@ __device__ float2 random(unsigned pixel_index, unsigned bounce, unsigned sample_
 	unsigned hash = pcg_hash((pixel_index * unsigned(SampleDimension::NUM_DIMENSIONS) + unsigned(Dim)) * MAX_BOUNCES + bounce);
 
 	// If we run out of PMJ02 samples, fall back to random
-	if (sample_index >= PMJ_NUM_SAMPLES_PER_SEQUENCE) {
+	if (sample_index >= pmj_num_samples_per_sequence) {
 		const float one_over_max_unsigned = __uint_as_float(0x2f7fffff); // Constant such that 0xffffffff will map to a float strictly less than 1.0f
 
 		float x = hash_with(sample_index,              hash) * one_over_max_unsigned;
@@ -57,10 +58,10 @@ __device__ float2 random(unsigned pixel_index, unsigned bounce, unsigned sample_
 
 	// If we run out of unique PMJ sequences, reuse a previous one but permute the index
 	if (dim >= PMJ_NUM_SEQUENCES) {
-		sample_index = permute(sample_index, PMJ_NUM_SAMPLES_PER_SEQUENCE, hash);
+		sample_index = permute(sample_index, pmj_num_samples_per_sequence, hash);
 	}
 
-	const float2 * pmj_sequence = pmj_samples + (dim % PMJ_NUM_SEQUENCES) * PMJ_NUM_SAMPLES_PER_SEQUENCE;
+	const float2 * pmj_sequence = pmj_samples + (dim % PMJ_NUM_SEQUENCES) * pmj_num_samples_per_sequence;
 	float2 sample = pmj_sequence[sample_index];
 
 	// Apply Cranley-Patterson rotation
@@ -190,14 +191,41 @@ __device__ float3 sample_visible_normals_ggx(const float3 & omega, float alpha_x
 	return normalize(make_float3(alpha_x * n_h.x, alpha_y * n_h.y, n_h.z));
 }
 
+// Selects a bin using u_index and decides between the bin and its alias using u_coin
+__device__ inline int sample_alias_table(const AliasEntry table[], int count, float u_index, float u_coin) {
+	int index = min(int(u_index * float(count)), count - 1);
+
+	AliasEntry entry = table[index];
+	return u_coin < entry.probability ? index : entry.alias;
+}
+
+// Uses u for both decisions and afterwards remaps it to a uniform random number that can be reused
+__device__ inline int sample_alias_table_and_remap(const AliasEntry table[], int count, float & u) {
+	float u_scaled = u * float(count);
+	int   index    = min(int(u_scaled), count - 1);
+
+	u = fminf(u_scaled - float(index), ONE_MINUS_EPSILON);
+
+	AliasEntry entry = table[index];
+	if (u < entry.probability) {
+		u = fminf(u / entry.probability, ONE_MINUS_EPSILON);
+		return index;
+	} else {
+		u = fminf((u - entry.probability) / (1.0f - entry.probability), ONE_MINUS_EPSILON);
+		return entry.alias;
+	}
+}
+
 __device__ int sample_light(float u1, float u2, int & transform_id) {
-	// Pick light emitting Mesh
-	int light_mesh_id = binary_search(light_mesh_cumulative_probability, 0, light_mesh_count - 1, u1);
+	// Pick light emitting Mesh, u1 is remapped so that it can be reused below
+	int light_mesh_id = sample_alias_table_and_remap(light_mesh_alias_table, light_mesh_count, u1);
 	transform_id = light_mesh_transform_indices[light_mesh_id];
 
-	// Pick light emitting Triangle on the Mesh
+	// Pick light emitting Triangle on the Mesh. The index into the table only uses u2,
+	// large Meshes would leave too few bits of a single random number for the coin flip
 	int2 triangle_span = light_mesh_triangle_span[light_mesh_id];
-	int light_triangle_id = binary_search(light_triangle_cumulative_probability, triangle_span.x, triangle_span.y, u2);
+	int  triangle_count = triangle_span.y - triangle_span.x + 1;
+	int light_triangle_id = triangle_span.x + sample_alias_table(light_triangle_alias_table + triangle_span.x, triangle_count, u2, u1);
 
 	return light_triangle_indices[light_triangle_id];
 }
@@ -1,10 +1,14 @@
 #pragma once
+#include "Sampling.h"
 
 __device__ __constant__ int      sky_width;
 __device__ __constant__ int      sky_height;
 __device__ __constant__ float3 * sky_data;
 
-__device__ float3 sample_sky(const float3 & direction) {
+__device__ __constant__ const AliasEntry * sky_alias_table;  // Over all texels, weighted by luminance times solid angle, see Renderer/Sky.h
+__device__ __constant__ float              sky_total_weight; // Zero if the Sky can not be importance sampled
+
+__device__ inline int sky_get_index(const float3 & direction) {
 	// Convert direction to spherical coordinates
 	float phi   = atan2f(-direction.z, direction.x);
 	float theta = acosf(clamp(direction.y, -1.0f, 1.0f));
@@ -12,11 +16,50 @@ __device__ float3 sample_sky(const float3 & direction) {
 	float u = phi   * ONE_OVER_TWO_PI;
 	float v = theta * ONE_OVER_PI;
 
+	// atan2 returns angles in [-pi, pi]
+	if (u < 0.0f) u += 1.0f;
+
 	// Convert to pixel coordinates
-	int x = int(u * sky_width);
-	int y = int(v * sky_height);
+	int x = min(int(u * sky_width),  sky_width  - 1);
+	int y = min(int(v * sky_height), sky_height - 1);
+
+	return x + y * sky_width;
+}
+
+__device__ float3 sample_sky(const float3 & direction) {
+	return sky_data[sky_get_index(direction)];
+}
+
+// Probability of selecting the Sky in Next Event Estimation, the remainder goes to the Lights in the Scene
+__device__ inline float sky_get_nee_probability() {
+	if (!config.enable_sky_importance_sampling || sky_total_weight == 0.0f) return 0.0f;
+
+	return lights_total_weight > 0.0f ? 0.5f : 1.0f;
+}
+
+// Solid angle pdf of importance sampling the Sky in the given direction, given the radiance the Sky has in that direction
+__device__ inline float sky_pdf(const float3 & sky_radiance) {
+	return fmaxf(luminance(sky_radiance.x, sky_radiance.y, sky_radiance.z), 0.0f) / sky_total_weight;
+}
+
+// Samples a direction proportional to the luminance of the Sky
+__device__ inline float3 sky_sample_direction(float u_index, float u_coin, float u_phi, float u_theta) {
+	int index = sample_alias_table(sky_alias_table, sky_width * sky_height, u_index, u_coin);
+
+	int x = index % sky_width;
+	int y = index / sky_width;
+
+	// Sample uniformly in phi and cos(theta), which is uniform in solid angle within the texel
+	float phi = (float(x) + u_phi) * TWO_PI / float(sky_width);
+
+	float cos_theta_0 = cosf(float(y)     * PI / float(sky_height));
+	float cos_theta_1 = cosf(float(y + 1) * PI / float(sky_height));
+
+	float cos_theta = cos_theta_0 + u_theta * (cos_theta_1 - cos_theta_0);
+	float sin_theta = safe_sqrt(1.0f - cos_theta * cos_theta);
 
-	int index = clamp(x + y * sky_width, 0, sky_width * sky_height - 1);
+	float sin_phi, cos_phi;
+	sincosf(phi, &sin_phi, &cos_phi); // Not the intrinsic, the direction should map back to the same texel
 
-	return sky_data[index];
+	return make_float3(cos_phi * sin_theta, cos_theta, -sin_phi * sin_theta);
 }
@@ -40,13 +40,29 @@ struct CPUConfig {
 
 	OutputFormat screenshot_format = OutputFormat::PPM;
 
+	int   batch_size          = 0;    // Number of pixels rendered per batch, 0 chooses it automatically (see Renderer/Integrators/BatchSize.h)
+	float batch_memory_budget = 0.5f; // Fraction of free Device memory the ray buffers may use when choosing the batch size automatically
+
 	int    output_sample_index = INVALID;
 	String output_filename     = "render.ppm"_sv;
 
-	bool bvh_force_rebuild        = false;
-	bool enable_bvh_optimization  = false;
-	bool enable_block_compression = true;
-	bool enable_scene_update      = false;
+	String pmj_filename = "Data/pmj02.bin"_sv; // Table of PMJ02 sequences, the built-in sequences are used if the file does not exist
+
+	String memory_report_filename; // If set, a JSON report of memory usage per subsystem is written here once loading is done
+	String ray_stats_filename;     // If set, per bounce ray statistics are written here on exit (requires ENABLE_RAY_STATS)
+
+	String kernel_cache_directory = "Data/KernelCache"_sv; // Compiled PTX is cached here, see Device/KernelCache.h
+
+	int geometry_cache_budget = 256; // Host memory in MB that geometry streaming may use for resident clusters, see Renderer/GeometryCache.h
+
+	bool bvh_force_rebuild            = false;
+	bool enable_bvh_optimization      = false;
+	bool enable_block_compression     = true;
+	bool enable_scene_update          = false;
+	bool enable_progressive_loading   = false; // Start rendering before all assets are loaded, assets are swapped in as they finish loading
+	bool enable_device_memory_pool    = true;  // Sub-allocate Device memory from a pool instead of calling cuMemAlloc for every buffer (see Device/MemoryPool.h)
+	bool enable_kernel_specialization = true;  // Compile the Pathtracer kernels for only the features the Scene uses (see Renderer/SceneFeatures.h)
+	bool enable_geometry_streaming    = false; // Move the triangles of loaded MeshDatas to cluster files next to their BVH files, they are read back through a GeometryCache (see Renderer/GeometryCache.h)
 
 	MipmapFilterType mipmap_filter = MipmapFilterType::BOX;
 
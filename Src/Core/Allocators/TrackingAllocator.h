@@ -0,0 +1,48 @@
+#pragma once
+#include <string.h>
+
+#include "Allocator.h"
+
+#include "Core/MemoryTracker.h"
+
+// Allocator that counts the memory that passes through it under a named MemoryTracker Tag
+// The actual allocation is forwarded to the parent Allocator, or to the heap if no parent is provided
+struct TrackingAllocator final : Allocator {
+	Allocator          * parent = nullptr;
+	MemoryTracker::Tag * tag    = nullptr;
+
+	TrackingAllocator(MemoryTracker::Tag * tag, Allocator * parent = nullptr) : parent(parent), tag(tag) { }
+	TrackingAllocator(StringView tag_name,      Allocator * parent = nullptr) : parent(parent), tag(MemoryTracker::get_tag(tag_name)) { }
+
+	NON_COPYABLE(TrackingAllocator);
+	NON_MOVEABLE(TrackingAllocator);
+
+	~TrackingAllocator() = default;
+
+private:
+	// The size of each allocation is stored in a header in front of it, so that it is known when freeing.
+	// 16 bytes keeps the returned memory aligned the same way as the memory provided by the parent
+	static constexpr size_t HEADER_SIZE = 16;
+
+	char * alloc(size_t num_bytes) override {
+		char * ptr = Allocator::alloc_array<char>(parent, HEADER_SIZE + num_bytes);
+		memcpy(ptr, &num_bytes, sizeof(size_t));
+
+		MemoryTracker::on_alloc(tag, num_bytes);
+
+		return ptr + HEADER_SIZE;
+	}
+
+	void free(void * ptr) override {
+		if (ptr == nullptr) return;
+
+		char * header = static_cast<char *>(ptr) - HEADER_SIZE;
+
+		size_t num_bytes;
+		memcpy(&num_bytes, header, sizeof(size_t));
+
+		MemoryTracker::on_free(tag, num_bytes);
+
+		Allocator::free_array(parent, header);
+	}
+};
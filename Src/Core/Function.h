@@ -1,5 +1,8 @@
 #pragma once
+#include <new>
+#include <cstddef>
 #include <utility>
+#include <type_traits>
 
 #include "OwnPtr.h"
 #include "Allocators/Allocator.h"
@@ -8,10 +11,17 @@ template<typename> struct Function;
 
 template<typename Result, typename ... Args>
 struct Function<Result(Args ...)> {
+	// Callables up to this size are stored inline, without a heap allocation.
+	// Large enough for lambdas capturing 'this' plus a few pointers/handles or a String, which covers most ThreadPool Work
+	static constexpr size_t INLINE_SIZE = 6 * sizeof(void *);
+
 	struct CallableBase {
 		virtual ~CallableBase() = default;
 
 		virtual Result call(Args ... args) = 0;
+
+		// Move constructs this Callable into (inline) storage at dst
+		virtual CallableBase * move_to(void * dst) = 0;
 	};
 
 	template<typename T>
@@ -28,25 +38,80 @@ struct Function<Result(Args ...)> {
 		Result call(Args ... args) override {
 			return impl(std::forward<Args>(args) ...);
 		}
+
+		CallableBase * move_to(void * dst) override {
+			return new (dst) Callable(std::move(impl));
+		}
 	};
 
-	mutable OwnPtr<CallableBase> callable; // TODO: Perhaps support some in-situ storage here for small callables to avoid indirection
+	template<typename T>
+	static constexpr bool fits_inline =
+		sizeof (Callable<T>) <= INLINE_SIZE &&
+		alignof(Callable<T>) <= alignof(std::max_align_t) &&
+		std::is_nothrow_move_constructible_v<T>;
+
+	alignas(std::max_align_t) char storage[INLINE_SIZE];
+
+	mutable CallableBase * callable = nullptr; // Points into storage if the Callable is stored inline, otherwise heap allocated
 
 	Function() = default;
 
 	template<typename T>
-	Function(T impl) : callable(make_owned<Callable<T>>(std::move(impl))) { }
+	Function(T impl) {
+		if constexpr (fits_inline<T>) {
+			callable = new (storage) Callable<T>(std::move(impl));
+		} else {
+			callable = new Callable<T>(std::move(impl));
+		}
+	}
 
 	NON_COPYABLE(Function);
-	DEFAULT_MOVEABLE(Function);
 
-	~Function() = default;
+	Function(Function && other) noexcept {
+		move_from(other);
+	}
+
+	Function & operator=(Function && other) noexcept {
+		if (this != &other) {
+			destroy();
+			move_from(other);
+		}
+		return *this;
+	}
+
+	~Function() {
+		destroy();
+	}
 
 	Result operator()(Args ... args) const {
 		return callable->call(std::forward<Args>(args) ...);
 	}
 
 	operator bool() {
-		return callable.ptr != nullptr;
+		return callable != nullptr;
+	}
+
+	inline bool is_inline() const {
+		return callable == reinterpret_cast<const CallableBase *>(storage);
+	}
+
+private:
+	void move_from(Function & other) {
+		if (other.is_inline()) {
+			callable = other.callable->move_to(storage);
+			other.callable->~CallableBase();
+		} else {
+			callable = other.callable;
+		}
+		other.callable = nullptr;
+	}
+
+	void destroy() {
+		if (is_inline()) {
+			callable->~CallableBase();
+		} else {
+			delete callable;
+		}
+		callable = nullptr;
 	}
 };
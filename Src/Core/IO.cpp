@@ -17,6 +17,18 @@ bool IO::file_is_newer(StringView filename_a, StringView filename_b) {
 	return last_write_time_filename_a < last_write_time_filename_b;
 }
 
+bool IO::file_delete(StringView filename) {
+	std::error_code error;
+	return std::filesystem::remove(stringview_to_path(filename), error);
+}
+
+bool IO::directory_create(StringView directory) {
+	std::error_code error;
+	std::filesystem::create_directories(stringview_to_path(directory), error);
+
+	return std::filesystem::is_directory(stringview_to_path(directory), error);
+}
+
 String IO::file_read(const String & filename, Allocator * allocator) {
 	FILE * file = nullptr;
 	fopen_s(&file, filename.data(), "rb");
@@ -1,27 +1,32 @@
 #pragma once
 #include <stdio.h>
 
+#include "Log.h"
 #include "Format.h"
 #include "Allocators/LinearAllocator.h"
 
 namespace IO {
+	// Output is routed through the asynchronous Log, see Log.h
 	inline void print(char c) {
-		putchar(c);
+		Log::print(c);
 	}
 
 	inline void print(StringView str) {
-		fwrite(str.start, sizeof(char), str.length(), stdout);
+		Log::print(str);
 	}
 
 	template<typename ... Args>
 	inline void print(StringView fmt, const Args & ... args) {
-		LinearAllocator<KILOBYTES(4)> allocator;
-		String string = Format(&allocator).format(fmt, args ...);
-		print(string.view());
+		{
+			String string = Format(Log::get_thread_buffer()).format(fmt, args ...);
+			print(string.view());
+		}
+		Log::reset_thread_buffer();
 	}
 
 	[[noreturn]]
 	inline void exit(int code) {
+		Log::flush();
 		__debugbreak();
 		::exit(code);
 	}
@@ -30,6 +35,11 @@ namespace IO {
 
 	bool file_is_newer(StringView filename_a, StringView filename_b);
 
+	bool file_delete(StringView filename);
+
+	// Creates the directory and any missing parent directories, returns whether the directory exists afterwards
+	bool directory_create(StringView directory);
+
 	String file_read (const String & filename, Allocator * allocator);
 	bool   file_write(const String & filename, StringView data);
 }
@@ -0,0 +1,432 @@
+#include "Log.h"
+
+#include <string.h>
+
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+
+#include "Array.h"
+#include "Allocators/LinearAllocator.h"
+
+#include "Util/StringUtil.h"
+
+struct LogMessage {
+	Log::Severity severity;
+	Log::Category category;
+	unsigned      thread_id;
+	int64_t       time_in_us; // Relative to the start of the program
+	String        text;
+};
+
+struct LogBackend {
+	static constexpr size_t QUEUE_CAPACITY = 16384;
+
+	static constexpr size_t BATCH_SIZE = QUEUE_CAPACITY / 4;
+
+	static constexpr std::chrono::milliseconds BATCH_DELAY = std::chrono::milliseconds(1);
+	static constexpr std::chrono::milliseconds FLUSH_DELAY = std::chrono::milliseconds(2);
+
+	std::mutex              mutex;
+	std::condition_variable condition_not_empty;
+	std::condition_variable condition_not_full;
+	std::condition_variable condition_written;
+
+	// Ring buffer of messages waiting to be written
+	Array<LogMessage> queue = Array<LogMessage>(QUEUE_CAPACITY);
+	size_t            queue_head  = 0;
+	size_t            queue_count = 0;
+
+	uint64_t num_submitted = 0;
+	uint64_t num_written   = 0;
+
+	int num_flush_waiters = 0;
+
+	std::atomic<uint64_t> num_dropped = 0;
+
+	std::thread thread;
+	bool        is_running = false;
+	bool        is_done    = false;
+
+	FILE * output    = stdout;
+	FILE * json_file = nullptr;
+
+	std::atomic<Log::Severity> min_severity[size_t(Log::Category::COUNT)];
+
+	std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+
+	LogBackend() {
+		for (size_t i = 0; i < size_t(Log::Category::COUNT); i++) {
+			min_severity[i] = Log::Severity::INFO;
+		}
+	}
+};
+
+// Initialized on first use and never destroyed, so that logging works during static initialization and destruction
+static LogBackend & get_backend() {
+	static LogBackend * backend = new LogBackend();
+	return *backend;
+}
+
+static std::atomic<unsigned> next_thread_id = 0;
+static thread_local unsigned thread_id      = next_thread_id++;
+
+static thread_local LinearAllocator<KILOBYTES(16)> thread_buffer;
+static thread_local LinearAllocator<KILOBYTES(1)>  json_buffer; // Separate from thread_buffer, which may be in use by the caller of a synchronous write
+
+// Characters printed one at a time by this thread that have not been submitted yet, see Log::print(char)
+static constexpr size_t PENDING_CHARS_CAPACITY = 256;
+
+static thread_local char   pending_chars[PENDING_CHARS_CAPACITY];
+static thread_local size_t pending_char_count = 0;
+
+StringView Log::severity_name(Severity severity) {
+	switch (severity) {
+		case Severity::DEBUG:   return "DEBUG"_sv;
+		case Severity::INFO:    return "INFO"_sv;
+		case Severity::WARNING: return "WARNING"_sv;
+		case Severity::ERR:     return "ERROR"_sv;
+		default: ASSERT_UNREACHABLE();
+	}
+}
+
+StringView Log::category_name(Category category) {
+	switch (category) {
+		case Category::GENERAL:  return "general"_sv;
+		case Category::ASSETS:   return "assets"_sv;
+		case Category::BVH:      return "bvh"_sv;
+		case Category::CUDA:     return "cuda"_sv;
+		case Category::RENDERER: return "renderer"_sv;
+		default: ASSERT_UNREACHABLE();
+	}
+}
+
+bool Log::parse_severity(StringView name, Severity & severity) {
+	if (name == "debug")   { severity = Severity::DEBUG;   return true; }
+	if (name == "info")    { severity = Severity::INFO;    return true; }
+	if (name == "warning") { severity = Severity::WARNING; return true; }
+	if (name == "error")   { severity = Severity::ERR;     return true; }
+	return false;
+}
+
+bool Log::parse_category(StringView name, Category & category) {
+	for (int i = 0; i < int(Category::COUNT); i++) {
+		if (name == category_name(Category(i))) {
+			category = Category(i);
+			return true;
+		}
+	}
+	return false;
+}
+
+// Writes a single message, only called by one thread at a time
+static void write_message(LogBackend & backend, const LogMessage & message, Array<char> & scratch) {
+	if (message.category != Log::Category::GENERAL) {
+		StringView category = Log::category_name(message.category);
+		fputc('[', backend.output);
+		fwrite(category.start, sizeof(char), category.length(), backend.output);
+		fputs("] ", backend.output);
+	}
+	if (message.severity >= Log::Severity::WARNING) {
+		StringView severity = Log::severity_name(message.severity);
+		fwrite(severity.start, sizeof(char), severity.length(), backend.output);
+		fputs(": ", backend.output);
+	}
+	fwrite(message.text.data(), sizeof(char), message.text.size(), backend.output);
+
+	if (backend.json_file) {
+		// Trailing newlines are part of the text output but not of the structured message
+		StringView text = message.text.view();
+		while (text.length() > 0 && (text.end[-1] == '\n' || text.end[-1] == '\r')) text.end--;
+
+		if (text.length() == 0) return;
+
+		scratch.clear();
+
+		// The opening brace is appended separately, Format would interpret it as the start of a replacement field
+		String fields = Format(&json_buffer).format("\"time_us\":{},\"thread\":{},\"severity\":\"{}\",\"category\":\"{}\",\"message\":\""_sv,
+			message.time_in_us,
+			message.thread_id,
+			Log::severity_name(message.severity),
+			Log::category_name(message.category)
+		);
+		scratch.push_back('{');
+		scratch.push_back(fields.data(), fields.size());
+		Util::append_json_escaped(scratch, text);
+		scratch.push_back("\"}\n", 3);
+
+		fwrite(scratch.data(), sizeof(char), scratch.size(), backend.json_file);
+		json_buffer.reset();
+	}
+}
+
+static void background_thread_loop(LogBackend & backend) {
+	Array<LogMessage> batch;
+	Array<char>       scratch;
+
+	bool needs_fflush = false;
+
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(backend.mutex);
+
+			auto has_work = [&backend]() { return backend.queue_count > 0 || backend.is_done; };
+			if (needs_fflush) {
+				// Wait briefly for more messages before flushing, so that a burst of messages does not result in a write per message
+				backend.condition_not_empty.wait_for(lock, LogBackend::FLUSH_DELAY, has_work);
+			} else {
+				backend.condition_not_empty.wait(lock, has_work);
+			}
+
+			if (backend.queue_count == 0) {
+				lock.unlock();
+
+				fflush(backend.output);
+				if (backend.json_file) fflush(backend.json_file);
+				needs_fflush = false;
+
+				if (backend.is_done) return;
+				continue;
+			}
+
+			// Give other threads a moment to submit more messages, so that they are written in larger batches
+			backend.condition_not_empty.wait_for(lock, LogBackend::BATCH_DELAY, [&backend]() {
+				return backend.queue_count >= LogBackend::BATCH_SIZE || backend.is_done || backend.num_flush_waiters > 0;
+			});
+
+			// Take all queued messages at once, so that the queue is not locked while writing
+			batch.clear();
+			while (backend.queue_count > 0) {
+				batch.push_back(std::move(backend.queue[backend.queue_head]));
+				backend.queue_head = (backend.queue_head + 1) % LogBackend::QUEUE_CAPACITY;
+				backend.queue_count--;
+			}
+		}
+		backend.condition_not_full.notify_all();
+
+		for (size_t i = 0; i < batch.size(); i++) {
+			write_message(backend, batch[i], scratch);
+		}
+		needs_fflush = true;
+
+		{
+			std::lock_guard<std::mutex> lock(backend.mutex);
+			backend.num_written += batch.size();
+		}
+		backend.condition_written.notify_all();
+	}
+}
+
+void Log::init() {
+	LogBackend & backend = get_backend();
+
+	std::lock_guard<std::mutex> lock(backend.mutex);
+	if (backend.is_running) return;
+
+	backend.is_running = true;
+	backend.is_done    = false;
+	backend.thread = std::thread([&backend]() {
+		background_thread_loop(backend);
+	});
+}
+
+static void submit(Log::Severity severity, Log::Category category, StringView text);
+
+static void submit_pending_chars() {
+	if (pending_char_count == 0) return;
+
+	size_t count = pending_char_count;
+	pending_char_count = 0;
+
+	if (Log::is_enabled(Log::Severity::INFO, Log::Category::GENERAL)) {
+		submit(Log::Severity::INFO, Log::Category::GENERAL, StringView { pending_chars, pending_chars + count });
+	}
+}
+
+void Log::shutdown() {
+	submit_pending_chars();
+
+	LogBackend & backend = get_backend();
+	{
+		std::lock_guard<std::mutex> lock(backend.mutex);
+		if (!backend.is_running) return;
+
+		backend.is_done = true;
+	}
+	backend.condition_not_empty.notify_all();
+	backend.thread.join();
+
+	{
+		std::lock_guard<std::mutex> lock(backend.mutex);
+		backend.is_running = false;
+	}
+
+	uint64_t num_dropped = backend.num_dropped;
+	if (num_dropped > 0) {
+		Log::warning(Category::GENERAL, "{} log messages were dropped because the log queue was full\n"_sv, num_dropped);
+	}
+
+	if (backend.json_file) {
+		fclose(backend.json_file);
+		backend.json_file = nullptr;
+	}
+}
+
+void Log::flush() {
+	submit_pending_chars();
+
+	LogBackend & backend = get_backend();
+
+	std::unique_lock<std::mutex> lock(backend.mutex);
+	if (backend.is_running) {
+		uint64_t target = backend.num_submitted;
+
+		backend.num_flush_waiters++;
+		backend.condition_not_empty.notify_one();
+		backend.condition_written.wait(lock, [&backend, target]() { return backend.num_written >= target; });
+		backend.num_flush_waiters--;
+	}
+	fflush(backend.output);
+	if (backend.json_file) fflush(backend.json_file);
+}
+
+void Log::set_min_severity(Severity severity) {
+	for (int i = 0; i < int(Category::COUNT); i++) {
+		set_min_severity(Category(i), severity);
+	}
+}
+
+void Log::set_min_severity(Category category, Severity severity) {
+	get_backend().min_severity[size_t(category)] = severity;
+}
+
+bool Log::is_enabled(Severity severity, Category category) {
+	return severity >= get_backend().min_severity[size_t(category)].load(std::memory_order_relaxed);
+}
+
+bool Log::open_json_file(const String & filename) {
+	LogBackend & backend = get_backend();
+	flush();
+
+	FILE * file = nullptr;
+	fopen_s(&file, filename.data(), "wb");
+	if (!file) {
+		Log::warning(Category::GENERAL, "Unable to open log file '{}'!\n"_sv, filename);
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(backend.mutex);
+	if (backend.json_file) fclose(backend.json_file);
+	backend.json_file = file;
+
+	return true;
+}
+
+Log::Stats Log::get_stats() {
+	LogBackend & backend = get_backend();
+	std::lock_guard<std::mutex> lock(backend.mutex);
+
+	Stats stats = { };
+	stats.num_messages = backend.num_written;
+	stats.num_dropped  = backend.num_dropped;
+	return stats;
+}
+
+void Log::set_output(FILE * file) {
+	flush();
+
+	LogBackend & backend = get_backend();
+	std::lock_guard<std::mutex> lock(backend.mutex);
+	backend.output = file;
+}
+
+void Log::write(Severity severity, Category category, StringView text) {
+	// Characters printed earlier by this thread go first, so that output of a thread stays in order
+	submit_pending_chars();
+	submit(severity, category, text);
+}
+
+static void submit(Log::Severity severity, Log::Category category, StringView text) {
+	using namespace Log;
+
+	LogBackend & backend = get_backend();
+
+	LogMessage message = { };
+	message.severity   = severity;
+	message.category   = category;
+	message.thread_id  = thread_id;
+	message.time_in_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - backend.start_time).count();
+
+	message.text       = String(text); // Copy outside of the lock
+
+	std::unique_lock<std::mutex> lock(backend.mutex);
+
+	if (!backend.is_running) {
+		// Synchronous path, the lock prevents interleaving with other threads
+		static Array<char> scratch;
+
+		write_message(backend, message, scratch);
+		backend.num_submitted++;
+		backend.num_written++;
+		return;
+	}
+
+	if (backend.queue_count == LogBackend::QUEUE_CAPACITY) {
+		if (severity < Severity::WARNING) {
+			backend.num_dropped++;
+			return;
+		}
+		backend.condition_not_full.wait(lock, [&backend]() { return backend.queue_count < LogBackend::QUEUE_CAPACITY; });
+	}
+
+	size_t index = (backend.queue_head + backend.queue_count) % LogBackend::QUEUE_CAPACITY;
+	backend.queue[index] = std::move(message);
+	backend.queue_count++;
+	backend.num_submitted++;
+
+	// The background thread waits for either the first message or a full batch
+	bool needs_notify = backend.queue_count == 1 || backend.queue_count == LogBackend::BATCH_SIZE;
+
+	lock.unlock();
+	if (needs_notify) {
+		backend.condition_not_empty.notify_one();
+	}
+}
+
+void Log::print(StringView message) {
+	Severity severity = Severity::INFO;
+
+	constexpr StringView WARNING_PREFIX = "WARNING: "_sv;
+	constexpr StringView ERROR_PREFIX   = "ERROR: "_sv;
+
+	// The prefix is stripped, write_message adds it back based on the Severity
+	if (message.length() >= WARNING_PREFIX.length() && memcmp(message.start, WARNING_PREFIX.start, WARNING_PREFIX.length()) == 0) {
+		severity = Severity::WARNING;
+		message.start += WARNING_PREFIX.length();
+	} else if (message.length() >= ERROR_PREFIX.length() && memcmp(message.start, ERROR_PREFIX.start, ERROR_PREFIX.length()) == 0) {
+		severity = Severity::ERR;
+		message.start += ERROR_PREFIX.length();
+	}
+
+	if (is_enabled(severity, Category::GENERAL)) {
+		write(severity, Category::GENERAL, message);
+	}
+}
+
+void Log::print(char c) {
+	pending_chars[pending_char_count++] = c;
+
+	if (c == '\n' || pending_char_count == PENDING_CHARS_CAPACITY) {
+		submit_pending_chars();
+	}
+}
+
+Allocator * Log::get_thread_buffer() {
+	return &thread_buffer;
+}
+
+void Log::reset_thread_buffer() {
+	thread_buffer.reset();
+}
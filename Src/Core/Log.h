@@ -0,0 +1,92 @@
+#pragma once
+#include <stdio.h>
+#include <stdint.h>
+
+#include "Format.h"
+#include "String.h"
+#include "StringView.h"
+
+// Buffered, thread-safe logging
+// Messages are formatted on the calling thread using a per-thread buffer and pushed onto a bounded queue,
+// a background thread writes them to stdout (and optionally as JSON lines to a file). Every message is written
+// in one piece, so output from different threads does not interleave within a message.
+// If the queue is full, DEBUG and INFO messages are dropped and counted, WARNING and ERR messages wait for space.
+// Before init and after shutdown messages are written synchronously
+namespace Log {
+	enum struct Severity {
+		DEBUG,
+		INFO,
+		WARNING,
+		ERR, // Not ERROR, which is defined as a macro by Windows.h
+
+		COUNT
+	};
+
+	enum struct Category {
+		GENERAL,
+		ASSETS,
+		BVH,
+		CUDA,
+		RENDERER,
+
+		COUNT
+	};
+
+	StringView severity_name(Severity severity);
+	StringView category_name(Category category);
+
+	bool parse_severity(StringView name, Severity & severity);
+	bool parse_category(StringView name, Category & category);
+
+	void init();
+	void shutdown();
+
+	// Blocks until all messages submitted so far have been written
+	void flush();
+
+	// Messages with a lower Severity than the minimum for their Category are discarded
+	void set_min_severity(Severity severity); // For all Categories
+	void set_min_severity(Category category, Severity severity);
+
+	bool is_enabled(Severity severity, Category category);
+
+	// Additionally writes every message as a line of JSON to the given file
+	bool open_json_file(const String & filename);
+
+	struct Stats {
+		uint64_t num_messages; // Number of messages that were written
+		uint64_t num_dropped;  // Number of messages that were dropped because the queue was full
+	};
+	Stats get_stats();
+
+	// Redirects the text output (stdout by default), used by the logging benchmark
+	void set_output(FILE * file);
+
+	// The text output prefixes WARNING and ERR messages with their Severity, so messages should not contain it themselves
+	void write(Severity severity, Category category, StringView message);
+
+	// Used by IO::print, derives the Severity from a "WARNING: " or "ERROR: " prefix, which is stripped from the message
+	void print(StringView message);
+	// Used by IO::print(char), characters are collected per thread and submitted as one message once a line is complete
+	void print(char c);
+
+	// Allocator for formatting on the calling thread, reset after each message
+	Allocator * get_thread_buffer();
+	void      reset_thread_buffer();
+
+	template<typename ... Args>
+	inline void message(Severity severity, Category category, StringView fmt, const Args & ... args) {
+		if (!is_enabled(severity, category)) return;
+
+		{
+			String string = Format(get_thread_buffer()).format(fmt, args ...);
+			write(severity, category, string.view());
+		}
+		reset_thread_buffer();
+	}
+
+	template<typename ... Args> inline void debug  (Category category, StringView fmt, const Args & ... args) { message(Severity::DEBUG,   category, fmt, args ...); }
+	template<typename ... Args> inline void info   (Category category, StringView fmt, const Args & ... args) { message(Severity::INFO,    category, fmt, args ...); }
+	template<typename ... Args> inline void warning(Category category, StringView fmt, const Args & ... args) { message(Severity::WARNING, category, fmt, args ...); }
+	template<typename ... Args> inline void error  (Category category, StringView fmt, const Args & ... args) { message(Severity::ERR,     category, fmt, args ...); }
+}
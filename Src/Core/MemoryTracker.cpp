@@ -0,0 +1,161 @@
+#include "MemoryTracker.h"
+
+#include "IO.h"
+#include "Log.h"
+#include "Mutex.h"
+#include "Format.h"
+#include "RobinHoodHashMap.h"
+
+#include "Allocators/TrackingAllocator.h"
+
+struct TrackedAllocation {
+	MemoryTracker::Tag * tag;
+	size_t               num_bytes;
+};
+
+struct MemoryTrackerRegistry {
+	MemoryTracker::Tag tags[MemoryTracker::MAX_TAGS];
+	int                num_tags = 0;
+
+	Mutex tags_mutex;
+
+	RobinHoodHashMap<uintptr_t, TrackedAllocation> allocations;
+	Mutex                                          allocations_mutex;
+};
+
+// Initialized on first use, so that it can be used during static initialization.
+// Intentionally never destroyed, so that it can also be used during static destruction
+static MemoryTrackerRegistry & get_registry() {
+	static MemoryTrackerRegistry * registry = new MemoryTrackerRegistry();
+	return *registry;
+}
+
+MemoryTracker::Tag * MemoryTracker::get_tag(StringView name) {
+	MemoryTrackerRegistry & registry = get_registry();
+	MutexLock lock(registry.tags_mutex);
+
+	for (int i = 0; i < registry.num_tags; i++) {
+		if (registry.tags[i].name == name) {
+			return &registry.tags[i];
+		}
+	}
+
+	if (registry.num_tags == MAX_TAGS) {
+		Log::error(Log::Category::GENERAL, "Exceeded maximum number of MemoryTracker tags ({})!\n"_sv, MAX_TAGS);
+		IO::exit(1);
+	}
+
+	Tag * tag = &registry.tags[registry.num_tags++];
+	tag->name = name;
+
+	return tag;
+}
+
+Allocator * MemoryTracker::get_allocator(StringView name) {
+	Tag * tag = get_tag(name);
+
+	MemoryTrackerRegistry & registry = get_registry();
+	MutexLock lock(registry.tags_mutex);
+
+	if (tag->allocator == nullptr) {
+		tag->allocator = new TrackingAllocator(tag);
+	}
+	return tag->allocator;
+}
+
+void MemoryTracker::on_alloc(Tag * tag, size_t num_bytes) {
+	int64_t current_bytes = tag->current_bytes.fetch_add(num_bytes) + int64_t(num_bytes);
+	tag->num_allocations++;
+
+	// Atomic max
+	int64_t peak_bytes = tag->peak_bytes.load();
+	while (current_bytes > peak_bytes && !tag->peak_bytes.compare_exchange_weak(peak_bytes, current_bytes)) { }
+}
+
+void MemoryTracker::on_free(Tag * tag, size_t num_bytes) {
+	tag->current_bytes.fetch_sub(num_bytes);
+	tag->num_frees++;
+}
+
+void MemoryTracker::track_alloc(Tag * tag, const void * ptr, size_t num_bytes) {
+	MemoryTrackerRegistry & registry = get_registry();
+	{
+		MutexLock lock(registry.allocations_mutex);
+		registry.allocations.insert(uintptr_t(ptr), TrackedAllocation { tag, num_bytes });
+	}
+	on_alloc(tag, num_bytes);
+}
+
+void MemoryTracker::track_free(const void * ptr) {
+	MemoryTrackerRegistry & registry = get_registry();
+
+	TrackedAllocation allocation = { };
+	{
+		MutexLock lock(registry.allocations_mutex);
+
+		TrackedAllocation * tracked_allocation = registry.allocations.try_get(uintptr_t(ptr));
+		if (!tracked_allocation) return; // Allocated before tracking was in place
+
+		allocation = *tracked_allocation;
+		registry.allocations.erase(uintptr_t(ptr));
+	}
+	on_free(allocation.tag, allocation.num_bytes);
+}
+
+void MemoryTracker::print_report() {
+	MemoryTrackerRegistry & registry = get_registry();
+	MutexLock lock(registry.tags_mutex);
+
+	IO::print("Memory usage per subsystem:\n"_sv);
+	IO::print("\t{:24}{:>16}{:>16}{:>14}{:>14}\n"_sv, "Tag"_sv, "Current (KB)"_sv, "Peak (KB)"_sv, "Allocations"_sv, "Frees"_sv);
+
+	for (int i = 0; i < registry.num_tags; i++) {
+		const Tag & tag = registry.tags[i];
+		IO::print("\t{:24}{:>16}{:>16}{:>14}{:>14}\n"_sv,
+			tag.name,
+			tag.current_bytes.load() / KILOBYTES(1),
+			tag.peak_bytes   .load() / KILOBYTES(1),
+			tag.num_allocations.load(),
+			tag.num_frees      .load()
+		);
+	}
+}
+
+String MemoryTracker::to_json(Allocator * allocator) {
+	MemoryTrackerRegistry & registry = get_registry();
+	MutexLock lock(registry.tags_mutex);
+
+	Array<char> json(allocator);
+
+	auto append = [&json](StringView str) {
+		json.push_back(str.start, str.length());
+	};
+
+	append("{\n\t\"tags\": [\n"_sv);
+	for (int i = 0; i < registry.num_tags; i++) {
+		const Tag & tag = registry.tags[i];
+		append("\t\t{ "_sv); // Appended separately, as Format treats { as the start of a replacement field
+		append("\"name\": \""_sv);
+		Util::append_json_escaped(json, tag.name.view());
+		append(Format(allocator).format("\", \"current_bytes\": {}, \"peak_bytes\": {}, \"num_allocations\": {}, \"num_frees\": {} }"_sv,
+			tag.current_bytes  .load(),
+			tag.peak_bytes     .load(),
+			tag.num_allocations.load(),
+			tag.num_frees      .load()
+		).view());
+		append(i + 1 < registry.num_tags ? ",\n"_sv : "\n"_sv);
+	}
+	append("\t]\n}\n"_sv);
+
+	return String(std::move(json));
+}
+
+bool MemoryTracker::write_json(const String & filename) {
+	String json = to_json();
+
+	bool success = IO::file_write(filename, json.view());
+	if (!success) {
+		Log::warning(Log::Category::GENERAL, "Unable to write memory report to '{}'!\n"_sv, filename);
+	}
+	return success;
+}
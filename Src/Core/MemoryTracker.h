@@ -0,0 +1,45 @@
+#pragma once
+#include <stdint.h>
+#include <atomic>
+
+#include "String.h"
+#include "StringView.h"
+
+struct TrackingAllocator;
+
+// Global registry of named subsystems (tags) that keeps track of how much memory each of them uses
+// Host allocations are counted by routing them through a TrackingAllocator, CUDA allocations made
+// through CUDAMemory are counted automatically under the "CUDA Device" and "CUDA Pinned" tags
+namespace MemoryTracker {
+	inline constexpr int MAX_TAGS = 64;
+
+	struct Tag {
+		String name;
+
+		std::atomic<int64_t> current_bytes   = 0;
+		std::atomic<int64_t> peak_bytes      = 0;
+		std::atomic<int64_t> num_allocations = 0; // Total number of allocations made over the lifetime of the program
+		std::atomic<int64_t> num_frees       = 0;
+
+		TrackingAllocator * allocator = nullptr; // Heap backed, created on demand by get_allocator
+	};
+
+	// Returns the Tag with the given name, registering it if it does not exist yet
+	// The returned pointer remains valid for the lifetime of the program
+	Tag * get_tag(StringView name);
+
+	// Returns a heap backed TrackingAllocator for the Tag with the given name, which lives for the duration of the program
+	Allocator * get_allocator(StringView name);
+
+	void on_alloc(Tag * tag, size_t num_bytes);
+	void on_free (Tag * tag, size_t num_bytes);
+
+	// For allocations where the size is not known when they are freed, such as CUDA allocations,
+	// the size is stored in a table indexed by address
+	void track_alloc(Tag * tag, const void * ptr, size_t num_bytes);
+	void track_free (const void * ptr);
+
+	void   print_report();
+	String to_json(Allocator * allocator = nullptr);
+	bool   write_json(const String & filename);
+}
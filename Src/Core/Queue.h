@@ -123,6 +123,14 @@ struct Queue {
 		return result;
 	}
 
+	// Pops the most recently pushed item, allows the Queue to be used as a double ended queue
+	constexpr T pop_back() {
+		ASSERT(size() > 0);
+
+		dec_wrap(tail);
+		return std::move(*tail);
+	}
+
 	constexpr size_t size() const {
 		if (head <= tail) {
 			return tail - head;
@@ -140,4 +148,11 @@ private:
 			ptr = data;
 		}
 	}
+
+	constexpr void dec_wrap(T *& ptr) {
+		if (ptr == data) {
+			ptr = data + capacity;
+		}
+		ptr--;
+	}
 };
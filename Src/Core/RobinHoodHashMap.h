@@ -0,0 +1,334 @@
+#pragma once
+#include <string.h>
+#include <type_traits>
+
+#include "Hash.h"
+#include "Compare.h"
+#include "Allocators/Allocator.h"
+
+#include "Util/Util.h"
+
+// Hash Map using Robin Hood hashing
+// On insertion, elements that are further away from their ideal slot take the place of elements that are closer to theirs.
+// This keeps the variance in probe lengths low, even at high load factors, and allows lookups to terminate early.
+// Erasing uses backward shift deletion, so no tombstones are needed
+template<typename Key, typename Value, typename Hash = Hash<Key>, typename Cmp = Compare::Equal<Key>>
+struct RobinHoodHashMap {
+	struct ProbeStats {
+		size_t count;
+		size_t capacity;
+
+		float load_factor;
+		float avg_probe_length; // Average distance from the ideal slot, 0 means the element is in its ideal slot
+		int   max_probe_length;
+	};
+
+	struct Map {
+		size_t count    = 0;
+		size_t capacity = 0;
+
+		size_t * hashes    = nullptr;
+		int    * distances = nullptr; // Distance from the ideal slot plus one, 0 means the slot is empty
+		char   * keys      = nullptr;
+		char   * values    = nullptr;
+
+		constexpr void init(Allocator * allocator, size_t cap) {
+			constexpr size_t MIN_CAPACITY = 4;
+
+			// Round up to power of two
+			size_t new_capacity = MIN_CAPACITY;
+			while (new_capacity < cap) new_capacity *= 2;
+
+			count    = 0;
+			capacity = new_capacity;
+
+			hashes    = Allocator::alloc_array<size_t>(allocator, capacity);
+			distances = Allocator::alloc_array<int>   (allocator, capacity);
+			keys      = Allocator::alloc_array<char>  (allocator, capacity * sizeof(Key));
+			values    = Allocator::alloc_array<char>  (allocator, capacity * sizeof(Value));
+
+			memset(distances, 0, capacity * sizeof(int));
+		}
+
+		constexpr void free(Allocator * allocator) {
+			Key   * ks = get_keys();
+			Value * vs = get_values();
+
+			for (size_t i = 0; i < capacity; i++) {
+				if (distances[i]) {
+					ks[i].~Key();
+					vs[i].~Value();
+				}
+			}
+
+			Allocator::free_array(allocator, hashes);
+			Allocator::free_array(allocator, distances);
+			Allocator::free_array(allocator, keys);
+			Allocator::free_array(allocator, values);
+		}
+
+		// Assumes the key is not yet present in the Map
+		constexpr Value & insert_new(size_t hash, Key key, Value value) {
+			size_t i        = hash & (capacity - 1);
+			int    distance = 1;
+
+			Value * result = nullptr;
+
+			while (true) {
+				if (distances[i] == 0) {
+					hashes   [i] = hash;
+					distances[i] = distance;
+					new (&get_keys()  [i]) Key(std::move(key));
+					new (&get_values()[i]) Value(std::move(value));
+					count++;
+
+					return result ? *result : get_values()[i];
+				} else if (distances[i] < distance) {
+					// Steal from the rich: the resident element is closer to its ideal slot than the one being inserted
+					Util::swap(hashes   [i], hash);
+					Util::swap(distances[i], distance);
+					Util::swap(get_keys  ()[i], key);
+					Util::swap(get_values()[i], value);
+
+					// The element that was originally inserted stays in this slot from now on
+					if (result == nullptr) result = &get_values()[i];
+				}
+
+				i = (i + 1) & (capacity - 1);
+				distance++;
+			}
+		}
+
+		template<typename K>
+		constexpr size_t find(size_t hash, const K & key) const {
+			size_t i        = hash & (capacity - 1);
+			int    distance = 1;
+
+			while (true) {
+				// If we encounter an element closer to its ideal slot than we are, the key cannot be present
+				if (distances[i] < distance) return INVALID_INDEX;
+
+				if (hashes[i] == hash && key_equals(get_keys()[i], key)) return i;
+
+				i = (i + 1) & (capacity - 1);
+				distance++;
+			}
+		}
+
+		constexpr void erase_at(size_t index) {
+			get_keys  ()[index].~Key();
+			get_values()[index].~Value();
+			distances[index] = 0;
+			count--;
+
+			// Backward shift: move subsequent elements of the cluster one slot closer to their ideal slot
+			size_t prev = index;
+			size_t next = (index + 1) & (capacity - 1);
+
+			while (distances[next] > 1) {
+				hashes   [prev] = hashes   [next];
+				distances[prev] = distances[next] - 1;
+				new (&get_keys  ()[prev]) Key  (std::move(get_keys  ()[next]));
+				new (&get_values()[prev]) Value(std::move(get_values()[next]));
+
+				get_keys  ()[next].~Key();
+				get_values()[next].~Value();
+				distances[next] = 0;
+
+				prev = next;
+				next = (next + 1) & (capacity - 1);
+			}
+		}
+
+		template<typename K>
+		static constexpr bool key_equals(const Key & a, const K & b) {
+			if constexpr (std::is_same_v<K, Key>) {
+				return Cmp()(a, b);
+			} else {
+				return a == b;
+			}
+		}
+
+		constexpr Key   * get_keys  () const { return reinterpret_cast<Key   *>(keys); }
+		constexpr Value * get_values() const { return reinterpret_cast<Value *>(values); }
+	} map;
+
+	static constexpr size_t INVALID_INDEX = size_t(-1);
+
+	Allocator * allocator = nullptr;
+
+	constexpr RobinHoodHashMap(Allocator * allocator = nullptr, size_t cap = 0) : allocator(allocator) {
+		map.init(allocator, cap);
+	}
+
+	NON_COPYABLE(RobinHoodHashMap);
+	NON_MOVEABLE(RobinHoodHashMap);
+
+	~RobinHoodHashMap() {
+		map.free(allocator);
+	}
+
+	constexpr Value & insert(Key key, Value value) {
+		size_t hash = Hash()(key);
+		return insert_by_hash(hash, std::move(key), std::move(value));
+	}
+
+	constexpr Value & insert_by_hash(size_t hash, Key key, Value value) {
+		size_t index = map.find(hash, key);
+		if (index != INVALID_INDEX) {
+			// Replace existing
+			return map.get_values()[index] = std::move(value);
+		}
+
+		grow_if_needed(map.count + 1);
+		return map.insert_new(hash, std::move(key), std::move(value));
+	}
+
+	// Lookup supports any key type K that hashes identically to Key and is comparable to it using ==,
+	// for example StringView for String keys. This avoids having to construct a temporary Key
+	template<typename K>
+	constexpr Value * try_get(const K & key) const {
+		return try_get_by_hash(hash_of(key), key);
+	}
+
+	template<typename K>
+	constexpr Value * try_get_by_hash(size_t hash, const K & key) const {
+		size_t index = map.find(hash, key);
+		return index != INVALID_INDEX ? &map.get_values()[index] : nullptr;
+	}
+
+	constexpr Value & operator[](const Key & key) {
+		size_t  hash  = Hash()(key);
+		Value * value = try_get_by_hash(hash, key);
+
+		if (value) return *value;
+
+		grow_if_needed(map.count + 1);
+		return map.insert_new(hash, key, Value { });
+	}
+
+	// Returns whether the key was present
+	template<typename K>
+	constexpr bool erase(const K & key) {
+		size_t index = map.find(hash_of(key), key);
+		if (index == INVALID_INDEX) return false;
+
+		map.erase_at(index);
+		return true;
+	}
+
+	// Ensures at least the given number of elements can be stored without having to grow
+	constexpr void reserve(size_t count) {
+		grow_if_needed(count);
+	}
+
+	constexpr void clear() {
+		map.free(allocator);
+		map.init(allocator, 0);
+	}
+
+	constexpr size_t size() const { return map.count; }
+
+	ProbeStats get_probe_stats() const {
+		ProbeStats stats = { };
+		stats.count       = map.count;
+		stats.capacity    = map.capacity;
+		stats.load_factor = float(map.count) / float(map.capacity);
+
+		size_t total_probe_length = 0;
+		for (size_t i = 0; i < map.capacity; i++) {
+			if (map.distances[i]) {
+				int probe_length = map.distances[i] - 1;
+
+				total_probe_length += probe_length;
+				if (probe_length > stats.max_probe_length) {
+					stats.max_probe_length = probe_length;
+				}
+			}
+		}
+		stats.avg_probe_length = map.count > 0 ? float(total_probe_length) / float(map.count) : 0.0f;
+
+		return stats;
+	}
+
+	struct Iterator {
+		Map  * map   = nullptr;
+		size_t index = 0;
+
+		Key   & get_key()   const { return map->get_keys  ()[index]; }
+		Value & get_value() const { return map->get_values()[index]; }
+
+		void operator++() {
+			if (map) {
+				while (index + 1 < map->capacity) {
+					index++;
+
+					if (map->distances[index]) return;
+				}
+				map = nullptr;
+			}
+			index = 0;
+		}
+		void operator--() {
+			if (map) {
+				while (index > 0) {
+					index--;
+
+					if (map->distances[index]) return;
+				}
+				map = nullptr;
+			}
+			index = 0;
+		}
+
+		bool operator==(const Iterator & other) const { return map == other.map && index == other.index; }
+		bool operator!=(const Iterator & other) const { return map != other.map || index != other.index; }
+	};
+
+	Iterator begin() {
+		for (size_t i = 0; i < map.capacity; i++) {
+			if (map.distances[i]) {
+				return Iterator { &map, i };
+			}
+		}
+		return end();
+	}
+
+	Iterator end() {
+		return Iterator { nullptr, 0 };
+	}
+
+private:
+	template<typename K>
+	static constexpr size_t hash_of(const K & key) {
+		if constexpr (std::is_same_v<K, Key>) {
+			return Hash()(key);
+		} else {
+			return ::Hash<K>()(key);
+		}
+	}
+
+	static constexpr size_t MAX_LOAD_FACTOR_NUMERATOR   = 7; // Robin Hood hashing performs well up to high load factors
+	static constexpr size_t MAX_LOAD_FACTOR_DENOMINATOR = 8;
+
+	constexpr void grow_if_needed(size_t required_count) {
+		if (required_count * MAX_LOAD_FACTOR_DENOMINATOR <= map.capacity * MAX_LOAD_FACTOR_NUMERATOR) return;
+
+		size_t new_capacity = map.capacity;
+		while (required_count * MAX_LOAD_FACTOR_DENOMINATOR > new_capacity * MAX_LOAD_FACTOR_NUMERATOR) {
+			new_capacity *= 2;
+		}
+
+		Map new_map = { };
+		new_map.init(allocator, new_capacity);
+
+		for (size_t i = 0; i < map.capacity; i++) {
+			if (map.distances[i]) {
+				new_map.insert_new(map.hashes[i], std::move(map.get_keys()[i]), std::move(map.get_values()[i]));
+			}
+		}
+
+		map.free(allocator);
+		map = new_map;
+	}
+};
@@ -1,37 +1,119 @@
 #pragma once
+#include <stddef.h>
+
 #include "Array.h"
 #include "Compare.h"
 
 #include "Util/Util.h"
 
 namespace Sort {
+	// Sorts small ranges, used as base case by quick_sort
+	template<typename T, typename Cmp>
+	constexpr void insertion_sort(T * first, T * last, Cmp cmp = Compare::LessThan<T>()) {
+		for (T * i = first + 1; i < last; i++) {
+			T value = std::move(*i);
+
+			T * j = i;
+			while (j > first && cmp(value, *(j - 1))) {
+				*j = std::move(*(j - 1));
+				j--;
+			}
+			*j = std::move(value);
+		}
+	}
+
+	template<typename T, typename Cmp>
+	constexpr void heap_sort(T * first, T * last, Cmp cmp = Compare::LessThan<T>()) {
+		ptrdiff_t count = last - first;
+
+		auto sift_down = [first, &cmp](ptrdiff_t root, ptrdiff_t end) {
+			while (2 * root + 1 < end) {
+				ptrdiff_t child = 2 * root + 1;
+				if (child + 1 < end && cmp(first[child], first[child + 1])) {
+					child++;
+				}
+				if (!cmp(first[root], first[child])) return;
+
+				Util::swap(first[root], first[child]);
+				root = child;
+			}
+		};
+
+		// Build max heap
+		for (ptrdiff_t i = count / 2 - 1; i >= 0; i--) {
+			sift_down(i, count);
+		}
+		// Repeatedly move the max element to the end
+		for (ptrdiff_t end = count - 1; end > 0; end--) {
+			Util::swap(first[0], first[end]);
+			sift_down(0, end);
+		}
+	}
+
+	template<typename T, typename Cmp>
+	constexpr void quick_sort_impl(T * first, T * last, Cmp & cmp, int depth_limit) {
+		constexpr ptrdiff_t INSERTION_SORT_THRESHOLD = 16;
+
+		while (last - first > INSERTION_SORT_THRESHOLD) {
+			if (depth_limit == 0) {
+				// Recursion is going too deep, likely due to adversarial input. Fall back to heap sort to guarantee O(n log n)
+				heap_sort(first, last, cmp);
+				return;
+			}
+			depth_limit--;
+
+			// Median of three pivot selection, avoids worst case behaviour on sorted input
+			T * a = first;
+			T * b = first + (last - first) / 2;
+			T * c = last - 1;
+			if (cmp(*b, *a)) Util::swap(a, b);
+			if (cmp(*c, *b)) Util::swap(b, c);
+			if (cmp(*b, *a)) Util::swap(a, b);
+
+			T pivot = *b;
+
+			T * i = first;
+			T * j = first;
+			T * k = last;
+
+			// Dutch National Flag algorithm
+			while (j < k) {
+				if (cmp(*j, pivot)) { // *j < pivot
+					Util::swap(*i, *j);
+					i++;
+					j++;
+				} else if (cmp(pivot, *j)) { // *j > pivot
+					k--;
+					Util::swap(*j, *k);
+				} else { // *j == pivot
+					j++;
+				}
+			}
+
+			// Recurse on the smaller partition and loop on the larger one, bounds stack depth to O(log n)
+			if (i - first < last - j) {
+				quick_sort_impl(first, i, cmp, depth_limit);
+				first = j;
+			} else {
+				quick_sort_impl(j, last, cmp, depth_limit);
+				last = i;
+			}
+		}
+
+		insertion_sort(first, last, cmp);
+	}
+
+	// Introsort: quick sort that falls back to heap sort if recursion gets too deep, and to insertion sort for small ranges
 	template<typename T, typename Cmp>
 	constexpr void quick_sort(T * first, T * last, Cmp cmp = Compare::LessThan<T>()) {
 		if (first >= last - 1) return;
 
-		T pivot = first[(last - first) / 2];
-
-		T * i = first;
-		T * j = first;
-		T * k = last;
-
-		// Dutch National Flag algorithm
-		while (j < k) {
-			if (cmp(*j, pivot)) { // *j < pivot
-				Util::swap(*i, *j);
-				i++;
-				j++;
-			} else if (cmp(pivot, *j)) { // *j > pivot
-				k--;
-				Util::swap(*j, *k);
-			} else { // *j == pivot
-				j++;
-			}
+		int depth_limit = 0;
+		for (ptrdiff_t n = last - first; n > 1; n >>= 1) {
+			depth_limit += 2;
 		}
 
-		// Recurse
-		quick_sort(first, i,    cmp);
-		quick_sort(j,     last, cmp);
+		quick_sort_impl(first, last, cmp, depth_limit);
 	}
 
 	// Merge sort
@@ -69,4 +151,83 @@ namespace Sort {
 		Array<T> tmp(last - first);
 		stable_sort(first, last, tmp.data(), cmp);
 	}
+
+	// Maps a float to an unsigned integer key with the same ordering, negative floats included
+	inline unsigned float_to_radix_key(float value) {
+		unsigned bits = Util::bit_cast<unsigned>(value);
+		unsigned mask = (bits & 0x80000000u) ? 0xffffffffu : 0x80000000u;
+		return bits ^ mask;
+	}
+
+	inline float radix_key_to_float(unsigned key) {
+		unsigned mask = (key & 0x80000000u) ? 0x80000000u : 0xffffffffu;
+		return Util::bit_cast<float>(key ^ mask);
+	}
+
+	// Maps a signed integer to an unsigned integer key with the same ordering
+	inline unsigned int_to_radix_key(int value) {
+		return unsigned(value) ^ 0x80000000u;
+	}
+
+	inline constexpr int RADIX_BITS       = 8;
+	inline constexpr int RADIX_NUM_DIGITS = 1 << RADIX_BITS;
+	inline constexpr int RADIX_NUM_PASSES = 32 / RADIX_BITS;
+
+	inline constexpr unsigned radix_digit(unsigned key, int pass) {
+		return (key >> (pass * RADIX_BITS)) & (RADIX_NUM_DIGITS - 1);
+	}
+
+	// Stable LSD radix sort of unsigned keys, with an optional array of values that is permuted along with the keys (values may be nullptr).
+	// tmp_keys and tmp_values should have room for count elements. The result is stored in keys and values
+	template<typename Value>
+	void radix_sort(unsigned * keys, Value * values, unsigned * tmp_keys, Value * tmp_values, size_t count) {
+		if (count <= 1) return;
+
+		unsigned * src_keys   = keys;
+		Value    * src_values = values;
+		unsigned * dst_keys   = tmp_keys;
+		Value    * dst_values = tmp_values;
+
+		for (int pass = 0; pass < RADIX_NUM_PASSES; pass++) {
+			size_t offsets[RADIX_NUM_DIGITS] = { };
+			for (size_t i = 0; i < count; i++) {
+				offsets[radix_digit(src_keys[i], pass)]++;
+			}
+
+			// Skip passes in which all keys have the same digit, common for keys with a limited range
+			if (offsets[radix_digit(src_keys[0], pass)] == count) continue;
+
+			// Exclusive prefix sum
+			size_t sum = 0;
+			for (int d = 0; d < RADIX_NUM_DIGITS; d++) {
+				size_t digit_count = offsets[d];
+				offsets[d] = sum;
+				sum += digit_count;
+			}
+
+			for (size_t i = 0; i < count; i++) {
+				size_t index = offsets[radix_digit(src_keys[i], pass)]++;
+
+				dst_keys[index] = src_keys[i];
+				if (values) dst_values[index] = std::move(src_values[i]);
+			}
+
+			Util::swap(src_keys,   dst_keys);
+			Util::swap(src_values, dst_values);
+		}
+
+		// Copy back if the final result ended up in the temporary buffers
+		if (src_keys != keys) {
+			memcpy(keys, src_keys, count * sizeof(unsigned));
+			if (values) {
+				for (size_t i = 0; i < count; i++) {
+					values[i] = std::move(src_values[i]);
+				}
+			}
+		}
+	}
+
+	inline void radix_sort(unsigned * keys, unsigned * tmp_keys, size_t count) {
+		radix_sort<int>(keys, nullptr, tmp_keys, nullptr, count);
+	}
 }
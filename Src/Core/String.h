@@ -178,6 +178,9 @@ inline bool operator!=(const String & a, const String & b) {
 	return false;
 }
 
+inline bool operator==(const String & a, StringView b) { return a.view() == b; }
+inline bool operator!=(const String & a, StringView b) { return !(a.view() == b); }
+
 inline bool operator< (const String & a, const String & b) { return strcmp(a.data(), b.data()) <  0; }
 inline bool operator> (const String & a, const String & b) { return strcmp(a.data(), b.data()) >  0; }
 inline bool operator<=(const String & a, const String & b) { return strcmp(a.data(), b.data()) <= 0; }
@@ -5,6 +5,8 @@
 #include <GL/glew.h>
 #include <cudaGL.h>
 
+#include "CUDAMemory.h"
+
 #include "Core/IO.h"
 #include "Core/Allocators/StackAllocator.h"
 
@@ -93,6 +95,8 @@ void CUDAContext::init() {
 }
 
 void CUDAContext::free() {
+	CUDAMemory::free_pool();
+
 	CUDACALL(cuCtxDestroy(context));
 	CUDACALL(cuDevicePrimaryCtxReset(device));
 }
@@ -3,6 +3,124 @@
 #include <GL/glew.h>
 #include <cudaGL.h>
 
+#include "Config.h"
+
+#include "Core/Log.h"
+#include "Core/Mutex.h"
+
+// Backend of the MemoryPool that obtains its blocks from the CUDA driver
+struct CUDABackend final : MemoryPool::Backend {
+	uint64_t alloc(size_t num_bytes) override {
+		CUdeviceptr ptr;
+		CUresult result = cuMemAlloc(&ptr, num_bytes);
+
+		// Running out of memory is handled by the MemoryPool, which trims itself and retries
+		if (result == CUDA_ERROR_OUT_OF_MEMORY) return 0;
+
+		CUDACALL(result);
+		return ptr;
+	}
+
+	void free(uint64_t ptr, size_t num_bytes) override {
+		CUDACALL(cuMemFree(ptr));
+	}
+
+	// Kernels and async copies on any stream may still access memory that was freed on the Host,
+	// cuMemFree used to implicitly wait for these before the memory could be reused
+	void synchronize() override {
+		CUDACALL(cuCtxSynchronize());
+	}
+};
+
+static CUDABackend cuda_backend;
+static Mutex       pool_mutex;
+
+// Intentionally never destroyed, by then the CUDA Context has been destroyed which releases all Device memory
+static MemoryPool & get_pool() {
+	static MemoryPool * pool = new MemoryPool(&cuda_backend);
+	return *pool;
+}
+
+MemoryTracker::Tag * CUDAMemory::get_tag_device() {
+	static MemoryTracker::Tag * tag = MemoryTracker::get_tag("CUDA Device"_sv);
+	return tag;
+}
+
+MemoryTracker::Tag * CUDAMemory::get_tag_pinned() {
+	static MemoryTracker::Tag * tag = MemoryTracker::get_tag("CUDA Pinned"_sv);
+	return tag;
+}
+
+CUdeviceptr CUDAMemory::alloc_device(size_t num_bytes) {
+	if (!cpu_config.enable_device_memory_pool) {
+		CUdeviceptr ptr;
+		CUDACALL(cuMemAlloc(&ptr, num_bytes));
+		return ptr;
+	}
+
+	MutexLock lock(pool_mutex);
+
+	CUdeviceptr ptr = get_pool().alloc(num_bytes);
+	if (ptr == NULL) {
+		Log::error(Log::Category::CUDA, "Out of Device memory while allocating {} KB!\n"_sv, num_bytes >> 10);
+		CUDACALL(CUDA_ERROR_OUT_OF_MEMORY);
+	}
+	return ptr;
+}
+
+void CUDAMemory::free_device(CUdeviceptr ptr) {
+	if (!cpu_config.enable_device_memory_pool) {
+		CUDACALL(cuMemFree(ptr));
+		return;
+	}
+
+	MutexLock lock(pool_mutex);
+	get_pool().free(ptr);
+}
+
+void CUDAMemory::trim_pool() {
+	MutexLock lock(pool_mutex);
+	get_pool().trim();
+}
+
+void CUDAMemory::free_pool() {
+	MutexLock lock(pool_mutex);
+	get_pool().free_all();
+}
+
+MemoryPool::Stats CUDAMemory::get_pool_stats() {
+	MutexLock lock(pool_mutex);
+	return get_pool().get_stats();
+}
+
+void CUDAMemory::print_pool_stats() {
+	if (!cpu_config.enable_device_memory_pool) return;
+
+	MemoryPool::Stats stats = get_pool_stats();
+
+	IO::print("Device memory pool: {} MB reserved in {} blocks, {} MB in use (peak {} MB), {} MB free, largest free range {} MB\n"_sv,
+		stats.bytes_reserved >> 20, stats.num_blocks, stats.bytes_in_use >> 20, stats.bytes_in_use_peak >> 20, stats.bytes_free >> 20, stats.largest_free_range >> 20);
+	IO::print("Device memory pool: {} allocations ({} live, {} served by size classes), {} frees, {} cuMemAlloc calls, {} synchronizes, peak transient {} KB\n"_sv,
+		stats.num_alloc_calls, stats.num_allocations, stats.num_size_class_hits, stats.num_free_calls, stats.num_backend_allocs, stats.num_synchronizes, stats.bytes_transient_peak >> 10);
+}
+
+void CUDAMemory::reset_transient() {
+	MutexLock lock(pool_mutex);
+	get_pool().reset_transient();
+}
+
+// Transient allocations always go through the pool, even if it is disabled for regular allocations
+CUdeviceptr CUDAMemory::alloc_transient(size_t num_bytes) {
+	MutexLock lock(pool_mutex);
+
+	CUdeviceptr ptr = get_pool().alloc_transient(num_bytes);
+	if (ptr == NULL) {
+		Log::error(Log::Category::CUDA, "Out of Device memory while allocating {} KB of transient memory!\n"_sv, num_bytes >> 10);
+		CUDACALL(CUDA_ERROR_OUT_OF_MEMORY);
+	}
+	return ptr;
+}
+
 CUarray CUDAMemory::create_array(int width, int height, int channels, CUarray_format format) {
 	CUDA_ARRAY_DESCRIPTOR desc = { };
 	desc.Width       = width;
@@ -4,6 +4,12 @@
 #include "Core/Array.h"
 #include "Core/Assertion.h"
 #include "Core/IO.h"
+#include "Core/MemoryTracker.h"
+#include "Core/Allocators/Allocator.h"
+
+#include "Math/Math.h"
+
+#include "MemoryPool.h"
 
 namespace CUDAMemory {
 	// Type safe device pointer wrapper
@@ -23,6 +29,32 @@ namespace CUDAMemory {
 		}
 	};
 
+	// Pointer to the element at the given offset, does not take ownership
+	template<typename T>
+	inline Ptr<T> offset(Ptr<T> ptr, size_t offset) {
+		return Ptr<T>(ptr.ptr + offset * sizeof(T));
+	}
+
+	// MemoryTracker Tags under which device and pinned allocations are counted
+	MemoryTracker::Tag * get_tag_device();
+	MemoryTracker::Tag * get_tag_pinned();
+
+	// Untyped Device allocation, goes through the MemoryPool unless it is disabled in cpu_config
+	CUdeviceptr alloc_device(size_t num_bytes);
+	void        free_device (CUdeviceptr ptr);
+
+	// Returns cached Device memory that is not in use to the driver
+	void trim_pool();
+	// Releases all Device memory held by the MemoryPool, called before the CUDA Context is destroyed
+	void free_pool();
+
+	MemoryPool::Stats get_pool_stats();
+	void              print_pool_stats();
+
+	// Marks the end of a frame, after which all transient allocations may be reused
+	void reset_transient();
+	CUdeviceptr alloc_transient(size_t num_bytes);
+
 	template<typename T>
 	inline T * malloc_pinned(size_t count = 1) {
 		ASSERT(count > 0);
@@ -30,6 +62,8 @@ namespace CUDAMemory {
 		T * ptr;
 		CUDACALL(cuMemAllocHost(reinterpret_cast<void **>(&ptr), count * sizeof(T)));
 
+		MemoryTracker::track_alloc(get_tag_pinned(), ptr, count * sizeof(T));
+
 		return ptr;
 	}
 
@@ -37,12 +71,20 @@ namespace CUDAMemory {
 	inline Ptr<T> malloc(size_t count = 1) {
 		ASSERT(count > 0);
 
-		CUdeviceptr ptr;
-		CUDACALL(cuMemAlloc(&ptr, count * sizeof(T)));
+		CUdeviceptr ptr = alloc_device(count * sizeof(T));
+
+		MemoryTracker::track_alloc(get_tag_device(), reinterpret_cast<const void *>(ptr), count * sizeof(T));
 
 		return Ptr<T>(ptr);
 	}
 
+	// Device memory that is only valid until the end of the current frame (see reset_transient), and should not be freed
+	template<typename T>
+	inline Ptr<T> malloc_transient(size_t count = 1) {
+		ASSERT(count > 0);
+		return Ptr<T>(alloc_transient(count * sizeof(T)));
+	}
+
 	template<typename T>
 	inline Ptr<T> malloc(const T * data, size_t count) {
 		Ptr<T> ptr = malloc<T>(count);
@@ -64,13 +106,15 @@ namespace CUDAMemory {
 	template<typename T>
 	inline void free_pinned(T * ptr) {
 		ASSERT(ptr);
+		MemoryTracker::track_free(ptr);
 		CUDACALL(cuMemFreeHost(ptr));
 	}
 
 	template<typename T>
 	inline void free(Ptr<T> & ptr) {
 		ASSERT(ptr.ptr);
-		CUDACALL(cuMemFree(ptr.ptr));
+		MemoryTracker::track_free(reinterpret_cast<const void *>(ptr.ptr));
+		free_device(ptr.ptr);
 		ptr.ptr = NULL;
 	}
 
@@ -110,6 +154,54 @@ namespace CUDAMemory {
 		CUDACALL(cuMemcpyDtoHAsync(dst, src.ptr, count * sizeof(T), stream));
 	}
 
+	template<typename T>
+	inline void memcpy_async(Ptr<T> dst, Ptr<T> src, size_t count, CUstream stream) {
+		ASSERT(src.ptr);
+		ASSERT(dst.ptr);
+		ASSERT(count > 0);
+
+		CUDACALL(cuMemcpyDtoDAsync(dst.ptr, src.ptr, count * sizeof(T), stream));
+	}
+
+	// Uploads count elements to dst without a full copy of the data on the Host.
+	// fill(first, count, dst) should produce the given range of elements into dst, which is one of two pinned staging buffers.
+	// The buffers are alternated so that filling the next chunk on the Host overlaps with the async upload of the previous chunk
+	template<typename T, typename Fill>
+	inline void upload_staged(Ptr<T> dst, size_t count, CUstream stream, Fill && fill, size_t staging_size_in_bytes = MEGABYTES(8)) {
+		if (count == 0) return;
+
+		size_t chunk_size = Math::min(Math::max<size_t>(staging_size_in_bytes / sizeof(T), 1), count);
+
+		T      * staging[2] = { };
+		CUevent  uploaded[2] = { };
+		for (int i = 0; i < 2; i++) {
+			staging[i] = malloc_pinned<T>(chunk_size);
+			CUDACALL(cuEventCreate(&uploaded[i], CU_EVENT_DISABLE_TIMING));
+		}
+
+		int buffer = 0;
+		for (size_t first = 0; first < count; first += chunk_size) {
+			size_t n = Math::min(chunk_size, count - first);
+
+			// Wait until the previous upload from this staging buffer has completed
+			CUDACALL(cuEventSynchronize(uploaded[buffer]));
+
+			fill(first, n, staging[buffer]);
+
+			memcpy_async(offset(dst, first), staging[buffer], n, stream);
+			CUDACALL(cuEventRecord(uploaded[buffer], stream));
+
+			buffer ^= 1;
+		}
+
+		CUDACALL(cuStreamSynchronize(stream));
+
+		for (int i = 0; i < 2; i++) {
+			CUDACALL(cuEventDestroy(uploaded[i]));
+			free_pinned(staging[i]);
+		}
+	}
+
 	template<typename T>
 	inline void memset_async(Ptr<T> ptr, int value, size_t count, CUstream stream) {
 		int size_in_bytes = count * sizeof(T);
@@ -6,10 +6,14 @@
 
 #include "Core/Assertion.h"
 #include "Core/IO.h"
+#include "Core/Log.h"
 #include "Core/Parser.h"
 #include "Core/Timer.h"
 
+#include "Config.h"
+
 #include "CUDAMemory.h"
+#include "KernelCache.h"
 
 #include "Util/Util.h"
 #include "Util/StringUtil.h"
@@ -30,9 +34,8 @@ struct Include {
 
 // Recursively walks include tree
 // Collects filename and source of included files in 'includes'
-// Also check whether any included file has been modified since last compilation and if so sets 'should_recompile'
 // Returns source code of 'filename'
-static String scan_includes_recursive(const String & filename, Allocator * allocator, StringView directory, Array<Include> & includes, StringView ptx_filename, bool & should_recompile) {
+static String scan_includes_recursive(const String & filename, Allocator * allocator, StringView directory, Array<Include> & includes) {
 	String source = IO::file_read(filename, allocator);
 	Parser parser(source.view(), filename.view());
 
@@ -73,19 +76,13 @@ static String scan_includes_recursive(const String & filename, Allocator * alloc
 				String include_full_path = Util::combine_stringviews(directory, include_filename, allocator);
 
 				if (IO::file_exists(include_full_path.view())) {
-					if (!should_recompile && IO::file_is_newer(ptx_filename, include_full_path.view())) {
-						should_recompile = true;
-
-						IO::print("CUDA Module '{}': Recompilation required because included file '{}' changed.\n"_sv, filename, include_filename);
-					}
-
 					StringView path = Util::get_directory(include_full_path.view());
 
 					size_t index = includes.size();
 					includes.emplace_back();
 
 					includes[index].filename = String(include_filename, allocator);
-					includes[index].source   = scan_includes_recursive(include_full_path, allocator, path, includes, ptx_filename, should_recompile);
+					includes[index].source   = scan_includes_recursive(include_full_path, allocator, path, includes);
 				}
 			}
 		} else {
@@ -96,9 +93,81 @@ static String scan_includes_recursive(const String & filename, Allocator * alloc
 	return source;
 }
 
+// The Key covers everything that determines the PTX that NVRTC produces, see KernelCache.h
+static KernelCache::Key calc_cache_key(StringView module_name, const String & source, const Array<Include> & includes, const Array<String> & options) {
+	int nvrtc_major;
+	int nvrtc_minor;
+	NVRTC_CALL(nvrtcVersion(&nvrtc_major, &nvrtc_minor));
+
+	KernelCache::KeyBuilder key_builder;
+	key_builder.add(module_name);
+	key_builder.add(source.view());
+
+	key_builder.add(uint64_t(includes.size()));
+	for (size_t i = 0; i < includes.size(); i++) {
+		key_builder.add(includes[i].filename.view());
+		key_builder.add(includes[i].source  .view());
+	}
+
+	key_builder.add(uint64_t(options.size()));
+	for (size_t i = 0; i < options.size(); i++) {
+		key_builder.add(options[i].view());
+	}
+
+	key_builder.add(uint64_t(nvrtc_major));
+	key_builder.add(uint64_t(nvrtc_minor));
+
+	return key_builder.get();
+}
+
 void CUDAModule::init(const String & module_name, const String & filename, int compute_capability, int max_registers) {
 	ScopeTimer timer("CUDA Module Init"_sv);
 
+	this->module_name        = module_name;
+	this->filename           = filename;
+	this->compute_capability = compute_capability;
+	this->max_registers      = max_registers;
+
+	bindings       .clear();
+	binding_indices.clear();
+
+	load();
+}
+
+void CUDAModule::reload() {
+	ScopeTimer timer("CUDA Module Reload"_sv);
+
+	CUmodule module_prev = module;
+	load();
+
+	// Point every Binding to the global in the new Module and restore its value
+	for (auto it = binding_indices.begin(); it != binding_indices.end(); ++it) {
+		const String & variable_name = it.get_key();
+		Binding      & binding       = bindings[it.get_value()];
+
+		size_t size;
+		CUresult result = cuModuleGetGlobal(&binding.ptr, &size, module, variable_name.c_str());
+		if (result == CUDA_ERROR_NOT_FOUND) {
+			Log::warning(Log::Category::CUDA, "Global CUDA variable '{}' no longer exists after reload!\n"_sv, variable_name);
+			binding.ptr = NULL;
+			continue;
+		}
+		CUDACALL(result);
+
+		if (binding.value.size() == 0) continue; // Never assigned by the Host
+
+		if (binding.value.size() != size) {
+			Log::warning(Log::Category::CUDA, "Global CUDA variable '{}' changed size after reload ({} -> {} bytes), its value was not restored!\n"_sv, variable_name, binding.value.size(), size);
+			continue;
+		}
+
+		CUDACALL(cuMemcpyHtoD(binding.ptr, binding.value.data(), size));
+	}
+
+	CUDACALL(cuModuleUnload(module_prev));
+}
+
+void CUDAModule::load() {
 	if (!IO::file_exists(filename.view())) {
 		IO::print("ERROR: File '{}' does not exist!\n"_sv, filename);
 		IO::exit(1);
@@ -106,24 +175,38 @@ void CUDAModule::init(const String & module_name, const String & filename, int c
 
 	LinearAllocator<KILOBYTES(512)> allocator;
 
-#ifdef _DEBUG
-	String ptx_filename = Util::combine_stringviews(filename.view(), ".debug.ptx"_sv, &allocator);
-#else
-	String ptx_filename = Util::combine_stringviews(filename.view(), ".release.ptx"_sv, &allocator);
-#endif
-
-	bool should_recompile = true;
-
-	// If the binary does not exists we definately need to compile
-	if (IO::file_exists(ptx_filename.view())) {
-		// Recompile if the source file is newer than the binary
-		should_recompile = IO::file_is_newer(ptx_filename.view(), filename.view());
+	// Configure options
+	Array<String> nvrtc_options;
+	nvrtc_options.emplace_back("--std=c++11"_sv);
+	nvrtc_options.push_back(Format().format("--gpu-architecture=compute_{}"_sv, compute_capability));
+	nvrtc_options.push_back(Format().format("--maxrregcount={}"_sv, max_registers));
+	nvrtc_options.emplace_back("--use_fast_math"_sv);
+	nvrtc_options.emplace_back("--extra-device-vectorization"_sv);
+	//nvrtc_options.emplace_back("--device-debug"_sv);
+	nvrtc_options.emplace_back("-lineinfo"_sv);
+	nvrtc_options.emplace_back("-restrict"_sv);
+
+	for (size_t i = 0; i < defines.size(); i++) {
+		nvrtc_options.push_back(defines[i]);
 	}
 
 	StringView path = Util::get_directory(filename.view());
 
 	Array<Include> includes;
-	String source = scan_includes_recursive(filename, &allocator, path, includes, ptx_filename.view(), should_recompile);
+	String source = scan_includes_recursive(filename, &allocator, path, includes);
+
+	StringView cache_directory = cpu_config.kernel_cache_directory.view();
+	if (!IO::directory_create(cache_directory)) {
+		Log::warning(Log::Category::CUDA, "Unable to create kernel cache directory '{}'!\n"_sv, cache_directory);
+	}
+
+	KernelCache::Index cache_index;
+	KernelCache::load_index(cache_directory, cache_index);
+
+	KernelCache::Key cache_key    = calc_cache_key(module_name.view(), source, includes, nvrtc_options);
+	String           ptx_filename = KernelCache::get_ptx_filename(cache_directory, cache_key, &allocator);
+
+	bool should_recompile = !cache_index.lookup(cache_key) || !IO::file_exists(ptx_filename.view());
 
 	if (should_recompile) {
 		nvrtcProgram program;
@@ -141,23 +224,13 @@ void CUDAModule::init(const String & module_name, const String & filename, int c
 			// Create NVRTC Program from the source and all includes
 			NVRTC_CALL(nvrtcCreateProgram(&program, source.data(), module_name.c_str(), int(num_includes), include_sources.data(), include_names.data()));
 
-			// Configure options
-			String option_compute = Format(&allocator).format("--gpu-architecture=compute_{}"_sv, compute_capability);
-			String option_maxregs = Format(&allocator).format("--maxrregcount={}"_sv, max_registers);
-
-			const char * options[] = {
-				"--std=c++11",
-				option_compute.data(),
-				option_maxregs.data(),
-				"--use_fast_math",
-				"--extra-device-vectorization",
-				//"--device-debug",
-				"-lineinfo",
-				"-restrict"
-			};
+			Array<const char *> option_strings(nvrtc_options.size(), &allocator);
+			for (size_t i = 0; i < nvrtc_options.size(); i++) {
+				option_strings[i] = nvrtc_options[i].c_str();
+			}
 
 			// Compile to PTX
-			nvrtcResult result = nvrtcCompileProgram(program, Util::array_count(options), options);
+			nvrtcResult result = nvrtcCompileProgram(program, int(option_strings.size()), option_strings.data());
 
 			size_t log_size;
 			NVRTC_CALL(nvrtcGetProgramLogSize(program, &log_size));
@@ -173,10 +246,16 @@ void CUDAModule::init(const String & module_name, const String & filename, int c
 
 			__debugbreak(); // Compile error
 
+			NVRTC_CALL(nvrtcDestroyProgram(&program));
+
 			// Reload file and try again
 			allocator.reset();
 			includes.clear();
-			source = scan_includes_recursive(filename, &allocator, path, includes, ptx_filename.view(), should_recompile);
+			source = scan_includes_recursive(filename, &allocator, path, includes);
+
+			// The source changed, so it will be cached under a different Key
+			cache_key    = calc_cache_key(module_name.view(), source, includes, nvrtc_options);
+			ptx_filename = KernelCache::get_ptx_filename(cache_directory, cache_key, &allocator);
 		}
 
 		// Obtain PTX from NVRTC
@@ -187,10 +266,19 @@ void CUDAModule::init(const String & module_name, const String & filename, int c
 
 		// Cache PTX on disk
 		IO::file_write(ptx_filename, ptx.view());
+
+		Array<KernelCache::Key> evicted_keys;
+		cache_index.insert(cache_key, ptx.size(), evicted_keys);
+
+		for (size_t i = 0; i < evicted_keys.size(); i++) {
+			IO::file_delete(KernelCache::get_ptx_filename(cache_directory, evicted_keys[i], &allocator).view());
+		}
 	} else {
-		IO::print("CUDA Module '{}' did not need to recompile.\n"_sv, filename);
+		IO::print("CUDA Module '{}' did not need to recompile, loaded '{}' from the kernel cache.\n"_sv, filename, ptx_filename);
 	}
 
+	KernelCache::save_index(cache_directory, cache_index);
+
 	char log_buffer[8192];
 	log_buffer[0] = NULL;
 
@@ -227,17 +315,35 @@ void CUDAModule::init(const String & module_name, const String & filename, int c
 
 void CUDAModule::free() {
 	CUDACALL(cuModuleUnload(module));
+
+	bindings       .clear();
+	binding_indices.clear();
 }
 
-CUDAModule::Global CUDAModule::get_global(const char * variable_name) const {
-	Global global;
+CUDAModule::Global CUDAModule::get_global(const char * variable_name) {
+	StringView name = StringView::from_c_str(variable_name);
+
+	int * binding_index = binding_indices.try_get(name);
+	if (binding_index) return Global { this, *binding_index };
+
+	Binding binding = { };
 
 	size_t size;
-	CUresult result = cuModuleGetGlobal(&global.ptr, &size, module, variable_name);
+	CUresult result = cuModuleGetGlobal(&binding.ptr, &size, module, variable_name);
 	if (result == CUDA_ERROR_NOT_FOUND) {
 		IO::print("ERROR: Global CUDA variable '{}' not found!\n"_sv, variable_name);
 	}
 	CUDACALL(result);
 
-	return global;
+	int index = int(bindings.size());
+	bindings.push_back(std::move(binding));
+	binding_indices.insert(String(name), index);
+
+	return Global { this, index };
+}
+
+void CUDAModule::Global::record(const void * value, size_t size) const {
+	Array<unsigned char> & recorded_value = module->bindings[binding_index].value;
+	recorded_value.resize(size);
+	memcpy(recorded_value.data(), value, size);
 }
@@ -5,35 +5,73 @@
 
 #include "CUDACall.h"
 
+#include "Core/Array.h"
 #include "Core/String.h"
+#include "Core/RobinHoodHashMap.h"
 
 struct CUDAModule {
 	CUmodule module;
 
-	struct Global {
+	String module_name;
+	String filename;
+	int    compute_capability;
+	int    max_registers;
+
+	// Additional -D options the Module is compiled with, can be changed before calling init() or reload()
+	Array<String> defines;
+
+	// Every global that was looked up through get_global, together with the last value the Host assigned to it.
+	// This allows reload() to restore the globals of the recompiled Module, so the Device allocations they point to can stay alive
+	struct Binding {
 		CUdeviceptr ptr;
 
+		Array<unsigned char> value;
+	};
+	Array<Binding>                bindings;
+	RobinHoodHashMap<String, int> binding_indices;
+
+	// Handle to a global, remains valid when the Module is reloaded
+	struct Global {
+		CUDAModule * module;
+		int          binding_index;
+
+		inline CUdeviceptr ptr() const {
+			return module->bindings[binding_index].ptr;
+		}
+
 		template<typename T>
 		inline void set_value(const T & value) const {
-			CUDACALL(cuMemcpyHtoD(ptr, &value, sizeof(T)));
+			record(&value, sizeof(T));
+			CUDACALL(cuMemcpyHtoD(ptr(), &value, sizeof(T)));
 		}
 
 		template<typename T>
 		inline void set_value_async(const T & value, CUstream stream) const {
-			CUDACALL(cuMemcpyHtoDAsync(ptr, &value, sizeof(T), stream));
+			record(&value, sizeof(T));
+			CUDACALL(cuMemcpyHtoDAsync(ptr(), &value, sizeof(T), stream));
 		}
 
 		template<typename T>
 		inline T get_value() const {
 			T result;
-			CUDACALL(cuMemcpyDtoH(&result, ptr, sizeof(T)));
+			CUDACALL(cuMemcpyDtoH(&result, ptr(), sizeof(T)));
 
 			return result;
 		}
+
+	private:
+		void record(const void * value, size_t size) const;
 	};
 
 	void init(const String & module_name, const String & filename, int compute_capability, int max_registers);
 	void free();
 
-	Global get_global(const char * variable_name) const;
+	// Recompiles the Module if its source or defines changed and restores the last value of every global in the new Module.
+	// Kernels (CUfunctions) of the old Module are invalid afterwards and need to be looked up again
+	void reload();
+
+	Global get_global(const char * variable_name);
+
+private:
+	void load();
 };
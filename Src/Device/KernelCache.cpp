@@ -0,0 +1,247 @@
+#include "KernelCache.h"
+
+#include <string.h>
+
+#include "Core/IO.h"
+#include "Core/Log.h"
+#include "Core/Parser.h"
+#include "Core/Allocators/StackAllocator.h"
+
+#include "Util/Check.h"
+
+constexpr uint64_t FNV_PRIME = 1099511628211ull;
+
+constexpr char KERNEL_CACHE_FILETYPE_VERSION = 1;
+
+void KernelCache::KeyBuilder::add(StringView str) {
+	uint64_t length = 0;
+
+	for (const char * c = str.start; c < str.end; c++) {
+		if (*c == '\r') continue;
+
+		hash = (hash ^ uint8_t(*c)) * FNV_PRIME;
+		length++;
+	}
+
+	add(length);
+}
+
+void KernelCache::KeyBuilder::add(uint64_t value) {
+	for (int i = 0; i < 8; i++) {
+		hash = (hash ^ ((value >> (8 * i)) & 0xff)) * FNV_PRIME;
+	}
+}
+
+bool KernelCache::Index::lookup(Key key) {
+	for (size_t i = 0; i < entries.size(); i++) {
+		if (entries[i].key == key) {
+			entries[i].last_used = ++clock;
+			return true;
+		}
+	}
+	return false;
+}
+
+void KernelCache::Index::insert(Key key, size_t size, Array<Key> & evicted) {
+	remove(key);
+	entries.push_back({ key, size, ++clock });
+
+	while (entries.size() > 1 && (entries.size() > size_t(max_entries) || size_in_bytes() > max_bytes)) {
+		// Find least recently used entry, the entry that was just inserted has the highest clock and is never selected
+		size_t lru_index = 0;
+		for (size_t i = 1; i < entries.size(); i++) {
+			if (entries[i].last_used < entries[lru_index].last_used) {
+				lru_index = i;
+			}
+		}
+
+		evicted.push_back(entries[lru_index].key);
+
+		entries[lru_index] = entries.back();
+		entries.pop_back();
+	}
+}
+
+void KernelCache::Index::remove(Key key) {
+	for (size_t i = 0; i < entries.size(); i++) {
+		if (entries[i].key == key) {
+			entries[i] = entries.back();
+			entries.pop_back();
+			return;
+		}
+	}
+}
+
+size_t KernelCache::Index::size_in_bytes() const {
+	size_t size = 0;
+	for (size_t i = 0; i < entries.size(); i++) {
+		size += entries[i].size;
+	}
+	return size;
+}
+
+struct KernelCacheHeader {
+	char filetype_identifier[4];
+	char filetype_version;
+
+	uint64_t clock;
+	int      num_entries;
+};
+
+String KernelCache::Index::serialize(Allocator * allocator) const {
+	KernelCacheHeader header = { };
+	header.filetype_identifier[0] = 'K';
+	header.filetype_identifier[1] = 'C';
+	header.filetype_identifier[2] = 'I';
+	header.filetype_identifier[3] = '\0';
+	header.filetype_version = KERNEL_CACHE_FILETYPE_VERSION;
+
+	header.clock       = clock;
+	header.num_entries = int(entries.size());
+
+	Array<char> data(allocator);
+	data.push_back(reinterpret_cast<const char *>(&header), sizeof(header));
+	data.push_back(reinterpret_cast<const char *>(entries.data()), entries.size() * sizeof(Entry));
+	data.push_back('\0'); // The data may end in a zero byte, always terminate explicitly so that it is not mistaken for the terminator
+
+	return String(std::move(data));
+}
+
+bool KernelCache::Index::deserialize(StringView data) {
+	entries.clear();
+	clock = 0;
+
+	if (data.length() < sizeof(KernelCacheHeader)) return false;
+
+	Parser parser(data);
+	KernelCacheHeader header = parser.parse_binary<KernelCacheHeader>();
+
+	if (strcmp(header.filetype_identifier, "KCI") != 0 || header.filetype_version != KERNEL_CACHE_FILETYPE_VERSION) return false;
+
+	if (header.num_entries < 0 || data.length() != sizeof(KernelCacheHeader) + size_t(header.num_entries) * sizeof(Entry)) return false;
+
+	entries.resize(header.num_entries);
+	for (size_t i = 0; i < entries.size(); i++) {
+		entries[i] = parser.parse_binary<Entry>();
+	}
+	clock = header.clock;
+
+	return true;
+}
+
+String KernelCache::get_ptx_filename(StringView directory, Key key, Allocator * allocator) {
+	char key_hex[17];
+	for (int i = 0; i < 16; i++) {
+		key_hex[i] = "0123456789abcdef"[(key >> (60 - 4 * i)) & 0xf];
+	}
+	key_hex[16] = '\0';
+
+	return Format(allocator).format("{}/{}.ptx"_sv, directory, StringView::from_c_str(key_hex));
+}
+
+String KernelCache::get_index_filename(StringView directory, Allocator * allocator) {
+	return Format(allocator).format("{}/index.bin"_sv, directory);
+}
+
+void KernelCache::load_index(StringView directory, Index & index) {
+	StackAllocator<KILOBYTES(8)> allocator;
+	String index_filename = get_index_filename(directory, &allocator);
+
+	if (!IO::file_exists(index_filename.view())) {
+		index.entries.clear();
+		index.clock = 0;
+		return;
+	}
+
+	String data = IO::file_read(index_filename, &allocator);
+	if (!index.deserialize(data.view())) {
+		Log::warning(Log::Category::CUDA, "Kernel cache index '{}' is invalid, the cache will be rebuilt!\n"_sv, index_filename);
+	}
+}
+
+void KernelCache::save_index(StringView directory, const Index & index) {
+	StackAllocator<KILOBYTES(8)> allocator;
+	String index_filename = get_index_filename(directory, &allocator);
+
+	String data = index.serialize(&allocator);
+	if (!IO::file_write(index_filename, data.view())) {
+		Log::warning(Log::Category::CUDA, "Unable to write kernel cache index '{}'!\n"_sv, index_filename);
+	}
+}
+
+bool KernelCache::run_check() {
+	Check::Checker check;
+
+	auto calc_key = [](StringView source, StringView option, uint64_t nvrtc_version) {
+		KeyBuilder key_builder;
+		key_builder.add("Pathtracer"_sv);
+		key_builder.add(source);
+		key_builder.add(option);
+		key_builder.add(nvrtc_version);
+		return key_builder.get();
+	};
+
+	// Key construction
+	Key key = calc_key("int a;\nint b;\n"_sv, "-DSCENE_HAS_MEDIA=1"_sv, 12);
+
+	check(key == calc_key("int a;\r\nint b;\r\n"_sv, "-DSCENE_HAS_MEDIA=1"_sv, 12), "Key ignores line endings");
+	check(key != calc_key("int a;\nint c;\n"_sv,     "-DSCENE_HAS_MEDIA=1"_sv, 12), "Key depends on source");
+	check(key != calc_key("int a;\nint b;\n"_sv,     "-DSCENE_HAS_MEDIA=0"_sv, 12), "Key depends on options");
+	check(key != calc_key("int a;\nint b;\n"_sv,     "-DSCENE_HAS_MEDIA=1"_sv, 13), "Key depends on NVRTC version");
+	check(key != calc_key("int a;\nint b;\n-DSCENE_HAS_MEDIA=1"_sv, ""_sv, 12),     "Key depends on field boundaries");
+
+	// Eviction by number of entries
+	Array<Key> evicted;
+
+	Index index;
+	index.max_entries = 3;
+	index.insert(1, 10, evicted);
+	index.insert(2, 10, evicted);
+	index.insert(3, 10, evicted);
+	check(evicted.size() == 0, "No eviction below the limit");
+
+	check( index.lookup(1), "Lookup of inserted key");
+	check(!index.lookup(4), "Lookup of unknown key");
+
+	index.insert(4, 10, evicted);
+	check(evicted.size() == 1 && evicted[0] == 2, "Least recently used entry is evicted");
+	check(index.lookup(1) && index.lookup(3) && index.lookup(4) && !index.lookup(2), "Remaining entries after eviction");
+
+	evicted.clear();
+	index.insert(3, 20, evicted);
+	check(evicted.size() == 0 && index.entries.size() == 3 && index.size_in_bytes() == 40, "Reinserting a key updates its entry");
+
+	// Eviction by size
+	Index index_bytes;
+	index_bytes.max_bytes = 100;
+	index_bytes.insert(1, 60, evicted);
+	index_bytes.insert(2, 60, evicted);
+	check(evicted.size() == 1 && evicted[0] == 1, "Entries are evicted to stay within the size limit");
+
+	evicted.clear();
+	index_bytes.insert(3, 200, evicted);
+	check(index_bytes.lookup(3) && index_bytes.entries.size() == 1, "Entry larger than the cache is kept");
+
+	// Serialization
+	String data = index.serialize();
+
+	Index index_loaded;
+	check(index_loaded.deserialize(data.view()), "Deserialize valid Index");
+	check(index_loaded.clock == index.clock && index_loaded.entries.size() == index.entries.size(), "Deserialized Index matches");
+
+	for (size_t i = 0; i < index.entries.size(); i++) {
+		const Entry & a = index.entries[i];
+		const Entry & b = index_loaded.entries[i];
+		check(a.key == b.key && a.size == b.size && a.last_used == b.last_used, "Deserialized entry matches");
+	}
+
+	check(!index_loaded.deserialize(StringView { data.data(), data.data() + data.size() - 1 }), "Reject truncated Index");
+	check(!index_loaded.deserialize("garbage"_sv), "Reject invalid Index");
+	check(index_loaded.entries.size() == 0, "Invalid Index is empty");
+
+	// Filenames
+	String ptx_filename = get_ptx_filename("Cache"_sv, 0x0123456789abcdefull);
+	check(ptx_filename.view() == "Cache/0123456789abcdef.ptx"_sv, "PTX filename");
+
+	return check.report("Kernel cache"_sv);
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+#include "Core/Array.h"
+#include "Core/String.h"
+#include "Core/StringView.h"
+
+// On-disk cache of PTX compiled by NVRTC. Every cached Module is identified by a Key, which is a hash of everything that
+// determines the output of the compiler: the source of the Module and of all files it includes, all compiler options
+// (including the -D defines the Module is specialized with) and the NVRTC version. Because the Key only depends on
+// content, and not on file timestamps or paths, cached PTX stays valid across checkouts and machines.
+// The index of the cache is kept within a maximum number of entries and bytes by evicting the least recently used entries
+namespace KernelCache {
+	using Key = uint64_t;
+
+	constexpr int    MAX_ENTRIES = 32;
+	constexpr size_t MAX_BYTES   = MEGABYTES(256);
+
+	// Incremental 64 bit FNV-1a hash
+	struct KeyBuilder {
+		uint64_t hash = 14695981039346656037ull;
+
+		// Carriage returns are skipped, so that checkouts with CRLF and LF line endings produce the same Key.
+		// The length of every field is mixed in as well, so that consecutive fields cannot run into each other
+		void add(StringView str);
+		void add(uint64_t value);
+
+		Key get() const { return hash; }
+	};
+
+	struct Entry {
+		Key      key;
+		uint64_t size;      // Size of the PTX in bytes
+		uint64_t last_used; // Value of Index::clock when the entry was last looked up or inserted
+	};
+
+	struct Index {
+		Array<Entry> entries;
+		uint64_t     clock = 0;
+
+		int    max_entries = MAX_ENTRIES;
+		size_t max_bytes   = MAX_BYTES;
+
+		// Returns whether the Key is in the cache, and if so marks it as most recently used
+		bool lookup(Key key);
+
+		// Adds (or updates) the Key as most recently used, then evicts least recently used entries until the cache is within its limits.
+		// The entry that was just inserted is never evicted. Keys of evicted entries are appended to 'evicted', so their files can be deleted
+		void insert(Key key, size_t size, Array<Key> & evicted);
+
+		void remove(Key key);
+
+		size_t size_in_bytes() const;
+
+		// Binary representation of the Index, as stored on disk
+		String serialize(Allocator * allocator = nullptr) const;
+		bool   deserialize(StringView data);
+	};
+
+	// The Key already covers the name of the Module, so the filename of an evicted entry can be found from its Key alone
+	String get_ptx_filename  (StringView directory, Key key, Allocator * allocator = nullptr);
+	String get_index_filename(StringView directory, Allocator * allocator = nullptr);
+
+	// Loads the Index from the cache directory, the Index is empty if it does not exist or is invalid
+	void load_index(StringView directory, Index & index);
+	void save_index(StringView directory, const Index & index);
+
+	// Checks Key construction, lookup, eviction and (de)serialization of the Index
+	bool run_check();
+}
@@ -0,0 +1,766 @@
+#include "MemoryPool.h"
+
+#include "Core/IO.h"
+#include "Core/Log.h"
+#include "Core/Sort.h"
+#include "Core/Random.h"
+
+#include "Math/Math.h"
+
+#include "Util/Check.h"
+
+static int get_size_class(size_t num_bytes) {
+	int    size_class = 0;
+	size_t class_size = MemoryPool::SMALL_SIZE_MIN;
+
+	while (class_size < num_bytes) {
+		class_size *= 2;
+		size_class++;
+	}
+	return size_class;
+}
+
+static size_t get_size_class_size(int size_class) {
+	return MemoryPool::SMALL_SIZE_MIN << size_class;
+}
+
+static uint64_t align_up(uint64_t ptr, size_t alignment) {
+	return (ptr + alignment - 1) & ~uint64_t(alignment - 1);
+}
+
+template<typename T>
+static void array_insert(Array<T> & array, size_t index, const T & element) {
+	array.push_back(element);
+	for (size_t i = array.size() - 1; i > index; i--) {
+		array[i] = array[i - 1];
+	}
+	array[index] = element;
+}
+
+template<typename T>
+static void array_erase(Array<T> & array, size_t index) {
+	for (size_t i = index; i + 1 < array.size(); i++) {
+		array[i] = array[i + 1];
+	}
+	array.pop_back();
+}
+
+uint64_t MemoryPool::alloc(size_t num_bytes, size_t alignment) {
+	ASSERT(backend);
+	ASSERT(num_bytes > 0);
+	ASSERT((alignment & (alignment - 1)) == 0);
+
+	num_alloc_calls++;
+
+	alignment = Math::max(alignment, ALIGNMENT);
+
+	Allocation allocation = { };
+	uint64_t   ptr        = 0;
+
+	// Slots within a slab are only aligned to ALIGNMENT, so stricter alignments are always sub-allocated from a block
+	if (num_bytes <= SMALL_SIZE_MAX && alignment == ALIGNMENT) {
+		allocation.size_class = get_size_class(num_bytes);
+		allocation.size       = get_size_class_size(allocation.size_class);
+		ptr = alloc_small(allocation.size_class);
+	} else {
+		allocation.size_class = SIZE_CLASS_NONE;
+		allocation.size       = Math::round_up(num_bytes, ALIGNMENT);
+		ptr = alloc_range(allocation.size, alignment);
+	}
+	if (ptr == 0) return 0;
+
+	allocations.insert(ptr, allocation);
+
+	bytes_in_use     += allocation.size;
+	bytes_in_use_peak = Math::max(bytes_in_use_peak, bytes_in_use);
+
+	return ptr;
+}
+
+void MemoryPool::free(uint64_t ptr) {
+	Allocation * allocation = allocations.try_get(ptr);
+	if (!allocation) {
+		Log::warning(Log::Category::CUDA, "Freeing address {} that was not allocated by the MemoryPool!\n"_sv, ptr);
+		return;
+	}
+
+	num_free_calls++;
+	bytes_in_use -= allocation->size;
+
+	deferred_frees.push_back({ ptr, *allocation });
+	allocations.erase(ptr);
+}
+
+uint64_t MemoryPool::alloc_transient(size_t num_bytes) {
+	ASSERT(backend);
+
+	if (transient_retired) {
+		flush_deferred();
+	}
+
+	num_bytes = Math::round_up(Math::max<size_t>(num_bytes, 1), ALIGNMENT);
+
+	while (transient_chunk_index < transient_chunks.size()) {
+		TransientChunk & chunk = transient_chunks[transient_chunk_index];
+
+		if (chunk.offset + num_bytes <= chunk.size) {
+			uint64_t ptr = chunk.ptr + chunk.offset;
+			chunk.offset += num_bytes;
+
+			bytes_transient     += num_bytes;
+			bytes_transient_peak = Math::max(bytes_transient_peak, bytes_transient);
+
+			return ptr;
+		}
+		transient_chunk_index++;
+	}
+
+	size_t chunk_size = Math::max(TRANSIENT_CHUNK_SIZE, num_bytes);
+
+	uint64_t chunk_ptr = alloc_range(chunk_size, ALIGNMENT);
+	if (chunk_ptr == 0) return 0;
+
+	transient_chunks.push_back({ chunk_ptr, chunk_size, num_bytes });
+	transient_chunk_index = int(transient_chunks.size()) - 1;
+
+	bytes_transient     += num_bytes;
+	bytes_transient_peak = Math::max(bytes_transient_peak, bytes_transient);
+
+	return chunk_ptr;
+}
+
+void MemoryPool::reset_transient() {
+	// The Device may still be using the transient memory of this frame, so the chunks are only rewound after synchronizing.
+	// This happens lazily on the first transient allocation of a later frame, so frames that do not use transient memory never wait
+	if (bytes_transient > 0) {
+		transient_retired = true;
+	}
+	bytes_transient = 0;
+}
+
+void MemoryPool::trim() {
+	if (!backend) return;
+
+	flush_deferred();
+
+	bool transient_in_use = bytes_transient > 0;
+	if (!transient_in_use) {
+		for (size_t i = 0; i < transient_chunks.size(); i++) {
+			free_range(transient_chunks[i].ptr, transient_chunks[i].size);
+		}
+		transient_chunks.clear();
+		transient_chunk_index = 0;
+	}
+
+	release_empty_slabs();
+	release_empty_blocks();
+}
+
+void MemoryPool::free_all() {
+	if (backend) {
+		for (size_t i = 0; i < blocks.size(); i++) {
+			backend->free(blocks[i].ptr, blocks[i].size);
+			num_backend_frees++;
+		}
+	}
+	blocks.clear();
+
+	for (int i = 0; i < NUM_SIZE_CLASSES; i++) {
+		size_classes[i].slabs     .clear();
+		size_classes[i].free_slots.clear();
+	}
+	allocations.clear();
+	deferred_frees.clear();
+
+	transient_chunks.clear();
+	transient_chunk_index = 0;
+	transient_retired     = false;
+
+	bytes_in_use    = 0;
+	bytes_transient = 0;
+}
+
+MemoryPool::Stats MemoryPool::get_stats() const {
+	Stats stats = { };
+
+	for (size_t b = 0; b < blocks.size(); b++) {
+		const Block & block = blocks[b];
+		stats.bytes_reserved += block.size;
+		stats.bytes_free     += block.bytes_free;
+
+		for (size_t i = 0; i < block.free_ranges.size(); i++) {
+			stats.largest_free_range = Math::max(stats.largest_free_range, block.free_ranges[i].size);
+		}
+	}
+
+	for (int i = 0; i < NUM_SIZE_CLASSES; i++) {
+		stats.bytes_free += size_classes[i].free_slots.size() * get_size_class_size(i);
+		stats.num_slabs  += int(size_classes[i].slabs.size());
+	}
+
+	for (size_t i = 0; i < transient_chunks.size(); i++) {
+		stats.bytes_free += transient_retired ? transient_chunks[i].size : transient_chunks[i].size - transient_chunks[i].offset;
+	}
+
+	for (size_t i = 0; i < deferred_frees.size(); i++) {
+		stats.bytes_deferred += deferred_frees[i].allocation.size;
+	}
+
+	stats.bytes_in_use         = bytes_in_use;
+	stats.bytes_in_use_peak    = bytes_in_use_peak;
+	stats.bytes_transient      = bytes_transient;
+	stats.bytes_transient_peak = bytes_transient_peak;
+
+	stats.num_blocks      = int(blocks.size());
+	stats.num_allocations = int(allocations.size());
+
+	stats.num_alloc_calls     = num_alloc_calls;
+	stats.num_free_calls      = num_free_calls;
+	stats.num_size_class_hits = num_size_class_hits;
+	stats.num_backend_allocs  = num_backend_allocs;
+	stats.num_backend_frees   = num_backend_frees;
+	stats.num_synchronizes    = num_synchronizes;
+
+	return stats;
+}
+
+bool MemoryPool::validate() {
+	bool success = true;
+
+	auto check = [&success](bool condition, const char * what) {
+		if (!condition) {
+			IO::print("MemoryPool inconsistent: {}\n"_sv, StringView::from_c_str(what));
+			success = false;
+		}
+	};
+
+	for (size_t b = 0; b < blocks.size(); b++) {
+		const Block & block = blocks[b];
+
+		size_t bytes_free = 0;
+		for (size_t i = 0; i < block.free_ranges.size(); i++) {
+			const Range & range = block.free_ranges[i];
+
+			check(range.size > 0,                                            "Free range is empty");
+			check(range.ptr % ALIGNMENT == 0 && range.size % ALIGNMENT == 0, "Free range is not aligned");
+			check(range.ptr >= block.ptr && range.ptr + range.size <= block.ptr + block.size, "Free range is outside its block");
+			if (i > 0) {
+				const Range & prev = block.free_ranges[i - 1];
+				check(prev.ptr + prev.size < range.ptr, "Free ranges are not sorted or not coalesced");
+			}
+			bytes_free += range.size;
+		}
+		check(bytes_free == block.bytes_free, "Free bytes of block do not add up");
+	}
+
+	for (int c = 0; c < NUM_SIZE_CLASSES; c++) {
+		const SizeClass & size_class = size_classes[c];
+		size_t slot_size = get_size_class_size(c);
+
+		int num_used = 0;
+		for (size_t s = 0; s < size_class.slabs.size(); s++) {
+			num_used += size_class.slabs[s].num_used;
+		}
+		size_t num_slots = size_class.slabs.size() * (SLAB_SIZE / slot_size);
+		check(num_used + size_class.free_slots.size() == num_slots, "Slots of size class do not add up");
+
+		for (size_t i = 0; i < size_class.free_slots.size(); i++) {
+			check(size_class.free_slots[i] % ALIGNMENT == 0, "Free slot is not aligned");
+		}
+	}
+
+	size_t bytes_allocated = 0;
+	for (auto it = allocations.begin(); it != allocations.end(); ++it) {
+		bytes_allocated += it.get_value().size;
+	}
+	check(bytes_allocated == bytes_in_use, "Bytes in use do not add up");
+
+	size_t bytes_transient_chunks = 0;
+	if (!transient_retired) {
+		for (size_t i = 0; i < transient_chunks.size(); i++) {
+			bytes_transient_chunks += transient_chunks[i].offset;
+		}
+	}
+
+	Stats stats = get_stats();
+	check(stats.bytes_reserved == stats.bytes_in_use + stats.bytes_deferred + stats.bytes_free + bytes_transient_chunks, "Reserved bytes do not add up");
+
+	return success;
+}
+
+uint64_t MemoryPool::alloc_small(int size_class) {
+	SizeClass & sc = size_classes[size_class];
+
+	if (sc.free_slots.size() == 0 && deferred_frees.size() > 0) {
+		flush_deferred();
+	}
+
+	size_t slot_size = get_size_class_size(size_class);
+
+	if (sc.free_slots.size() > 0) {
+		num_size_class_hits++;
+
+		uint64_t ptr = sc.free_slots.back();
+		sc.free_slots.pop_back();
+
+		for (size_t i = 0; i < sc.slabs.size(); i++) {
+			if (ptr >= sc.slabs[i].ptr && ptr < sc.slabs[i].ptr + SLAB_SIZE) {
+				sc.slabs[i].num_used++;
+				break;
+			}
+		}
+		return ptr;
+	}
+
+	uint64_t slab_ptr = alloc_range(SLAB_SIZE, ALIGNMENT);
+	if (slab_ptr == 0) return 0;
+
+	sc.slabs.push_back({ slab_ptr, 1 });
+
+	// Pushed in reverse, so that slots are handed out in order of address
+	size_t num_slots = SLAB_SIZE / slot_size;
+	for (size_t i = num_slots - 1; i >= 1; i--) {
+		sc.free_slots.push_back(slab_ptr + i * slot_size);
+	}
+	return slab_ptr;
+}
+
+void MemoryPool::free_small(uint64_t ptr, int size_class) {
+	SizeClass & sc = size_classes[size_class];
+
+	for (size_t i = 0; i < sc.slabs.size(); i++) {
+		if (ptr >= sc.slabs[i].ptr && ptr < sc.slabs[i].ptr + SLAB_SIZE) {
+			ASSERT(sc.slabs[i].num_used > 0);
+			sc.slabs[i].num_used--;
+			break;
+		}
+	}
+	sc.free_slots.push_back(ptr);
+}
+
+uint64_t MemoryPool::alloc_range(size_t num_bytes, size_t alignment) {
+	uint64_t ptr = 0;
+	if (try_alloc_range(num_bytes, alignment, ptr)) return ptr;
+
+	// Reusing memory of deferred frees requires synchronizing, but is still preferable to growing the pool
+	if (deferred_frees.size() > 0) {
+		flush_deferred();
+		if (try_alloc_range(num_bytes, alignment, ptr)) return ptr;
+	}
+
+	// Padding needed to align the allocation within a block, which itself is only guaranteed to be aligned to ALIGNMENT
+	size_t num_bytes_padded = num_bytes + alignment - ALIGNMENT;
+	size_t block_size_dedicated = Math::round_up(num_bytes_padded, BLOCK_GRANULARITY);
+	size_t block_size           = Math::max(BLOCK_SIZE, block_size_dedicated);
+
+	uint64_t block_ptr = backend->alloc(block_size);
+	if (block_ptr == 0) {
+		// Out of memory, return all cached memory to the Backend and try again with the smallest block that fits
+		trim();
+		if (try_alloc_range(num_bytes, alignment, ptr)) return ptr;
+
+		block_size = block_size_dedicated;
+		block_ptr  = backend->alloc(block_size);
+		if (block_ptr == 0) return 0;
+	}
+	ASSERT(block_ptr % ALIGNMENT == 0);
+
+	num_backend_allocs++;
+
+	Block & block = blocks.emplace_back();
+	block.ptr        = block_ptr;
+	block.size       = block_size;
+	block.bytes_free = block_size;
+	block.free_ranges.push_back({ block_ptr, block_size });
+
+	bool success = try_alloc_range(num_bytes, alignment, ptr);
+	ASSERT(success);
+
+	return ptr;
+}
+
+bool MemoryPool::try_alloc_range(size_t num_bytes, size_t alignment, uint64_t & ptr) {
+	Block * best_block = nullptr;
+	size_t  best_index = 0;
+	size_t  best_size  = SIZE_MAX;
+
+	// Best fit: the smallest free range that can hold the allocation
+	for (size_t b = 0; b < blocks.size(); b++) {
+		Block & block = blocks[b];
+		if (block.bytes_free < num_bytes) continue;
+
+		for (size_t i = 0; i < block.free_ranges.size(); i++) {
+			const Range & range = block.free_ranges[i];
+			if (range.size >= best_size) continue;
+
+			uint64_t aligned = align_up(range.ptr, alignment);
+			if (aligned + num_bytes > range.ptr + range.size) continue;
+
+			best_block = &block;
+			best_index = i;
+			best_size  = range.size;
+		}
+	}
+	if (!best_block) return false;
+
+	Range range = best_block->free_ranges[best_index];
+
+	uint64_t aligned     = align_up(range.ptr, alignment);
+	size_t   size_before = aligned - range.ptr;
+	size_t   size_after  = (range.ptr + range.size) - (aligned + num_bytes);
+
+	// Replace the range by what is left before and after the allocation, which keeps the ranges sorted
+	if (size_before > 0 && size_after > 0) {
+		best_block->free_ranges[best_index] = { range.ptr, size_before };
+		array_insert(best_block->free_ranges, best_index + 1, Range { aligned + num_bytes, size_after });
+	} else if (size_before > 0) {
+		best_block->free_ranges[best_index] = { range.ptr, size_before };
+	} else if (size_after > 0) {
+		best_block->free_ranges[best_index] = { aligned + num_bytes, size_after };
+	} else {
+		array_erase(best_block->free_ranges, best_index);
+	}
+	best_block->bytes_free -= num_bytes;
+
+	ptr = aligned;
+	return true;
+}
+
+void MemoryPool::free_range(uint64_t ptr, size_t num_bytes) {
+	Block * block = nullptr;
+	for (size_t b = 0; b < blocks.size(); b++) {
+		if (ptr >= blocks[b].ptr && ptr < blocks[b].ptr + blocks[b].size) {
+			block = &blocks[b];
+			break;
+		}
+	}
+	ASSERT(block);
+
+	Array<Range> & ranges = block->free_ranges;
+
+	// Binary search for the first free range after ptr
+	size_t first = 0;
+	size_t last  = ranges.size();
+	while (first < last) {
+		size_t middle = (first + last) / 2;
+		if (ranges[middle].ptr < ptr) {
+			first = middle + 1;
+		} else {
+			last = middle;
+		}
+	}
+	size_t index = first;
+
+	bool merge_prev = index > 0             && ranges[index - 1].ptr + ranges[index - 1].size == ptr;
+	bool merge_next = index < ranges.size() && ptr + num_bytes == ranges[index].ptr;
+
+	if (merge_prev && merge_next) {
+		ranges[index - 1].size += num_bytes + ranges[index].size;
+		array_erase(ranges, index);
+	} else if (merge_prev) {
+		ranges[index - 1].size += num_bytes;
+	} else if (merge_next) {
+		ranges[index].ptr   = ptr;
+		ranges[index].size += num_bytes;
+	} else {
+		array_insert(ranges, index, Range { ptr, num_bytes });
+	}
+	block->bytes_free += num_bytes;
+}
+
+void MemoryPool::flush_deferred() {
+	if (deferred_frees.size() == 0 && !transient_retired) return;
+
+	backend->synchronize();
+	num_synchronizes++;
+
+	for (size_t i = 0; i < deferred_frees.size(); i++) {
+		const DeferredFree & deferred_free = deferred_frees[i];
+
+		if (deferred_free.allocation.size_class == SIZE_CLASS_NONE) {
+			free_range(deferred_free.ptr, deferred_free.allocation.size);
+		} else {
+			free_small(deferred_free.ptr, deferred_free.allocation.size_class);
+		}
+	}
+	deferred_frees.clear();
+
+	if (transient_retired) {
+		for (size_t i = 0; i < transient_chunks.size(); i++) {
+			transient_chunks[i].offset = 0;
+		}
+		transient_chunk_index = 0;
+		transient_retired     = false;
+	}
+}
+
+void MemoryPool::release_empty_slabs() {
+	for (int c = 0; c < NUM_SIZE_CLASSES; c++) {
+		SizeClass & sc = size_classes[c];
+
+		size_t s = 0;
+		while (s < sc.slabs.size()) {
+			Slab slab = sc.slabs[s];
+			if (slab.num_used > 0) {
+				s++;
+				continue;
+			}
+
+			// Remove the free slots of the slab, keeping the order of the remaining slots
+			size_t num_slots_kept = 0;
+			for (size_t i = 0; i < sc.free_slots.size(); i++) {
+				uint64_t slot = sc.free_slots[i];
+				if (slot < slab.ptr || slot >= slab.ptr + SLAB_SIZE) {
+					sc.free_slots[num_slots_kept++] = slot;
+				}
+			}
+			while (sc.free_slots.size() > num_slots_kept) {
+				sc.free_slots.pop_back();
+			}
+
+			free_range(slab.ptr, SLAB_SIZE);
+
+			sc.slabs[s] = sc.slabs.back();
+			sc.slabs.pop_back();
+		}
+	}
+}
+
+void MemoryPool::release_empty_blocks() {
+	size_t b = 0;
+	while (b < blocks.size()) {
+		if (blocks[b].bytes_free < blocks[b].size) {
+			b++;
+			continue;
+		}
+
+		backend->free(blocks[b].ptr, blocks[b].size);
+		num_backend_frees++;
+
+		if (b + 1 < blocks.size()) {
+			blocks[b] = std::move(blocks.back());
+		}
+		blocks.pop_back();
+	}
+}
+
+// Hands out addresses from a fake address space and checks that the pool uses it correctly
+struct FakeBackend final : MemoryPool::Backend {
+	struct BackendAllocation {
+		uint64_t ptr;
+		size_t   size;
+	};
+	Array<BackendAllocation> backend_allocations;
+
+	uint64_t next_ptr = uint64_t(1) << 40;
+
+	size_t capacity        = 0;
+	size_t bytes_allocated = 0;
+
+	int num_synchronizes = 0;
+	int num_errors       = 0;
+
+	FakeBackend(size_t capacity) : capacity(capacity) { }
+
+	uint64_t alloc(size_t num_bytes) override {
+		if (bytes_allocated + num_bytes > capacity) return 0;
+
+		uint64_t ptr = next_ptr;
+		next_ptr += Math::round_up<uint64_t>(num_bytes, MEGABYTES(2)) + MEGABYTES(2); // Leave a gap, so that adjacent blocks are never contiguous
+
+		backend_allocations.push_back({ ptr, num_bytes });
+		bytes_allocated += num_bytes;
+
+		return ptr;
+	}
+
+	void free(uint64_t ptr, size_t num_bytes) override {
+		for (size_t i = 0; i < backend_allocations.size(); i++) {
+			if (backend_allocations[i].ptr == ptr) {
+				if (backend_allocations[i].size != num_bytes) {
+					IO::print("FAILED: Backend free of {} with size {}, but it was allocated with size {}\n"_sv, ptr, num_bytes, backend_allocations[i].size);
+					num_errors++;
+				}
+				bytes_allocated -= backend_allocations[i].size;
+
+				backend_allocations[i] = backend_allocations.back();
+				backend_allocations.pop_back();
+				return;
+			}
+		}
+		IO::print("FAILED: Backend free of {}, which was not allocated\n"_sv, ptr);
+		num_errors++;
+	}
+
+	void synchronize() override {
+		num_synchronizes++;
+	}
+
+	bool contains(uint64_t ptr, size_t num_bytes) const {
+		for (size_t i = 0; i < backend_allocations.size(); i++) {
+			const BackendAllocation & allocation = backend_allocations[i];
+			if (ptr >= allocation.ptr && ptr + num_bytes <= allocation.ptr + allocation.size) return true;
+		}
+		return false;
+	}
+};
+
+static size_t random_allocation_size(RNG & rng) {
+	uint32_t kind = rng.get_uint32(100);
+	if (kind < 60) {
+		return 1 + rng.get_uint32(uint32_t(MemoryPool::SMALL_SIZE_MAX));
+	} else if (kind < 95) {
+		return MemoryPool::SMALL_SIZE_MAX + rng.get_uint32(MEGABYTES(16));
+	} else {
+		return MEGABYTES(16) + rng.get_uint32(MEGABYTES(200));
+	}
+}
+
+bool MemoryPool::run_check() {
+	constexpr int NUM_ITERATIONS = 20000;
+	constexpr int VALIDATE_INTERVAL = 500;
+
+	struct LiveAllocation {
+		uint64_t ptr;
+		size_t   size;
+		size_t   alignment;
+	};
+
+	RNG rng(1234);
+
+	Check::Checker check;
+
+	auto check_overlap = [&](Array<LiveAllocation> & live) {
+		Array<LiveAllocation> sorted = live;
+		Sort::quick_sort(sorted.begin(), sorted.end(), [](const LiveAllocation & a, const LiveAllocation & b) { return a.ptr < b.ptr; });
+
+		for (size_t i = 1; i < sorted.size(); i++) {
+			check(sorted[i - 1].ptr + sorted[i - 1].size <= sorted[i].ptr, "Allocations do not overlap");
+		}
+	};
+
+	// Fuzz random allocations, frees, transient allocations and trims. The Backend is small enough to run out of memory regularly
+	{
+		FakeBackend backend(GIGABYTES(size_t(2)));
+		MemoryPool  pool(&backend);
+
+		Array<LiveAllocation> live;
+		Array<LiveAllocation> live_transient;
+
+		int num_out_of_memory = 0;
+
+		auto check_live = [&]() {
+			Array<LiveAllocation> all = live;
+			for (size_t j = 0; j < live_transient.size(); j++) {
+				all.push_back(live_transient[j]);
+			}
+			check_overlap(all);
+		};
+
+		for (int i = 0; i < NUM_ITERATIONS; i++) {
+			uint32_t op = rng.get_uint32(100);
+
+			if (op < 50) {
+				size_t size      = random_allocation_size(rng);
+				size_t alignment = rng.get_uint32(10) == 0 ? size_t(512) << rng.get_uint32(8) : ALIGNMENT;
+
+				uint64_t ptr = pool.alloc(size, alignment);
+				if (ptr == 0) {
+					num_out_of_memory++;
+					continue;
+				}
+
+				check(ptr % alignment == 0,          "Allocation is aligned");
+				check(backend.contains(ptr, size),   "Allocation lies within Backend memory");
+				live.push_back({ ptr, size, alignment });
+			} else if (op < 85) {
+				if (live.size() == 0) continue;
+
+				size_t index = rng.get_uint32(uint32_t(live.size()));
+				pool.free(live[index].ptr);
+
+				live[index] = live.back();
+				live.pop_back();
+			} else if (op < 95) {
+				size_t size = 1 + rng.get_uint32(MEGABYTES(6));
+
+				uint64_t ptr = pool.alloc_transient(size);
+				if (ptr == 0) {
+					num_out_of_memory++;
+					continue;
+				}
+
+				check(ptr % ALIGNMENT == 0,        "Transient allocation is aligned");
+				check(backend.contains(ptr, size), "Transient allocation lies within Backend memory");
+				live_transient.push_back({ ptr, size, ALIGNMENT });
+			} else if (op < 99) {
+				// End of frame
+				check_live();
+
+				pool.reset_transient();
+				live_transient.clear();
+			} else {
+				pool.trim();
+			}
+
+			if (i % VALIDATE_INTERVAL == 0) {
+				check_live();
+				check(pool.validate(), "Pool is consistent");
+			}
+		}
+
+		Stats stats = pool.get_stats();
+		IO::print("Fuzzed {} operations: {} allocations, {} out of memory, {} Backend allocations, {} synchronizes, peak {} MB in use\n"_sv,
+			NUM_ITERATIONS, stats.num_alloc_calls, num_out_of_memory, stats.num_backend_allocs, stats.num_synchronizes, stats.bytes_in_use_peak >> 20);
+
+		for (size_t i = 0; i < live.size(); i++) {
+			pool.free(live[i].ptr);
+		}
+		pool.reset_transient();
+		pool.trim();
+
+		check(pool.validate(),                         "Pool is consistent after freeing everything");
+		check(backend.backend_allocations.size() == 0, "All Backend memory is returned after trim");
+		check(pool.get_stats().bytes_reserved == 0,    "No memory is reserved after trim");
+		check(backend.num_errors == 0,                 "Backend is used correctly");
+	}
+
+	// Repeatedly resizing should reuse the memory of the previous resolution instead of going to the Backend
+	{
+		FakeBackend backend(GIGABYTES(size_t(8)));
+		MemoryPool  pool(&backend);
+
+		constexpr int NUM_BUFFERS = 8; // Roughly the number of AOV and SVGF history buffers
+		constexpr int NUM_RESOLUTIONS = 4;
+		constexpr int resolutions[NUM_RESOLUTIONS][2] = { { 3840, 2160 }, { 1920, 1080 }, { 2560, 1440 }, { 1280, 720 } };
+
+		uint64_t buffers[NUM_BUFFERS] = { };
+		int64_t  num_backend_allocs_warmup = 0;
+
+		for (int i = 0; i < 10 * NUM_RESOLUTIONS; i++) {
+			int width  = resolutions[i % NUM_RESOLUTIONS][0];
+			int height = resolutions[i % NUM_RESOLUTIONS][1];
+
+			for (int b = 0; b < NUM_BUFFERS; b++) {
+				if (buffers[b]) pool.free(buffers[b]);
+				buffers[b] = pool.alloc(size_t(width) * size_t(height) * 16);
+				check(buffers[b] != 0, "Resize allocation succeeded");
+			}
+			pool.alloc_transient(KILOBYTES(100));
+			pool.reset_transient();
+
+			if (i == NUM_RESOLUTIONS - 1) {
+				num_backend_allocs_warmup = pool.get_stats().num_backend_allocs;
+			}
+		}
+		check(pool.validate(), "Pool is consistent after resizing");
+
+		Stats stats = pool.get_stats();
+		check(stats.num_backend_allocs == num_backend_allocs_warmup, "Resizing reuses memory after the first round of resolutions");
+
+		IO::print("Resized {} times: {} Backend allocations ({} MB reserved, {} MB peak in use), {} synchronizes\n"_sv,
+			10 * NUM_RESOLUTIONS, stats.num_backend_allocs, stats.bytes_reserved >> 20, stats.bytes_in_use_peak >> 20, stats.num_synchronizes);
+	}
+
+	return check.report("Memory pool"_sv);
+}
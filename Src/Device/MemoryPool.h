@@ -0,0 +1,178 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+#include "Core/Array.h"
+#include "Core/Assertion.h"
+#include "Core/RobinHoodHashMap.h"
+#include "Core/Allocators/Allocator.h"
+
+// Allocation policy that sub-allocates Device memory out of large blocks, so that freeing and reallocating buffers
+// (for example on every window resize) reuses memory instead of going through cuMemAlloc / cuMemFree every time.
+// The policy only deals with addresses and is written against an abstract Backend, so it can be checked on the CPU.
+//  - Small allocations are rounded up to a power of two size class and served from slabs with a free list per class
+//  - Larger allocations are sub-allocated from blocks using best fit, freed ranges are coalesced with their neighbours
+//  - Transient allocations are bump allocated and all released at once by reset_transient() at the end of a frame
+// Memory stays reserved by the pool until trim() is called, or until the Backend runs out of memory
+struct MemoryPool {
+	struct Backend {
+		virtual ~Backend() { }
+
+		// Returns 0 on failure, the address should be aligned to at least MemoryPool::ALIGNMENT
+		virtual uint64_t alloc(size_t num_bytes) = 0;
+		virtual void     free (uint64_t ptr, size_t num_bytes) = 0;
+
+		// Waits until the Device no longer accesses any memory that has been freed so far
+		virtual void synchronize() = 0;
+	};
+
+	static constexpr size_t ALIGNMENT = 256; // Same alignment that cuMemAlloc guarantees
+
+	static constexpr size_t SMALL_SIZE_MIN   = 256;
+	static constexpr size_t SMALL_SIZE_MAX   = KILOBYTES(64);
+	static constexpr int    NUM_SIZE_CLASSES = 9; // 256 B, 512 B, ..., 64 KB
+	static constexpr int    SIZE_CLASS_NONE  = -1;
+	static constexpr size_t SLAB_SIZE        = MEGABYTES(1);
+
+	static constexpr size_t BLOCK_SIZE           = MEGABYTES(64);
+	static constexpr size_t BLOCK_GRANULARITY    = MEGABYTES(2); // Allocations that do not fit in a regular block get a dedicated block of a multiple of this size
+	static constexpr size_t TRANSIENT_CHUNK_SIZE = MEGABYTES(4);
+
+	struct Stats {
+		size_t bytes_reserved;       // Obtained from the Backend
+		size_t bytes_in_use;         // Handed out by alloc, including rounding up to the size class or alignment
+		size_t bytes_in_use_peak;
+		size_t bytes_free;           // Reserved, but not in use. Includes free slots in slabs and unused transient memory
+		size_t bytes_deferred;       // Freed, but not yet available for reuse until the next synchronize
+		size_t largest_free_range;   // Largest allocation that can be made without going to the Backend
+		size_t bytes_transient;      // Allocated through alloc_transient since the last reset_transient
+		size_t bytes_transient_peak;
+
+		int num_blocks;
+		int num_slabs;
+		int num_allocations;         // Currently live allocations made through alloc
+
+		int64_t num_alloc_calls;
+		int64_t num_free_calls;
+		int64_t num_size_class_hits; // Small allocations served from a free slot without creating a new slab
+		int64_t num_backend_allocs;
+		int64_t num_backend_frees;
+		int64_t num_synchronizes;
+	};
+
+	MemoryPool() = default;
+	MemoryPool(Backend * backend) : backend(backend) { }
+
+	NON_COPYABLE(MemoryPool);
+	NON_MOVEABLE(MemoryPool);
+
+	~MemoryPool() {
+		free_all();
+	}
+
+	void init(Backend * pool_backend) {
+		ASSERT(backend == nullptr);
+		backend = pool_backend;
+	}
+
+	// Returns 0 if the Backend ran out of memory. alignment should be a power of two
+	uint64_t alloc(size_t num_bytes, size_t alignment = ALIGNMENT);
+
+	// The memory is only reused after the next call to Backend::synchronize, which happens lazily on the next allocation that needs it
+	void free(uint64_t ptr);
+
+	// Memory that is valid until the next reset_transient, does not need to be freed
+	uint64_t alloc_transient(size_t num_bytes);
+	void     reset_transient();
+
+	// Returns all memory that is not in use to the Backend
+	void trim();
+
+	// Returns all memory to the Backend, including memory that is still in use
+	void free_all();
+
+	Stats get_stats() const;
+
+	// Checks internal consistency: free ranges are sorted, coalesced and inside their block, and all byte counts add up
+	bool validate();
+
+	// Fuzzes the pool with random allocations against a fake CPU heap, and checks that resizing reuses memory
+	static bool run_check();
+
+private:
+	struct Range {
+		uint64_t ptr;
+		size_t   size;
+	};
+
+	struct Block {
+		uint64_t ptr;
+		size_t   size;
+
+		Array<Range> free_ranges; // Sorted by address, adjacent ranges are always merged
+		size_t       bytes_free;
+	};
+
+	struct Slab {
+		uint64_t ptr;
+		int      num_used;
+	};
+
+	struct SizeClass {
+		Array<Slab>     slabs;
+		Array<uint64_t> free_slots;
+	};
+
+	struct Allocation {
+		size_t size;
+		int    size_class; // SIZE_CLASS_NONE for allocations that are sub-allocated from a block directly
+	};
+
+	struct TransientChunk {
+		uint64_t ptr;
+		size_t   size;
+		size_t   offset;
+	};
+
+	Backend * backend = nullptr;
+
+	Array<Block> blocks;
+	SizeClass    size_classes[NUM_SIZE_CLASSES];
+
+	RobinHoodHashMap<uint64_t, Allocation> allocations;
+
+	struct DeferredFree {
+		uint64_t   ptr;
+		Allocation allocation;
+	};
+
+	// Frees that have not been synchronized with the Device yet
+	Array<DeferredFree> deferred_frees;
+
+	Array<TransientChunk> transient_chunks;
+	int                   transient_chunk_index = 0;
+	bool                  transient_retired     = false; // Set by reset_transient, the chunks can only be reused after synchronizing
+
+	size_t bytes_in_use         = 0;
+	size_t bytes_in_use_peak    = 0;
+	size_t bytes_transient      = 0;
+	size_t bytes_transient_peak = 0;
+
+	int64_t num_alloc_calls     = 0;
+	int64_t num_free_calls      = 0;
+	int64_t num_size_class_hits = 0;
+	int64_t num_backend_allocs  = 0;
+	int64_t num_backend_frees   = 0;
+	int64_t num_synchronizes    = 0;
+
+	uint64_t alloc_small(int size_class);
+	void     free_small (uint64_t ptr, int size_class);
+
+	uint64_t alloc_range    (size_t num_bytes, size_t alignment);
+	bool     try_alloc_range(size_t num_bytes, size_t alignment, uint64_t & ptr);
+	void     free_range     (uint64_t ptr, size_t num_bytes);
+
+	void flush_deferred();
+	void release_empty_slabs();
+	void release_empty_blocks();
+};
@@ -8,9 +8,11 @@
 #include "Config.h"
 #include "Args.h"
 
+#include "Core/Log.h"
 #include "Core/Sort.h"
 #include "Core/Parser.h"
 #include "Core/Timer.h"
+#include "Core/MemoryTracker.h"
 #include "Core/Allocators/StackAllocator.h"
 
 #include "Input.h"
@@ -20,7 +22,9 @@
 #include "Exporters/PPMExporter.h"
 
 #include "Util/Util.h"
+#include "Util/PMJ02.h"
 #include "Util/PerfTest.h"
+#include "Util/ThreadPool.h"
 
 extern "C" { _declspec(dllexport) unsigned NvOptimusEnablement = true; } // Forces NVIDIA driver to be used
 
@@ -61,6 +65,8 @@ static void draw_gui(Window & window, Integrator & integrator);
 
 int main(int num_args, char ** args) {
 	Args::parse(num_args, args);
+	Log::init();
+
 	if (cpu_config.scene_filenames.size() == 0) {
 		cpu_config.scene_filenames.push_back("Data/sponza/scene.xml"_sv);
 	}
@@ -71,9 +77,7 @@ int main(int num_args, char ** args) {
 	Timer timer = { };
 	timer.start();
 
-	for (int i = 1; i < PMJ_NUM_SEQUENCES; i++) {
-		PMJ::shuffle(i);
-	}
+	PMJ02::init(cpu_config.pmj_filename, ThreadPool::get_shared());
 
 	Window window("Pathtracer"_sv, cpu_config.initial_width, cpu_config.initial_height);
 
@@ -106,6 +110,8 @@ int main(int num_args, char ** args) {
 
 	LinearAllocator<MEGABYTES(16)> frame_allocator;
 
+	bool memory_report_done = false;
+
 	// Render loop
 	while (!window.is_closed) {
 		perf_test.frame_begin();
@@ -115,6 +121,9 @@ int main(int num_args, char ** args) {
 
 			if (integrator) {
 				integrator->cuda_free();
+
+				// The buffers of the old Integrator are cached by the pool, return them to the driver before allocating those of the new one
+				CUDAMemory::trim_pool();
 			}
 
 			switch (cpu_config.integrator) {
@@ -122,6 +131,20 @@ int main(int num_args, char ** args) {
 				case IntegratorType::AO:         integrator = make_owned<AO>        (window.frame_buffer_handle, window.width, window.height, scene); break;
 				default: ASSERT_UNREACHABLE();
 			}
+
+			// Loading is done once the first Integrator has been initialized
+			if (!memory_report_done) {
+				memory_report_done = true;
+
+				// Device memory that was freed during loading is still cached by the pool, return it to the driver
+				CUDAMemory::trim_pool();
+
+				MemoryTracker::print_report();
+				CUDAMemory::print_pool_stats();
+				if (!cpu_config.memory_report_filename.is_empty()) {
+					MemoryTracker::write_json(cpu_config.memory_report_filename);
+				}
+			}
 		}
 
 		integrator->update((float)timing.delta_time, &frame_allocator);
@@ -167,8 +190,7 @@ int main(int num_args, char ** args) {
 		if (Input::is_key_released(SDL_SCANCODE_F5)) {
 			ScopeTimer timer("Hot Reload"_sv);
 
-			integrator->cuda_free();
-			integrator->cuda_init(window.frame_buffer_handle, window.width, window.height);
+			integrator->cuda_reload();
 		}
 
 		if (perf_test.frame_end((float)timing.delta_time)) break;
@@ -178,10 +200,22 @@ int main(int num_args, char ** args) {
 		window.swap();
 
 		frame_allocator.reset();
+		CUDAMemory::reset_transient();
+	}
+
+#if ENABLE_RAY_STATS
+	// Ray statistics are only gathered by the Pathtracer
+	if (!cpu_config.ray_stats_filename.is_empty() && cpu_config.integrator == IntegratorType::PATHTRACER) {
+		Pathtracer & pathtracer = static_cast<Pathtracer &>(*integrator.get());
+		pathtracer.ray_stats.flush();
+		pathtracer.ray_stats.write(cpu_config.ray_stats_filename);
 	}
+#endif
 
 	CUDAContext::free();
 
+	Log::shutdown();
+
 	return EXIT_SUCCESS;
 }
 
@@ -350,6 +384,11 @@ static void draw_gui(Window & window, Integrator & integrator) {
 				case BVHType::BVH4: ImGui::TextUnformatted("BVH:   BVH4"); break;
 				case BVHType::BVH8: ImGui::TextUnformatted("BVH:   BVH8"); break;
 			}
+
+			if (cpu_config.enable_device_memory_pool) {
+				MemoryPool::Stats pool_stats = CUDAMemory::get_pool_stats();
+				ImGui::Text("Pool:  %zu / %zu MB", pool_stats.bytes_in_use >> 20, pool_stats.bytes_reserved >> 20);
+			}
 		}
 
 		if (ImGui::CollapsingHeader("Kernel Timings") && integrator.event_pool.num_used > 0) {
@@ -463,11 +502,11 @@ static void draw_gui(Window & window, Integrator & integrator) {
 				const Mesh     & mesh      = integrator.scene.meshes[i];
 				const MeshData & mesh_data = integrator.scene.asset_manager.get_mesh_data(mesh.mesh_data_handle);
 
-				triangle_count += mesh_data.triangles.size();
+				triangle_count += mesh_data.triangle_count();
 
 				if (mesh.light.weight > 0.0f) {
 					light_mesh_count++;
-					light_triangle_count += mesh_data.triangles.size();
+					light_triangle_count += mesh_data.triangle_count();
 				}
 			}
 
@@ -540,7 +579,10 @@ static void draw_gui(Window & window, Integrator & integrator) {
 
 				mesh_changed |= ImGui::DragFloat("Scale", &mesh.scale, 0.1f, 0.0f, INFINITY);
 
-				if (mesh_changed) integrator.invalidated_scene = true;
+				if (mesh_changed) {
+					integrator.scene.mark_mesh_dirty(integrator.pixel_query.mesh_id);
+					integrator.invalidated_scene = true;
+				}
 
 				ImGui::Separator();
 
@@ -691,8 +733,11 @@ static void draw_gui(Window & window, Integrator & integrator) {
 		if (integrator.pixel_query.triangle_id != INVALID) {
 			const MeshData & mesh_data = integrator.scene.asset_manager.get_mesh_data(mesh.mesh_data_handle);
 
-			int              index    = mesh_data.bvh->indices[integrator.pixel_query.triangle_id - integrator.mesh_data_triangle_offsets[mesh.mesh_data_handle.handle]];
-			const Triangle & triangle = mesh_data.triangles[index];
+			// Cluster files store the Triangles in the same order as the aggregated triangle array
+			int              index    = integrator.triangle_order[integrator.pixel_query.triangle_id];
+			const Triangle & triangle = mesh_data.clusters.get() ?
+				mesh_data.clusters.get()->triangles[integrator.pixel_query.triangle_id - integrator.mesh_data_triangle_offsets[mesh.mesh_data_handle.handle]] :
+				mesh_data.triangles[index];
 
 			int mouse_x, mouse_y;
 			Input::mouse_position(&mouse_x, &mouse_y);
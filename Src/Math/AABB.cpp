@@ -2,6 +2,9 @@
 
 #include "Matrix4.h"
 
+// AABB::transform is the scalar reference for AABBSoA::transform, so it must not be contracted into fused multiply-add either
+#pragma fp_contract(off)
+
 AABB AABB::create_empty() {
 	AABB aabb;
 	aabb.min = Vector3(+INFINITY);
@@ -0,0 +1,235 @@
+#include "AABBSoA.h"
+
+#include <immintrin.h>
+
+#include "Math/Matrix4.h"
+
+// /fp:precise still allows contraction into fused multiply-add, which would make the AVX2 and scalar paths round differently
+#pragma fp_contract(off)
+
+void AABBSoA::resize(size_t count) {
+	min_x.resize(count);
+	min_y.resize(count);
+	min_z.resize(count);
+	max_x.resize(count);
+	max_y.resize(count);
+	max_z.resize(count);
+}
+
+AABB AABBSoA::unify(size_t first, size_t last) const {
+	AABB aabb = AABB::create_empty();
+	for (size_t i = first; i < last; i++) {
+		aabb.expand(get(i));
+	}
+	return aabb;
+}
+
+#ifdef __AVX2__
+// Computes the surface area of 8 AABBs, in the same order of operations as AABB::surface_area
+static inline __m256 surface_area_8(__m256 min_x, __m256 min_y, __m256 min_z, __m256 max_x, __m256 max_y, __m256 max_z) {
+	__m256 diff_x = _mm256_sub_ps(max_x, min_x);
+	__m256 diff_y = _mm256_sub_ps(max_y, min_y);
+	__m256 diff_z = _mm256_sub_ps(max_z, min_z);
+
+	__m256 sum = _mm256_add_ps(_mm256_add_ps(
+		_mm256_mul_ps(diff_x, diff_y),
+		_mm256_mul_ps(diff_y, diff_z)),
+		_mm256_mul_ps(diff_z, diff_x)
+	);
+	return _mm256_mul_ps(_mm256_set1_ps(2.0f), sum);
+}
+
+// Shifts x by the given lane permutation, fills the lanes in BLEND_MASK with the identity element and combines the result with x
+template<bool IS_MIN, int BLEND_MASK>
+static inline __m256 scan_step(__m256 x, __m256i permutation) {
+	const __m256 identity = _mm256_set1_ps(IS_MIN ? INFINITY : -INFINITY);
+
+	__m256 shifted = _mm256_blend_ps(_mm256_permutevar8x32_ps(x, permutation), identity, BLEND_MASK);
+
+	return IS_MIN ? _mm256_min_ps(x, shifted) : _mm256_max_ps(x, shifted);
+}
+
+// Inclusive scan within a register using log2(8) = 3 steps.
+// Forward scans propagate from lane 0 towards lane 7, reverse scans from lane 7 towards lane 0
+template<bool IS_MIN, bool REVERSE>
+static inline __m256 scan_8(__m256 x) {
+	if constexpr (REVERSE) {
+		x = scan_step<IS_MIN, 0b10000000>(x, _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 7));
+		x = scan_step<IS_MIN, 0b11000000>(x, _mm256_setr_epi32(2, 3, 4, 5, 6, 7, 7, 7));
+		x = scan_step<IS_MIN, 0b11110000>(x, _mm256_setr_epi32(4, 5, 6, 7, 7, 7, 7, 7));
+	} else {
+		x = scan_step<IS_MIN, 0b00000001>(x, _mm256_setr_epi32(0, 0, 1, 2, 3, 4, 5, 6));
+		x = scan_step<IS_MIN, 0b00000011>(x, _mm256_setr_epi32(0, 0, 0, 1, 2, 3, 4, 5));
+		x = scan_step<IS_MIN, 0b00001111>(x, _mm256_setr_epi32(0, 0, 0, 0, 0, 1, 2, 3));
+	}
+	return x;
+}
+
+// Scans 8 AABBs starting at offset, combines the result with the running union in carry and writes surface areas to result
+template<bool REVERSE>
+static inline void sweep_8(const AABBSoA & aabbs, size_t offset, __m256 carry[6], float result[]) {
+	__m256 min_x = _mm256_min_ps(carry[0], scan_8<true,  REVERSE>(_mm256_loadu_ps(aabbs.min_x.data() + offset)));
+	__m256 min_y = _mm256_min_ps(carry[1], scan_8<true,  REVERSE>(_mm256_loadu_ps(aabbs.min_y.data() + offset)));
+	__m256 min_z = _mm256_min_ps(carry[2], scan_8<true,  REVERSE>(_mm256_loadu_ps(aabbs.min_z.data() + offset)));
+	__m256 max_x = _mm256_max_ps(carry[3], scan_8<false, REVERSE>(_mm256_loadu_ps(aabbs.max_x.data() + offset)));
+	__m256 max_y = _mm256_max_ps(carry[4], scan_8<false, REVERSE>(_mm256_loadu_ps(aabbs.max_y.data() + offset)));
+	__m256 max_z = _mm256_max_ps(carry[5], scan_8<false, REVERSE>(_mm256_loadu_ps(aabbs.max_z.data() + offset)));
+
+	_mm256_storeu_ps(result + offset, surface_area_8(min_x, min_y, min_z, max_x, max_y, max_z));
+
+	// Broadcast the lane that contains the union of all 8 AABBs
+	const __m256i last_lane = _mm256_set1_epi32(REVERSE ? 0 : 7);
+	carry[0] = _mm256_permutevar8x32_ps(min_x, last_lane);
+	carry[1] = _mm256_permutevar8x32_ps(min_y, last_lane);
+	carry[2] = _mm256_permutevar8x32_ps(min_z, last_lane);
+	carry[3] = _mm256_permutevar8x32_ps(max_x, last_lane);
+	carry[4] = _mm256_permutevar8x32_ps(max_y, last_lane);
+	carry[5] = _mm256_permutevar8x32_ps(max_z, last_lane);
+}
+
+static inline void carry_init(__m256 carry[6]) {
+	for (int i = 0; i < 3; i++) carry[i]     = _mm256_set1_ps(+INFINITY);
+	for (int i = 0; i < 3; i++) carry[i + 3] = _mm256_set1_ps(-INFINITY);
+}
+
+static inline AABB carry_to_aabb(const __m256 carry[6]) {
+	AABB aabb;
+	aabb.min = Vector3(_mm256_cvtss_f32(carry[0]), _mm256_cvtss_f32(carry[1]), _mm256_cvtss_f32(carry[2]));
+	aabb.max = Vector3(_mm256_cvtss_f32(carry[3]), _mm256_cvtss_f32(carry[4]), _mm256_cvtss_f32(carry[5]));
+	return aabb;
+}
+#endif
+
+void AABBSoA::prefix_surface_areas(size_t count, float result[]) const {
+	AABB aabb = AABB::create_empty();
+	size_t i = 0;
+
+#ifdef __AVX2__
+	__m256 carry[6];
+	carry_init(carry);
+
+	for (; i + 8 <= count; i += 8) {
+		sweep_8<false>(*this, i, carry, result);
+	}
+	aabb = carry_to_aabb(carry);
+#endif
+
+	for (; i < count; i++) {
+		aabb.expand(get(i));
+		result[i] = aabb.surface_area();
+	}
+}
+
+void AABBSoA::suffix_surface_areas(size_t count, float result[]) const {
+	AABB aabb = AABB::create_empty();
+	size_t i = count;
+
+#ifdef __AVX2__
+	// The remainder at the end is handled first, so that the vectorized part starts at index 0
+	size_t vector_count = count & ~size_t(7);
+	for (; i > vector_count; i--) {
+		aabb.expand(get(i - 1));
+		result[i - 1] = aabb.surface_area();
+	}
+
+	__m256 carry[6] = {
+		_mm256_set1_ps(aabb.min.x), _mm256_set1_ps(aabb.min.y), _mm256_set1_ps(aabb.min.z),
+		_mm256_set1_ps(aabb.max.x), _mm256_set1_ps(aabb.max.y), _mm256_set1_ps(aabb.max.z)
+	};
+	for (; i >= 8; i -= 8) {
+		sweep_8<true>(*this, i - 8, carry, result);
+	}
+#endif
+
+	for (; i > 0; i--) {
+		aabb.expand(get(i - 1));
+		result[i - 1] = aabb.surface_area();
+	}
+}
+
+void AABBSoA::calc_centers(size_t count, float center_x[], float center_y[], float center_z[]) const {
+	size_t i = 0;
+
+#ifdef __AVX2__
+	const __m256 half = _mm256_set1_ps(0.5f);
+
+	for (; i + 8 <= count; i += 8) {
+		_mm256_storeu_ps(center_x + i, _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(min_x.data() + i), _mm256_loadu_ps(max_x.data() + i)), half));
+		_mm256_storeu_ps(center_y + i, _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(min_y.data() + i), _mm256_loadu_ps(max_y.data() + i)), half));
+		_mm256_storeu_ps(center_z + i, _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(min_z.data() + i), _mm256_loadu_ps(max_z.data() + i)), half));
+	}
+#endif
+
+	for (; i < count; i++) {
+		Vector3 center = get(i).get_center();
+		center_x[i] = center.x;
+		center_y[i] = center.y;
+		center_z[i] = center.z;
+	}
+}
+
+void AABBSoA::transform(const AABBSoA & aabbs, const Matrix4 transformations[], size_t count, AABBSoA & result) {
+	size_t i = 0;
+
+#ifdef __AVX2__
+	const __m256 half = _mm256_set1_ps(0.5f);
+	const __m256 sign = _mm256_set1_ps(-0.0f);
+
+	// Offsets of the first cell of each of the 8 consecutive matrices
+	const __m256i offsets = _mm256_setr_epi32(0, 16, 32, 48, 64, 80, 96, 112);
+
+	for (; i + 8 <= count; i += 8) {
+		__m256 min_x = _mm256_loadu_ps(aabbs.min_x.data() + i);
+		__m256 min_y = _mm256_loadu_ps(aabbs.min_y.data() + i);
+		__m256 min_z = _mm256_loadu_ps(aabbs.min_z.data() + i);
+		__m256 max_x = _mm256_loadu_ps(aabbs.max_x.data() + i);
+		__m256 max_y = _mm256_loadu_ps(aabbs.max_y.data() + i);
+		__m256 max_z = _mm256_loadu_ps(aabbs.max_z.data() + i);
+
+		__m256 center_x = _mm256_mul_ps(half, _mm256_add_ps(min_x, max_x));
+		__m256 center_y = _mm256_mul_ps(half, _mm256_add_ps(min_y, max_y));
+		__m256 center_z = _mm256_mul_ps(half, _mm256_add_ps(min_z, max_z));
+		__m256 extent_x = _mm256_mul_ps(half, _mm256_sub_ps(max_x, min_x));
+		__m256 extent_y = _mm256_mul_ps(half, _mm256_sub_ps(max_y, min_y));
+		__m256 extent_z = _mm256_mul_ps(half, _mm256_sub_ps(max_z, min_z));
+
+		const float * cells = transformations[i].cells;
+
+		__m256 new_min[3];
+		__m256 new_max[3];
+
+		for (int row = 0; row < 3; row++) {
+			__m256 m0 = _mm256_i32gather_ps(cells, _mm256_add_epi32(offsets, _mm256_set1_epi32(row * 4 + 0)), 4);
+			__m256 m1 = _mm256_i32gather_ps(cells, _mm256_add_epi32(offsets, _mm256_set1_epi32(row * 4 + 1)), 4);
+			__m256 m2 = _mm256_i32gather_ps(cells, _mm256_add_epi32(offsets, _mm256_set1_epi32(row * 4 + 2)), 4);
+			__m256 m3 = _mm256_i32gather_ps(cells, _mm256_add_epi32(offsets, _mm256_set1_epi32(row * 4 + 3)), 4);
+
+			__m256 new_center = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(
+				_mm256_mul_ps(m0, center_x),
+				_mm256_mul_ps(m1, center_y)),
+				_mm256_mul_ps(m2, center_z)),
+				m3
+			);
+			__m256 new_extent = _mm256_add_ps(_mm256_add_ps(
+				_mm256_mul_ps(_mm256_andnot_ps(sign, m0), extent_x),
+				_mm256_mul_ps(_mm256_andnot_ps(sign, m1), extent_y)),
+				_mm256_mul_ps(_mm256_andnot_ps(sign, m2), extent_z)
+			);
+
+			new_min[row] = _mm256_sub_ps(new_center, new_extent);
+			new_max[row] = _mm256_add_ps(new_center, new_extent);
+		}
+
+		_mm256_storeu_ps(result.min_x.data() + i, new_min[0]);
+		_mm256_storeu_ps(result.min_y.data() + i, new_min[1]);
+		_mm256_storeu_ps(result.min_z.data() + i, new_min[2]);
+		_mm256_storeu_ps(result.max_x.data() + i, new_max[0]);
+		_mm256_storeu_ps(result.max_y.data() + i, new_max[1]);
+		_mm256_storeu_ps(result.max_z.data() + i, new_max[2]);
+	}
+#endif
+
+	for (; i < count; i++) {
+		result.set(i, AABB::transform(aabbs.get(i), transformations[i]));
+	}
+}
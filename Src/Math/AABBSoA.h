@@ -0,0 +1,61 @@
+#pragma once
+#include "Core/Array.h"
+
+#include "Math/AABB.h"
+
+struct Matrix4;
+
+// Structure of Arrays layout for a list of AABBs.
+// Storing every component in its own contiguous array allows sweeps over many AABBs to process 8 boxes at a time using AVX2.
+// All kernels produce results that are bit-identical to the equivalent loops over AABB (min/max are exact,
+// and floating point arithmetic is performed in the same order without fused multiply-add).
+// This relies on AABB.cpp and AABBSoA.cpp being compiled with /fp:precise instead of the project wide /fp:fast
+struct AABBSoA {
+	Array<float> min_x;
+	Array<float> min_y;
+	Array<float> min_z;
+	Array<float> max_x;
+	Array<float> max_y;
+	Array<float> max_z;
+
+	AABBSoA(size_t count = 0, Allocator * allocator = nullptr) :
+		min_x(allocator), min_y(allocator), min_z(allocator),
+		max_x(allocator), max_y(allocator), max_z(allocator)
+	{
+		resize(count);
+	}
+
+	void resize(size_t count);
+
+	size_t size() const { return min_x.size(); }
+
+	inline void set(size_t index, const AABB & aabb) {
+		min_x[index] = aabb.min.x;
+		min_y[index] = aabb.min.y;
+		min_z[index] = aabb.min.z;
+		max_x[index] = aabb.max.x;
+		max_y[index] = aabb.max.y;
+		max_z[index] = aabb.max.z;
+	}
+
+	inline AABB get(size_t index) const {
+		AABB aabb;
+		aabb.min = Vector3(min_x[index], min_y[index], min_z[index]);
+		aabb.max = Vector3(max_x[index], max_y[index], max_z[index]);
+		return aabb;
+	}
+
+	// Union of the AABBs in the range [first, last)
+	AABB unify(size_t first, size_t last) const;
+
+	// result[i] = surface area of the union of AABBs [0, i], for i in [0, count)
+	void prefix_surface_areas(size_t count, float result[]) const;
+	// result[i] = surface area of the union of AABBs [i, count), for i in [0, count)
+	void suffix_surface_areas(size_t count, float result[]) const;
+
+	// Centers of the first count AABBs, stored per component
+	void calc_centers(size_t count, float center_x[], float center_y[], float center_z[]) const;
+
+	// Transforms the first count AABBs, each by its own transformation, and stores the bounds of the transformed AABBs in result. See AABB::transform
+	static void transform(const AABBSoA & aabbs, const Matrix4 transformations[], size_t count, AABBSoA & result);
+};
@@ -0,0 +1,190 @@
+#include "TransformSoA.h"
+
+#include <immintrin.h>
+
+#include "Math/Matrix4.h"
+
+// /fp:precise still allows contraction into fused multiply-add, which would make the AVX2 and scalar paths round differently
+#pragma fp_contract(off)
+
+void TransformSoA::resize(size_t count) {
+	position_x.resize(count);
+	position_y.resize(count);
+	position_z.resize(count);
+	rotation_x.resize(count);
+	rotation_y.resize(count);
+	rotation_z.resize(count);
+	rotation_w.resize(count);
+	scale     .resize(count);
+}
+
+// Generic over float and __m256, so that the scalar fallback and the AVX2 kernel share the same order of operations
+template<typename T, typename Ops>
+static inline void calc_matrix(T px, T py, T pz, T x, T y, T z, T w, T s, T cells[12], T cells_inv[12]) {
+	T one = Ops::set1(1.0f);
+	T two = Ops::set1(2.0f);
+
+	T xx = Ops::mul(x, x);
+	T yy = Ops::mul(y, y);
+	T zz = Ops::mul(z, z);
+	T xz = Ops::mul(x, z);
+	T xy = Ops::mul(x, y);
+	T yz = Ops::mul(y, z);
+	T wx = Ops::mul(w, x);
+	T wy = Ops::mul(w, y);
+	T wz = Ops::mul(w, z);
+
+	// Rotation matrix, same as Matrix4::create_rotation
+	T r[3][3];
+	r[0][0] = Ops::sub(one, Ops::mul(two, Ops::add(yy, zz)));
+	r[1][0] =               Ops::mul(two, Ops::add(xy, wz));
+	r[2][0] =               Ops::mul(two, Ops::sub(xz, wy));
+
+	r[0][1] =               Ops::mul(two, Ops::sub(xy, wz));
+	r[1][1] = Ops::sub(one, Ops::mul(two, Ops::add(xx, zz)));
+	r[2][1] =               Ops::mul(two, Ops::add(yz, wx));
+
+	r[0][2] =               Ops::mul(two, Ops::add(xz, wy));
+	r[1][2] =               Ops::mul(two, Ops::sub(yz, wx));
+	r[2][2] = Ops::sub(one, Ops::mul(two, Ops::add(xx, yy)));
+
+	T s_inv = Ops::div(one, s);
+
+	T p[3] = { px, py, pz };
+
+	for (int row = 0; row < 3; row++) {
+		// translation * rotation * scale
+		cells[row * 4 + 0] = Ops::mul(r[row][0], s);
+		cells[row * 4 + 1] = Ops::mul(r[row][1], s);
+		cells[row * 4 + 2] = Ops::mul(r[row][2], s);
+		cells[row * 4 + 3] = p[row];
+
+		// (1 / scale) * transpose(rotation) * -translation, the translation is applied last to match the rounding of Matrix4 multiplication
+		cells_inv[row * 4 + 0] = Ops::mul(s_inv, r[0][row]);
+		cells_inv[row * 4 + 1] = Ops::mul(s_inv, r[1][row]);
+		cells_inv[row * 4 + 2] = Ops::mul(s_inv, r[2][row]);
+		cells_inv[row * 4 + 3] = Ops::add(Ops::add(
+			Ops::mul(cells_inv[row * 4 + 0], Ops::neg(px)),
+			Ops::mul(cells_inv[row * 4 + 1], Ops::neg(py))),
+			Ops::mul(cells_inv[row * 4 + 2], Ops::neg(pz))
+		);
+	}
+}
+
+struct ScalarOps {
+	static inline float set1(float a)          { return a; }
+	static inline float add (float a, float b) { return a + b; }
+	static inline float sub (float a, float b) { return a - b; }
+	static inline float mul (float a, float b) { return a * b; }
+	static inline float div (float a, float b) { return a / b; }
+	static inline float neg (float a)          { return -a; }
+};
+
+#ifdef __AVX2__
+struct AVX2Ops {
+	static inline __m256 set1(float  a)           { return _mm256_set1_ps(a); }
+	static inline __m256 add (__m256 a, __m256 b) { return _mm256_add_ps(a, b); }
+	static inline __m256 sub (__m256 a, __m256 b) { return _mm256_sub_ps(a, b); }
+	static inline __m256 mul (__m256 a, __m256 b) { return _mm256_mul_ps(a, b); }
+	static inline __m256 div (__m256 a, __m256 b) { return _mm256_div_ps(a, b); }
+	static inline __m256 neg (__m256 a)           { return _mm256_xor_ps(a, _mm256_set1_ps(-0.0f)); }
+};
+
+// Transposes the 8x8 matrix in rows, afterwards rows[j] contains lane j of every original row
+static inline void transpose_8x8(__m256 rows[8]) {
+	__m256 t0 = _mm256_unpacklo_ps(rows[0], rows[1]);
+	__m256 t1 = _mm256_unpackhi_ps(rows[0], rows[1]);
+	__m256 t2 = _mm256_unpacklo_ps(rows[2], rows[3]);
+	__m256 t3 = _mm256_unpackhi_ps(rows[2], rows[3]);
+	__m256 t4 = _mm256_unpacklo_ps(rows[4], rows[5]);
+	__m256 t5 = _mm256_unpackhi_ps(rows[4], rows[5]);
+	__m256 t6 = _mm256_unpacklo_ps(rows[6], rows[7]);
+	__m256 t7 = _mm256_unpackhi_ps(rows[6], rows[7]);
+
+	__m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+
+	rows[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+	rows[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+	rows[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+	rows[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+	rows[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+	rows[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+	rows[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+	rows[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+}
+
+// Transposes the 12 cells of 8 matrices from SoA back to the individual matrices, including the constant bottom row
+static inline void store_matrices_8(const __m256 cells[12], Matrix4 matrices[8]) {
+	__m256 top[8] = { cells[0], cells[1], cells[2], cells[3], cells[4], cells[5], cells[6], cells[7] };
+	__m256 bottom[8] = {
+		cells[8], cells[9], cells[10], cells[11],
+		_mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_set1_ps(1.0f)
+	};
+
+	transpose_8x8(top);
+	transpose_8x8(bottom);
+
+	for (int j = 0; j < 8; j++) {
+		_mm256_storeu_ps(matrices[j].cells,     top   [j]);
+		_mm256_storeu_ps(matrices[j].cells + 8, bottom[j]);
+	}
+}
+#endif
+
+static inline void set_bottom_row(Matrix4 & matrix) {
+	matrix.cells[12] = 0.0f;
+	matrix.cells[13] = 0.0f;
+	matrix.cells[14] = 0.0f;
+	matrix.cells[15] = 1.0f;
+}
+
+void TransformSoA::calc_matrices(const TransformSoA & transforms, size_t count, Matrix4 matrices[], Matrix4 matrices_inv[]) {
+	size_t i = 0;
+
+#ifdef __AVX2__
+	for (; i + 8 <= count; i += 8) {
+		__m256 cells    [12];
+		__m256 cells_inv[12];
+
+		calc_matrix<__m256, AVX2Ops>(
+			_mm256_loadu_ps(transforms.position_x.data() + i),
+			_mm256_loadu_ps(transforms.position_y.data() + i),
+			_mm256_loadu_ps(transforms.position_z.data() + i),
+			_mm256_loadu_ps(transforms.rotation_x.data() + i),
+			_mm256_loadu_ps(transforms.rotation_y.data() + i),
+			_mm256_loadu_ps(transforms.rotation_z.data() + i),
+			_mm256_loadu_ps(transforms.rotation_w.data() + i),
+			_mm256_loadu_ps(transforms.scale     .data() + i),
+			cells,
+			cells_inv
+		);
+
+		store_matrices_8(cells,     matrices     + i);
+		store_matrices_8(cells_inv, matrices_inv + i);
+	}
+#endif
+
+	for (; i < count; i++) {
+		calc_matrix<float, ScalarOps>(
+			transforms.position_x[i],
+			transforms.position_y[i],
+			transforms.position_z[i],
+			transforms.rotation_x[i],
+			transforms.rotation_y[i],
+			transforms.rotation_z[i],
+			transforms.rotation_w[i],
+			transforms.scale     [i],
+			matrices    [i].cells,
+			matrices_inv[i].cells
+		);
+		set_bottom_row(matrices    [i]);
+		set_bottom_row(matrices_inv[i]);
+	}
+}
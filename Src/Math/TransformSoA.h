@@ -0,0 +1,49 @@
+#pragma once
+#include "Core/Array.h"
+
+#include "Math/Vector3.h"
+#include "Math/Quaternion.h"
+
+struct Matrix4;
+
+// Structure of Arrays layout for a list of translation, rotation and uniform scale transforms.
+// Allows the matrices of many transforms to be computed 8 at a time using AVX2. The kernel produces results that are
+// bit-identical to the scalar fallback and to multiplying out Matrix4::create_translation/rotation/scale (floating point
+// arithmetic is performed in the same order without fused multiply-add, TransformSoA.cpp is compiled with /fp:precise for this)
+struct TransformSoA {
+	Array<float> position_x;
+	Array<float> position_y;
+	Array<float> position_z;
+	Array<float> rotation_x;
+	Array<float> rotation_y;
+	Array<float> rotation_z;
+	Array<float> rotation_w;
+	Array<float> scale;
+
+	TransformSoA(size_t count = 0, Allocator * allocator = nullptr) :
+		position_x(allocator), position_y(allocator), position_z(allocator),
+		rotation_x(allocator), rotation_y(allocator), rotation_z(allocator), rotation_w(allocator),
+		scale(allocator)
+	{
+		resize(count);
+	}
+
+	void resize(size_t count);
+
+	size_t size() const { return scale.size(); }
+
+	inline void set(size_t index, const Vector3 & position, const Quaternion & rotation, float scale) {
+		position_x[index] = position.x;
+		position_y[index] = position.y;
+		position_z[index] = position.z;
+		rotation_x[index] = rotation.x;
+		rotation_y[index] = rotation.y;
+		rotation_z[index] = rotation.z;
+		rotation_w[index] = rotation.w;
+		this->scale[index] = scale;
+	}
+
+	// Computes translation * rotation * scale and its inverse for the first count transforms.
+	// Uses the closed form of the product instead of full matrix multiplications, the inverse uses the transpose of the rotation
+	static void calc_matrices(const TransformSoA & transforms, size_t count, Matrix4 matrices[], Matrix4 matrices_inv[]);
+};
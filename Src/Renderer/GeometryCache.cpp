@@ -0,0 +1,394 @@
+#include "GeometryCache.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <mutex>
+#include <condition_variable>
+
+#include "Core/IO.h"
+#include "Core/Log.h"
+#include "Core/Timer.h"
+#include "Core/Format.h"
+#include "Core/Random.h"
+
+#include "Renderer/Integrators/GeometryAggregation.h"
+
+#include "Util/ThreadPool.h"
+
+struct GeometryCacheSync {
+	std::mutex              mutex;
+	std::condition_variable condition; // Signaled whenever a cluster finishes loading
+};
+
+GeometryCache::GeometryCache(const Array<int> & cluster_sizes, size_t budget_in_bytes, ClusterLoader loader, ThreadPool * thread_pool) :
+	clusters(cluster_sizes.size()),
+	budget_in_bytes(budget_in_bytes),
+	loader(std::move(loader)),
+	thread_pool(thread_pool)
+{
+	sync = make_owned<GeometryCacheSync>();
+
+	for (int i = 0; i < clusters.size(); i++) {
+		Cluster & cluster = clusters[i];
+		cluster.num_triangles = cluster_sizes[i];
+		cluster.state         = ClusterState::NOT_RESIDENT;
+		cluster.pin_count     = 0;
+		cluster.lru_prev      = INVALID;
+		cluster.lru_next      = INVALID;
+	}
+}
+
+GeometryCache::~GeometryCache() {
+	wait_idle();
+}
+
+const Triangle * GeometryCache::acquire(int cluster_index) {
+	std::unique_lock<std::mutex> lock(sync->mutex);
+
+	Cluster & cluster = clusters[cluster_index];
+	stats.num_acquires++;
+
+	// Pin before potentially releasing the lock, so that the cluster cannot be evicted before it is returned
+	cluster.pin_count++;
+
+	if (cluster.state == ClusterState::RESIDENT) {
+		stats.num_hits++;
+	} else {
+		stats.num_stalls++;
+
+		Timer timer;
+		timer.start();
+
+		if (cluster.state == ClusterState::NOT_RESIDENT || cluster.state == ClusterState::QUEUED) {
+			// Demand load on the calling thread, this is allowed to exceed the budget if everything else is pinned.
+			// A prefetch that has not started yet is taken over, so that callers that run on the ThreadPool never wait on Work queued behind them
+			if (cluster.state == ClusterState::NOT_RESIDENT) {
+				reserve_bytes(cluster.num_triangles * sizeof(Triangle), true);
+			}
+			cluster.state = ClusterState::LOADING;
+
+			lock.unlock();
+			load(cluster_index);
+			lock.lock();
+		} else {
+			// A prefetch for this cluster is already in flight
+			sync->condition.wait(lock, [&cluster]() { return cluster.state == ClusterState::RESIDENT; });
+		}
+
+		stats.stall_time += timer.stop();
+	}
+
+	lru_unlink   (cluster_index);
+	lru_push_head(cluster_index);
+
+	return cluster.triangles.data();
+}
+
+void GeometryCache::release(int cluster_index) {
+	std::lock_guard<std::mutex> lock(sync->mutex);
+
+	ASSERT(clusters[cluster_index].pin_count > 0);
+	clusters[cluster_index].pin_count--;
+}
+
+void GeometryCache::prefetch(int cluster_index) {
+	{
+		std::lock_guard<std::mutex> lock(sync->mutex);
+
+		Cluster & cluster = clusters[cluster_index];
+		if (cluster.state != ClusterState::NOT_RESIDENT) return;
+
+		if (!reserve_bytes(cluster.num_triangles * sizeof(Triangle), false)) return;
+
+		cluster.state = ClusterState::QUEUED;
+
+		stats.num_prefetches++;
+		num_in_flight++;
+	}
+
+	auto work = [this, cluster_index]() {
+		bool is_queued;
+		{
+			std::lock_guard<std::mutex> lock(sync->mutex);
+
+			// The load may have been taken over by acquire() in the meantime
+			Cluster & cluster = clusters[cluster_index];
+			is_queued = cluster.state == ClusterState::QUEUED;
+			if (is_queued) {
+				cluster.state = ClusterState::LOADING;
+			}
+		}
+
+		if (is_queued) {
+			load(cluster_index);
+		}
+
+		// Notify while holding the lock, once wait_idle() observes num_in_flight == 0 the GeometryCache may be destroyed
+		std::lock_guard<std::mutex> lock(sync->mutex);
+		num_in_flight--;
+		sync->condition.notify_all();
+	};
+
+	if (thread_pool) {
+		thread_pool->submit(std::move(work));
+	} else {
+		work();
+	}
+}
+
+void GeometryCache::wait_idle() {
+	std::unique_lock<std::mutex> lock(sync->mutex);
+	sync->condition.wait(lock, [this]() { return num_in_flight == 0; });
+}
+
+void GeometryCache::print_stats() const {
+	IO::print("Geometry cache: {} acquires, {} hits ({} hit rate), {} stalls, {} prefetches, {} evictions\n"_sv,
+		stats.num_acquires, stats.num_hits, stats.hit_rate(), stats.num_stalls, stats.num_prefetches, stats.num_evictions
+	);
+	IO::print("Geometry cache: peak resident memory {} KB (budget {} KB), stall time {} us\n"_sv,
+		stats.peak_resident_bytes / 1024, budget_in_bytes / 1024, stats.stall_time
+	);
+}
+
+bool GeometryCache::reserve_bytes(size_t num_bytes, bool force) {
+	while (resident_bytes + num_bytes > budget_in_bytes) {
+		if (!evict_lru()) {
+			if (!force) return false;
+			break;
+		}
+	}
+
+	resident_bytes += num_bytes;
+	stats.peak_resident_bytes = Math::max(stats.peak_resident_bytes, resident_bytes);
+
+	return true;
+}
+
+bool GeometryCache::evict_lru() {
+	// Find the least recently used cluster that is not pinned
+	int cluster_index = lru_tail;
+	while (cluster_index != INVALID && clusters[cluster_index].pin_count > 0) {
+		cluster_index = clusters[cluster_index].lru_prev;
+	}
+	if (cluster_index == INVALID) return false;
+
+	lru_unlink(cluster_index);
+
+	Cluster & cluster = clusters[cluster_index];
+	cluster.state     = ClusterState::NOT_RESIDENT;
+	cluster.triangles = Array<Triangle>();
+
+	resident_bytes -= cluster.num_triangles * sizeof(Triangle);
+
+	stats.num_evictions++;
+	return true;
+}
+
+void GeometryCache::lru_unlink(int cluster_index) {
+	Cluster & cluster = clusters[cluster_index];
+
+	if (cluster.lru_prev != INVALID) {
+		clusters[cluster.lru_prev].lru_next = cluster.lru_next;
+	} else if (lru_head == cluster_index) {
+		lru_head = cluster.lru_next;
+	}
+
+	if (cluster.lru_next != INVALID) {
+		clusters[cluster.lru_next].lru_prev = cluster.lru_prev;
+	} else if (lru_tail == cluster_index) {
+		lru_tail = cluster.lru_prev;
+	}
+
+	cluster.lru_prev = INVALID;
+	cluster.lru_next = INVALID;
+}
+
+void GeometryCache::lru_push_head(int cluster_index) {
+	Cluster & cluster = clusters[cluster_index];
+	cluster.lru_prev = INVALID;
+	cluster.lru_next = lru_head;
+
+	if (lru_head != INVALID) {
+		clusters[lru_head].lru_prev = cluster_index;
+	} else {
+		lru_tail = cluster_index;
+	}
+	lru_head = cluster_index;
+}
+
+void GeometryCache::load(int cluster_index) {
+	// The number of Triangles never changes, so it is safe to read without holding the lock
+	Array<Triangle> triangles(clusters[cluster_index].num_triangles);
+	loader(cluster_index, triangles.data());
+
+	{
+		std::lock_guard<std::mutex> lock(sync->mutex);
+
+		Cluster & cluster = clusters[cluster_index];
+		cluster.triangles = std::move(triangles);
+		cluster.state     = ClusterState::RESIDENT;
+
+		lru_push_head(cluster_index);
+
+		sync->condition.notify_all();
+	}
+}
+
+void GeometryStreaming::replay_trace(GeometryCache & cache, const Array<int> & trace, int prefetch_distance) {
+	for (int i = 0; i < Math::min(prefetch_distance, int(trace.size())); i++) {
+		cache.prefetch(trace[i]);
+	}
+
+	for (int i = 0; i < trace.size(); i++) {
+		if (prefetch_distance > 0 && i + prefetch_distance < trace.size()) {
+			cache.prefetch(trace[i + prefetch_distance]);
+		}
+
+		cache.acquire(trace[i]);
+		cache.release(trace[i]);
+	}
+
+	cache.wait_idle();
+}
+
+bool GeometryStreaming::ClusterSet::init(size_t budget_in_bytes, ThreadPool * thread_pool) {
+	Array<int> cluster_sizes;
+
+	for (int i = 0; i < mesh_data_count; i++) {
+		const ClusterFile::Reader * reader = mesh_datas[first_mesh_data + i].clusters.get();
+		if (!reader) {
+			cluster_offsets.push_back(INVALID);
+			continue;
+		}
+
+		cluster_offsets.push_back(cluster_sizes.size());
+		for (int c = 0; c < reader->num_clusters; c++) {
+			cluster_sizes    .push_back(reader->clusters[c].num_triangles);
+			cluster_locations.push_back({ reader, c });
+		}
+	}
+
+	if (cluster_sizes.size() == 0) return false;
+
+	cache = make_owned<GeometryCache>(cluster_sizes, budget_in_bytes, [this](int cluster_index, Triangle * dst) {
+		const ClusterLocation & location = cluster_locations[cluster_index];
+		const ClusterFile::Reader & reader = *location.reader;
+
+		memcpy(dst, reader.get_cluster_triangles(location.cluster_index), reader.clusters[location.cluster_index].num_triangles * sizeof(Triangle));
+	}, thread_pool);
+
+	return true;
+}
+
+void GeometryStreaming::ClusterSet::fill_triangles(int mesh_data_index, size_t first, size_t count, CUDATriangle dst[]) {
+	constexpr int PREFETCH_DISTANCE = 4; // In clusters
+
+	int i = mesh_data_index - first_mesh_data;
+	ASSERT(i >= 0 && i < mesh_data_count);
+
+	int cluster_offset = cluster_offsets[i];
+	int num_clusters   = mesh_datas[mesh_data_index].clusters.get()->num_clusters;
+	ASSERT(cluster_offset != INVALID);
+
+	int              cluster   = INVALID; // Currently acquired cluster, relative to the MeshData
+	const Triangle * triangles = nullptr;
+
+	for (size_t t = 0; t < count; t++) {
+		size_t stored_index = first + t;
+
+		if (int(stored_index / ClusterFile::CLUSTER_SIZE) != cluster) {
+			if (cluster != INVALID) {
+				cache->release(cluster_offset + cluster);
+			}
+			cluster   = int(stored_index / ClusterFile::CLUSTER_SIZE);
+			triangles = cache->acquire(cluster_offset + cluster);
+
+			for (int p = 1; p <= PREFETCH_DISTANCE && cluster + p < num_clusters; p++) {
+				cache->prefetch(cluster_offset + cluster + p);
+			}
+		}
+
+		dst[t] = GeometryAggregation::convert_triangle(triangles[stored_index % ClusterFile::CLUSTER_SIZE]);
+	}
+
+	if (cluster != INVALID) {
+		cache->release(cluster_offset + cluster);
+	}
+}
+
+void GeometryStreaming::run_benchmark() {
+	constexpr int NUM_TRIANGLES = 256 * 1024;
+	constexpr int TRACE_LENGTH  = 20000;
+
+	constexpr float JUMP_PROBABILITY = 0.02f;
+
+	static constexpr const char * CLUSTER_FILENAME = "geometry_streaming_benchmark.clu";
+
+	// Synthetic Triangles, stored in their original order
+	Array<Triangle> triangles(NUM_TRIANGLES);
+	Array<int>      order    (NUM_TRIANGLES);
+	for (int t = 0; t < NUM_TRIANGLES; t++) {
+		Triangle & triangle = triangles[t];
+		triangle = { };
+		triangle.position_0 = Vector3(float(t), 0.0f, 0.0f);
+		triangle.position_1 = triangle.position_0 + Vector3(1.0f, 0.0f, 0.0f);
+		triangle.position_2 = triangle.position_0 + Vector3(0.0f, 1.0f, 0.0f);
+		triangle.aabb = AABB::from_points(&triangle.position_0, 3);
+
+		order[t] = t;
+	}
+
+	String cluster_filename = CLUSTER_FILENAME;
+	if (!ClusterFile::save(cluster_filename, triangles.data(), order.data(), NUM_TRIANGLES)) return;
+
+	{
+		ClusterFile::Reader reader;
+		if (!reader.open(cluster_filename)) return;
+
+		Array<int> cluster_sizes(reader.num_clusters);
+		for (int c = 0; c < reader.num_clusters; c++) {
+			cluster_sizes[c] = reader.clusters[c].num_triangles;
+		}
+
+		// A random walk with small steps models a camera moving through the Scene, the occasional jump models a disocclusion
+		RNG rng(1337);
+
+		Array<int> trace(TRACE_LENGTH);
+
+		int position = 0;
+		for (int i = 0; i < TRACE_LENGTH; i++) {
+			if (rng.get_float() < JUMP_PROBABILITY) {
+				position = int(rng.get_uint32(reader.num_clusters));
+			} else {
+				position = Math::clamp(position + int(rng.get_uint32(5)) - 2, 0, reader.num_clusters - 1);
+			}
+			trace[i] = position;
+		}
+
+		size_t total_bytes = size_t(NUM_TRIANGLES) * sizeof(Triangle);
+
+		IO::print("Geometry streaming benchmark: {} accesses to {} clusters of {} triangles ({} KB in total)\n"_sv, TRACE_LENGTH, reader.num_clusters, ClusterFile::CLUSTER_SIZE, total_bytes / 1024);
+
+		ThreadPool & thread_pool = ThreadPool::get_shared();
+
+		size_t budgets           [] = { total_bytes / 16, total_bytes / 4, total_bytes };
+		int    prefetch_distances[] = { 0, 4, 16 };
+
+		for (size_t budget_in_bytes : budgets) {
+			for (int prefetch_distance : prefetch_distances) {
+				GeometryCache cache(cluster_sizes, budget_in_bytes, [&reader](int cluster_index, Triangle * dst) {
+					memcpy(dst, reader.get_cluster_triangles(cluster_index), reader.clusters[cluster_index].num_triangles * sizeof(Triangle));
+				}, &thread_pool);
+
+				replay_trace(cache, trace, prefetch_distance);
+
+				const GeometryCache::Stats & stats = cache.stats;
+				IO::print("Budget {} KB, prefetch distance {}: hit rate {}, peak resident {} KB, {} stalls taking {} us\n"_sv,
+					budget_in_bytes / 1024, prefetch_distance, stats.hit_rate(), stats.peak_resident_bytes / 1024, stats.num_stalls, stats.stall_time
+				);
+			}
+		}
+	}
+
+	remove(CLUSTER_FILENAME);
+}
@@ -0,0 +1,146 @@
+#pragma once
+#include "Core/Array.h"
+#include "Core/Function.h"
+#include "Core/OwnPtr.h"
+
+#include "Assets/ClusterFile.h"
+
+#include "Renderer/MeshData.h"
+
+struct ThreadPool;
+struct CUDATriangle;
+
+// Out-of-core cache of Triangle clusters (see Assets/ClusterFile.h)
+// Keeps the memory used by resident clusters under a fixed budget by evicting the least recently used clusters.
+// Clusters can be prefetched asynchronously on a ThreadPool, acquiring a cluster that is not resident stalls the caller until it is loaded
+struct GeometryCache {
+	// Copies the Triangles of the given cluster into dst
+	using ClusterLoader = Function<void(int cluster_index, Triangle * dst)>;
+
+	struct Stats {
+		size_t num_acquires;
+		size_t num_hits;
+		size_t num_stalls;
+		size_t num_prefetches;
+		size_t num_evictions;
+
+		size_t peak_resident_bytes;
+		size_t stall_time; // In microseconds
+
+		inline float hit_rate() const {
+			return num_acquires > 0 ? float(num_hits) / float(num_acquires) : 0.0f;
+		}
+	};
+
+	enum struct ClusterState : char {
+		NOT_RESIDENT,
+		QUEUED,  // Prefetch submitted to the ThreadPool but not started, acquire() loads the cluster itself instead of waiting on the ThreadPool
+		LOADING,
+		RESIDENT
+	};
+
+	struct Cluster {
+		Array<Triangle> triangles;
+		int             num_triangles;
+
+		ClusterState state;
+		int          pin_count;
+
+		int lru_prev;
+		int lru_next;
+	};
+
+	Array<Cluster> clusters;
+
+	// Intrusive doubly linked list through resident clusters, head is most recently used
+	int lru_head = INVALID;
+	int lru_tail = INVALID;
+
+	size_t budget_in_bytes;
+	size_t resident_bytes = 0; // Includes memory reserved for clusters that are currently loading
+
+	ClusterLoader loader;
+	ThreadPool  * thread_pool;
+
+	OwnPtr<struct GeometryCacheSync> sync;
+
+	int num_in_flight = 0;
+
+	Stats stats = { };
+
+	// cluster_sizes contains the number of Triangles in every cluster
+	GeometryCache(const Array<int> & cluster_sizes, size_t budget_in_bytes, ClusterLoader loader, ThreadPool * thread_pool = nullptr);
+
+	NON_COPYABLE(GeometryCache);
+	NON_MOVEABLE(GeometryCache);
+
+	~GeometryCache();
+
+	// Returns the Triangles of the cluster, loading it if needed. The cluster stays resident until release() is called
+	const Triangle * acquire(int cluster_index);
+	void             release(int cluster_index);
+
+	// Starts loading the cluster in the background if it is not resident already.
+	// Prefetches are dropped if they would require evicting pinned clusters
+	void prefetch(int cluster_index);
+
+	// Waits for all outstanding prefetches to finish
+	void wait_idle();
+
+	void print_stats() const;
+
+private:
+	// The following assume sync->mutex is held
+	bool reserve_bytes(size_t num_bytes, bool force);
+	bool evict_lru();
+
+	void lru_unlink   (int cluster_index);
+	void lru_push_head(int cluster_index);
+
+	void load(int cluster_index);
+};
+
+namespace GeometryStreaming {
+	// Replays a trace of cluster accesses against the cache, issuing prefetches prefetch_distance accesses ahead of time.
+	// Used to evaluate budgets and prefetch distances, see GeometryCache::Stats for the results
+	void replay_trace(GeometryCache & cache, const Array<int> & trace, int prefetch_distance);
+
+	// A single GeometryCache over the cluster files of a range of MeshDatas, see ClusterFile::move_triangles.
+	// Used by Integrator::init_geometry and Integrator::append_mesh_data to read the triangles they upload when CPUConfig::enable_geometry_streaming is set
+	struct ClusterSet {
+		const Array<MeshData> & mesh_datas;
+
+		int first_mesh_data;
+		int mesh_data_count;
+
+		Array<int> cluster_offsets; // Index of the first cluster of every MeshData in the cache, INVALID if its Triangles are in memory
+
+		struct ClusterLocation {
+			const ClusterFile::Reader * reader;
+			int                         cluster_index;
+		};
+		Array<ClusterLocation> cluster_locations; // For every cluster in the cache, where it is stored
+
+		OwnPtr<GeometryCache> cache;
+
+		ClusterSet(const Array<MeshData> & mesh_datas, int first_mesh_data, int mesh_data_count) :
+			mesh_datas(mesh_datas), first_mesh_data(first_mesh_data), mesh_data_count(mesh_data_count) { }
+
+		NON_COPYABLE(ClusterSet);
+		NON_MOVEABLE(ClusterSet);
+
+		~ClusterSet() = default;
+
+		// Returns false if none of the MeshDatas in the range has its Triangles in a cluster file
+		bool init(size_t budget_in_bytes, ThreadPool * thread_pool);
+
+		// Produces the stored triangles [first, first + count) of a MeshData that has a cluster file into dst.
+		// Cluster files use the order of GeometryAggregation::calc_triangle_order, so consecutive triangles come from the same or the next cluster.
+		// Safe to call from multiple threads at once
+		void fill_triangles(int mesh_data_index, size_t first, size_t count, CUDATriangle dst[]);
+	};
+
+	// Replays synthetic traces against a GeometryCache backed by a cluster file for several budgets and prefetch distances,
+	// and reports the peak resident memory and the time spent stalled on clusters that were not resident
+	void run_benchmark();
+}
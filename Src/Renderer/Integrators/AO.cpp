@@ -7,31 +7,24 @@ void AO::cuda_init(unsigned frame_buffer_handle, int screen_width, int screen_he
 	init_globals();
 
 	pinned_buffer_sizes = CUDAMemory::malloc_pinned<BufferSizesAO>();
-	pinned_buffer_sizes->reset(BATCH_SIZE);
-
 	global_buffer_sizes = cuda_module.get_global("buffer_sizes");
-	global_buffer_sizes.set_value(*pinned_buffer_sizes);
 
-	resize_init(frame_buffer_handle, screen_width, screen_height);
+	scene.has_diffuse    = false;
+	scene.has_plastic    = false;
+	scene.has_dielectric = false;
+	scene.has_conductor  = false;
+	scene.has_lights     = false;
 
 	init_geometry();
 	init_rng();
 	init_events();
 
-	ray_buffer_trace .init(BATCH_SIZE);
-	ray_buffer_shadow.init(BATCH_SIZE);
-	cuda_module.get_global("ray_buffer_trace") .set_value(ray_buffer_trace);
-	cuda_module.get_global("ray_buffer_shadow").set_value(ray_buffer_shadow);
+	// Initialized after the Scene has been uploaded, since the batch size depends on the memory that is left
+	resize_init(frame_buffer_handle, screen_width, screen_height);
 
 	scene.camera.update(0.0f);
 	scene.update(0.0f);
 
-	scene.has_diffuse    = false;
-	scene.has_plastic    = false;
-	scene.has_dielectric = false;
-	scene.has_conductor  = false;
-	scene.has_lights     = false;
-
 	invalidated_scene      = true;
 	invalidated_materials  = true;
 	invalidated_mediums    = true;
@@ -52,6 +45,18 @@ void AO::cuda_free() {
 
 	CUDAMemory::free_pinned(pinned_buffer_sizes);
 
+	free_batch_buffers();
+	batch_size = 0;
+}
+
+void AO::init_batch_buffers() {
+	ray_buffer_trace .init(batch_size);
+	ray_buffer_shadow.init(batch_size);
+	cuda_module.get_global("ray_buffer_trace") .set_value(ray_buffer_trace);
+	cuda_module.get_global("ray_buffer_shadow").set_value(ray_buffer_shadow);
+}
+
+void AO::free_batch_buffers() {
 	ray_buffer_trace .free();
 	ray_buffer_shadow.free();
 }
@@ -59,6 +64,10 @@ void AO::cuda_free() {
 void AO::init_module() {
 	cuda_module.init("AO"_sv, "Src/CUDA/AO.cu"_sv, CUDAContext::compute_capability, MAX_REGISTERS);
 
+	init_kernels();
+}
+
+void AO::init_kernels() {
 	kernel_generate         .init(&cuda_module, "kernel_generate");
 	kernel_trace_bvh2       .init(&cuda_module, "kernel_trace_bvh2");
 	kernel_trace_bvh4       .init(&cuda_module, "kernel_trace_bvh4");
@@ -117,6 +126,13 @@ void AO::resize_init(unsigned frame_buffer_handle, int width, int height) {
 	cuda_module.get_global("screen_pitch") .set_value(screen_pitch);
 	cuda_module.get_global("screen_height").set_value(screen_height);
 
+	// The batch size depends on the resolution, the ray buffers are reallocated if it changes
+	bool had_batch_buffers = batch_size > 0;
+	if (calc_batch_size(BATCH_BYTES_PER_PIXEL)) {
+		if (had_batch_buffers) free_batch_buffers();
+		init_batch_buffers();
+	}
+
 	init_aovs();
 	aov_enable(AOVType::RADIANCE);
 	cuda_module.get_global("aovs").set_value(aovs);
@@ -126,20 +142,24 @@ void AO::resize_init(unsigned frame_buffer_handle, int width, int height) {
 	surf_accumulator     = CUDAMemory::create_surface(CUDAMemory::resource_get_array(resource_accumulator));
 	cuda_module.get_global("accumulator").set_value(surf_accumulator);
 
-	kernel_generate         .set_grid_dim(Math::divide_round_up(BATCH_SIZE, kernel_generate         .block_dim_x), 1, 1);
-	kernel_ambient_occlusion.set_grid_dim(Math::divide_round_up(BATCH_SIZE, kernel_ambient_occlusion.block_dim_x), 1, 1);
-	kernel_accumulate       .set_grid_dim(screen_pitch / kernel_accumulate.block_dim_x, Math::divide_round_up(height, kernel_accumulate.block_dim_y), 1);
+	resize_kernels();
 
 	scene.camera.resize(width, height);
 	invalidated_camera = true;
 
 	// Reset buffer sizes to default for next frame
-	pinned_buffer_sizes->reset(Math::min(BATCH_SIZE, pixel_count));
+	pinned_buffer_sizes->reset(Math::min(batch_size, pixel_count));
 	global_buffer_sizes.set_value(*pinned_buffer_sizes);
 
 	sample_index = 0;
 }
 
+void AO::resize_kernels() {
+	kernel_generate         .set_grid_dim(Math::divide_round_up(batch_size, kernel_generate         .block_dim_x), 1, 1);
+	kernel_ambient_occlusion.set_grid_dim(Math::divide_round_up(batch_size, kernel_ambient_occlusion.block_dim_x), 1, 1);
+	kernel_accumulate       .set_grid_dim(screen_pitch / kernel_accumulate.block_dim_x, Math::divide_round_up(screen_height, kernel_accumulate.block_dim_y), 1);
+}
+
 void AO::resize_free() {
 	CUDACALL(cuStreamSynchronize(memory_stream));
 
@@ -150,6 +170,8 @@ void AO::resize_free() {
 }
 
 void AO::update(float delta, Allocator * frame_allocator) {
+	update_assets();
+
 	if (invalidated_scene) {
 		sample_index = 0;
 	}
@@ -163,12 +185,12 @@ void AO::render() {
 	CUDACALL(cuStreamSynchronize(memory_stream));
 
 	int pixels_left = pixel_count;
-	int batch_size  = Math::min(BATCH_SIZE, pixel_count);
+	int pixels_per_batch = Math::min(batch_size, pixel_count);
 
-	// Render in batches of BATCH_SIZE pixels at a time
+	// Render in batches of pixels_per_batch pixels at a time
 	while (pixels_left > 0) {
 		int pixel_offset = pixel_count - pixels_left;
-		int pixel_count  = Math::min(batch_size, pixels_left);
+		int pixel_count  = Math::min(pixels_per_batch, pixels_left);
 
 		// Generate primary Rays from the current Camera orientation
 		event_pool.record(event_desc_primary);
@@ -183,11 +205,11 @@ void AO::render() {
 		event_pool.record(event_desc_shadow_trace);
 		kernel_trace_shadow->execute();
 
-		pixels_left -= batch_size;
+		pixels_left -= pixels_per_batch;
 
 		if (pixels_left > 0) {
 			// Set buffer sizes to appropriate pixel count for next Batch
-			pinned_buffer_sizes->reset(Math::min(batch_size, pixels_left));
+			pinned_buffer_sizes->reset(Math::min(pixels_per_batch, pixels_left));
 			global_buffer_sizes.set_value(*pinned_buffer_sizes);
 		}
 	}
@@ -198,7 +220,7 @@ void AO::render() {
 	event_pool.record(event_desc_end);
 
 	// Reset buffer sizes to default for next frame
-	pinned_buffer_sizes->reset(batch_size);
+	pinned_buffer_sizes->reset(pixels_per_batch);
 	global_buffer_sizes.set_value(*pinned_buffer_sizes);
 
 	aovs_clear_to_zero();
@@ -10,6 +10,9 @@ struct TraceBufferAO {
 
 	CUDAMemory::Ptr<int> pixel_index;
 
+	// Size of one element summed over all arrays
+	static constexpr size_t ELEMENT_SIZE = 2 * sizeof(float3) + sizeof(float4) + sizeof(int);
+
 	inline void init(int buffer_size) {
 		origin   .init(buffer_size);
 		direction.init(buffer_size);
@@ -32,6 +35,8 @@ struct ShadowRayBufferAO {
 	CUDAMemory::Ptr<float> max_distance;
 	CUDAMemory::Ptr<int>   pixel_index;
 
+	static constexpr size_t ELEMENT_SIZE = 2 * sizeof(float3) + sizeof(float) + sizeof(int);
+
 	inline void init(int buffer_size) {
 		ray_origin   .init(buffer_size);
 		ray_direction.init(buffer_size);
@@ -101,10 +106,17 @@ struct AO final : Integrator {
 	void cuda_free() override;
 
 	void init_module();
+	void init_kernels() override;
 	void init_events();
 
+	static constexpr size_t BATCH_BYTES_PER_PIXEL = TraceBufferAO::ELEMENT_SIZE + ShadowRayBufferAO::ELEMENT_SIZE;
+
+	void init_batch_buffers();
+	void free_batch_buffers();
+
 	void resize_init(unsigned frame_buffer_handle, int width, int height) override; // Part of resize that initializes new size
 	void resize_free()                                                    override; // Part of resize that cleans up old size
+	void resize_kernels()                                                 override; // Part of resize that sets Kernel launch dimensions
 
 	void update(float delta, Allocator * frame_allocator) override;
 	void render()                                         override;
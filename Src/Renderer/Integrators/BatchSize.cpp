@@ -0,0 +1,114 @@
+#include "BatchSize.h"
+
+#include "Config.h"
+
+#include "Core/IO.h"
+#include "Core/Random.h"
+
+#include "Math/Math.h"
+
+#include "Renderer/Integrators/AO.h"
+#include "Renderer/Integrators/Pathtracer.h"
+
+#include "Util/Check.h"
+
+static BatchSize::Batches make_batches(int pixel_count, size_t bytes_per_pixel, int batch_size) {
+	BatchSize::Batches batches = { };
+	batches.batch_size   = batch_size;
+	batches.batch_count  = Math::divide_round_up(pixel_count, batch_size);
+	batches.buffer_bytes = size_t(batch_size) * bytes_per_pixel;
+	return batches;
+}
+
+BatchSize::Batches BatchSize::calc(int pixel_count, size_t bytes_per_pixel, size_t bytes_available, float memory_budget) {
+	ASSERT(pixel_count > 0);
+	ASSERT(bytes_per_pixel > 0);
+
+	// Rendering the whole frame in one batch is the best case, there is no benefit to larger buffers
+	size_t batch_size_max    = Math::round_up<size_t>(pixel_count, WARP_SIZE);
+	size_t batch_size_budget = size_t(double(bytes_available) * double(memory_budget)) / bytes_per_pixel;
+
+	size_t batch_size = Math::min(batch_size_max, batch_size_budget);
+	batch_size -= batch_size % WARP_SIZE;
+
+	// Below the minimum the overhead of launching all Kernels for every batch dominates,
+	// if even that does not fit the allocation will report running out of memory
+	batch_size = Math::max<size_t>(batch_size, Math::min<size_t>(BATCH_SIZE_MIN, batch_size_max));
+
+	return make_batches(pixel_count, bytes_per_pixel, int(batch_size));
+}
+
+BatchSize::Batches BatchSize::calc_fixed(int pixel_count, size_t bytes_per_pixel, int batch_size) {
+	ASSERT(pixel_count > 0);
+	ASSERT(batch_size  > 0);
+
+	return make_batches(pixel_count, bytes_per_pixel, Math::round_up(batch_size, WARP_SIZE));
+}
+
+BatchSize::Batches BatchSize::choose(int pixel_count, size_t bytes_per_pixel, size_t bytes_available) {
+	if (cpu_config.batch_size > 0) {
+		return calc_fixed(pixel_count, bytes_per_pixel, cpu_config.batch_size);
+	} else {
+		return calc(pixel_count, bytes_per_pixel, bytes_available, cpu_config.batch_memory_budget);
+	}
+}
+
+void BatchSize::print_report(int width, int height, size_t bytes_available) {
+	int pixel_count = width * height;
+
+	IO::print("Resolution {}x{} ({} pixels), {} MB available, memory budget {}:\n"_sv, width, height, pixel_count, bytes_available >> 20, cpu_config.batch_memory_budget);
+
+	auto report = [&](StringView integrator_name, size_t bytes_per_pixel) {
+		Batches batches = choose(pixel_count, bytes_per_pixel, bytes_available);
+		IO::print("{}: {} bytes per pixel, batch size {}, {} batches per frame, ray buffers take up {} MB\n"_sv,
+			integrator_name, bytes_per_pixel, batches.batch_size, batches.batch_count, batches.buffer_bytes >> 20);
+	};
+	report("Pathtracer"_sv, Pathtracer::BATCH_BYTES_PER_PIXEL);
+	report("AO        "_sv, AO::BATCH_BYTES_PER_PIXEL);
+}
+
+bool BatchSize::run_check() {
+	constexpr int NUM_TESTS = 10000;
+
+	RNG rng(4321);
+
+	Check::Checker checker;
+
+	auto check = [&checker](bool condition, const char * what, int pixel_count, size_t bytes_per_pixel, size_t bytes_available, const Batches & batches) {
+		checker(condition, "{} (pixels {}, bytes per pixel {}, bytes available {}: batch size {}, batch count {})"_sv,
+			StringView::from_c_str(what), pixel_count, bytes_per_pixel, bytes_available, batches.batch_size, batches.batch_count);
+	};
+
+	for (int i = 0; i < NUM_TESTS; i++) {
+		int    pixel_count     = 1 + rng.get_uint32(7680 * 4320);
+		size_t bytes_per_pixel = 16 + rng.get_uint32(512);
+		size_t bytes_available = size_t(rng.get_uint32(24 * 1024)) << 20;
+		float  memory_budget   = 0.1f + 0.9f * rng.get_float();
+
+		Batches batches = calc(pixel_count, bytes_per_pixel, bytes_available, memory_budget);
+
+		size_t pixels_covered = size_t(batches.batch_size) * size_t(batches.batch_count);
+
+		check(batches.batch_size > 0,                                                        "Batch size is positive",            pixel_count, bytes_per_pixel, bytes_available, batches);
+		check(batches.batch_size % WARP_SIZE == 0,                                           "Batch size is warp aligned",        pixel_count, bytes_per_pixel, bytes_available, batches);
+		check(pixels_covered >= size_t(pixel_count),                                         "Batches cover the frame",           pixel_count, bytes_per_pixel, bytes_available, batches);
+		check(pixels_covered - batches.batch_size < size_t(pixel_count),                     "No batch is empty",                 pixel_count, bytes_per_pixel, bytes_available, batches);
+		check(batches.buffer_bytes == size_t(batches.batch_size) * bytes_per_pixel,          "Buffer size matches batch size",    pixel_count, bytes_per_pixel, bytes_available, batches);
+		check(batches.batch_size <= Math::round_up(pixel_count, WARP_SIZE),                  "Batch is no larger than the frame", pixel_count, bytes_per_pixel, bytes_available, batches);
+		check(batches.batch_size >= Math::min(BATCH_SIZE_MIN, Math::round_up(pixel_count, WARP_SIZE)), "Batch is at least the minimum", pixel_count, bytes_per_pixel, bytes_available, batches);
+
+		// The budget may only be exceeded to reach the minimum batch size
+		bool within_budget = double(batches.buffer_bytes) <= double(bytes_available) * double(memory_budget) || batches.batch_size <= BATCH_SIZE_MIN;
+		check(within_budget, "Buffers fit in the memory budget", pixel_count, bytes_per_pixel, bytes_available, batches);
+
+		// If the whole frame fits in the budget it should be rendered in a single batch
+		bool frame_fits = double(Math::round_up(pixel_count, WARP_SIZE)) * double(bytes_per_pixel) <= double(bytes_available) * double(memory_budget);
+		check(!frame_fits || batches.batch_count == 1, "Frame that fits is a single batch", pixel_count, bytes_per_pixel, bytes_available, batches);
+	}
+
+	// The old fixed batch size of 1080 * 720 pixels renders a 4K frame in 11 batches
+	Batches batches_4k = calc_fixed(3840 * 2160, Pathtracer::BATCH_BYTES_PER_PIXEL, 1080 * 720);
+	check(batches_4k.batch_count == 11, "Fixed batch size", 3840 * 2160, Pathtracer::BATCH_BYTES_PER_PIXEL, 0, batches_4k);
+
+	return checker.report("Batch size"_sv);
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <stddef.h>
+
+// Rendering is performed in batches (wavefronts) of at most batch_size pixels. The batch size is the capacity of every ray buffer,
+// so larger batches need fewer iterations of the render loop per frame and keep the GPU busier, but also require more memory.
+// The batch size is chosen at runtime as the whole frame if that fits in a fraction of the free Device memory, otherwise as the
+// largest batch that does fit. It is a multiple of the warp size, and never smaller than BATCH_SIZE_MIN
+namespace BatchSize {
+	constexpr int BATCH_SIZE_MIN = 32 * 1024;
+
+	struct Batches {
+		int batch_size;
+		int batch_count; // Number of batches needed to render one frame
+
+		size_t buffer_bytes; // Memory taken up by all ray buffers
+	};
+
+	// bytes_per_pixel is the size of one element summed over all ray buffers that scale with the batch size.
+	// memory_budget is the fraction of bytes_available that the ray buffers are allowed to occupy
+	Batches calc(int pixel_count, size_t bytes_per_pixel, size_t bytes_available, float memory_budget);
+
+	// Batches needed to render a frame with the given fixed batch size
+	Batches calc_fixed(int pixel_count, size_t bytes_per_pixel, int batch_size);
+
+	// Chooses the batch size based on cpu_config, which either fixes it or sets the memory budget
+	Batches choose(int pixel_count, size_t bytes_per_pixel, size_t bytes_available);
+
+	// Prints the batch size, number of batches and ray buffer memory of both Integrators for the given configuration
+	void print_report(int width, int height, size_t bytes_available);
+
+	// Checks that the chosen batches cover the frame, respect the memory budget and are warp aligned
+	bool run_check();
+}
@@ -0,0 +1,367 @@
+#include "GeometryAggregation.h"
+
+#include "Core/IO.h"
+#include "Core/Timer.h"
+#include "Core/Random.h"
+
+#include "Renderer/GeometryCache.h"
+
+#include "Util/ThreadPool.h"
+
+static constexpr size_t BLOCK_SIZE = 4096; // Elements per Work item
+
+// Splits [first, first + count) into blocks and calls func(block_first, block_count) for each, in parallel if possible
+template<typename Func>
+static void for_each_block(size_t first, size_t count, ThreadPool * thread_pool, Func && func) {
+	int block_count = int((count + BLOCK_SIZE - 1) / BLOCK_SIZE);
+
+	auto process_block = [&](int b) {
+		size_t block_first = first + size_t(b) * BLOCK_SIZE;
+		func(block_first, Math::min(BLOCK_SIZE, first + count - block_first));
+	};
+
+	if (thread_pool) {
+		thread_pool->parallel_for(0, block_count, 1, process_block);
+	} else {
+		for (int b = 0; b < block_count; b++) {
+			process_block(b);
+		}
+	}
+}
+
+// Calls func(mesh_data_index, index_in_mesh_data, index_in_range, count) for the part of [first, first + count) that overlaps each MeshData.
+// Elements before the offset of the first MeshData (the TLAS Nodes in the aggregated BVH) are skipped
+template<typename GetSize, typename Func>
+static void for_each_mesh_data_range(const Array<int> & offsets, size_t first, size_t count, GetSize && get_size, Func && func) {
+	int mesh_data_count = int(offsets.size());
+	if (mesh_data_count == 0) return;
+
+	// Binary search for the last MeshData that starts at or before first
+	int lo = 0;
+	int hi = mesh_data_count;
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if (size_t(offsets[mid]) <= first) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	int m = Math::max(lo - 1, 0);
+
+	size_t position = Math::max(first, size_t(offsets[m]));
+	size_t end      = first + count;
+
+	while (position < end && m < mesh_data_count) {
+		size_t mesh_data_first = size_t(offsets[m]);
+		size_t mesh_data_end   = mesh_data_first + get_size(m);
+
+		if (position < mesh_data_end) {
+			size_t n = Math::min(mesh_data_end, end) - position;
+			func(m, position - mesh_data_first, position - first, n);
+			position += n;
+		}
+		m++;
+	}
+}
+
+int GeometryAggregation::calc_triangle_order(const MeshData & mesh_data, int order[], int rank[]) {
+	int triangle_count = int(mesh_data.triangle_count());
+
+	for (int t = 0; t < triangle_count; t++) {
+		rank[t] = INVALID;
+	}
+
+	int unique_count = 0;
+	for (size_t i = 0; i < mesh_data.bvh->indices.size(); i++) {
+		int index = mesh_data.bvh->indices[i];
+		if (rank[index] == INVALID) {
+			rank [index]        = unique_count;
+			order[unique_count] = index;
+			unique_count++;
+		}
+	}
+
+	// Triangles that are not referenced by the BVH still need to be stored, Lights may sample them
+	int stored_count = unique_count;
+	for (int t = 0; t < triangle_count; t++) {
+		if (rank[t] == INVALID) {
+			rank [t]            = stored_count;
+			order[stored_count] = t;
+			stored_count++;
+		}
+	}
+
+	return unique_count;
+}
+
+CUDATriangle GeometryAggregation::convert_triangle(const Triangle & triangle) {
+	CUDATriangle result;
+	result.position_0      = triangle.position_0;
+	result.position_edge_1 = triangle.position_1 - triangle.position_0;
+	result.position_edge_2 = triangle.position_2 - triangle.position_0;
+
+	result.normal_0      = triangle.normal_0;
+	result.normal_edge_1 = triangle.normal_1 - triangle.normal_0;
+	result.normal_edge_2 = triangle.normal_2 - triangle.normal_0;
+
+	result.tex_coord_0      = triangle.tex_coord_0;
+	result.tex_coord_edge_1 = triangle.tex_coord_1 - triangle.tex_coord_0;
+	result.tex_coord_edge_2 = triangle.tex_coord_2 - triangle.tex_coord_0;
+	return result;
+}
+
+// The following convert n elements of a single MeshData, starting at src within the MeshData.
+// Triangles of a MeshData that were moved to a cluster file are read through the ClusterSet, they are already stored in order there
+static void convert_triangles(const MeshData & mesh_data, int mesh_data_index, const int order[], size_t src, size_t n, CUDATriangle triangles[], GeometryStreaming::ClusterSet * clusters) {
+	if (mesh_data.clusters.get()) {
+		ASSERT(clusters);
+		clusters->fill_triangles(mesh_data_index, src, n, triangles);
+		return;
+	}
+
+	for (size_t i = 0; i < n; i++) {
+		triangles[i] = GeometryAggregation::convert_triangle(mesh_data.triangles[order[src + i]]);
+	}
+}
+
+static void convert_triangle_references(const MeshData & mesh_data, const int reverse_indices[], size_t src, size_t n, int references[]) {
+	for (size_t i = 0; i < n; i++) {
+		references[i] = reverse_indices[mesh_data.bvh->indices[src + i]];
+	}
+}
+
+void GeometryAggregation::fill_triangles(
+	const Array<MeshData> & mesh_datas,
+	const Array<int>      & triangle_offsets,
+	const Array<int>      & triangle_order,
+	size_t first, size_t count,
+	CUDATriangle dst[],
+	ThreadPool * thread_pool,
+	GeometryStreaming::ClusterSet * clusters
+) {
+	for_each_block(first, count, thread_pool, [&](size_t block_first, size_t block_count) {
+		for_each_mesh_data_range(triangle_offsets, block_first, block_count, [&](int m) { return mesh_datas[m].triangle_count(); }, [&](int m, size_t src, size_t offset, size_t n) {
+			convert_triangles(mesh_datas[m], m, triangle_order.data() + triangle_offsets[m], src, n, dst + (block_first - first) + offset, clusters);
+		});
+	});
+}
+
+void GeometryAggregation::fill_mesh_data_triangles(const MeshData & mesh_data, int mesh_data_index, const int order[], size_t first, size_t count, CUDATriangle dst[], ThreadPool * thread_pool, GeometryStreaming::ClusterSet * clusters) {
+	for_each_block(first, count, thread_pool, [&](size_t block_first, size_t block_count) {
+		convert_triangles(mesh_data, mesh_data_index, order, block_first, block_count, dst + (block_first - first), clusters);
+	});
+}
+
+void GeometryAggregation::fill_triangle_references(
+	const Array<MeshData> & mesh_datas,
+	const Array<int>      & index_offsets,
+	const Array<int>      & triangle_offsets,
+	const Array<int>      & reverse_indices,
+	size_t first, size_t count,
+	int          dst[],
+	ThreadPool * thread_pool
+) {
+	for_each_block(first, count, thread_pool, [&](size_t block_first, size_t block_count) {
+		for_each_mesh_data_range(index_offsets, block_first, block_count, [&](int m) { return mesh_datas[m].bvh->indices.size(); }, [&](int m, size_t src, size_t offset, size_t n) {
+			convert_triangle_references(mesh_datas[m], reverse_indices.data() + triangle_offsets[m], src, n, dst + (block_first - first) + offset);
+		});
+	});
+}
+
+void GeometryAggregation::fill_mesh_data_triangle_references(const MeshData & mesh_data, const int reverse_indices[], size_t first, size_t count, int dst[], ThreadPool * thread_pool) {
+	for_each_block(first, count, thread_pool, [&](size_t block_first, size_t block_count) {
+		convert_triangle_references(mesh_data, reverse_indices, block_first, block_count, dst + (block_first - first));
+	});
+}
+
+static void relocate(BVHNode2 & node, int bvh_offset, int index_offset) {
+	if (node.is_leaf()) {
+		node.first += index_offset;
+	} else {
+		node.left += bvh_offset;
+	}
+}
+
+static void relocate(BVHNode4 & node, int bvh_offset, int index_offset) {
+	int child_count = node.get_child_count();
+	for (int c = 0; c < child_count; c++) {
+		if (node.is_leaf(c)) {
+			node.get_index(c) += index_offset;
+		} else {
+			node.get_index(c) += bvh_offset;
+		}
+	}
+}
+
+static void relocate(BVHNode8 & node, int bvh_offset, int index_offset) {
+	node.base_index_triangle += index_offset;
+	node.base_index_child    += bvh_offset;
+}
+
+template<typename BVHType, typename Node>
+static void convert_bvh_nodes(const MeshData & mesh_data, int bvh_offset, int index_offset, size_t src, size_t n, Node nodes[]) {
+	const BVHType * bvh = static_cast<const BVHType *>(mesh_data.bvh.get());
+
+	memcpy(nodes, bvh->nodes.data() + src, n * sizeof(Node));
+
+	for (size_t i = 0; i < n; i++) {
+		relocate(nodes[i], bvh_offset, index_offset);
+	}
+}
+
+template<typename BVHType, typename Node>
+static void fill_bvh_nodes_impl(const Array<MeshData> & mesh_datas, const Array<int> & bvh_offsets, const Array<int> & index_offsets, size_t first, size_t count, Node dst[], ThreadPool * thread_pool) {
+	for_each_block(first, count, thread_pool, [&](size_t block_first, size_t block_count) {
+		for_each_mesh_data_range(bvh_offsets, block_first, block_count, [&](int m) { return mesh_datas[m].bvh->node_count(); }, [&](int m, size_t src, size_t offset, size_t n) {
+			convert_bvh_nodes<BVHType>(mesh_datas[m], bvh_offsets[m], index_offsets[m], src, n, dst + (block_first - first) + offset);
+		});
+	});
+}
+
+template<typename BVHType, typename Node>
+static void fill_mesh_data_bvh_nodes_impl(const MeshData & mesh_data, int bvh_offset, int index_offset, size_t first, size_t count, Node dst[], ThreadPool * thread_pool) {
+	for_each_block(first, count, thread_pool, [&](size_t block_first, size_t block_count) {
+		convert_bvh_nodes<BVHType>(mesh_data, bvh_offset, index_offset, block_first, block_count, dst + (block_first - first));
+	});
+}
+
+void GeometryAggregation::fill_bvh_nodes(const Array<MeshData> & mesh_datas, const Array<int> & bvh_offsets, const Array<int> & index_offsets, size_t first, size_t count, BVHNode2 dst[], ThreadPool * thread_pool) {
+	fill_bvh_nodes_impl<BVH2>(mesh_datas, bvh_offsets, index_offsets, first, count, dst, thread_pool);
+}
+
+void GeometryAggregation::fill_bvh_nodes(const Array<MeshData> & mesh_datas, const Array<int> & bvh_offsets, const Array<int> & index_offsets, size_t first, size_t count, BVHNode4 dst[], ThreadPool * thread_pool) {
+	fill_bvh_nodes_impl<BVH4>(mesh_datas, bvh_offsets, index_offsets, first, count, dst, thread_pool);
+}
+
+void GeometryAggregation::fill_bvh_nodes(const Array<MeshData> & mesh_datas, const Array<int> & bvh_offsets, const Array<int> & index_offsets, size_t first, size_t count, BVHNode8 dst[], ThreadPool * thread_pool) {
+	fill_bvh_nodes_impl<BVH8>(mesh_datas, bvh_offsets, index_offsets, first, count, dst, thread_pool);
+}
+
+void GeometryAggregation::fill_mesh_data_bvh_nodes(const MeshData & mesh_data, int bvh_offset, int index_offset, size_t first, size_t count, BVHNode2 dst[], ThreadPool * thread_pool) {
+	fill_mesh_data_bvh_nodes_impl<BVH2>(mesh_data, bvh_offset, index_offset, first, count, dst, thread_pool);
+}
+
+void GeometryAggregation::fill_mesh_data_bvh_nodes(const MeshData & mesh_data, int bvh_offset, int index_offset, size_t first, size_t count, BVHNode4 dst[], ThreadPool * thread_pool) {
+	fill_mesh_data_bvh_nodes_impl<BVH4>(mesh_data, bvh_offset, index_offset, first, count, dst, thread_pool);
+}
+
+void GeometryAggregation::fill_mesh_data_bvh_nodes(const MeshData & mesh_data, int bvh_offset, int index_offset, size_t first, size_t count, BVHNode8 dst[], ThreadPool * thread_pool) {
+	fill_mesh_data_bvh_nodes_impl<BVH8>(mesh_data, bvh_offset, index_offset, first, count, dst, thread_pool);
+}
+
+void GeometryAggregation::run_benchmark() {
+	constexpr int    MESH_DATA_COUNT = 1000;
+	constexpr int    MAX_TRIANGLES   = 4000;
+	constexpr size_t TLAS_NODE_COUNT = 2 * MESH_DATA_COUNT;
+	constexpr size_t CHUNK_SIZE      = MEGABYTES(16);
+
+	RNG rng(1337);
+
+	// Synthetic MeshDatas of varying size. Only the layout matters for the benchmark, so the BVHs are not built
+	// but filled with alternating leaves and internal Nodes, and the indices are a random permutation
+	Array<MeshData> mesh_datas(MESH_DATA_COUNT);
+
+	Array<int> bvh_offsets     (MESH_DATA_COUNT);
+	Array<int> triangle_offsets(MESH_DATA_COUNT);
+	Array<int> index_offsets   (MESH_DATA_COUNT);
+
+	size_t bvh_node_count = TLAS_NODE_COUNT;
+	size_t triangle_count = 0;
+
+	for (int m = 0; m < MESH_DATA_COUNT; m++) {
+		int mesh_triangle_count = 1 + rng.get_uint32(MAX_TRIANGLES);
+
+		MeshData & mesh_data = mesh_datas[m];
+		mesh_data.triangles.resize(mesh_triangle_count);
+
+		for (int t = 0; t < mesh_triangle_count; t++) {
+			Triangle & triangle = mesh_data.triangles[t];
+			triangle.position_0 = Vector3(float(t), float(m), 0.0f);
+			triangle.position_1 = triangle.position_0 + Vector3(1.0f, 0.0f, 0.0f);
+			triangle.position_2 = triangle.position_0 + Vector3(0.0f, 1.0f, 0.0f);
+			triangle.normal_0 = triangle.normal_1 = triangle.normal_2 = Vector3(0.0f, 0.0f, 1.0f);
+		}
+
+		OwnPtr<BVH2> bvh = make_owned<BVH2>();
+		bvh->indices.resize(mesh_triangle_count);
+		for (int t = 0; t < mesh_triangle_count; t++) {
+			bvh->indices[t] = t;
+		}
+		for (int t = mesh_triangle_count - 1; t > 0; t--) {
+			Util::swap(bvh->indices[t], bvh->indices[rng.get_uint32(t + 1)]);
+		}
+
+		bvh->nodes.resize(2 * mesh_triangle_count - 1);
+		for (size_t n = 0; n < bvh->nodes.size(); n++) {
+			BVHNode2 & node = bvh->nodes[n];
+			node.aabb  = AABB::create_empty();
+			node.left  = int(n / 2);
+			node.count = n & 1;
+			node.axis  = 0;
+		}
+
+		bvh_offsets     [m] = int(bvh_node_count);
+		triangle_offsets[m] = int(triangle_count);
+		index_offsets   [m] = int(triangle_count);
+
+		bvh_node_count += bvh->nodes.size();
+		triangle_count += mesh_triangle_count;
+
+		mesh_data.bvh = std::move(bvh);
+	}
+
+	size_t bytes = triangle_count * sizeof(CUDATriangle) + bvh_node_count * sizeof(BVHNode2);
+	IO::print("{} MeshDatas, {} triangles, {} BVH Nodes, {} MB of aggregated geometry\n"_sv, MESH_DATA_COUNT, triangle_count, bvh_node_count, bytes / MEGABYTES(1));
+
+	Array<int> triangle_order (triangle_count);
+	Array<int> reverse_indices(triangle_count);
+	{
+		ScopeTimer timer("Triangle order"_sv);
+		for (int m = 0; m < MESH_DATA_COUNT; m++) {
+			int * rank = reverse_indices.data() + triangle_offsets[m];
+			calc_triangle_order(mesh_datas[m], triangle_order.data() + triangle_offsets[m], rank);
+
+			for (size_t t = 0; t < mesh_datas[m].triangles.size(); t++) {
+				rank[t] += triangle_offsets[m];
+			}
+		}
+	}
+
+	// Previous approach: the full aggregated arrays on the host, filled on a single thread
+	{
+		Array<CUDATriangle> triangles(triangle_count);
+		Array<BVHNode2>     nodes    (bvh_node_count);
+
+		ScopeTimer timer("Full arrays, serial"_sv);
+		fill_triangles(mesh_datas, triangle_offsets, triangle_order, 0, triangle_count, triangles.data(), nullptr);
+		fill_bvh_nodes(mesh_datas, bvh_offsets, index_offsets, TLAS_NODE_COUNT, bvh_node_count - TLAS_NODE_COUNT, nodes.data() + TLAS_NODE_COUNT, nullptr);
+	}
+
+	// Full arrays filled in parallel, this is the throughput limit of the fill itself
+	ThreadPool & thread_pool = ThreadPool::get_shared();
+	{
+		Array<CUDATriangle> triangles(triangle_count);
+		Array<BVHNode2>     nodes    (bvh_node_count);
+
+		ScopeTimer timer("Full arrays, parallel"_sv);
+		fill_triangles(mesh_datas, triangle_offsets, triangle_order, 0, triangle_count, triangles.data(), &thread_pool);
+		fill_bvh_nodes(mesh_datas, bvh_offsets, index_offsets, TLAS_NODE_COUNT, bvh_node_count - TLAS_NODE_COUNT, nodes.data() + TLAS_NODE_COUNT, &thread_pool);
+	}
+
+	// Staging sized chunks filled in parallel, the way Integrator::init_geometry streams the geometry to the GPU
+	{
+		Array<CUDATriangle> staging_triangles(CHUNK_SIZE / sizeof(CUDATriangle));
+		Array<BVHNode2>     staging_nodes    (CHUNK_SIZE / sizeof(BVHNode2));
+
+		ScopeTimer timer("Staging chunks, parallel"_sv);
+		for (size_t first = 0; first < triangle_count; first += staging_triangles.size()) {
+			size_t count = Math::min(staging_triangles.size(), triangle_count - first);
+			fill_triangles(mesh_datas, triangle_offsets, triangle_order, first, count, staging_triangles.data(), &thread_pool);
+		}
+		for (size_t first = TLAS_NODE_COUNT; first < bvh_node_count; first += staging_nodes.size()) {
+			size_t count = Math::min(staging_nodes.size(), bvh_node_count - first);
+			fill_bvh_nodes(mesh_datas, bvh_offsets, index_offsets, first, count, staging_nodes.data(), &thread_pool);
+		}
+	}
+}
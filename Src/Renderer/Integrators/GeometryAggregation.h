@@ -0,0 +1,88 @@
+#pragma once
+#include "Core/Array.h"
+
+#include "Math/Vector2.h"
+#include "Math/Vector3.h"
+
+#include "BVH/BVH.h"
+
+#include "Renderer/MeshData.h"
+
+struct ThreadPool;
+
+namespace GeometryStreaming { struct ClusterSet; }
+
+// Layout of a triangle on the GPU, every attribute is stored as the value at the first vertex and two edges
+struct CUDATriangle {
+	Vector3 position_0;
+	Vector3 position_edge_1;
+	Vector3 position_edge_2;
+
+	Vector3 normal_0;
+	Vector3 normal_edge_1;
+	Vector3 normal_edge_2;
+
+	Vector2 tex_coord_0;
+	Vector2 tex_coord_edge_1;
+	Vector2 tex_coord_edge_2;
+};
+
+// Gathers the geometry of all MeshDatas into the aggregated arrays that are uploaded to the GPU.
+// Every MeshData occupies a contiguous range of each aggregated array, starting at its offset (see Integrator::init_geometry).
+// The fill functions produce an arbitrary range [first, first + count) of an aggregated array directly into dst,
+// so that the arrays can be streamed through small staging buffers instead of being built on the host in full.
+// The range is split into blocks that are processed in parallel if a ThreadPool is provided.
+//
+// Every triangle is stored on the GPU exactly once, even if the BVH references it multiple times (spatial splits in the SBVH).
+// BVH leaves then index a list of 4 byte references into the deduplicated triangle array.
+// Triangles are stored in the order in which the BVH first references them, so that without duplicates the references are the identity
+namespace GeometryAggregation {
+	// Order in which the triangles of the MeshData are stored on the GPU, unreferenced triangles go last.
+	// order[i] is the original index of the i-th stored triangle and rank[t] the position at which original triangle t is stored.
+	// Returns the number of distinct triangles referenced by the BVH, equal to the number of references if there are no duplicates
+	int calc_triangle_order(const MeshData & mesh_data, int order[], int rank[]);
+
+	CUDATriangle convert_triangle(const Triangle & triangle);
+
+	// Deduplicated triangles, triangle_order holds the concatenated orders of all MeshDatas (offset by triangle_offsets).
+	// MeshDatas whose triangles were moved to a cluster file are read through clusters, which then has to cover them (see Renderer/GeometryCache.h)
+	void fill_triangles(
+		const Array<MeshData> & mesh_datas,
+		const Array<int>      & triangle_offsets,
+		const Array<int>      & triangle_order,
+		size_t first, size_t count,
+		CUDATriangle dst[],
+		ThreadPool * thread_pool,
+		GeometryStreaming::ClusterSet * clusters = nullptr
+	);
+
+	// References in BVH order, reverse_indices[triangle_offset + original index] is the aggregated index of a stored triangle
+	void fill_triangle_references(
+		const Array<MeshData> & mesh_datas,
+		const Array<int>      & index_offsets,
+		const Array<int>      & triangle_offsets,
+		const Array<int>      & reverse_indices,
+		size_t first, size_t count,
+		int          dst[],
+		ThreadPool * thread_pool
+	);
+
+	// BVH Nodes, with their child and triangle indices relocated into the aggregated arrays
+	void fill_bvh_nodes(const Array<MeshData> & mesh_datas, const Array<int> & bvh_offsets, const Array<int> & index_offsets, size_t first, size_t count, BVHNode2 dst[], ThreadPool * thread_pool);
+	void fill_bvh_nodes(const Array<MeshData> & mesh_datas, const Array<int> & bvh_offsets, const Array<int> & index_offsets, size_t first, size_t count, BVHNode4 dst[], ThreadPool * thread_pool);
+	void fill_bvh_nodes(const Array<MeshData> & mesh_datas, const Array<int> & bvh_offsets, const Array<int> & index_offsets, size_t first, size_t count, BVHNode8 dst[], ThreadPool * thread_pool);
+
+	// The same for the range of a single MeshData, used to append a MeshData that finished loading to existing aggregated arrays
+	// (see Integrator::append_mesh_data). Here first and count are relative to the start of the MeshData, and order and reverse_indices
+	// point to the part of triangle_order and reverse_indices that belongs to the MeshData
+	void fill_mesh_data_triangles          (const MeshData & mesh_data, int mesh_data_index, const int order[], size_t first, size_t count, CUDATriangle dst[], ThreadPool * thread_pool, GeometryStreaming::ClusterSet * clusters = nullptr);
+	void fill_mesh_data_triangle_references(const MeshData & mesh_data, const int reverse_indices[],          size_t first, size_t count, int          dst[], ThreadPool * thread_pool);
+
+	void fill_mesh_data_bvh_nodes(const MeshData & mesh_data, int bvh_offset, int index_offset, size_t first, size_t count, BVHNode2 dst[], ThreadPool * thread_pool);
+	void fill_mesh_data_bvh_nodes(const MeshData & mesh_data, int bvh_offset, int index_offset, size_t first, size_t count, BVHNode4 dst[], ThreadPool * thread_pool);
+	void fill_mesh_data_bvh_nodes(const MeshData & mesh_data, int bvh_offset, int index_offset, size_t first, size_t count, BVHNode8 dst[], ThreadPool * thread_pool);
+
+	// Benchmarks the host side of the aggregation on synthetic MeshDatas, writing into host buffers.
+	// Compares filling the full arrays serially against filling staging sized chunks on the ThreadPool
+	void run_benchmark();
+}
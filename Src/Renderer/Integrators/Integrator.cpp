@@ -7,9 +7,42 @@
 #include "BVH/Converters/BVH4Converter.h"
 #include "BVH/Converters/BVH8Converter.h"
 
+#include "Core/Log.h"
 #include "Core/Allocators/PinnedAllocator.h"
 
+#include "Renderer/Integrators/BatchSize.h"
+
 #include "Util/BlueNoise.h"
+#include "Util/ThreadPool.h"
+
+bool Integrator::calc_batch_size(size_t bytes_per_pixel) {
+	// Memory cached by the pool can be reused for the ray buffers as well
+	MemoryPool::Stats pool_stats = CUDAMemory::get_pool_stats();
+
+	size_t bytes_available = CUDAContext::get_available_memory() + pool_stats.bytes_free + pool_stats.bytes_deferred + size_t(batch_size) * bytes_per_pixel;
+
+	BatchSize::Batches batches = BatchSize::choose(pixel_count, bytes_per_pixel, bytes_available);
+	if (batches.batch_size == batch_size) return false;
+
+	IO::print("Batch size: {} pixels ({} batches per frame), ray buffers take up {} MB\n"_sv, batches.batch_size, batches.batch_count, batches.buffer_bytes >> 20);
+
+	batch_size = batches.batch_size;
+	cuda_module.get_global("batch_size").set_value(batch_size);
+
+	return true;
+}
+
+void Integrator::cuda_reload() {
+	// Kernels from the old Module may still be running
+	CUDACALL(cuCtxSynchronize());
+
+	cuda_module.reload();
+
+	init_kernels();
+	resize_kernels();
+
+	invalidated_gpu_config = true; // Restarts accumulation
+}
 
 void Integrator::init_globals() {
 	global_camera      = cuda_module.get_global("camera");
@@ -24,7 +57,10 @@ void Integrator::init_materials() {
 	cuda_module.get_global("material_types").set_value(ptr_material_types);
 	cuda_module.get_global("materials")     .set_value(ptr_materials);
 
-	scene.asset_manager.wait_until_loaded();
+	// With progressive loading the Integrator starts out with placeholders, the actual assets are patched in by update_assets()
+	if (!cpu_config.enable_progressive_loading) {
+		scene.asset_manager.wait_until_loaded();
+	}
 
 	ptr_media = CUDAMemory::malloc<CUDAMedium>(scene.asset_manager.media.size());
 	cuda_module.get_global("media").set_value(ptr_media);
@@ -35,62 +71,8 @@ void Integrator::init_materials() {
 		textures      .resize(texture_count);
 		texture_arrays.resize(texture_count);
 
-		// Get maximum anisotropy from OpenGL
-		int max_aniso;
-		glGetIntegerv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &max_aniso);
-
 		for (int i = 0; i < texture_count; i++) {
-			const Texture & texture = scene.asset_manager.textures[i];
-
-			// Create mipmapped CUDA array
-			texture_arrays[i] = CUDAMemory::create_array_mipmap(
-				texture.width,
-				texture.height,
-				texture.channels,
-				texture.get_cuda_array_format(),
-				texture.mip_levels()
-			);
-
-			// Upload each level of the mipmap
-			for (int level = 0; level < texture.mip_levels(); level++) {
-				CUarray level_array;
-				CUDACALL(cuMipmappedArrayGetLevel(&level_array, texture_arrays[i], level));
-
-				int level_width_in_bytes = texture.get_width_in_bytes(level);
-				int level_height         = Math::max(texture.height >> level, 1);
-
-				CUDAMemory::copy_array(level_array, level_width_in_bytes, level_height, texture.data.data() + texture.mip_offsets[level]);
-			}
-
-			// Describe the Array to read from
-			CUDA_RESOURCE_DESC res_desc = { };
-			res_desc.resType = CUresourcetype::CU_RESOURCE_TYPE_MIPMAPPED_ARRAY;
-			res_desc.res.mipmap.hMipmappedArray = texture_arrays[i];
-
-			// Describe how to sample the Texture
-			CUDA_TEXTURE_DESC tex_desc = { };
-			tex_desc.addressMode[0] = CUaddress_mode::CU_TR_ADDRESS_MODE_WRAP;
-			tex_desc.addressMode[1] = CUaddress_mode::CU_TR_ADDRESS_MODE_WRAP;
-			tex_desc.addressMode[2] = CUaddress_mode::CU_TR_ADDRESS_MODE_CLAMP;
-			tex_desc.filterMode       = CUfilter_mode::CU_TR_FILTER_MODE_LINEAR;
-			tex_desc.mipmapFilterMode = CUfilter_mode::CU_TR_FILTER_MODE_LINEAR;
-			tex_desc.mipmapLevelBias = 0.0f;
-			tex_desc.maxAnisotropy = max_aniso;
-			tex_desc.minMipmapLevelClamp = 0.0f;
-			tex_desc.maxMipmapLevelClamp = float(texture.mip_levels() - 1);
-			tex_desc.flags = CU_TRSF_NORMALIZED_COORDINATES;
-
-			// Describe the Texture View
-			CUDA_RESOURCE_VIEW_DESC view_desc = { };
-			view_desc.format = texture.get_cuda_resource_view_format();
-			view_desc.width  = texture.get_cuda_resource_view_width();
-			view_desc.height = texture.get_cuda_resource_view_height();
-			view_desc.firstMipmapLevel = 0;
-			view_desc.lastMipmapLevel  = texture.mip_levels() - 1;
-
-			CUDACALL(cuTexObjectCreate(&textures[i].texture, &res_desc, &tex_desc, &view_desc));
-
-			textures[i].lod_bias = 0.5f * log2f(float(texture.width * texture.height));
+			init_texture(i);
 		}
 
 		ptr_textures = CUDAMemory::malloc(textures);
@@ -98,69 +80,169 @@ void Integrator::init_materials() {
 	}
 }
 
-void Integrator::init_geometry() {
-	for (size_t i = 0; i < scene.meshes.size(); i++) {
-		scene.meshes[i].calc_aabb(scene);
+void Integrator::init_texture(int texture_index) {
+	const Texture & texture = scene.asset_manager.textures[texture_index];
+
+	// Get maximum anisotropy from OpenGL
+	int max_aniso;
+	glGetIntegerv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &max_aniso);
+
+	// Create mipmapped CUDA array
+	texture_arrays[texture_index] = CUDAMemory::create_array_mipmap(
+		texture.width,
+		texture.height,
+		texture.channels,
+		texture.get_cuda_array_format(),
+		texture.mip_levels()
+	);
+
+	// Upload each level of the mipmap
+	for (int level = 0; level < texture.mip_levels(); level++) {
+		CUarray level_array;
+		CUDACALL(cuMipmappedArrayGetLevel(&level_array, texture_arrays[texture_index], level));
+
+		int level_width_in_bytes = texture.get_width_in_bytes(level);
+		int level_height         = Math::max(texture.height >> level, 1);
+
+		CUDAMemory::copy_array(level_array, level_width_in_bytes, level_height, texture.data.data() + texture.mip_offsets[level]);
 	}
 
+	// Describe the Array to read from
+	CUDA_RESOURCE_DESC res_desc = { };
+	res_desc.resType = CUresourcetype::CU_RESOURCE_TYPE_MIPMAPPED_ARRAY;
+	res_desc.res.mipmap.hMipmappedArray = texture_arrays[texture_index];
+
+	// Describe how to sample the Texture
+	CUDA_TEXTURE_DESC tex_desc = { };
+	tex_desc.addressMode[0] = CUaddress_mode::CU_TR_ADDRESS_MODE_WRAP;
+	tex_desc.addressMode[1] = CUaddress_mode::CU_TR_ADDRESS_MODE_WRAP;
+	tex_desc.addressMode[2] = CUaddress_mode::CU_TR_ADDRESS_MODE_CLAMP;
+	tex_desc.filterMode       = CUfilter_mode::CU_TR_FILTER_MODE_LINEAR;
+	tex_desc.mipmapFilterMode = CUfilter_mode::CU_TR_FILTER_MODE_LINEAR;
+	tex_desc.mipmapLevelBias = 0.0f;
+	tex_desc.maxAnisotropy = max_aniso;
+	tex_desc.minMipmapLevelClamp = 0.0f;
+	tex_desc.maxMipmapLevelClamp = float(texture.mip_levels() - 1);
+	tex_desc.flags = CU_TRSF_NORMALIZED_COORDINATES;
+
+	// Describe the Texture View
+	CUDA_RESOURCE_VIEW_DESC view_desc = { };
+	view_desc.format = texture.get_cuda_resource_view_format();
+	view_desc.width  = texture.get_cuda_resource_view_width();
+	view_desc.height = texture.get_cuda_resource_view_height();
+	view_desc.firstMipmapLevel = 0;
+	view_desc.lastMipmapLevel  = texture.mip_levels() - 1;
+
+	CUDACALL(cuTexObjectCreate(&textures[texture_index].texture, &res_desc, &tex_desc, &view_desc));
+
+	textures[texture_index].lod_bias = 0.5f * log2f(float(texture.width * texture.height));
+}
+
+void Integrator::init_geometry() {
 	size_t mesh_data_count = scene.asset_manager.mesh_datas.size();
 
 	mesh_data_bvh_offsets     .resize(mesh_data_count);
 	mesh_data_triangle_offsets.resize(mesh_data_count);
+	mesh_data_index_offsets   .resize(mesh_data_count);
 
-	Array<int> mesh_data_index_offsets(mesh_data_count);
-
-	size_t aggregated_bvh_node_count = 2 * scene.meshes.size(); // Reserve 2 times Mesh count for TLAS
-	size_t aggregated_triangle_count = 0;
-	size_t aggregated_index_count    = 0;
+	aggregated_bvh_node_count = 2 * scene.meshes.size(); // Reserve 2 times Mesh count for TLAS
+	aggregated_triangle_count = 0;
+	aggregated_index_count    = 0;
 
+	// Offsets of every MeshData into the aggregated arrays (exclusive prefix sum over their sizes)
 	for (size_t i = 0; i < mesh_data_count; i++) {
 		mesh_data_bvh_offsets     [i] = aggregated_bvh_node_count;
 		mesh_data_triangle_offsets[i] = aggregated_triangle_count;
 		mesh_data_index_offsets   [i] = aggregated_index_count;
 
 		aggregated_bvh_node_count += scene.asset_manager.mesh_datas[i].bvh->node_count();
-		aggregated_triangle_count += scene.asset_manager.mesh_datas[i].triangles.size();
-		aggregated_index_count    += scene.asset_manager.mesh_datas[i].bvh->indices.size();;
+		aggregated_triangle_count += scene.asset_manager.mesh_datas[i].triangle_count();
+		aggregated_index_count    += scene.asset_manager.mesh_datas[i].bvh->indices.size();
 	}
 
-	Array<CUDATriangle> aggregated_triangles(aggregated_index_count);
+	aggregated_bvh_node_capacity = aggregated_bvh_node_count;
+	aggregated_triangle_capacity = aggregated_triangle_count;
+	aggregated_index_capacity    = aggregated_index_count;
+
+	// The aggregated arrays are never built on the Host, every chunk is filled in parallel directly into pinned staging memory
+	// and its upload overlaps with filling the next chunk
+	const Array<MeshData> & mesh_datas = scene.asset_manager.mesh_datas;
+
+	// Every triangle is stored once, in the order in which its BVH first references it
+	triangle_order .resize(aggregated_triangle_count);
 	reverse_indices.resize(aggregated_triangle_count);
 
-	for (int m = 0; m < mesh_data_count; m++) {
-		const MeshData & mesh_data = scene.asset_manager.mesh_datas[m];
+	Array<int> unique_triangle_counts(mesh_data_count);
+
+	thread_pool.parallel_for(0, int(mesh_data_count), 1, [&](int m) {
+		int   triangle_offset = mesh_data_triangle_offsets[m];
+		int * rank            = reverse_indices.data() + triangle_offset;
 
-		for (size_t i = 0; i < mesh_data.bvh->indices.size(); i++) {
-			int index = mesh_data.bvh->indices[i];
-			const Triangle & triangle = mesh_data.triangles[index];
+		unique_triangle_counts[m] = GeometryAggregation::calc_triangle_order(mesh_datas[m], triangle_order.data() + triangle_offset, rank);
 
-			aggregated_triangles[mesh_data_index_offsets[m] + i].position_0      = triangle.position_0;
-			aggregated_triangles[mesh_data_index_offsets[m] + i].position_edge_1 = triangle.position_1 - triangle.position_0;
-			aggregated_triangles[mesh_data_index_offsets[m] + i].position_edge_2 = triangle.position_2 - triangle.position_0;
+		for (size_t t = 0; t < mesh_datas[m].triangle_count(); t++) {
+			rank[t] += triangle_offset;
+		}
+	});
 
-			aggregated_triangles[mesh_data_index_offsets[m] + i].normal_0      = triangle.normal_0;
-			aggregated_triangles[mesh_data_index_offsets[m] + i].normal_edge_1 = triangle.normal_1 - triangle.normal_0;
-			aggregated_triangles[mesh_data_index_offsets[m] + i].normal_edge_2 = triangle.normal_2 - triangle.normal_0;
+	// BVH leaves only need to go through references if some BVH does not reference each of its triangles exactly once
+	bool   needs_triangle_references = false;
+	size_t triangle_bytes_saved      = 0;
 
-			aggregated_triangles[mesh_data_index_offsets[m] + i].tex_coord_0      = triangle.tex_coord_0;
-			aggregated_triangles[mesh_data_index_offsets[m] + i].tex_coord_edge_1 = triangle.tex_coord_1 - triangle.tex_coord_0;
-			aggregated_triangles[mesh_data_index_offsets[m] + i].tex_coord_edge_2 = triangle.tex_coord_2 - triangle.tex_coord_0;
+	for (size_t m = 0; m < mesh_data_count; m++) {
+		size_t triangle_count  = mesh_datas[m].triangle_count();
+		size_t reference_count = mesh_datas[m].bvh->indices.size();
+		size_t unique_count    = unique_triangle_counts[m];
 
-			reverse_indices[mesh_data_triangle_offsets[m] + index] = mesh_data_index_offsets[m] + i;
+		if (unique_count != reference_count || reference_count != triangle_count) {
+			needs_triangle_references = true;
 		}
+
+		if (unique_count < reference_count) {
+			size_t bytes_saved = (reference_count - unique_count) * sizeof(CUDATriangle);
+			triangle_bytes_saved += bytes_saved;
+
+			Log::info(Log::Category::BVH, "MeshData {}: {} references to {} triangles, deduplication saves {} KB of triangles for {} KB of references\n"_sv,
+				m, reference_count, unique_count, bytes_saved / KILOBYTES(1), reference_count * sizeof(int) / KILOBYTES(1));
+		}
+	}
+
+	if (triangle_bytes_saved > 0) {
+		Log::info(Log::Category::BVH, "Triangle deduplication saves {} KB in total, references take up {} KB\n"_sv, triangle_bytes_saved / KILOBYTES(1), aggregated_index_count * sizeof(int) / KILOBYTES(1));
 	}
 
-	ptr_triangles = CUDAMemory::malloc(aggregated_triangles);
+	// Triangles that were moved to cluster files are read back through a GeometryCache. Fills that need a cluster
+	// which is still queued for prefetching load it themselves, so the fill can share the ThreadPool with the prefetches
+	OwnPtr<GeometryStreaming::ClusterSet> clusters = init_cluster_set(0, int(mesh_data_count));
+
+	ptr_triangles = CUDAMemory::malloc<CUDATriangle>(aggregated_triangle_count);
+	CUDAMemory::upload_staged(ptr_triangles, aggregated_triangle_count, memory_stream, [&](size_t first, size_t count, CUDATriangle * dst) {
+		GeometryAggregation::fill_triangles(mesh_datas, mesh_data_triangle_offsets, triangle_order, first, count, dst, &thread_pool, clusters.get());
+	});
 	cuda_module.get_global("triangles").set_value(ptr_triangles);
 
-	pinned_mesh_bvh_root_indices             = CUDAMemory::malloc_pinned<int>      (scene.meshes.size());
-	pinned_mesh_material_ids                 = CUDAMemory::malloc_pinned<int>      (scene.meshes.size());
-	pinned_mesh_transforms                   = CUDAMemory::malloc_pinned<Matrix3x4>(scene.meshes.size());
-	pinned_mesh_transforms_inv               = CUDAMemory::malloc_pinned<Matrix3x4>(scene.meshes.size());
-	pinned_mesh_transforms_prev              = CUDAMemory::malloc_pinned<Matrix3x4>(scene.meshes.size());
-	pinned_light_mesh_cumulative_probability = CUDAMemory::malloc_pinned<float>    (scene.meshes.size());
-	pinned_light_mesh_triangle_span          = CUDAMemory::malloc_pinned<int2>     (scene.meshes.size());
-	pinned_light_mesh_transform_indices      = CUDAMemory::malloc_pinned<int>      (scene.meshes.size());
+	if (clusters) {
+		clusters->cache->print_stats();
+	}
+
+	if (needs_triangle_references) {
+		ptr_triangle_references = CUDAMemory::malloc<int>(aggregated_index_count);
+		CUDAMemory::upload_staged(ptr_triangle_references, aggregated_index_count, memory_stream, [&](size_t first, size_t count, int * dst) {
+			GeometryAggregation::fill_triangle_references(mesh_datas, mesh_data_index_offsets, mesh_data_triangle_offsets, reverse_indices, first, count, dst, &thread_pool);
+		});
+	}
+	cuda_module.get_global("triangle_references").set_value(ptr_triangle_references);
+
+	pinned_mesh_bvh_root_indices        = CUDAMemory::malloc_pinned<int>         (scene.meshes.size());
+	pinned_mesh_material_ids            = CUDAMemory::malloc_pinned<int>         (scene.meshes.size());
+	pinned_mesh_transforms              = CUDAMemory::malloc_pinned<Matrix3x4>   (scene.meshes.size());
+	pinned_mesh_transforms_inv          = CUDAMemory::malloc_pinned<Matrix3x4>   (scene.meshes.size());
+	pinned_mesh_transforms_prev         = CUDAMemory::malloc_pinned<Matrix3x4>   (scene.meshes.size());
+	pinned_light_mesh_alias_table       = CUDAMemory::malloc_pinned<AliasEntry>  (scene.meshes.size());
+	pinned_light_mesh_triangle_span     = CUDAMemory::malloc_pinned<int2>        (scene.meshes.size());
+	pinned_light_mesh_transform_indices = CUDAMemory::malloc_pinned<int>         (scene.meshes.size());
+	pinned_light_mesh_bvh_nodes         = CUDAMemory::malloc_pinned<LightBVHNode>(2 * scene.meshes.size());
+	pinned_light_mesh_bvh_leaves        = CUDAMemory::malloc_pinned<int>         (scene.meshes.size());
 
 	ptr_mesh_bvh_root_indices = CUDAMemory::malloc<int>      (scene.meshes.size());
 	ptr_mesh_material_ids     = CUDAMemory::malloc<int>      (scene.meshes.size());
@@ -178,35 +260,21 @@ void Integrator::init_geometry() {
 	tlas_raw.nodes  .resize(scene.meshes.size() * 2);
 	tlas_builder = make_owned<SAHBuilder>(tlas_raw, scene.meshes.size());
 
+	// Each individual BVH puts its Nodes in a shared aggregated array of BVH Nodes, with child and triangle indices relocated.
+	// The Nodes reserved for the TLAS are skipped, they are uploaded every frame by build_tlas
+	auto upload_bvh_nodes = [&](auto ptr_bvh_nodes) {
+		size_t tlas_node_count = 2 * scene.meshes.size();
+
+		CUDAMemory::upload_staged(CUDAMemory::offset(ptr_bvh_nodes, tlas_node_count), aggregated_bvh_node_count - tlas_node_count, memory_stream, [&](size_t first, size_t count, auto * dst) {
+			GeometryAggregation::fill_bvh_nodes(mesh_datas, mesh_data_bvh_offsets, mesh_data_index_offsets, tlas_node_count + first, count, dst, &thread_pool);
+		});
+	};
+
 	switch (cpu_config.bvh_type) {
 		case BVHType::BVH:
 		case BVHType::SBVH: {
-			Array<BVHNode2> aggregated_bvh_nodes(aggregated_bvh_node_count);
-
-			// Each individual BVH needs to put its Nodes in a shared aggregated array of BVH Nodes before being upload to the GPU
-			// The procedure to do this is different for each BVH type
-			for (int m = 0; m < mesh_data_count; m++) {
-				const MeshData & mesh_data = scene.asset_manager.mesh_datas[m];
-				const BVH2 * bvh = static_cast<const BVH2 *>(mesh_data.bvh.get());
-
-				int index_offset = mesh_data_index_offsets[m];
-				int bvh_offset   = mesh_data_bvh_offsets[m];
-
-				BVHNode2 * dst = aggregated_bvh_nodes.data() + bvh_offset;
-
-				for (size_t n = 0; n < bvh->nodes.size(); n++) {
-					BVHNode2 & node = dst[n];
-					node = bvh->nodes[n];
-
-					if (node.is_leaf()) {
-						node.first += index_offset;
-					} else {
-						node.left += bvh_offset;
-					}
-				}
-			}
-
-			ptr_bvh_nodes_2 = CUDAMemory::malloc<BVHNode2>(aggregated_bvh_nodes);
+			ptr_bvh_nodes_2 = CUDAMemory::malloc<BVHNode2>(aggregated_bvh_node_count);
+			upload_bvh_nodes(ptr_bvh_nodes_2);
 			cuda_module.get_global("bvh_nodes").set_value(ptr_bvh_nodes_2);
 
 			tlas           = make_owned<BVH2>(PinnedAllocator::instance());
@@ -214,35 +282,8 @@ void Integrator::init_geometry() {
 			break;
 		}
 		case BVHType::BVH4: {
-			Array<BVHNode4> aggregated_bvh_nodes(aggregated_bvh_node_count);
-
-			// Each individual BVH needs to put its Nodes in a shared aggregated array of BVH Nodes before being upload to the GPU
-			// The procedure to do this is different for each BVH type
-			for (int m = 0; m < mesh_data_count; m++) {
-				const MeshData & mesh_data = scene.asset_manager.mesh_datas[m];
-				const BVH4 * bvh = static_cast<const BVH4 *>(mesh_data.bvh.get());
-
-				int index_offset = mesh_data_index_offsets[m];
-				int bvh_offset   = mesh_data_bvh_offsets[m];
-
-				BVHNode4 * dst = aggregated_bvh_nodes.data() + bvh_offset;
-
-				for (size_t n = 0; n < bvh->nodes.size(); n++) {
-					BVHNode4 & node = dst[n];
-					node = bvh->nodes[n];
-
-					int child_count = node.get_child_count();
-					for (int c = 0; c < child_count; c++) {
-						if (node.is_leaf(c)) {
-							node.get_index(c) += index_offset;
-						} else {
-							node.get_index(c) += bvh_offset;
-						}
-					}
-				}
-			}
-
-			ptr_bvh_nodes_4 = CUDAMemory::malloc<BVHNode4>(aggregated_bvh_nodes);
+			ptr_bvh_nodes_4 = CUDAMemory::malloc<BVHNode4>(aggregated_bvh_node_count);
+			upload_bvh_nodes(ptr_bvh_nodes_4);
 			cuda_module.get_global("bvh4_nodes").set_value(ptr_bvh_nodes_4);
 
 			tlas           = make_owned<BVH4>(PinnedAllocator::instance());
@@ -250,36 +291,127 @@ void Integrator::init_geometry() {
 			break;
 		}
 		case BVHType::BVH8: {
-			Array<BVHNode8> aggregated_bvh_nodes(aggregated_bvh_node_count);
+			ptr_bvh_nodes_8 = CUDAMemory::malloc<BVHNode8>(aggregated_bvh_node_count);
+			upload_bvh_nodes(ptr_bvh_nodes_8);
+			cuda_module.get_global("bvh8_nodes").set_value(ptr_bvh_nodes_8);
 
-			// Each individual BVH needs to put its Nodes in a shared aggregated array of BVH Nodes before being upload to the GPU
-			// The procedure to do this is different for each BVH type
-			for (int m = 0; m < mesh_data_count; m++) {
-				const MeshData & mesh_data = scene.asset_manager.mesh_datas[m];
-				const BVH8 * bvh = static_cast<const BVH8 *>(mesh_data.bvh.get());
+			tlas           = make_owned<BVH8>(PinnedAllocator::instance());
+			tlas_converter = make_owned<BVH8Converter>(static_cast<BVH8 &>(*tlas.get()), tlas_raw);
+			break;
+		}
+	}
+}
 
-				int index_offset = mesh_data_index_offsets[m];
-				int bvh_offset   = mesh_data_bvh_offsets[m];
+// Makes room for at least required elements in a Device array that holds count elements in an allocation of capacity elements.
+// Grows geometrically, so that appending MeshDatas one at a time copies every element only a constant number of times on average
+template<typename T>
+static void reserve_device_array(CUDAMemory::Ptr<T> & ptr, size_t count, size_t & capacity, size_t required, CUstream stream) {
+	if (required <= capacity) return;
 
-				BVHNode8 * dst = aggregated_bvh_nodes.data() + bvh_offset;
+	size_t new_capacity = Math::max(required, capacity + capacity / 2);
 
-				for (size_t n = 0; n < bvh->nodes.size(); n++) {
-					BVHNode8 & node = dst[n];
-					node = bvh->nodes[n];
+	CUDAMemory::Ptr<T> new_ptr = CUDAMemory::malloc<T>(new_capacity);
+	if (count > 0) {
+		CUDAMemory::memcpy_async(new_ptr, ptr, count, stream);
+	}
 
-					node.base_index_triangle += index_offset;
-					node.base_index_child    += bvh_offset;
-				}
-			}
+	// The GPU may still be using the old array
+	CUDACALL(cuCtxSynchronize());
+	if (ptr.ptr != NULL) {
+		CUDAMemory::free(ptr);
+	}
 
-			ptr_bvh_nodes_8 = CUDAMemory::malloc<BVHNode8>(aggregated_bvh_nodes);
-			cuda_module.get_global("bvh8_nodes").set_value(ptr_bvh_nodes_8);
+	ptr      = new_ptr;
+	capacity = new_capacity;
+}
 
-			tlas           = make_owned<BVH8>(PinnedAllocator::instance());
-			tlas_converter = make_owned<BVH8Converter>(static_cast<BVH8 &>(*tlas.get()), tlas_raw);
-			break;
+void Integrator::append_mesh_data(int mesh_data_index) {
+	const MeshData & mesh_data = scene.asset_manager.mesh_datas[mesh_data_index];
+
+	size_t bvh_node_count = mesh_data.bvh->node_count();
+	size_t triangle_count = mesh_data.triangle_count();
+	size_t index_count    = mesh_data.bvh->indices.size();
+
+	size_t bvh_offset      = aggregated_bvh_node_count;
+	size_t triangle_offset = aggregated_triangle_count;
+	size_t index_offset    = aggregated_index_count;
+
+	mesh_data_bvh_offsets     [mesh_data_index] = int(bvh_offset);
+	mesh_data_triangle_offsets[mesh_data_index] = int(triangle_offset);
+	mesh_data_index_offsets   [mesh_data_index] = int(index_offset);
+
+	aggregated_bvh_node_count += bvh_node_count;
+	aggregated_triangle_count += triangle_count;
+	aggregated_index_count    += index_count;
+
+	triangle_order .resize(aggregated_triangle_count);
+	reverse_indices.resize(aggregated_triangle_count);
+
+	int * order = triangle_order .data() + triangle_offset;
+	int * rank  = reverse_indices.data() + triangle_offset;
+
+	size_t unique_count = GeometryAggregation::calc_triangle_order(mesh_data, order, rank);
+
+	for (size_t t = 0; t < triangle_count; t++) {
+		rank[t] += int(triangle_offset);
+	}
+
+	OwnPtr<GeometryStreaming::ClusterSet> clusters = init_cluster_set(mesh_data_index, 1);
+
+	reserve_device_array(ptr_triangles, triangle_offset, aggregated_triangle_capacity, aggregated_triangle_count, memory_stream);
+	CUDAMemory::upload_staged(CUDAMemory::offset(ptr_triangles, triangle_offset), triangle_count, memory_stream, [&](size_t first, size_t count, CUDATriangle * dst) {
+		GeometryAggregation::fill_mesh_data_triangles(mesh_data, mesh_data_index, order, first, count, dst, &thread_pool, clusters.get());
+	});
+	cuda_module.get_global("triangles").set_value(ptr_triangles);
+
+	// Without references the BVH leaves index the triangles directly, which requires every MeshData to reference each of its triangles exactly once
+	if (ptr_triangle_references.ptr != NULL) {
+		reserve_device_array(ptr_triangle_references, index_offset, aggregated_index_capacity, aggregated_index_count, memory_stream);
+		upload_triangle_references(mesh_data_index);
+	} else if (unique_count != index_count || index_count != triangle_count) {
+		aggregated_index_capacity = Math::max(aggregated_index_capacity, aggregated_index_count);
+
+		ptr_triangle_references = CUDAMemory::malloc<int>(aggregated_index_capacity);
+		for (int m = 0; m < scene.asset_manager.mesh_datas.size(); m++) {
+			upload_triangle_references(m);
 		}
 	}
+	cuda_module.get_global("triangle_references").set_value(ptr_triangle_references);
+
+	auto append_bvh_nodes = [&](auto & ptr_bvh_nodes) {
+		reserve_device_array(ptr_bvh_nodes, bvh_offset, aggregated_bvh_node_capacity, aggregated_bvh_node_count, memory_stream);
+		CUDAMemory::upload_staged(CUDAMemory::offset(ptr_bvh_nodes, bvh_offset), bvh_node_count, memory_stream, [&](size_t first, size_t count, auto * dst) {
+			GeometryAggregation::fill_mesh_data_bvh_nodes(mesh_data, int(bvh_offset), int(index_offset), first, count, dst, &thread_pool);
+		});
+	};
+
+	switch (cpu_config.bvh_type) {
+		case BVHType::BVH:
+		case BVHType::SBVH: append_bvh_nodes(ptr_bvh_nodes_2); cuda_module.get_global("bvh_nodes") .set_value(ptr_bvh_nodes_2); break;
+		case BVHType::BVH4: append_bvh_nodes(ptr_bvh_nodes_4); cuda_module.get_global("bvh4_nodes").set_value(ptr_bvh_nodes_4); break;
+		case BVHType::BVH8: append_bvh_nodes(ptr_bvh_nodes_8); cuda_module.get_global("bvh8_nodes").set_value(ptr_bvh_nodes_8); break;
+		default: ASSERT_UNREACHABLE();
+	}
+}
+
+OwnPtr<GeometryStreaming::ClusterSet> Integrator::init_cluster_set(int first_mesh_data, int mesh_data_count) {
+	OwnPtr<GeometryStreaming::ClusterSet> clusters = make_owned<GeometryStreaming::ClusterSet>(scene.asset_manager.mesh_datas, first_mesh_data, mesh_data_count);
+
+	size_t budget_in_bytes = size_t(cpu_config.geometry_cache_budget) * MEGABYTES(1);
+
+	if (!clusters->init(budget_in_bytes, &thread_pool)) return nullptr;
+
+	return clusters;
+}
+
+void Integrator::upload_triangle_references(int mesh_data_index) {
+	const MeshData & mesh_data = scene.asset_manager.mesh_datas[mesh_data_index];
+
+	const int * reverse_indices_mesh_data = reverse_indices.data() + mesh_data_triangle_offsets[mesh_data_index];
+
+	CUDAMemory::upload_staged(CUDAMemory::offset(ptr_triangle_references, mesh_data_index_offsets[mesh_data_index]), mesh_data.bvh->indices.size(), memory_stream, [&](size_t first, size_t count, int * dst) {
+		GeometryAggregation::fill_mesh_data_triangle_references(mesh_data, reverse_indices_mesh_data, first, count, dst, &thread_pool);
+	});
 }
 
 void Integrator::init_sky() {
@@ -288,11 +420,19 @@ void Integrator::init_sky() {
 	cuda_module.get_global("sky_width") .set_value(scene.sky.width);
 	cuda_module.get_global("sky_height").set_value(scene.sky.height);
 	cuda_module.get_global("sky_data")  .set_value(ptr_sky_data);
+
+	// A black Sky has no alias table, sky_total_weight being zero disables importance sampling
+	if (scene.sky.total_weight > 0.0f) {
+		ptr_sky_alias_table = CUDAMemory::malloc(scene.sky.alias_table);
+	}
+	cuda_module.get_global("sky_alias_table") .set_value(ptr_sky_alias_table);
+	cuda_module.get_global("sky_total_weight").set_value(scene.sky.total_weight);
 }
 
 void Integrator::init_rng() {
-	ptr_pmj_samples = CUDAMemory::malloc<PMJ::Point>(PMJ::samples, PMJ_NUM_SEQUENCES * PMJ_NUM_SAMPLES_PER_SEQUENCE);
-	cuda_module.get_global("pmj_samples").set_value(ptr_pmj_samples);
+	ptr_pmj_samples = CUDAMemory::malloc<PMJ::Point>(PMJ02::table.samples);
+	cuda_module.get_global("pmj_samples")                 .set_value(ptr_pmj_samples);
+	cuda_module.get_global("pmj_num_samples_per_sequence").set_value(unsigned(PMJ02::table.num_samples_per_sequence));
 
 	ptr_blue_noise_textures = CUDAMemory::malloc<unsigned short>(&BlueNoise::textures[0][0][0], BLUE_NOISE_NUM_TEXTURES * BLUE_NOISE_TEXTURE_DIM * BLUE_NOISE_TEXTURE_DIM);
 	cuda_module.get_global("blue_noise_textures").set_value(ptr_blue_noise_textures);
@@ -325,14 +465,18 @@ void Integrator::free_materials() {
 }
 
 void Integrator::free_geometry() {
+	tlas_mesh_indices_uploaded.clear();
+
 	CUDAMemory::free_pinned(pinned_mesh_bvh_root_indices);
 	CUDAMemory::free_pinned(pinned_mesh_material_ids);
 	CUDAMemory::free_pinned(pinned_mesh_transforms);
 	CUDAMemory::free_pinned(pinned_mesh_transforms_inv);
 	CUDAMemory::free_pinned(pinned_mesh_transforms_prev);
-	CUDAMemory::free_pinned(pinned_light_mesh_cumulative_probability);
+	CUDAMemory::free_pinned(pinned_light_mesh_alias_table);
 	CUDAMemory::free_pinned(pinned_light_mesh_triangle_span);
 	CUDAMemory::free_pinned(pinned_light_mesh_transform_indices);
+	CUDAMemory::free_pinned(pinned_light_mesh_bvh_nodes);
+	CUDAMemory::free_pinned(pinned_light_mesh_bvh_leaves);
 
 	CUDAMemory::free(ptr_mesh_bvh_root_indices);
 	CUDAMemory::free(ptr_mesh_material_ids);
@@ -348,10 +492,18 @@ void Integrator::free_geometry() {
 	}
 
 	CUDAMemory::free(ptr_triangles);
+
+	if (ptr_triangle_references.ptr != NULL) {
+		CUDAMemory::free(ptr_triangle_references);
+	}
 }
 
 void Integrator::free_sky() {
 	CUDAMemory::free(ptr_sky_data);
+
+	if (ptr_sky_alias_table.ptr != NULL) {
+		CUDAMemory::free(ptr_sky_alias_table);
+	}
 }
 
 void Integrator::free_rng() {
@@ -403,24 +555,136 @@ void Integrator::build_tlas() {
 	}
 	ASSERT(tlas->indices.data());
 
-	for (int i = 0; i < scene.meshes.size(); i++) {
-		const Mesh & mesh = scene.meshes[tlas->indices[i]];
+	int mesh_count = int(scene.meshes.size());
+
+	// The pinned buffers hold what was uploaded previously, only slots whose contents changed are written and uploaded.
+	// A slot changes if the TLAS placed a different Mesh in it, or if the transforms of the Mesh in it were updated by Scene::update
+	bool upload_all = tlas_mesh_indices_uploaded.size() != mesh_count;
+	if (upload_all) {
+		tlas_mesh_indices_uploaded.resize(mesh_count);
+	}
+
+	Array<int> dirty_slots;
 
-		pinned_mesh_bvh_root_indices[i] = mesh_data_bvh_offsets[mesh.mesh_data_handle.handle] | (mesh.has_identity_transform() << 31);
+	for (int i = 0; i < mesh_count; i++) {
+		int mesh_index = tlas->indices[i];
+		Mesh & mesh = scene.meshes[mesh_index];
+
+		int bvh_root_index = mesh_data_bvh_offsets[mesh.mesh_data_handle.handle] | (mesh.has_identity_transform() << 31);
 
 		ASSERT(mesh.material_handle.handle != INVALID);
-		pinned_mesh_material_ids[i] = mesh.material_handle.handle;
+		int material_id = mesh.material_handle.handle;
+
+		bool slot_dirty =
+			upload_all ||
+			mesh.transform_updated ||
+			tlas_mesh_indices_uploaded  [i] != mesh_index ||
+			pinned_mesh_bvh_root_indices[i] != bvh_root_index ||
+			pinned_mesh_material_ids    [i] != material_id;
+
+		if (!slot_dirty) continue;
+
+		dirty_slots.push_back(i);
+
+		mesh.transform_updated = false;
+
+		tlas_mesh_indices_uploaded  [i] = mesh_index;
+		pinned_mesh_bvh_root_indices[i] = bvh_root_index;
+		pinned_mesh_material_ids    [i] = material_id;
 
 		memcpy(pinned_mesh_transforms     [i].cells, mesh.transform     .cells, sizeof(Matrix3x4));
 		memcpy(pinned_mesh_transforms_inv [i].cells, mesh.transform_inv .cells, sizeof(Matrix3x4));
 		memcpy(pinned_mesh_transforms_prev[i].cells, mesh.transform_prev.cells, sizeof(Matrix3x4));
 	}
 
-	CUDAMemory::memcpy_async(ptr_mesh_bvh_root_indices,  pinned_mesh_bvh_root_indices, scene.meshes.size(), memory_stream);
-	CUDAMemory::memcpy_async(ptr_mesh_material_ids,      pinned_mesh_material_ids,     scene.meshes.size(), memory_stream);
-	CUDAMemory::memcpy_async(ptr_mesh_transforms,        pinned_mesh_transforms,       scene.meshes.size(), memory_stream);
-	CUDAMemory::memcpy_async(ptr_mesh_transforms_inv,    pinned_mesh_transforms_inv,   scene.meshes.size(), memory_stream);
-	CUDAMemory::memcpy_async(ptr_mesh_transforms_prev,   pinned_mesh_transforms_prev,  scene.meshes.size(), memory_stream);
+	// Upload contiguous ranges of dirty slots. Ranges separated by small gaps are merged, to avoid issuing many tiny copies
+	constexpr int MAX_GAP = 16;
+
+	size_t d = 0;
+	while (d < dirty_slots.size()) {
+		int first = dirty_slots[d];
+		int last  = first;
+
+		d++;
+		while (d < dirty_slots.size() && dirty_slots[d] - last <= MAX_GAP) {
+			last = dirty_slots[d];
+			d++;
+		}
+
+		int count = last - first + 1;
+
+		CUDAMemory::memcpy_async(CUDAMemory::offset(ptr_mesh_bvh_root_indices, first), pinned_mesh_bvh_root_indices + first, count, memory_stream);
+		CUDAMemory::memcpy_async(CUDAMemory::offset(ptr_mesh_material_ids,     first), pinned_mesh_material_ids     + first, count, memory_stream);
+		CUDAMemory::memcpy_async(CUDAMemory::offset(ptr_mesh_transforms,       first), pinned_mesh_transforms       + first, count, memory_stream);
+		CUDAMemory::memcpy_async(CUDAMemory::offset(ptr_mesh_transforms_inv,   first), pinned_mesh_transforms_inv   + first, count, memory_stream);
+		CUDAMemory::memcpy_async(CUDAMemory::offset(ptr_mesh_transforms_prev,  first), pinned_mesh_transforms_prev  + first, count, memory_stream);
+	}
+}
+
+void Integrator::update_assets() {
+	AssetManager & asset_manager = scene.asset_manager;
+	if (!asset_manager.is_loading()) return;
+
+	bool mesh_datas_loaded = false;
+	bool synced            = false;
+
+	AssetManager::LoadedAsset loaded_asset;
+	while (asset_manager.poll_loaded(loaded_asset)) {
+		switch (loaded_asset.type) {
+			case AssetManager::LoadedAsset::Type::MESH_DATA: {
+				// The placeholder stays in place on the GPU, the MeshData is written to unused memory past the end of the aggregated arrays.
+				// Meshes using the MeshData need their AABB recomputed, and build_tlas uploads their slots since their BVH root changed
+				append_mesh_data(loaded_asset.handle);
+
+				for (int i = 0; i < scene.meshes.size(); i++) {
+					if (scene.meshes[i].mesh_data_handle.handle == loaded_asset.handle) {
+						scene.mark_mesh_dirty(i);
+					}
+				}
+				mesh_datas_loaded = true;
+				break;
+			}
+
+			case AssetManager::LoadedAsset::Type::TEXTURE: {
+				// Not every Integrator uses Textures
+				if (textures.size() == 0) break;
+
+				// The GPU may still be using the placeholder
+				if (!synced) {
+					synced = true;
+					CUDACALL(cuCtxSynchronize());
+				}
+
+				int texture_index = loaded_asset.handle;
+
+				CUDAMemory::free_array  (texture_arrays[texture_index]);
+				CUDAMemory::free_texture(textures[texture_index].texture);
+
+				init_texture(texture_index);
+				CUDAMemory::memcpy(CUDAMemory::offset(ptr_textures, texture_index), &textures[texture_index]);
+
+				invalidated_gpu_config = true; // Restarts accumulation
+				break;
+			}
+
+			default: ASSERT_UNREACHABLE();
+		}
+	}
+
+	// The TLAS is rebuilt as part of the Scene update
+	if (mesh_datas_loaded) {
+		pixel_query.mesh_id     = INVALID;
+		pixel_query.triangle_id = INVALID;
+
+		invalidated_scene     = true;
+		invalidated_materials = true; // Light power depends on the triangles of the MeshData
+	}
+
+	if (!asset_manager.is_loading()) {
+		asset_manager.wait_until_loaded(); // Releases the loader threads
+
+		Log::info(Log::Category::ASSETS, "All assets finished loading\n"_sv);
+	}
 }
 
 void Integrator::update(float delta, Allocator * frame_allocator) {
@@ -475,7 +739,7 @@ void Integrator::update(float delta, Allocator * frame_allocator) {
 	}
 
 	if (pixel_query_status == PixelQueryStatus::OUTPUT_READY) {
-		CUDAMemory::memcpy_async(&pixel_query, CUDAMemory::Ptr<PixelQuery>(global_pixel_query.ptr), 1, memory_stream);
+		CUDAMemory::memcpy_async(&pixel_query, CUDAMemory::Ptr<PixelQuery>(global_pixel_query.ptr()), 1, memory_stream);
 
 		if (pixel_query.mesh_id != INVALID) {
 			pixel_query.mesh_id = tlas->indices[pixel_query.mesh_id];
@@ -483,7 +747,7 @@ void Integrator::update(float delta, Allocator * frame_allocator) {
 
 		// Reset pixel query
 		pixel_query.pixel_index = INVALID;
-		CUDAMemory::memcpy_async(CUDAMemory::Ptr<PixelQuery>(global_pixel_query.ptr), &pixel_query, 1, memory_stream);
+		global_pixel_query.set_value_async(pixel_query, memory_stream);
 
 		pixel_query_status = PixelQueryStatus::INACTIVE;
 	}
@@ -10,10 +10,14 @@
 
 #include "BVH/Builders/SAHBuilder.h"
 #include "BVH/Converters/BVHConverter.h"
+#include "BVH/LightBVH.h"
 
 #include "Renderer/Scene.h"
+#include "Renderer/GeometryCache.h"
+#include "Renderer/Integrators/GeometryAggregation.h"
 
-#include "Util/PMJ.h"
+#include "Util/PMJ02.h"
+#include "Util/ThreadPool.h"
 
 
 // Mirror CUDA vector types
@@ -56,6 +60,8 @@ struct AOV {
 struct Integrator {
 	Scene & scene;
 
+	ThreadPool & thread_pool; // Shared with the rest of the CPU side preprocessing, see ThreadPool::get_shared
+
 	bool invalidated_scene      = true;
 	bool invalidated_materials  = true;
 	bool invalidated_mediums    = true;
@@ -69,6 +75,8 @@ struct Integrator {
 
 	int pixel_count;
 
+	int batch_size = 0; // Number of pixels rendered per batch, the capacity of all ray buffers (see BatchSize.h)
+
 	int sample_index = 0;
 
 	enum struct PixelQueryStatus {
@@ -135,21 +143,8 @@ struct Integrator {
 
 	CUDAMemory::Ptr<CUDATexture> ptr_textures;
 
-	struct CUDATriangle {
-		Vector3 position_0;
-		Vector3 position_edge_1;
-		Vector3 position_edge_2;
-
-		Vector3 normal_0;
-		Vector3 normal_edge_1;
-		Vector3 normal_edge_2;
-
-		Vector2 tex_coord_0;
-		Vector2 tex_coord_edge_1;
-		Vector2 tex_coord_edge_2;
-	};
-
 	CUDAMemory::Ptr<CUDATriangle> ptr_triangles;
+	CUDAMemory::Ptr<int>          ptr_triangle_references; // Only allocated if some BVH references triangles multiple times (SBVH)
 
 	CUDAMemory::Ptr<BVHNode2>  ptr_bvh_nodes_2;
 	CUDAMemory::Ptr<BVHNode4>  ptr_bvh_nodes_4;
@@ -160,30 +155,47 @@ struct Integrator {
 	CUDAMemory::Ptr<Matrix3x4> ptr_mesh_transforms_inv;
 	CUDAMemory::Ptr<Matrix3x4> ptr_mesh_transforms_prev;
 
-	int       * pinned_mesh_bvh_root_indices             = nullptr;
-	int       * pinned_mesh_material_ids                 = nullptr;
-	Matrix3x4 * pinned_mesh_transforms                   = nullptr;
-	Matrix3x4 * pinned_mesh_transforms_inv               = nullptr;
-	Matrix3x4 * pinned_mesh_transforms_prev              = nullptr;
-	float     * pinned_light_mesh_cumulative_probability = nullptr;
-	int2      * pinned_light_mesh_triangle_span          = nullptr;
-	int       * pinned_light_mesh_transform_indices      = nullptr;
+	int          * pinned_mesh_bvh_root_indices        = nullptr;
+	int          * pinned_mesh_material_ids            = nullptr;
+	Matrix3x4    * pinned_mesh_transforms              = nullptr;
+	Matrix3x4    * pinned_mesh_transforms_inv          = nullptr;
+	Matrix3x4    * pinned_mesh_transforms_prev         = nullptr;
+	AliasEntry   * pinned_light_mesh_alias_table       = nullptr;
+	int2         * pinned_light_mesh_triangle_span     = nullptr;
+	int          * pinned_light_mesh_transform_indices = nullptr;
+	LightBVHNode * pinned_light_mesh_bvh_nodes         = nullptr;
+	int          * pinned_light_mesh_bvh_leaves        = nullptr;
 
 	BVH2                 tlas_raw;
 	OwnPtr<BVH>          tlas;
 	OwnPtr<SAHBuilder>   tlas_builder;
 	OwnPtr<BVHConverter> tlas_converter;
 
-	Array<int> reverse_indices;
+	Array<int> tlas_mesh_indices_uploaded; // For every slot in the pinned Mesh buffers, the index of the Mesh whose data was last uploaded from it
+
+	Array<int> reverse_indices; // For every original triangle (offset by mesh_data_triangle_offsets) its index in the aggregated triangle array
+	Array<int> triangle_order;  // For every triangle in the aggregated triangle array its original index within its MeshData
 
 	Array<int> mesh_data_bvh_offsets;
-	Array<int> mesh_data_triangle_offsets;
+	Array<int> mesh_data_triangle_offsets; // Offset into the aggregated (deduplicated) triangle array
+	Array<int> mesh_data_index_offsets;    // Offset into the aggregated triangle references, triangles may be referenced multiple times by the BVH (see BVH::indices)
+
+	// Number of elements in use in the aggregated arrays, and the number of elements their Device allocations have room for.
+	// MeshDatas that finish loading are appended at the end (see append_mesh_data), the range of their placeholder is left unused
+	size_t aggregated_bvh_node_count = 0;
+	size_t aggregated_triangle_count = 0;
+	size_t aggregated_index_count    = 0;
+
+	size_t aggregated_bvh_node_capacity = 0;
+	size_t aggregated_triangle_capacity = 0;
+	size_t aggregated_index_capacity    = 0;
 
 	CUDAModule::Global global_camera;
 	CUDAModule::Global global_config;
 	CUDAModule::Global global_buffer_sizes;
 
-	CUDAMemory::Ptr<Vector3> ptr_sky_data;
+	CUDAMemory::Ptr<Vector3>    ptr_sky_data;
+	CUDAMemory::Ptr<AliasEntry> ptr_sky_alias_table;
 
 	CUDAMemory::Ptr<PMJ::Point>     ptr_pmj_samples;
 	CUDAMemory::Ptr<unsigned short> ptr_blue_noise_textures;
@@ -193,7 +205,7 @@ struct Integrator {
 	AOV aovs[size_t(AOVType::COUNT)];
 	CUDAModule::Global global_aovs;
 
-	Integrator(Scene & scene) : scene(scene) {
+	Integrator(Scene & scene) : scene(scene), thread_pool(ThreadPool::get_shared()) {
 		CUDACALL(cuStreamCreate(&memory_stream, CU_STREAM_NON_BLOCKING));
 	}
 
@@ -205,11 +217,19 @@ struct Integrator {
 
 	void init_globals();
 	void init_materials();
+	void init_texture(int texture_index);
 	void init_geometry();
 	void init_sky();
 	void init_rng();
 	void init_aovs();
 
+	// Appends the triangles, triangle references, and BVH Nodes of a single MeshData to the aggregated arrays and points its offsets there
+	void append_mesh_data(int mesh_data_index);
+	void upload_triangle_references(int mesh_data_index);
+
+	// Opens a GeometryCache over the cluster files of the given range of MeshDatas, returns nullptr if none of them had its Triangles moved to a cluster file
+	OwnPtr<GeometryStreaming::ClusterSet> init_cluster_set(int first_mesh_data, int mesh_data_count);
+
 	void free_materials();
 	void free_geometry();
 	void free_sky();
@@ -219,6 +239,18 @@ struct Integrator {
 	virtual void resize_free() = 0;
 	virtual void resize_init(unsigned frame_buffer_handle, int width, int height) = 0;
 
+	// Looks up the Kernels in the CUDA Module and determines their launch dimensions, the screen size dependent ones are set by resize_kernels
+	virtual void init_kernels()   = 0;
+	virtual void resize_kernels() = 0;
+
+	// Chooses the batch size for the current resolution and free Device memory, returns true if it changed.
+	// In that case the ray buffers need to be reallocated, the memory they currently take up is counted as available
+	bool calc_batch_size(size_t bytes_per_pixel);
+
+	// Recompiles the CUDA Module in place (hot reload). Unlike cuda_free() followed by cuda_init(), all Device allocations
+	// (geometry, Textures, Sky, PMJ samples, frame buffers) are kept, only the globals pointing to them are rebound
+	void cuda_reload();
+
 	      AOV & get_aov(AOVType aov_type)       { return aovs[size_t(aov_type)]; }
 	const AOV & get_aov(AOVType aov_type) const { return aovs[size_t(aov_type)]; }
 
@@ -233,6 +265,10 @@ struct Integrator {
 
 	void build_tlas();
 
+	// Patches assets that finished loading since the last call into the GPU copies of the Scene (progressive loading).
+	// Textures replace their entry in the Texture table, MeshDatas are appended to the aggregated geometry
+	void update_assets();
+
 	virtual void update(float delta, Allocator * frame_allocator);
 	virtual void render() = 0;
 
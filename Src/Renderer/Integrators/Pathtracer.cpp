@@ -2,47 +2,53 @@
 
 #include <Imgui/imgui.h>
 
+#include "Core/HashMap.h"
 #include "Core/Allocators/LinearAllocator.h"
 
+#include "Util/ThreadPool.h"
+#include "Util/AliasTable.h"
+
+#include "BVH/LightBVH.h"
+
+#include "Renderer/SceneFeatures.h"
+
 void Pathtracer::cuda_init(unsigned frame_buffer_handle, int screen_width, int screen_height) {
 	init_module();
 	init_globals();
 
 	pinned_buffer_sizes = CUDAMemory::malloc_pinned<BufferSizes>();
-	pinned_buffer_sizes->reset(BATCH_SIZE);
-
 	global_buffer_sizes = cuda_module.get_global("buffer_sizes");
-	global_buffer_sizes.set_value(*pinned_buffer_sizes);
-
-	resize_init(frame_buffer_handle, screen_width, screen_height);
-
-	init_materials();
-	init_geometry();
-	init_sky();
-	init_rng();
-	init_events();
-
-	ray_buffer_trace_0.init(BATCH_SIZE);
-	ray_buffer_trace_1.init(BATCH_SIZE);
-	cuda_module.get_global("ray_buffer_trace_0").set_value(ray_buffer_trace_0);
-	cuda_module.get_global("ray_buffer_trace_1").set_value(ray_buffer_trace_1);
 
 	global_ray_buffer_shadow = cuda_module.get_global("ray_buffer_shadow");
 
 	global_svgf_data = cuda_module.get_global("svgf_data");
 
+#if ENABLE_RAY_STATS
+	global_ray_stats = cuda_module.get_global("ray_stats");
+	ray_stats.init();
+#endif
+
 	global_lights_total_weight = cuda_module.get_global("lights_total_weight");
 	global_lights_total_weight.set_value(0.0f);
 
-	scene.camera.update(0.0f);
-	scene.update(0.0f);
-
 	scene.has_diffuse    = false;
 	scene.has_plastic    = false;
 	scene.has_dielectric = false;
 	scene.has_conductor  = false;
 	scene.has_lights     = false;
 
+	init_materials();
+	init_geometry();
+	init_sky();
+	init_rng();
+	init_events();
+
+	// Initialized after the Scene has been uploaded, since the batch size depends on the memory that is left
+	resize_init(frame_buffer_handle, screen_width, screen_height);
+
+	scene.camera.update(0.0f);
+	scene.update(0.0f);
+
 	invalidated_scene      = true;
 	invalidated_materials  = true;
 	invalidated_mediums    = true;
@@ -65,35 +71,63 @@ void Pathtracer::cuda_free() {
 
 	CUDAMemory::free_pinned(pinned_buffer_sizes);
 
-	if (scene.has_lights) {
+#if ENABLE_RAY_STATS
+	ray_stats.free();
+#endif
+
+	// The light buffers are not allocated while all light MeshDatas are still loading
+	if (scene.has_lights && ptr_light_triangle_indices.ptr != NULL) {
 		CUDAMemory::free(ptr_light_triangle_indices);
-		CUDAMemory::free(ptr_light_triangle_cumulative_probability);
+		CUDAMemory::free(ptr_light_triangle_alias_table);
+		CUDAMemory::free(ptr_light_bvh_nodes);
+		CUDAMemory::free(ptr_light_bvh_leaves);
 
-		CUDAMemory::free(ptr_light_mesh_cumulative_probability);
+		CUDAMemory::free(ptr_light_mesh_alias_table);
 		CUDAMemory::free(ptr_light_mesh_triangle_span);
 		CUDAMemory::free(ptr_light_mesh_transform_indices);
-
-		ray_buffer_shadow.free();
+		CUDAMemory::free(ptr_light_mesh_bvh_nodes);
+		CUDAMemory::free(ptr_light_mesh_bvh_leaves);
 	}
 
-	ray_buffer_trace_0.free();
-	ray_buffer_trace_1.free();
+	free_batch_buffers();
+	batch_size = 0;
 
-	for (size_t i = 0; i < material_ray_buffers.size(); i++) {
-		material_ray_buffers[i].free();
-	}
 	material_ray_buffers.clear();
 
 	CUDAMemory::free(ptr_material_ray_buffers);
 }
 
 void Pathtracer::init_module() {
+	// Features that only appear later (for example when Materials are edited) trigger a recompile in update()
+	if (cpu_config.enable_kernel_specialization) {
+		set_kernel_features(SceneFeatures::get(scene.asset_manager.materials));
+	} else {
+		set_kernel_features(SceneFeatures::ALL);
+	}
+
 	cuda_module.init("Pathtracer"_sv, "Src/CUDA/Pathtracer.cu"_sv, CUDAContext::compute_capability, MAX_REGISTERS);
 
+	init_kernels();
+}
+
+void Pathtracer::set_kernel_features(unsigned features) {
+	kernel_features = features;
+
+	cuda_module.defines.clear();
+	SceneFeatures::to_defines(kernel_features, cuda_module.defines);
+	cuda_module.defines.push_back(Format().format("-DENABLE_RAY_STATS={}"_sv, ENABLE_RAY_STATS)); // Keep the kernels in sync with the Host
+
+	IO::print("Pathtracer kernels specialized for Scene features: {}\n"_sv, SceneFeatures::to_string(kernel_features));
+}
+
+void Pathtracer::init_kernels() {
 	kernel_generate           .init(&cuda_module, "kernel_generate");
 	kernel_trace_bvh2         .init(&cuda_module, "kernel_trace_bvh2");
 	kernel_trace_bvh4         .init(&cuda_module, "kernel_trace_bvh4");
 	kernel_trace_bvh8         .init(&cuda_module, "kernel_trace_bvh8");
+	kernel_reorder_keys       .init(&cuda_module, "kernel_reorder_keys");
+	kernel_reorder_scan       .init(&cuda_module, "kernel_reorder_scan");
+	kernel_reorder_scatter    .init(&cuda_module, "kernel_reorder_scatter");
 	kernel_sort               .init(&cuda_module, "kernel_sort");
 	kernel_material_diffuse   .init(&cuda_module, "kernel_material_diffuse");
 	kernel_material_plastic   .init(&cuda_module, "kernel_material_plastic");
@@ -120,6 +154,9 @@ void Pathtracer::init_module() {
 
 	// Set Block dimensions for all Kernels
 	kernel_generate           .set_block_dim(256, 1, 1);
+	kernel_reorder_keys       .set_block_dim(256, 1, 1);
+	kernel_reorder_scan       .set_block_dim(1024, 1, 1); // Single block, see kernel_reorder_scan
+	kernel_reorder_scatter    .set_block_dim(256, 1, 1);
 	kernel_sort               .set_block_dim(256, 1, 1);
 	kernel_material_diffuse   .set_block_dim(256, 1, 1);
 	kernel_material_plastic   .set_block_dim(256, 1, 1);
@@ -144,6 +181,39 @@ void Pathtracer::init_module() {
 	kernel_trace_calc_grid_and_block_size<8>(kernel_trace_shadow_bvh8);
 }
 
+void Pathtracer::init_batch_buffers() {
+	ray_buffer_trace_0.init(batch_size);
+	ray_buffer_trace_1.init(batch_size);
+	cuda_module.get_global("ray_buffer_trace_0").set_value(ray_buffer_trace_0);
+	cuda_module.get_global("ray_buffer_trace_1").set_value(ray_buffer_trace_1);
+
+	if (scene.has_lights) {
+		ray_buffer_shadow.init(batch_size);
+		global_ray_buffer_shadow.set_value(ray_buffer_shadow);
+	}
+
+	// The MaterialBuffers keep their slot in the Device array, so the material_buffer_* globals that point into it remain valid
+	if (material_ray_buffers.size() > 0) {
+		for (size_t i = 0; i < material_ray_buffers.size(); i++) {
+			material_ray_buffers[i].init(batch_size);
+		}
+		CUDAMemory::memcpy(ptr_material_ray_buffers, material_ray_buffers.data(), material_ray_buffers.size());
+	}
+}
+
+void Pathtracer::free_batch_buffers() {
+	ray_buffer_trace_0.free();
+	ray_buffer_trace_1.free();
+
+	if (scene.has_lights) {
+		ray_buffer_shadow.free();
+	}
+
+	for (size_t i = 0; i < material_ray_buffers.size(); i++) {
+		material_ray_buffers[i].free();
+	}
+}
+
 void Pathtracer::init_events() {
 	int display_order = 0;
 	event_desc_primary = { display_order++, "Primary"_sv, "Primary"_sv };
@@ -151,6 +221,7 @@ void Pathtracer::init_events() {
 	for (int i = 0; i < MAX_BOUNCES; i++) {
 		String category = Format().format("Bounce {}"_sv, i);
 
+		event_desc_reorder            [i] = CUDAEvent::Desc { display_order, category, "Reorder"_sv };
 		event_desc_trace              [i] = CUDAEvent::Desc { display_order, category, "Trace"_sv };
 		event_desc_sort               [i] = CUDAEvent::Desc { display_order, category, "Sort"_sv };
 		event_desc_material_diffuse   [i] = CUDAEvent::Desc { display_order, category, "Diffuse"_sv };
@@ -188,6 +259,13 @@ void Pathtracer::resize_init(unsigned frame_buffer_handle, int width, int height
 	cuda_module.get_global("screen_pitch") .set_value(screen_pitch);
 	cuda_module.get_global("screen_height").set_value(screen_height);
 
+	// The batch size depends on the resolution, the ray buffers are reallocated if it changes
+	bool had_batch_buffers = batch_size > 0;
+	if (calc_batch_size(BATCH_BYTES_PER_PIXEL)) {
+		if (had_batch_buffers) free_batch_buffers();
+		init_batch_buffers();
+	}
+
 	// Create Frame Buffers
 	init_aovs();
 	aov_enable(AOVType::RADIANCE);
@@ -197,27 +275,13 @@ void Pathtracer::resize_init(unsigned frame_buffer_handle, int width, int height
 	surf_accumulator     = CUDAMemory::create_surface(CUDAMemory::resource_get_array(resource_accumulator));
 	cuda_module.get_global("accumulator").set_value(surf_accumulator);
 
-	// Set Grid dimensions for screen size dependent Kernels
-	kernel_svgf_reproject.set_grid_dim(screen_pitch / kernel_svgf_reproject.block_dim_x, Math::divide_round_up(height, kernel_svgf_reproject.block_dim_y), 1);
-	kernel_svgf_variance .set_grid_dim(screen_pitch / kernel_svgf_variance .block_dim_x, Math::divide_round_up(height, kernel_svgf_variance .block_dim_y), 1);
-	kernel_svgf_atrous   .set_grid_dim(screen_pitch / kernel_svgf_atrous   .block_dim_x, Math::divide_round_up(height, kernel_svgf_atrous   .block_dim_y), 1);
-	kernel_svgf_finalize .set_grid_dim(screen_pitch / kernel_svgf_finalize .block_dim_x, Math::divide_round_up(height, kernel_svgf_finalize .block_dim_y), 1);
-	kernel_taa           .set_grid_dim(screen_pitch / kernel_taa           .block_dim_x, Math::divide_round_up(height, kernel_taa           .block_dim_y), 1);
-	kernel_taa_finalize  .set_grid_dim(screen_pitch / kernel_taa_finalize  .block_dim_x, Math::divide_round_up(height, kernel_taa_finalize  .block_dim_y), 1);
-	kernel_accumulate    .set_grid_dim(screen_pitch / kernel_accumulate    .block_dim_x, Math::divide_round_up(height, kernel_accumulate    .block_dim_y), 1);
-
-	kernel_generate           .set_grid_dim(Math::divide_round_up(BATCH_SIZE, kernel_generate           .block_dim_x), 1, 1);
-	kernel_sort               .set_grid_dim(Math::divide_round_up(BATCH_SIZE, kernel_sort               .block_dim_x), 1, 1);
-	kernel_material_diffuse   .set_grid_dim(Math::divide_round_up(BATCH_SIZE, kernel_material_diffuse   .block_dim_x), 1, 1);
-	kernel_material_plastic   .set_grid_dim(Math::divide_round_up(BATCH_SIZE, kernel_material_plastic   .block_dim_x), 1, 1);
-	kernel_material_dielectric.set_grid_dim(Math::divide_round_up(BATCH_SIZE, kernel_material_dielectric.block_dim_x), 1, 1);
-	kernel_material_conductor .set_grid_dim(Math::divide_round_up(BATCH_SIZE, kernel_material_conductor .block_dim_x), 1, 1);
+	resize_kernels();
 
 	scene.camera.resize(width, height);
 	invalidated_camera = true;
 
 	// Reset buffer sizes to default for next frame
-	pinned_buffer_sizes->reset(Math::min(BATCH_SIZE, pixel_count));
+	pinned_buffer_sizes->reset(Math::min(batch_size, pixel_count));
 	global_buffer_sizes.set_value(*pinned_buffer_sizes);
 
 	sample_index = 0;
@@ -225,6 +289,27 @@ void Pathtracer::resize_init(unsigned frame_buffer_handle, int width, int height
 	if (gpu_config.enable_svgf) svgf_init();
 }
 
+void Pathtracer::resize_kernels() {
+	// Set Grid dimensions for screen size dependent Kernels
+	kernel_svgf_reproject.set_grid_dim(screen_pitch / kernel_svgf_reproject.block_dim_x, Math::divide_round_up(screen_height, kernel_svgf_reproject.block_dim_y), 1);
+	kernel_svgf_variance .set_grid_dim(screen_pitch / kernel_svgf_variance .block_dim_x, Math::divide_round_up(screen_height, kernel_svgf_variance .block_dim_y), 1);
+	kernel_svgf_atrous   .set_grid_dim(screen_pitch / kernel_svgf_atrous   .block_dim_x, Math::divide_round_up(screen_height, kernel_svgf_atrous   .block_dim_y), 1);
+	kernel_svgf_finalize .set_grid_dim(screen_pitch / kernel_svgf_finalize .block_dim_x, Math::divide_round_up(screen_height, kernel_svgf_finalize .block_dim_y), 1);
+	kernel_taa           .set_grid_dim(screen_pitch / kernel_taa           .block_dim_x, Math::divide_round_up(screen_height, kernel_taa           .block_dim_y), 1);
+	kernel_taa_finalize  .set_grid_dim(screen_pitch / kernel_taa_finalize  .block_dim_x, Math::divide_round_up(screen_height, kernel_taa_finalize  .block_dim_y), 1);
+	kernel_accumulate    .set_grid_dim(screen_pitch / kernel_accumulate    .block_dim_x, Math::divide_round_up(screen_height, kernel_accumulate    .block_dim_y), 1);
+
+	kernel_generate           .set_grid_dim(Math::divide_round_up(batch_size, kernel_generate           .block_dim_x), 1, 1);
+	kernel_reorder_keys       .set_grid_dim(Math::divide_round_up(batch_size, kernel_reorder_keys       .block_dim_x), 1, 1);
+	kernel_reorder_scan       .set_grid_dim(1, 1, 1);
+	kernel_reorder_scatter    .set_grid_dim(Math::divide_round_up(batch_size, kernel_reorder_scatter    .block_dim_x), 1, 1);
+	kernel_sort               .set_grid_dim(Math::divide_round_up(batch_size, kernel_sort               .block_dim_x), 1, 1);
+	kernel_material_diffuse   .set_grid_dim(Math::divide_round_up(batch_size, kernel_material_diffuse   .block_dim_x), 1, 1);
+	kernel_material_plastic   .set_grid_dim(Math::divide_round_up(batch_size, kernel_material_plastic   .block_dim_x), 1, 1);
+	kernel_material_dielectric.set_grid_dim(Math::divide_round_up(batch_size, kernel_material_dielectric.block_dim_x), 1, 1);
+	kernel_material_conductor .set_grid_dim(Math::divide_round_up(batch_size, kernel_material_conductor .block_dim_x), 1, 1);
+}
+
 void Pathtracer::resize_free() {
 	CUDACALL(cuStreamSynchronize(memory_stream));
 
@@ -317,7 +402,10 @@ void Pathtracer::calc_light_power(Allocator * frame_allocator) {
 		Mesh & mesh = scene.meshes[m];
 		const Material & material = scene.asset_manager.get_material(mesh.material_handle);
 
-		if (material.type == Material::Type::LIGHT && (material.emission.x > 0.0f || material.emission.y > 0.0f || material.emission.z > 0.0f)) {
+		// MeshDatas that are still loading are not Lights yet, calc_light_power is called again once they arrive
+		bool mesh_data_loaded = scene.asset_manager.is_loaded(mesh.mesh_data_handle);
+
+		if (material.type == Material::Type::LIGHT && (material.emission.x > 0.0f || material.emission.y > 0.0f || material.emission.z > 0.0f) && mesh_data_loaded) {
 			Array<Mesh *> & meshes = mesh_data_used_as_lights[mesh.mesh_data_handle.handle];
 			meshes.allocator = frame_allocator;
 			meshes.push_back(&mesh);
@@ -327,13 +415,14 @@ void Pathtracer::calc_light_power(Allocator * frame_allocator) {
 		}
 	}
 
-	struct LightTriangle {
-		int    index;
-		double area;
-	};
-	Array<LightTriangle> light_triangles(frame_allocator);
+	Array<int>    light_triangle_indices(frame_allocator);
+	Array<double> light_triangle_areas  (frame_allocator);
 
 	struct LightMeshData {
+		MeshDataHandle mesh_data_handle;
+
+		const Triangle * triangles;
+
 		size_t first_triangle_index;
 		size_t triangle_count;
 
@@ -341,6 +430,9 @@ void Pathtracer::calc_light_power(Allocator * frame_allocator) {
 	};
 	Array<LightMeshData> light_mesh_datas(frame_allocator);
 
+	// Triangles of light MeshDatas that were moved to a cluster file are read back in their original order
+	Array<Array<Triangle>> light_triangles_from_clusters;
+
 	using It = decltype(mesh_data_used_as_lights)::Iterator;
 
 	for (It it = mesh_data_used_as_lights.begin(); it != mesh_data_used_as_lights.end(); ++it) {
@@ -350,18 +442,29 @@ void Pathtracer::calc_light_power(Allocator * frame_allocator) {
 		const MeshData & mesh_data = scene.asset_manager.get_mesh_data(mesh_data_handle);
 
 		LightMeshData & light_mesh_data = light_mesh_datas.emplace_back();
-		light_mesh_data.first_triangle_index = light_triangles.size();
-		light_mesh_data.triangle_count = mesh_data.triangles.size();
+		light_mesh_data.mesh_data_handle = mesh_data_handle;
+		light_mesh_data.triangles = mesh_data.triangles.data();
+		light_mesh_data.first_triangle_index = light_triangle_indices.size();
+		light_mesh_data.triangle_count = mesh_data.triangle_count();
 		light_mesh_data.total_area = 0.0f;
 
-		for (int t = 0; t < mesh_data.triangles.size(); t++) {
-			const Triangle & triangle = mesh_data.triangles[t];
+		if (mesh_data.clusters.get()) {
+			Array<Triangle> & triangles = light_triangles_from_clusters.emplace_back();
+			triangles.resize(light_mesh_data.triangle_count);
+			mesh_data.clusters.get()->read_triangles(triangle_order.data() + mesh_data_triangle_offsets[mesh_data_handle.handle], triangles.data());
+
+			light_mesh_data.triangles = triangles.data();
+		}
+
+		for (int t = 0; t < light_mesh_data.triangle_count; t++) {
+			const Triangle & triangle = light_mesh_data.triangles[t];
 
 			float area = 0.5f * Vector3::length(Vector3::cross(
 				triangle.position_1 - triangle.position_0,
 				triangle.position_2 - triangle.position_0
 			));
-			light_triangles.emplace_back(reverse_indices[mesh_data_triangle_offsets[mesh_data_handle.handle] + t], area);
+			light_triangle_indices.push_back(reverse_indices[mesh_data_triangle_offsets[mesh_data_handle.handle] + t]);
+			light_triangle_areas  .push_back(area);
 			light_mesh_data.total_area += area;
 		}
 
@@ -377,50 +480,86 @@ void Pathtracer::calc_light_power(Allocator * frame_allocator) {
 		}
 	}
 
-	if (light_triangles.size() > 0) {
-		Array<int>   light_triangle_indices               (light_triangles.size(), frame_allocator);
-		Array<float> light_triangle_cumulative_probability(light_triangles.size(), frame_allocator);
+	if (light_triangle_indices.size() > 0) {
+		Array<AliasEntry> light_triangle_alias_table(light_triangle_indices.size(), frame_allocator);
+
+		// The light BVH of a MeshData starts at twice the index of its first light triangle, as a BVH over n triangles has 2n - 1 Nodes.
+		// Leaves are looked up by the index of a triangle in the aggregated triangle array, which is what ray hits report
+		Array<LightBVHNode> light_bvh_nodes (2 * light_triangle_indices.size(), frame_allocator);
+		Array<int>          light_bvh_leaves(reverse_indices.size(),            frame_allocator);
+
+		for (size_t i = 0; i < light_bvh_leaves.size(); i++) {
+			light_bvh_leaves[i] = INVALID;
+		}
+
+		light_bvh_roots.resize(scene.asset_manager.mesh_datas.size());
 
-		for (int m = 0; m < light_mesh_datas.size(); m++) {
+		// Every light MeshData gets its own alias table over its triangles, weighted by area, and its own light BVH in object space.
+		// The power of the Light is taken into account when selecting the Mesh, see calc_light_mesh_weights
+		thread_pool.parallel_for(0, int(light_mesh_datas.size()), 1, [&](int m) {
 			const LightMeshData & light_mesh_data = light_mesh_datas[m];
 
-			double cumulative_area = 0.0;
+			AliasTable::build(
+				light_triangle_areas      .data() + light_mesh_data.first_triangle_index,
+				int(light_mesh_data.triangle_count),
+				light_triangle_alias_table.data() + light_mesh_data.first_triangle_index,
+				&thread_pool
+			);
 
-			for (int i = light_mesh_data.first_triangle_index; i < light_mesh_data.first_triangle_index + light_mesh_data.triangle_count; i++) {
-				light_triangle_indices[i] = light_triangles[i].index;
+			LightBVH light_bvh;
+			light_bvh.build(light_mesh_data.triangles, int(light_mesh_data.triangle_count));
 
-				cumulative_area += light_triangles[i].area / light_mesh_data.total_area;
-				light_triangle_cumulative_probability[i] = float(cumulative_area);
+			int node_offset = int(2 * light_mesh_data.first_triangle_index);
+
+			for (size_t n = 0; n < light_bvh.nodes.size(); n++) {
+				LightBVHNode node = light_bvh.nodes[n];
+				if (node.left   != INVALID) node.left   += node_offset;
+				if (node.parent != INVALID) node.parent += node_offset;
+
+				light_bvh_nodes[node_offset + n] = node;
 			}
+			light_bvh_roots[light_mesh_data.mesh_data_handle.handle] = light_bvh.nodes[0];
 
-			for (int i = light_mesh_data.first_triangle_index; i < light_mesh_data.first_triangle_index + light_mesh_data.triangle_count; i++) {
-				light_triangle_cumulative_probability[i] /= float(cumulative_area);
+			int triangle_offset = mesh_data_triangle_offsets[light_mesh_data.mesh_data_handle.handle];
+
+			for (size_t t = 0; t < light_mesh_data.triangle_count; t++) {
+				light_bvh_leaves[reverse_indices[triangle_offset + t]] = node_offset + light_bvh.leaves[t];
 			}
-		}
+		});
 
-		ptr_light_triangle_indices                = CUDAMemory::malloc(light_triangle_indices);
-		ptr_light_triangle_cumulative_probability = CUDAMemory::malloc(light_triangle_cumulative_probability);
+		ptr_light_triangle_indices     = CUDAMemory::malloc(light_triangle_indices);
+		ptr_light_triangle_alias_table = CUDAMemory::malloc(light_triangle_alias_table);
+		ptr_light_bvh_nodes            = CUDAMemory::malloc(light_bvh_nodes);
+		ptr_light_bvh_leaves           = CUDAMemory::malloc(light_bvh_leaves);
 
-		cuda_module.get_global("light_triangle_indices")               .set_value_async(ptr_light_triangle_indices,                memory_stream);
-		cuda_module.get_global("light_triangle_cumulative_probability").set_value_async(ptr_light_triangle_cumulative_probability, memory_stream);
+		cuda_module.get_global("light_triangle_indices")    .set_value_async(ptr_light_triangle_indices,     memory_stream);
+		cuda_module.get_global("light_triangle_alias_table").set_value_async(ptr_light_triangle_alias_table, memory_stream);
+		cuda_module.get_global("light_bvh_nodes")           .set_value_async(ptr_light_bvh_nodes,            memory_stream);
+		cuda_module.get_global("light_bvh_leaves")          .set_value_async(ptr_light_bvh_leaves,           memory_stream);
 
 		cuda_module.get_global("light_mesh_count").set_value_async(light_mesh_count, memory_stream);
 
-		if (ptr_light_mesh_cumulative_probability.ptr != NULL) CUDAMemory::free(ptr_light_mesh_cumulative_probability);
-		if (ptr_light_mesh_triangle_span         .ptr != NULL) CUDAMemory::free(ptr_light_mesh_triangle_span);
-		if (ptr_light_mesh_transform_indices     .ptr != NULL) CUDAMemory::free(ptr_light_mesh_transform_indices);
+		if (ptr_light_mesh_alias_table      .ptr != NULL) CUDAMemory::free(ptr_light_mesh_alias_table);
+		if (ptr_light_mesh_triangle_span    .ptr != NULL) CUDAMemory::free(ptr_light_mesh_triangle_span);
+		if (ptr_light_mesh_transform_indices.ptr != NULL) CUDAMemory::free(ptr_light_mesh_transform_indices);
+		if (ptr_light_mesh_bvh_nodes        .ptr != NULL) CUDAMemory::free(ptr_light_mesh_bvh_nodes);
+		if (ptr_light_mesh_bvh_leaves       .ptr != NULL) CUDAMemory::free(ptr_light_mesh_bvh_leaves);
 
 		// The Device pointers below are only filled in and copied to the GPU once the TLAS is constructed,
 		// therefore the scene_invalidated flag is required to be set.
 		invalidated_scene = true;
 
-		ptr_light_mesh_cumulative_probability = CUDAMemory::malloc<float>(light_mesh_count);
-		ptr_light_mesh_triangle_span          = CUDAMemory::malloc<int2> (light_mesh_count);
-		ptr_light_mesh_transform_indices      = CUDAMemory::malloc<int>  (light_mesh_count);
-
-		cuda_module.get_global("light_mesh_cumulative_probability").set_value_async(ptr_light_mesh_cumulative_probability, memory_stream);
-		cuda_module.get_global("light_mesh_triangle_span")         .set_value_async(ptr_light_mesh_triangle_span,          memory_stream);
-		cuda_module.get_global("light_mesh_transform_indices")     .set_value_async(ptr_light_mesh_transform_indices,      memory_stream);
+		ptr_light_mesh_alias_table       = CUDAMemory::malloc<AliasEntry>  (light_mesh_count);
+		ptr_light_mesh_triangle_span     = CUDAMemory::malloc<int2>        (light_mesh_count);
+		ptr_light_mesh_transform_indices = CUDAMemory::malloc<int>         (light_mesh_count);
+		ptr_light_mesh_bvh_nodes         = CUDAMemory::malloc<LightBVHNode>(2 * light_mesh_count - 1);
+		ptr_light_mesh_bvh_leaves        = CUDAMemory::malloc<int>         (scene.meshes.size());
+
+		cuda_module.get_global("light_mesh_alias_table")      .set_value_async(ptr_light_mesh_alias_table,       memory_stream);
+		cuda_module.get_global("light_mesh_triangle_span")    .set_value_async(ptr_light_mesh_triangle_span,     memory_stream);
+		cuda_module.get_global("light_mesh_transform_indices").set_value_async(ptr_light_mesh_transform_indices, memory_stream);
+		cuda_module.get_global("light_mesh_bvh_nodes")        .set_value_async(ptr_light_mesh_bvh_nodes,         memory_stream);
+		cuda_module.get_global("light_mesh_bvh_leaves")       .set_value_async(ptr_light_mesh_bvh_leaves,        memory_stream);
 	}
 }
 
@@ -429,9 +568,14 @@ void Pathtracer::calc_light_mesh_weights() {
 	int    light_mesh_count    = 0;
 	double lights_total_weight = 0.0;
 
+	light_mesh_weights   .clear();
+	light_mesh_primitives.clear();
+
 	for (int i = 0; i < scene.meshes.size(); i++) {
 		const Mesh & mesh = scene.meshes[tlas->indices[i]];
 
+		pinned_light_mesh_bvh_leaves[i] = INVALID;
+
 		bool mesh_is_light = mesh.light.weight > 0.0f;
 		if (mesh_is_light) {
 			int light_index = light_mesh_count++;
@@ -439,26 +583,47 @@ void Pathtracer::calc_light_mesh_weights() {
 			double light_weight_scaled = mesh.light.weight * mesh.scale * mesh.scale;
 			lights_total_weight += light_weight_scaled;
 
-			pinned_light_mesh_cumulative_probability[light_index]   = float(lights_total_weight);
-			pinned_light_mesh_triangle_span         [light_index].x = mesh.light.first_triangle_index;
-			pinned_light_mesh_triangle_span         [light_index].y = mesh.light.first_triangle_index + mesh.light.triangle_count - 1;
-			pinned_light_mesh_transform_indices     [light_index]   = i;
+			light_mesh_weights.push_back(light_weight_scaled);
+
+			// The normal cone of the MeshData only needs to be rotated into world space, as Meshes are scaled uniformly
+			const LightBVHNode & light_bvh_root = light_bvh_roots[mesh.mesh_data_handle.handle];
+
+			LightBVHPrimitive & light_mesh_primitive = light_mesh_primitives.emplace_back();
+			light_mesh_primitive.aabb        = mesh.aabb;
+			light_mesh_primitive.axis        = Vector3::normalize(Matrix4::transform_direction(mesh.transform, light_bvh_root.axis));
+			light_mesh_primitive.cos_theta_o = light_bvh_root.cos_theta_o;
+			light_mesh_primitive.power       = float(light_weight_scaled);
+
+			pinned_light_mesh_triangle_span    [light_index].x = mesh.light.first_triangle_index;
+			pinned_light_mesh_triangle_span    [light_index].y = mesh.light.first_triangle_index + mesh.light.triangle_count - 1;
+			pinned_light_mesh_transform_indices[light_index]   = i;
 		}
 	}
 
 	if (light_mesh_count > 0) {
+		AliasTable::build(light_mesh_weights.data(), light_mesh_count, pinned_light_mesh_alias_table);
+
+		light_mesh_bvh.build(light_mesh_primitives.data(), light_mesh_count);
+
+		memcpy(pinned_light_mesh_bvh_nodes, light_mesh_bvh.nodes.data(), light_mesh_bvh.nodes.size() * sizeof(LightBVHNode));
+
 		for (int i = 0; i < light_mesh_count; i++) {
-			pinned_light_mesh_cumulative_probability[i] /= float(lights_total_weight);
+			pinned_light_mesh_bvh_leaves[pinned_light_mesh_transform_indices[i]] = light_mesh_bvh.leaves[i];
 		}
-		CUDAMemory::memcpy_async(ptr_light_mesh_cumulative_probability, pinned_light_mesh_cumulative_probability, light_mesh_count, memory_stream);
-		CUDAMemory::memcpy_async(ptr_light_mesh_triangle_span,          pinned_light_mesh_triangle_span,          light_mesh_count, memory_stream);
-		CUDAMemory::memcpy_async(ptr_light_mesh_transform_indices,      pinned_light_mesh_transform_indices,      light_mesh_count, memory_stream);
+
+		CUDAMemory::memcpy_async(ptr_light_mesh_alias_table,       pinned_light_mesh_alias_table,       light_mesh_count,              memory_stream);
+		CUDAMemory::memcpy_async(ptr_light_mesh_triangle_span,     pinned_light_mesh_triangle_span,     light_mesh_count,              memory_stream);
+		CUDAMemory::memcpy_async(ptr_light_mesh_transform_indices, pinned_light_mesh_transform_indices, light_mesh_count,              memory_stream);
+		CUDAMemory::memcpy_async(ptr_light_mesh_bvh_nodes,         pinned_light_mesh_bvh_nodes,         light_mesh_bvh.nodes.size(),   memory_stream);
+		CUDAMemory::memcpy_async(ptr_light_mesh_bvh_leaves,        pinned_light_mesh_bvh_leaves,        scene.meshes.size(),           memory_stream);
 	}
 
 	global_lights_total_weight.set_value_async(float(lights_total_weight), memory_stream);
 }
 
 void Pathtracer::update(float delta, Allocator * frame_allocator) {
+	update_assets();
+
 	if (invalidated_materials) {
 		const Array<Material> & materials = scene.asset_manager.materials;
 
@@ -513,6 +678,14 @@ void Pathtracer::update(float delta, Allocator * frame_allocator) {
 
 		scene.check_materials();
 
+		// If the Scene now uses a feature the kernels were specialized without, recompile them.
+		// Features are never removed again, so that editing Materials back and forth does not keep recompiling
+		unsigned scene_features = SceneFeatures::get(materials);
+		if ((scene_features & ~kernel_features) != 0) {
+			set_kernel_features(kernel_features | scene_features);
+			cuda_reload();
+		}
+
 		bool material_types_changed =
 			(had_diffuse    ^ scene.has_diffuse) |
 			(had_plastic    ^ scene.has_plastic) |
@@ -533,10 +706,11 @@ void Pathtracer::update(float delta, Allocator * frame_allocator) {
 				for (int i = num_material_buffers_needed; i < material_ray_buffers.size(); i++) {
 					material_ray_buffers[i].free();
 				}
+				material_ray_buffers.resize(num_material_buffers_needed);
 			} else if (num_material_buffers_needed > material_ray_buffers.size()) {
 				// Allocate new required MaterialBuffers
 				for (int i = material_ray_buffers.size(); i < num_material_buffers_needed; i++) {
-					material_ray_buffers.emplace_back().init(BATCH_SIZE);
+					material_ray_buffers.emplace_back().init(batch_size);
 				}
 			}
 
@@ -568,15 +742,19 @@ void Pathtracer::update(float delta, Allocator * frame_allocator) {
 		bool lights_changed = had_lights ^ scene.has_lights;
 		if (lights_changed) {
 			if (scene.has_lights) {
-				ray_buffer_shadow.init(BATCH_SIZE);
+				ray_buffer_shadow.init(batch_size);
 
 				invalidated_scene = true;
 			} else {
 				ray_buffer_shadow.free();
 
-				CUDAMemory::free(ptr_light_mesh_cumulative_probability);
-				CUDAMemory::free(ptr_light_mesh_triangle_span);
-				CUDAMemory::free(ptr_light_mesh_transform_indices);
+				if (ptr_light_mesh_alias_table.ptr != NULL) {
+					CUDAMemory::free(ptr_light_mesh_alias_table);
+					CUDAMemory::free(ptr_light_mesh_triangle_span);
+					CUDAMemory::free(ptr_light_mesh_transform_indices);
+					CUDAMemory::free(ptr_light_mesh_bvh_nodes);
+					CUDAMemory::free(ptr_light_mesh_bvh_leaves);
+				}
 
 				global_lights_total_weight.set_value_async(0.0f, memory_stream);
 
@@ -588,9 +766,11 @@ void Pathtracer::update(float delta, Allocator * frame_allocator) {
 			global_ray_buffer_shadow.set_value_async(ray_buffer_shadow, memory_stream);
 		}
 
-		if (had_lights) {
+		if (had_lights && ptr_light_triangle_indices.ptr != NULL) {
 			CUDAMemory::free(ptr_light_triangle_indices);
-			CUDAMemory::free(ptr_light_triangle_cumulative_probability);
+			CUDAMemory::free(ptr_light_triangle_alias_table);
+			CUDAMemory::free(ptr_light_bvh_nodes);
+			CUDAMemory::free(ptr_light_bvh_leaves);
 		}
 		if (scene.has_lights) {
 			calc_light_power(frame_allocator);
@@ -656,15 +836,31 @@ void Pathtracer::update(float delta, Allocator * frame_allocator) {
 void Pathtracer::render() {
 	event_pool.reset();
 
+#if ENABLE_RAY_STATS
+	ray_stats.poll();
+#endif
+
 	CUDACALL(cuStreamSynchronize(memory_stream));
 
+	// The origins of Rays are quantized to a grid over the bounds of the TLAS
+	RayReorderBounds reorder_bounds = RayReorder::calc_bounds(tlas_raw.nodes.size() > 0 ? tlas_raw.nodes[0].aabb : AABB::create_empty());
+
+	// Scratch memory of the reorder passes is only used within this frame, so it comes from transient Device memory that is reused every frame
+	CUDAMemory::Ptr<unsigned> ptr_reorder_keys;      // One key per Ray in the batch
+	CUDAMemory::Ptr<int>      ptr_reorder_histogram; // RAY_REORDER_NUM_BUCKETS counts, turned into offsets by kernel_reorder_scan
+
+	if (gpu_config.enable_ray_reordering && gpu_config.num_bounces > 1) {
+		ptr_reorder_keys      = CUDAMemory::malloc_transient<unsigned>(batch_size);
+		ptr_reorder_histogram = CUDAMemory::malloc_transient<int>(RAY_REORDER_NUM_BUCKETS);
+	}
+
 	int pixels_left = pixel_count;
-	int batch_size  = Math::min(BATCH_SIZE, pixel_count);
+	int pixels_per_batch = Math::min(batch_size, pixel_count);
 
-	// Render in batches of BATCH_SIZE pixels at a time
+	// Render in batches of pixels_per_batch pixels at a time
 	while (pixels_left > 0) {
 		int pixel_offset = pixel_count - pixels_left;
-		int pixel_count  = Math::min(batch_size, pixels_left);
+		int pixel_count  = Math::min(pixels_per_batch, pixels_left);
 
 		event_pool.record(event_desc_primary);
 
@@ -672,6 +868,16 @@ void Pathtracer::render() {
 		kernel_generate.execute(sample_index, pixel_offset, pixel_count);
 
 		for (int bounce = 0; bounce < gpu_config.num_bounces; bounce++) {
+			// Sort the Rays emitted by the previous bounce by direction and origin, so that Rays in a warp traverse similar parts of the BVH
+			if (gpu_config.enable_ray_reordering && bounce > 0) {
+				event_pool.record(event_desc_reorder[bounce]);
+
+				CUDACALL(cuMemsetD32Async(ptr_reorder_histogram.ptr, 0, RAY_REORDER_NUM_BUCKETS, nullptr));
+				kernel_reorder_keys   .execute(bounce, reorder_bounds, ptr_reorder_keys.ptr, ptr_reorder_histogram.ptr);
+				kernel_reorder_scan   .execute(ptr_reorder_histogram.ptr);
+				kernel_reorder_scatter.execute(bounce, ptr_reorder_keys.ptr, ptr_reorder_histogram.ptr);
+			}
+
 			// Extend all Rays that are still alive to their next Triangle intersection
 			event_pool.record(event_desc_trace[bounce]);
 			kernel_trace->execute(bounce);
@@ -704,15 +910,19 @@ void Pathtracer::render() {
 			}
 		}
 
-		pixels_left -= batch_size;
+		pixels_left -= pixels_per_batch;
 
 		if (pixels_left > 0) {
 			// Set buffer sizes to appropriate pixel count for next Batch
-			pinned_buffer_sizes->reset(Math::min(batch_size, pixels_left));
+			pinned_buffer_sizes->reset(Math::min(pixels_per_batch, pixels_left));
 			global_buffer_sizes.set_value(*pinned_buffer_sizes);
 		}
 	}
 
+#if ENABLE_RAY_STATS
+	ray_stats.record(global_ray_stats.ptr(), sample_index, pixel_count, gpu_config.num_bounces);
+#endif
+
 	if (gpu_config.enable_svgf) {
 		// Temporal reprojection + integration
 		event_pool.record(event_desc_svgf_reproject);
@@ -761,7 +971,7 @@ void Pathtracer::render() {
 	event_pool.record(event_desc_end);
 
 	// Reset buffer sizes to default for next frame
-	pinned_buffer_sizes->reset(batch_size);
+	pinned_buffer_sizes->reset(pixels_per_batch);
 	global_buffer_sizes.set_value(*pinned_buffer_sizes);
 
 	aovs_clear_to_zero();
@@ -778,9 +988,19 @@ void Pathtracer::render_gui() {
 
 		invalidated_gpu_config |= ImGui::Checkbox("NEE", &gpu_config.enable_next_event_estimation);
 		invalidated_gpu_config |= ImGui::Checkbox("MIS", &gpu_config.enable_multiple_importance_sampling);
+		invalidated_gpu_config |= ImGui::Checkbox("Light BVH", &gpu_config.enable_light_bvh);
+		invalidated_gpu_config |= ImGui::Checkbox("Sky Importance Sampling", &gpu_config.enable_sky_importance_sampling);
 
 		invalidated_gpu_config |= ImGui::Checkbox("Russian Roulete", &gpu_config.enable_russian_roulette);
+
+		invalidated_gpu_config |= ImGui::Checkbox("Ray Reordering", &gpu_config.enable_ray_reordering);
+	}
+
+#if ENABLE_RAY_STATS
+	if (ImGui::CollapsingHeader("Ray Statistics")) {
+		ray_stats.render_gui();
 	}
+#endif
 
 	if (ImGui::CollapsingHeader("Auxilary AOVs", ImGuiTreeNodeFlags_DefaultOpen)) {
 		invalidated_aovs |= aov_render_gui_checkbox(AOVType::ALBEDO,   "Albedo");
@@ -1,5 +1,7 @@
 #pragma once
 #include "Renderer/Integrators/Integrator.h"
+#include "Renderer/Integrators/RayStats.h"
+#include "Renderer/Integrators/RayReorder.h"
 #include "Renderer/Material.h"
 
 struct TraceBuffer {
@@ -17,6 +19,9 @@ struct TraceBuffer {
 
 	CUDAMemory::Ptr<float> last_pdf;
 
+	// Size of one element summed over all arrays
+	static constexpr size_t ELEMENT_SIZE = 2 * sizeof(float3) + sizeof(float4) + sizeof(float2) + 2 * sizeof(int) + sizeof(float3) + sizeof(float);
+
 	void init(int buffer_size) {
 		ray_origin   .init(buffer_size);
 		ray_direction.init(buffer_size);
@@ -59,6 +64,8 @@ struct MaterialBuffer {
 	CUDAMemory::Ptr<int> pixel_index;
 	CUDAVector3_SoA      throughput;
 
+	static constexpr size_t ELEMENT_SIZE = sizeof(float3) + sizeof(int) + sizeof(float2) + sizeof(float4) + sizeof(int) + sizeof(float3);
+
 	void init(int buffer_size) {
 		direction.init(buffer_size);
 
@@ -91,6 +98,8 @@ struct ShadowRayBuffer {
 	CUDAMemory::Ptr<float>  max_distance;
 	CUDAMemory::Ptr<float4> illumination_and_pixel_index;
 
+	static constexpr size_t ELEMENT_SIZE = 2 * sizeof(float3) + sizeof(float) + sizeof(float4);
+
 	void init(int buffer_size) {
 		ray_origin   .init(buffer_size);
 		ray_direction.init(buffer_size);
@@ -137,6 +146,9 @@ struct Pathtracer final : Integrator {
 	CUDAKernel kernel_trace_bvh2;
 	CUDAKernel kernel_trace_bvh4;
 	CUDAKernel kernel_trace_bvh8;
+	CUDAKernel kernel_reorder_keys;
+	CUDAKernel kernel_reorder_scan;
+	CUDAKernel kernel_reorder_scatter;
 	CUDAKernel kernel_sort;
 	CUDAKernel kernel_material_diffuse;
 	CUDAKernel kernel_material_plastic;
@@ -163,6 +175,8 @@ struct Pathtracer final : Integrator {
 	TraceBuffer     ray_buffer_trace_1;
 	ShadowRayBuffer ray_buffer_shadow;
 
+	unsigned kernel_features; // SceneFeatures the CUDA Module is currently specialized for, see Renderer/SceneFeatures.h
+
 	Array<MaterialBuffer>               material_ray_buffers;
 	CUDAMemory::Ptr<MaterialBuffer> ptr_material_ray_buffers;
 
@@ -172,6 +186,11 @@ struct Pathtracer final : Integrator {
 
 	CUDAModule::Global global_svgf_data;
 
+#if ENABLE_RAY_STATS
+	RayStatsTracker    ray_stats;
+	CUDAModule::Global global_ray_stats;
+#endif
+
 	CUarray array_gbuffer_normal_and_depth;
 	CUarray array_gbuffer_mesh_id_and_triangle_id;
 	CUarray array_gbuffer_screen_position_prev;
@@ -195,15 +214,26 @@ struct Pathtracer final : Integrator {
 	// Light Sampling
 	CUDAModule::Global global_lights_total_weight;
 
-	CUDAMemory::Ptr<int>   ptr_light_triangle_indices;
-	CUDAMemory::Ptr<float> ptr_light_triangle_cumulative_probability;
+	CUDAMemory::Ptr<int>          ptr_light_triangle_indices;
+	CUDAMemory::Ptr<AliasEntry>   ptr_light_triangle_alias_table; // One table per light MeshData, spanning its triangles
+	CUDAMemory::Ptr<LightBVHNode> ptr_light_bvh_nodes;            // One BVH per light MeshData, see CUDA/LightBVH.h
+	CUDAMemory::Ptr<int>          ptr_light_bvh_leaves;
 
-	CUDAMemory::Ptr<float> ptr_light_mesh_cumulative_probability;
-	CUDAMemory::Ptr<int2>  ptr_light_mesh_triangle_span;
-	CUDAMemory::Ptr<int>   ptr_light_mesh_transform_indices;
+	CUDAMemory::Ptr<AliasEntry>   ptr_light_mesh_alias_table;
+	CUDAMemory::Ptr<int2>         ptr_light_mesh_triangle_span;
+	CUDAMemory::Ptr<int>          ptr_light_mesh_transform_indices;
+	CUDAMemory::Ptr<LightBVHNode> ptr_light_mesh_bvh_nodes;
+	CUDAMemory::Ptr<int>          ptr_light_mesh_bvh_leaves;
+
+	Array<double> light_mesh_weights; // Used to construct the alias table over light Meshes
+
+	Array<LightBVHNode>      light_bvh_roots;       // Root of the light BVH of every MeshData that is used as a Light, indexed by MeshDataHandle
+	Array<LightBVHPrimitive> light_mesh_primitives; // Used to construct the light BVH over light Meshes
+	LightBVH                 light_mesh_bvh;
 
 	// Timing Events
 	CUDAEvent::Desc event_desc_primary;
+	CUDAEvent::Desc event_desc_reorder[MAX_BOUNCES];
 	CUDAEvent::Desc event_desc_trace[MAX_BOUNCES];
 	CUDAEvent::Desc event_desc_sort [MAX_BOUNCES];
 	CUDAEvent::Desc event_desc_material_diffuse   [MAX_BOUNCES];
@@ -228,10 +258,20 @@ struct Pathtracer final : Integrator {
 	void cuda_free() override;
 
 	void init_module();
+	void set_kernel_features(unsigned features);
+	void init_kernels() override;
 	void init_events();
 
+	// Memory per pixel of a batch, assuming the worst case of all Material types (two MaterialBuffers) and Lights being present.
+	// Includes the transient ray reordering key of every pixel, see render
+	static constexpr size_t BATCH_BYTES_PER_PIXEL = 2 * TraceBuffer::ELEMENT_SIZE + 2 * MaterialBuffer::ELEMENT_SIZE + ShadowRayBuffer::ELEMENT_SIZE + sizeof(unsigned);
+
+	void init_batch_buffers();
+	void free_batch_buffers();
+
 	void resize_init(unsigned frame_buffer_handle, int width, int height) override; // Part of resize that initializes new size
 	void resize_free()                                                    override; // Part of resize that cleans up old size
+	void resize_kernels()                                                 override; // Part of resize that sets Kernel launch dimensions
 
 	void svgf_init();
 	void svgf_free();
@@ -0,0 +1,447 @@
+#include "RayReorder.h"
+
+#include "Core/IO.h"
+#include "Core/Random.h"
+#include "Core/Timer.h"
+
+#include "BVH/BVH.h"
+#include "BVH/Builders/SAHBuilder.h"
+
+#include "Renderer/Triangle.h"
+
+#include "Util/Check.h"
+#include "Util/Geometry.h"
+
+static constexpr unsigned GRID_SIZE = 1u << RAY_REORDER_ORIGIN_BITS;
+
+RayReorderBounds RayReorder::calc_bounds(const AABB & aabb) {
+	RayReorderBounds bounds = { };
+
+	// All origins map to the first cell of the grid
+	if (aabb.is_empty()) return bounds;
+
+	Vector3 extent = aabb.max - aabb.min;
+
+	bounds.min_x = aabb.min.x;
+	bounds.min_y = aabb.min.y;
+	bounds.min_z = aabb.min.z;
+	bounds.scale_x = extent.x > 0.0f ? float(GRID_SIZE) / extent.x : 0.0f;
+	bounds.scale_y = extent.y > 0.0f ? float(GRID_SIZE) / extent.y : 0.0f;
+	bounds.scale_z = extent.z > 0.0f ? float(GRID_SIZE) / extent.z : 0.0f;
+
+	return bounds;
+}
+
+unsigned RayReorder::calc_key(const RayReorderBounds & bounds, const Vector3 & origin, const Vector3 & direction) {
+	return ray_reorder_key(bounds, origin.x, origin.y, origin.z, direction.x, direction.y, direction.z);
+}
+
+void RayReorder::sort(const unsigned * keys, int count, int * order) {
+	Array<int> offsets(RAY_REORDER_NUM_BUCKETS);
+
+	for (int i = 0; i < count; i++) {
+		ASSERT(keys[i] < RAY_REORDER_NUM_BUCKETS);
+		offsets[keys[i]]++;
+	}
+
+	int offset = 0;
+	for (int b = 0; b < RAY_REORDER_NUM_BUCKETS; b++) {
+		int bucket_count = offsets[b];
+		offsets[b] = offset;
+		offset += bucket_count;
+	}
+
+	for (int i = 0; i < count; i++) {
+		order[offsets[keys[i]]++] = i;
+	}
+}
+
+// Closest hit traversal, mirrors bvh2_trace in CUDA/Raytracing/BVH2.h (including the order in which children are visited)
+static bool trace(const BVH2 & bvh, const Array<Triangle> & triangles, const Vector3 & origin, const Vector3 & direction, float & t_hit, int & triangle_hit, Array<int> * fetched_nodes) {
+	Vector3 inv_direction = Vector3(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+
+	auto intersects_aabb = [&](const AABB & aabb, float t_max) {
+		float t_near = 0.0f;
+		float t_far  = t_max;
+
+		for (int dimension = 0; dimension < 3; dimension++) {
+			float t0 = (aabb.min[dimension] - origin[dimension]) * inv_direction[dimension];
+			float t1 = (aabb.max[dimension] - origin[dimension]) * inv_direction[dimension];
+			if (t0 > t1) Util::swap(t0, t1);
+
+			t_near = Math::max(t_near, t0);
+			t_far  = Math::min(t_far,  t1);
+		}
+		return t_near <= t_far;
+	};
+
+	auto intersects_triangle = [&](const Triangle & triangle, float & t) {
+		Vector3 edge_1 = triangle.position_1 - triangle.position_0;
+		Vector3 edge_2 = triangle.position_2 - triangle.position_0;
+
+		Vector3 h = Vector3::cross(direction, edge_2);
+		float   a = Vector3::dot(edge_1, h);
+
+		float   f = 1.0f / a;
+		Vector3 s = origin - triangle.position_0;
+		float   u = f * Vector3::dot(s, h);
+		if (u < 0.0f || u > 1.0f) return false;
+
+		Vector3 q = Vector3::cross(s, edge_1);
+		float   v = f * Vector3::dot(direction, q);
+		if (v < 0.0f || u + v > 1.0f) return false;
+
+		t = f * Vector3::dot(edge_2, q);
+		return t > 0.0f;
+	};
+
+	t_hit        = INFINITY;
+	triangle_hit = INVALID;
+
+	int stack[128];
+	int stack_size = 0;
+	stack[stack_size++] = 0;
+
+	while (stack_size > 0) {
+		int node_index = stack[--stack_size];
+		const BVHNode2 & node = bvh.nodes[node_index];
+
+		if (fetched_nodes) fetched_nodes->push_back(node_index);
+
+		if (!intersects_aabb(node.aabb, t_hit)) continue;
+
+		if (node.is_leaf()) {
+			for (unsigned i = node.first; i < node.first + node.count; i++) {
+				int triangle_index = bvh.indices[i];
+
+				float t;
+				if (intersects_triangle(triangles[triangle_index], t) && t < t_hit) {
+					t_hit        = t;
+					triangle_hit = triangle_index;
+				}
+			}
+		} else {
+			ASSERT(stack_size + 2 <= Util::array_count(stack));
+
+			// Push the child that should be visited first last
+			bool left_first = direction[node.axis] > 0.0f;
+			stack[stack_size++] = left_first ? node.left + 1 : node.left;
+			stack[stack_size++] = left_first ? node.left     : node.left + 1;
+		}
+	}
+
+	return triangle_hit != INVALID;
+}
+
+RayReorder::Locality RayReorder::evaluate_locality(const BVH2 & bvh, const Array<Triangle> & triangles, const RayStream & stream, const int * order) {
+	// Direct mapped cache of 2048 Nodes, 64 KB worth of BVHNode2's, which is in the order of the L1 cache of an SM
+	constexpr int CACHE_SIZE = 2048;
+
+	Array<int> cache(CACHE_SIZE);
+	for (int i = 0; i < CACHE_SIZE; i++) {
+		cache[i] = INVALID;
+	}
+
+	Array<int> node_last_warp(bvh.nodes.size()); // Index of the last warp that fetched the Node, plus one
+	Array<int> fetched_nodes;
+
+	size_t num_fetches      = 0;
+	size_t num_cache_hits   = 0;
+	size_t num_unique_nodes = 0;
+
+	int ray_count  = int(stream.size());
+	int warp_count = (ray_count + WARP_SIZE - 1) / WARP_SIZE;
+
+	for (int i = 0; i < ray_count; i++) {
+		int ray_index = order ? order[i] : i;
+		int warp      = i / WARP_SIZE;
+
+		float t_hit;
+		int   triangle_hit;
+
+		fetched_nodes.clear();
+		trace(bvh, triangles, stream.origins[ray_index], stream.directions[ray_index], t_hit, triangle_hit, &fetched_nodes);
+
+		for (size_t n = 0; n < fetched_nodes.size(); n++) {
+			int node_index = fetched_nodes[n];
+
+			if (node_last_warp[node_index] != warp + 1) {
+				node_last_warp[node_index] = warp + 1;
+				num_unique_nodes++;
+			}
+
+			int & cache_line = cache[node_index % CACHE_SIZE];
+			if (cache_line == node_index) {
+				num_cache_hits++;
+			} else {
+				cache_line = node_index;
+			}
+		}
+		num_fetches += fetched_nodes.size();
+	}
+
+	Locality locality = { };
+	if (ray_count > 0) {
+		locality.nodes_per_ray         = double(num_fetches)      / double(ray_count);
+		locality.unique_nodes_per_warp = double(num_unique_nodes) / double(warp_count);
+		locality.cache_hit_rate        = num_fetches > 0 ? double(num_cache_hits) / double(num_fetches) : 0.0;
+	}
+	return locality;
+}
+
+bool RayReorder::run_check() {
+	Check::Checker check;
+
+	constexpr unsigned MORTON_BITS = 3 * RAY_REORDER_ORIGIN_BITS;
+	constexpr unsigned MORTON_MASK = (1u << MORTON_BITS) - 1;
+
+	AABB aabb = { Vector3(-2.0f, 0.0f, 10.0f), Vector3(6.0f, 1.0f, 12.0f) };
+	RayReorderBounds bounds = calc_bounds(aabb);
+
+	// Direction octant occupies the most significant bits
+	bool octants_valid = true;
+	for (unsigned octant = 0; octant < 8; octant++) {
+		Vector3 direction = Vector3(
+			octant & 1 ? -1.0f : 1.0f,
+			octant & 2 ? -1.0f : 1.0f,
+			octant & 4 ? -1.0f : 1.0f
+		);
+		unsigned key = calc_key(bounds, aabb.get_center(), direction);
+		octants_valid &= (key >> MORTON_BITS) == octant;
+	}
+	check(octants_valid, "Key contains the direction octant");
+
+	Vector3 direction = Vector3::normalize(Vector3(1.0f, 2.0f, 3.0f));
+
+	check((calc_key(bounds, aabb.min, direction) & MORTON_MASK) == 0,           "Minimum of the bounds maps to the first cell");
+	check((calc_key(bounds, aabb.max, direction) & MORTON_MASK) == MORTON_MASK, "Maximum of the bounds maps to the last cell");
+
+	check(calc_key(bounds, aabb.min - Vector3(100.0f), direction) == calc_key(bounds, aabb.min, direction), "Origins below the bounds are clamped");
+	check(calc_key(bounds, aabb.max + Vector3(100.0f), direction) == calc_key(bounds, aabb.max, direction), "Origins above the bounds are clamped");
+	check(calc_key(bounds, Vector3(NAN), direction) == calc_key(bounds, aabb.min, direction), "NaN origins map to the first cell");
+
+	check(calc_key(calc_bounds(AABB::create_empty()), Vector3(1.0f), direction) == 0, "Empty bounds map all origins to the first cell");
+
+	// Morton code increases along every axis
+	bool morton_monotonic = true;
+	for (int dimension = 0; dimension < 3; dimension++) {
+		unsigned key_prev = 0;
+		for (unsigned cell = 0; cell < GRID_SIZE; cell++) {
+			Vector3 origin = aabb.min;
+			origin[dimension] += (float(cell) + 0.5f) / float(GRID_SIZE) * (aabb.max[dimension] - aabb.min[dimension]);
+
+			unsigned key = calc_key(bounds, origin, direction) & MORTON_MASK;
+			if (cell > 0) morton_monotonic &= key > key_prev;
+			key_prev = key;
+		}
+	}
+	check(morton_monotonic, "Morton code increases along every axis");
+
+	// Sort
+	constexpr int COUNT = 10000;
+
+	RNG rng(1337);
+
+	Array<unsigned> keys(COUNT);
+	for (int i = 0; i < COUNT; i++) {
+		// Few distinct keys, so that buckets contain many Rays
+		keys[i] = rng.get_uint32(64) * (RAY_REORDER_NUM_BUCKETS / 64) + (i % 3);
+	}
+
+	Array<int> order(COUNT);
+	sort(keys.data(), COUNT, order.data());
+
+	Array<bool> seen(COUNT);
+	bool is_permutation = true;
+	bool is_sorted      = true;
+	bool is_stable      = true;
+	for (int i = 0; i < COUNT; i++) {
+		is_permutation &= order[i] >= 0 && order[i] < COUNT && !seen[order[i]];
+		if (!is_permutation) break;
+		seen[order[i]] = true;
+
+		if (i > 0) {
+			is_sorted &= keys[order[i - 1]] <= keys[order[i]];
+			is_stable &= keys[order[i - 1]] != keys[order[i]] || order[i - 1] < order[i];
+		}
+	}
+	check(is_permutation, "Sort produces a permutation");
+	check(is_sorted,      "Sort orders by key");
+	check(is_stable,      "Sort is stable");
+
+	// Emulation of the Device passes: histogram, exclusive scan per thread and per block, and scatter using atomics.
+	// Rays are scattered in reverse order, as on the Device the order within a bucket is arbitrary
+	{
+		constexpr int BLOCK_SIZE         = 1024;
+		constexpr int BUCKETS_PER_THREAD = RAY_REORDER_NUM_BUCKETS / BLOCK_SIZE;
+
+		Array<int> histogram(RAY_REORDER_NUM_BUCKETS);
+		for (int i = 0; i < COUNT; i++) {
+			histogram[keys[i]]++;
+		}
+
+		Array<int> thread_sums(BLOCK_SIZE);
+		for (int thread = 0; thread < BLOCK_SIZE; thread++) {
+			for (int i = 0; i < BUCKETS_PER_THREAD; i++) {
+				thread_sums[thread] += histogram[thread * BUCKETS_PER_THREAD + i];
+			}
+		}
+
+		int thread_offset = 0;
+		for (int thread = 0; thread < BLOCK_SIZE; thread++) {
+			int offset = thread_offset;
+			for (int i = 0; i < BUCKETS_PER_THREAD; i++) {
+				int & bucket = histogram[thread * BUCKETS_PER_THREAD + i];
+				int count = bucket;
+				bucket = offset;
+				offset += count;
+			}
+			thread_offset += thread_sums[thread];
+		}
+
+		Array<int> order_device(COUNT);
+		for (int i = COUNT - 1; i >= 0; i--) {
+			order_device[histogram[keys[i]]++] = i;
+		}
+
+		bool keys_match = true;
+		for (int i = 0; i < COUNT; i++) {
+			keys_match &= keys[order_device[i]] == keys[order[i]];
+		}
+		check(keys_match, "Device passes produce the same key sequence as the Host sort");
+	}
+
+	return check.report("Ray reorder"_sv);
+}
+
+// Scene of a closed room filled with spheres, gives secondary Rays a mix of short and long paths through the BVH
+static Array<Triangle> create_scene(RNG & rng) {
+	Array<Triangle> triangles = Geometry::cube(Matrix4::create_scale(10.0f));
+
+	for (int i = 0; i < 32; i++) {
+		Vector3 position = Vector3(
+			rng.get_float() * 16.0f - 8.0f,
+			rng.get_float() * 16.0f - 8.0f,
+			rng.get_float() * 16.0f - 8.0f
+		);
+		float radius = 0.5f + rng.get_float() * 1.5f;
+
+		Array<Triangle> sphere = Geometry::sphere(Matrix4::create_translation(position) * Matrix4::create_scale(radius), 3);
+		for (size_t t = 0; t < sphere.size(); t++) {
+			triangles.push_back(sphere[t]);
+		}
+	}
+
+	return triangles;
+}
+
+// Continues every Ray of the stream that hits something with a diffuse bounce, emitting the next Rays in the same order
+static RayReorder::RayStream record_next_bounce(const BVH2 & bvh, const Array<Triangle> & triangles, const RayReorder::RayStream & stream, RNG & rng) {
+	RayReorder::RayStream next;
+
+	for (size_t i = 0; i < stream.size(); i++) {
+		const Vector3 & origin    = stream.origins   [i];
+		const Vector3 & direction = stream.directions[i];
+
+		float t_hit;
+		int   triangle_hit;
+		if (!trace(bvh, triangles, origin, direction, t_hit, triangle_hit, nullptr)) continue;
+
+		const Triangle & triangle = triangles[triangle_hit];
+
+		Vector3 normal = Vector3::normalize(Vector3::cross(triangle.position_1 - triangle.position_0, triangle.position_2 - triangle.position_0));
+		if (Vector3::dot(normal, direction) > 0.0f) {
+			normal = -normal;
+		}
+
+		// Cosine weighted direction around the normal
+		Vector3 direction_out;
+		do {
+			direction_out = Vector3(
+				rng.get_float() * 2.0f - 1.0f,
+				rng.get_float() * 2.0f - 1.0f,
+				rng.get_float() * 2.0f - 1.0f
+			);
+		} while (Vector3::length(direction_out) > 1.0f);
+		direction_out = Vector3::normalize(normal + Vector3::normalize(direction_out));
+
+		next.origins   .push_back(origin + t_hit * direction + 0.001f * normal);
+		next.directions.push_back(direction_out);
+	}
+
+	return next;
+}
+
+void RayReorder::run_benchmark() {
+	constexpr int WIDTH  = 256;
+	constexpr int HEIGHT = 256;
+
+	RNG rng(1337);
+
+	Array<Triangle> triangles = create_scene(rng);
+
+	BVH2 bvh;
+	{
+		ScopeTimer timer("BVH Construction"_sv);
+		SAHBuilder(bvh, triangles.size()).build(triangles);
+	}
+
+	RayReorderBounds bounds = calc_bounds(bvh.nodes[0].aabb);
+
+	// Primary Rays of a pinhole camera in the corner of the room, in scanline order like kernel_generate
+	RayStream stream;
+	for (int y = 0; y < HEIGHT; y++) {
+		for (int x = 0; x < WIDTH; x++) {
+			Vector3 direction = Vector3(
+				(float(x) + 0.5f) / float(WIDTH)  - 0.5f,
+				(float(y) + 0.5f) / float(HEIGHT) - 0.5f,
+				1.0f
+			);
+			stream.origins   .push_back(Vector3(-6.0f, 0.0f, -9.0f));
+			stream.directions.push_back(Vector3::normalize(direction));
+		}
+	}
+
+	IO::print("Ray reordering locality, {} triangles, {} BVH Nodes, {}x{} primary Rays\n"_sv, triangles.size(), bvh.nodes.size(), WIDTH, HEIGHT);
+	IO::print("Lower unique Nodes per warp and higher cache hit rate mean more coherent traversal\n"_sv);
+
+	for (int bounce = 1; bounce <= 3; bounce++) {
+		stream = record_next_bounce(bvh, triangles, stream, rng);
+
+		int ray_count = int(stream.size());
+
+		Array<int> order_shuffled(ray_count);
+		for (int i = 0; i < ray_count; i++) {
+			order_shuffled[i] = i;
+		}
+		for (int i = ray_count - 1; i > 0; i--) {
+			Util::swap(order_shuffled[i], order_shuffled[rng.get_uint32(i + 1)]);
+		}
+
+		Array<unsigned> keys(ray_count);
+		for (int i = 0; i < ray_count; i++) {
+			keys[i] = calc_key(bounds, stream.origins[i], stream.directions[i]);
+		}
+
+		// Sorting happens after shuffling, so that the sorted order does not inherit the coherence of the emission order
+		Array<unsigned> keys_shuffled(ray_count);
+		for (int i = 0; i < ray_count; i++) {
+			keys_shuffled[i] = keys[order_shuffled[i]];
+		}
+		Array<int> order_sorted(ray_count);
+		sort(keys_shuffled.data(), ray_count, order_sorted.data());
+		for (int i = 0; i < ray_count; i++) {
+			order_sorted[i] = order_shuffled[order_sorted[i]];
+		}
+
+		IO::print("Bounce {} ({} Rays):\n"_sv, bounce, ray_count);
+
+		auto report = [&](StringView name, const int * order) {
+			Locality locality = evaluate_locality(bvh, triangles, stream, order);
+			IO::print("\t{}: {} Nodes per Ray, {} unique Nodes per warp, {} cache hit rate\n"_sv, name, locality.nodes_per_ray, locality.unique_nodes_per_warp, locality.cache_hit_rate);
+		};
+		report("emission order"_sv, nullptr);
+		report("shuffled      "_sv, order_shuffled.data());
+		report("sorted        "_sv, order_sorted.data());
+	}
+}
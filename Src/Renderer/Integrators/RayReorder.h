@@ -0,0 +1,49 @@
+#pragma once
+#include "CUDA/Common.h"
+
+#include "Core/Array.h"
+
+#include "Math/AABB.h"
+#include "Math/Vector3.h"
+
+struct BVH2;
+struct Triangle;
+
+// Host reference of the ray reordering pass of the Pathtracer (kernel_reorder_keys, kernel_reorder_scan and kernel_reorder_scatter).
+// When enabled, the Rays of every bounce after the first are sorted by ray_reorder_key (see CUDA/Common.h) before they are traced,
+// so that Rays with a similar direction and origin end up in the same warp and visit the same BVH Nodes.
+// The Device sorts using a counting sort over RAY_REORDER_NUM_BUCKETS buckets, where the order within a bucket is decided by atomics.
+// The Host uses the stable version of the same counting sort
+namespace RayReorder {
+	// Fits the grid that origins are quantized to around the given Scene bounds
+	RayReorderBounds calc_bounds(const AABB & aabb);
+
+	unsigned calc_key(const RayReorderBounds & bounds, const Vector3 & origin, const Vector3 & direction);
+
+	// Stable counting sort on the keys, writes the index of the Ray that ends up at position i to order[i]
+	void sort(const unsigned * keys, int count, int * order);
+
+	// Rays in the order they were emitted, as recorded from a single bounce
+	struct RayStream {
+		Array<Vector3> origins;
+		Array<Vector3> directions;
+
+		size_t size() const { return origins.size(); }
+	};
+
+	// Coherence of BVH traversal when the Rays of a stream are traced in a given order, WARP_SIZE consecutive Rays at a time
+	struct Locality {
+		double nodes_per_ray;         // Average number of Nodes fetched by a Ray
+		double unique_nodes_per_warp; // Average number of distinct Nodes fetched by a warp, lower means Rays in a warp share more of their traversal
+		double cache_hit_rate;        // Fraction of Node fetches that hit a small simulated cache
+	};
+
+	// Traces the Rays of the stream in the given order (or in emission order if order is nullptr) through the BVH and measures the locality of Node fetches
+	Locality evaluate_locality(const BVH2 & bvh, const Array<Triangle> & triangles, const RayStream & stream, const int * order = nullptr);
+
+	// Checks the key and the sort (including an emulation of the Device passes) on the CPU
+	bool run_check();
+
+	// Records the Rays of the first and second bounce of a synthetic Scene and reports their locality in emission order, shuffled, and sorted
+	void run_benchmark();
+}
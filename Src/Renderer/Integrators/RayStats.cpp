@@ -0,0 +1,249 @@
+#include "RayStats.h"
+
+#if ENABLE_RAY_STATS
+#include <Imgui/imgui.h>
+
+#include "Core/IO.h"
+#include "Core/Log.h"
+
+#include "Device/CUDACall.h"
+#include "Device/CUDAMemory.h"
+
+#include "Util/Util.h"
+#include "Util/StringUtil.h"
+
+static constexpr const char * ray_stat_names[] = {
+	"active",
+	"missed",
+	"hit_light",
+	"diffuse",
+	"plastic",
+	"dielectric",
+	"conductor",
+	"medium_scatter",
+	"russian_roulette",
+	"last_bounce",
+	"absorbed",
+	"shadow"
+};
+static_assert(Util::array_count(ray_stat_names) == int(RayStat::COUNT));
+
+const char * RayStatsTracker::get_name(RayStat stat) {
+	return ray_stat_names[int(stat)];
+}
+
+void RayStatsTracker::init() {
+	pinned_stats = CUDAMemory::malloc_pinned<RayStats>(NUM_SLOTS);
+
+	for (int i = 0; i < NUM_SLOTS; i++) {
+		slots[i] = { };
+		CUDACALL(cuEventCreate(&slots[i].event, CU_EVENT_DISABLE_TIMING));
+	}
+	slot_record_index = 0;
+	slot_poll_index   = 0;
+
+	history.clear();
+	history_offset = 0;
+}
+
+void RayStatsTracker::free() {
+	for (int i = 0; i < NUM_SLOTS; i++) {
+		if (slots[i].pending) {
+			CUDACALL(cuEventSynchronize(slots[i].event));
+		}
+		CUDACALL(cuEventDestroy(slots[i].event));
+	}
+
+	CUDAMemory::free_pinned(pinned_stats);
+}
+
+void RayStatsTracker::record(CUdeviceptr ptr_ray_stats, int sample_index, int pixel_count, int num_bounces) {
+	Slot & slot = slots[slot_record_index];
+
+	// If the Host is NUM_SLOTS frames ahead of the Device all slots are still pending and this frame is skipped
+	if (!slot.pending) {
+		slot.pending      = true;
+		slot.sample_index = sample_index;
+		slot.pixel_count  = pixel_count;
+		slot.num_bounces  = num_bounces;
+
+		CUDACALL(cuMemcpyDtoHAsync(&pinned_stats[slot_record_index], ptr_ray_stats, sizeof(RayStats), nullptr));
+		CUDACALL(cuEventRecord(slot.event, nullptr));
+
+		slot_record_index = (slot_record_index + 1) % NUM_SLOTS;
+	}
+
+	// Clear the counters for the next frame, ordered after the copy on the same stream
+	CUDACALL(cuMemsetD32Async(ptr_ray_stats, 0, sizeof(RayStats) / sizeof(unsigned), nullptr));
+}
+
+void RayStatsTracker::poll() {
+	while (slots[slot_poll_index].pending) {
+		CUresult result = cuEventQuery(slots[slot_poll_index].event);
+		if (result == CUDA_ERROR_NOT_READY) break;
+		CUDACALL(result);
+
+		consume(slot_poll_index);
+	}
+}
+
+void RayStatsTracker::flush() {
+	while (slots[slot_poll_index].pending) {
+		CUDACALL(cuEventSynchronize(slots[slot_poll_index].event));
+
+		consume(slot_poll_index);
+	}
+}
+
+void RayStatsTracker::consume(int slot_index) {
+	Slot & slot = slots[slot_index];
+	ASSERT(slot.pending);
+
+	Frame frame = { };
+	frame.sample_index = slot.sample_index;
+	frame.pixel_count  = slot.pixel_count;
+	frame.num_bounces  = slot.num_bounces;
+	frame.stats        = pinned_stats[slot_index];
+
+	if (history.size() < size_t(HISTORY_SIZE)) {
+		history.push_back(frame);
+	} else {
+		history[history_offset] = frame;
+		history_offset = (history_offset + 1) % HISTORY_SIZE;
+	}
+
+	slot.pending = false;
+	slot_poll_index = (slot_index + 1) % NUM_SLOTS;
+}
+
+const RayStatsTracker::Frame * RayStatsTracker::get_latest() const {
+	if (history.size() == 0) return nullptr;
+
+	return &history[(history_offset + history.size() - 1) % history.size()];
+}
+
+void RayStatsTracker::render_gui() {
+	const Frame * frame = get_latest();
+	if (!frame) {
+		ImGui::TextUnformatted("No statistics available yet");
+		return;
+	}
+
+	ImGui::Text("Frame %i, %i paths", frame->sample_index, frame->pixel_count);
+
+	// Occupancy (fraction of paths still alive) per bounce
+	float occupancy[MAX_BOUNCES];
+	for (int bounce = 0; bounce < frame->num_bounces; bounce++) {
+		occupancy[bounce] = frame->get_occupancy(bounce);
+	}
+	ImGui::PlotHistogram("Occupancy", occupancy, frame->num_bounces, 0, nullptr, 0.0f, 1.0f, ImVec2(0.0f, 60.0f));
+
+	constexpr ImGuiTableFlags table_flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollX | ImGuiTableFlags_ScrollY | ImGuiTableFlags_SizingFixedFit;
+
+	if (ImGui::BeginTable("Ray Statistics", 2 + int(RayStat::COUNT), table_flags, ImVec2(0.0f, 200.0f))) {
+		ImGui::TableSetupScrollFreeze(1, 1);
+		ImGui::TableSetupColumn("bounce");
+		ImGui::TableSetupColumn("occupancy");
+		for (int i = 0; i < int(RayStat::COUNT); i++) {
+			ImGui::TableSetupColumn(get_name(RayStat(i)));
+		}
+		ImGui::TableHeadersRow();
+
+		for (int bounce = 0; bounce < frame->num_bounces; bounce++) {
+			if (frame->get(bounce, RayStat::ACTIVE) == 0) break; // All paths have terminated
+
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn(); ImGui::Text("%i", bounce);
+			ImGui::TableNextColumn(); ImGui::Text("%.3f", occupancy[bounce]);
+
+			for (int i = 0; i < int(RayStat::COUNT); i++) {
+				ImGui::TableNextColumn(); ImGui::Text("%u", frame->get(bounce, RayStat(i)));
+			}
+		}
+		ImGui::EndTable();
+	}
+
+	if (ImGui::Button("Export CSV")) {
+		write("ray_stats.csv"_sv);
+	}
+	ImGui::SameLine();
+	if (ImGui::Button("Export JSON")) {
+		write("ray_stats.json"_sv);
+	}
+}
+
+String RayStatsTracker::to_csv(Allocator * allocator) const {
+	Array<char> csv(allocator);
+
+	auto append = [&csv](StringView str) {
+		csv.push_back(str.start, str.length());
+	};
+
+	append("frame,pixel_count,bounce,occupancy"_sv);
+	for (int i = 0; i < int(RayStat::COUNT); i++) {
+		append(","_sv);
+		append(StringView::from_c_str(get_name(RayStat(i))));
+	}
+	append("\n"_sv);
+
+	for_each_frame([&](const Frame & frame) {
+		for (int bounce = 0; bounce < frame.num_bounces; bounce++) {
+			append(Format(allocator).format("{},{},{},{}"_sv, frame.sample_index, frame.pixel_count, bounce, frame.get_occupancy(bounce)).view());
+
+			for (int i = 0; i < int(RayStat::COUNT); i++) {
+				append(Format(allocator).format(",{}"_sv, frame.get(bounce, RayStat(i))).view());
+			}
+			append("\n"_sv);
+		}
+	});
+
+	return String(std::move(csv));
+}
+
+String RayStatsTracker::to_json(Allocator * allocator) const {
+	Array<char> json(allocator);
+
+	auto append = [&json](StringView str) {
+		json.push_back(str.start, str.length());
+	};
+
+	append("{\n\t\"frames\": ["_sv);
+
+	bool first_frame = true;
+	for_each_frame([&](const Frame & frame) {
+		append(first_frame ? "\n\t\t{ "_sv : ",\n\t\t{ "_sv); // Appended separately, as Format treats { as the start of a replacement field
+		first_frame = false;
+
+		append(Format(allocator).format("\"frame\": {}, \"pixel_count\": {}, \"bounces\": ["_sv, frame.sample_index, frame.pixel_count).view());
+
+		for (int bounce = 0; bounce < frame.num_bounces; bounce++) {
+			append(bounce == 0 ? "\n\t\t\t{ "_sv : ",\n\t\t\t{ "_sv);
+			append(Format(allocator).format("\"bounce\": {}, \"occupancy\": {}"_sv, bounce, frame.get_occupancy(bounce)).view());
+
+			for (int i = 0; i < int(RayStat::COUNT); i++) {
+				append(Format(allocator).format(", \"{}\": {}"_sv, StringView::from_c_str(get_name(RayStat(i))), frame.get(bounce, RayStat(i))).view());
+			}
+			append(" }"_sv);
+		}
+		append("\n\t\t] }"_sv);
+	});
+
+	append("\n\t]\n}\n"_sv);
+
+	return String(std::move(json));
+}
+
+bool RayStatsTracker::write(const String & filename) const {
+	bool is_csv = Util::get_file_extension(filename.view()) == "csv"_sv;
+
+	String data = is_csv ? to_csv() : to_json();
+
+	bool success = IO::file_write(filename, data.view());
+	if (success) {
+		IO::print("Wrote ray statistics of {} frames to '{}'\n"_sv, history.size(), filename);
+	} else {
+		Log::warning(Log::Category::RENDERER, "Unable to write ray statistics to '{}'!\n"_sv, filename);
+	}
+	return success;
+}
+#endif
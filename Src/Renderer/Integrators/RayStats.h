@@ -0,0 +1,87 @@
+#pragma once
+#include <cuda.h>
+
+#include "CUDA/Common.h"
+
+#include "Core/Array.h"
+#include "Core/String.h"
+
+#if ENABLE_RAY_STATS
+// Host side of the per bounce ray statistics counted by the Pathtracer kernels (see RayStat in CUDA/Common.h).
+// At the end of every frame the Device counters are copied into one of a few pinned slots asynchronously and then cleared.
+// A slot is only read once its copy has completed, so gathering statistics never stalls the render loop,
+// instead the most recent statistics lag a couple of frames behind
+struct RayStatsTracker {
+	static constexpr int NUM_SLOTS    = 4;
+	static constexpr int HISTORY_SIZE = 120; // Number of most recent frames kept for display and export
+
+	// Per bounce histogram of every RayStat for a single frame
+	struct Frame {
+		int sample_index;
+		int pixel_count;
+		int num_bounces;
+
+		RayStats stats;
+
+		unsigned get(int bounce, RayStat stat) const { return stats.counts[bounce][int(stat)]; }
+
+		// Fraction of the paths in the frame that are still active at the given bounce
+		float get_occupancy(int bounce) const {
+			return pixel_count > 0 ? float(get(bounce, RayStat::ACTIVE)) / float(pixel_count) : 0.0f;
+		}
+	};
+
+	static const char * get_name(RayStat stat);
+
+	void init();
+	void free();
+
+	// Copies the Device counters into the next free slot and clears them, should be called after the last kernel of the frame
+	void record(CUdeviceptr ptr_ray_stats, int sample_index, int pixel_count, int num_bounces);
+
+	// Moves the slots whose copy has completed into the history, does not block
+	void poll();
+
+	// Waits for all pending slots and moves them into the history
+	void flush();
+
+	const Frame * get_latest() const;
+
+	void render_gui();
+
+	// One row per frame and bounce
+	String to_csv (Allocator * allocator = nullptr) const;
+	String to_json(Allocator * allocator = nullptr) const;
+
+	// Writes CSV if the filename ends in .csv, JSON otherwise
+	bool write(const String & filename) const;
+
+private:
+	struct Slot {
+		CUevent event;
+		bool    pending;
+
+		int sample_index;
+		int pixel_count;
+		int num_bounces;
+	};
+
+	RayStats * pinned_stats = nullptr; // One per Slot
+
+	Slot slots[NUM_SLOTS];
+	int  slot_record_index = 0; // Next Slot to record into
+	int  slot_poll_index   = 0; // Oldest Slot that may be pending
+
+	Array<Frame> history;            // Ring buffer, oldest Frame at history_offset once full
+	int          history_offset = 0;
+
+	void consume(int slot_index);
+
+	template<typename Callback>
+	void for_each_frame(Callback && callback) const {
+		for (size_t i = 0; i < history.size(); i++) {
+			callback(history[(history_offset + i) % history.size()]);
+		}
+	}
+};
+#endif
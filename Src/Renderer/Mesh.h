@@ -10,7 +10,6 @@ struct Scene;
 struct Mesh {
 	String name;
 
-	AABB aabb_untransformed;
 	AABB aabb;
 
 	MeshDataHandle mesh_data_handle;
@@ -27,6 +26,11 @@ struct Mesh {
 	Matrix4 transform_inv;
 	Matrix4 transform_prev;
 
+	// Set through Scene::mark_mesh_dirty when position, rotation or scale are modified.
+	// Only dirty Meshes get their transforms and AABB recomputed in Scene::update
+	bool transform_dirty   = false;
+	bool transform_updated = false; // Set by Scene::update when any of the transforms changed, reset once uploaded by Integrator::build_tlas
+
 	struct {
 		float weight = 0.0f;
 
@@ -36,10 +40,6 @@ struct Mesh {
 
 	Mesh(String name, MeshDataHandle mesh_data_handle, MaterialHandle material_handle);
 
-	void calc_aabb(const Scene & scene);
-
-	void update();
-
 	bool has_identity_transform() const;
 
 	inline Vector3 get_center() const { return aabb.get_center(); }
@@ -3,12 +3,23 @@
 
 #include "BVH/BVH.h"
 
+#include "Assets/ClusterFile.h"
+
 #include "Core/Array.h"
 #include "Core/OwnPtr.h"
 
 struct MeshData {
-	Array<Triangle> triangles;
+	Array<Triangle> triangles; // Empty if the Triangles were moved to a cluster file
 	OwnPtr<BVH>     bvh;
+
+	// Only set if the Triangles were moved to a cluster file when the MeshData was loaded (see CPUConfig::enable_geometry_streaming)
+	OwnPtr<ClusterFile::Reader> clusters;
+
+	AABB aabb; // Object space bounds, shared by all Meshes that instance this MeshData
+
+	inline size_t triangle_count() const {
+		return clusters.get() ? size_t(clusters.get()->num_triangles) : triangles.size();
+	}
 };
 
 struct MeshDataHandle { int handle = INVALID; };
@@ -4,6 +4,7 @@
 #include <stdio.h>
 
 #include "Core/IO.h"
+#include "Core/Allocators/TrackingAllocator.h"
 
 #include "Assets/OBJLoader.h"
 #include "Assets/PLYLoader.h"
@@ -11,11 +12,16 @@
 
 #include "Material.h"
 
+#include "Math/AABBSoA.h"
+#include "Math/TransformSoA.h"
+
 #include "Util/Util.h"
 #include "Util/StringUtil.h"
+#include "Util/ThreadPool.h"
 
 Scene::Scene(Allocator * allocator) : allocator(allocator), asset_manager(allocator), camera(Math::deg_to_rad(85.0f)), meshes(allocator) {
-	LinearAllocator<MEGABYTES(4)> load_allocator;
+	LinearAllocator<MEGABYTES(4)> linear_allocator;
+	TrackingAllocator load_allocator("Scene Parsing"_sv, &linear_allocator);
 
 	for (int i = 0; i < cpu_config.scene_filenames.size(); i++) {
 		const String & scene_filename = cpu_config.scene_filenames[i];
@@ -38,11 +44,21 @@ Scene::Scene(Allocator * allocator) : allocator(allocator), asset_manager(alloca
 		}
 	}
 
-	sky.load(cpu_config.sky_filename);
+	sky.load(cpu_config.sky_filename, ThreadPool::get_shared());
 }
 
 Mesh & Scene::add_mesh(String name, MeshDataHandle mesh_data_handle, MaterialHandle material_handle) {
-	return meshes.emplace_back(std::move(name), mesh_data_handle, material_handle);
+	Mesh & mesh = meshes.emplace_back(std::move(name), mesh_data_handle, material_handle);
+	mark_mesh_dirty(int(meshes.size()) - 1);
+	return mesh;
+}
+
+void Scene::mark_mesh_dirty(int mesh_index) {
+	Mesh & mesh = meshes[mesh_index];
+	if (!mesh.transform_dirty) {
+		mesh.transform_dirty = true;
+		dirty_mesh_indices.push_back(mesh_index);
+	}
 }
 
 void Scene::check_materials() {
@@ -65,7 +81,54 @@ void Scene::check_materials() {
 }
 
 void Scene::update(float delta) {
-	for (int i = 0; i < meshes.size(); i++) {
-		meshes[i].update();
+	// Meshes that moved in the previous update need their transform_prev to catch up, even if they did not move again
+	for (size_t i = 0; i < moved_mesh_indices.size(); i++) {
+		Mesh & mesh = meshes[moved_mesh_indices[i]];
+		if (!mesh.transform_dirty) {
+			mesh.transform_prev    = mesh.transform;
+			mesh.transform_updated = true;
+		}
+	}
+	moved_mesh_indices.clear();
+
+	size_t dirty_count = dirty_mesh_indices.size();
+	if (dirty_count == 0) return;
+
+	// Compute the transforms and AABBs of all dirty Meshes in batches
+	TransformSoA transforms(dirty_count);
+	AABBSoA      aabbs     (dirty_count);
+	AABBSoA      aabbs_transformed(dirty_count);
+
+	for (size_t i = 0; i < dirty_count; i++) {
+		const Mesh & mesh = meshes[dirty_mesh_indices[i]];
+
+		transforms.set(i, mesh.position, mesh.rotation, mesh.scale);
+		aabbs     .set(i, asset_manager.get_mesh_data(mesh.mesh_data_handle).aabb);
 	}
+
+	Array<Matrix4> matrices    (dirty_count);
+	Array<Matrix4> matrices_inv(dirty_count);
+
+	TransformSoA::calc_matrices(transforms, dirty_count, matrices.data(), matrices_inv.data());
+	AABBSoA::transform(aabbs, matrices.data(), dirty_count, aabbs_transformed);
+
+	for (size_t i = 0; i < dirty_count; i++) {
+		int mesh_index = dirty_mesh_indices[i];
+		Mesh & mesh = meshes[mesh_index];
+
+		mesh.transform_prev = mesh.transform;
+		mesh.transform      = matrices    [i];
+		mesh.transform_inv  = matrices_inv[i];
+
+		mesh.aabb = aabbs_transformed.get(i);
+		mesh.aabb.fix_if_needed();
+		ASSERT(mesh.aabb.is_valid());
+
+		mesh.transform_dirty   = false;
+		mesh.transform_updated = true;
+
+		moved_mesh_indices.push_back(mesh_index);
+	}
+
+	dirty_mesh_indices.clear();
 }
@@ -16,6 +16,9 @@ struct Scene {
 	Array<Mesh> meshes;
 	Sky         sky;
 
+	Array<int> dirty_mesh_indices; // Meshes marked dirty since the last update
+	Array<int> moved_mesh_indices; // Meshes whose transform changed in the last update, their transform_prev still has to catch up
+
 	bool has_diffuse    = false;
 	bool has_plastic    = false;
 	bool has_dielectric = false;
@@ -26,6 +29,9 @@ struct Scene {
 
 	Mesh & add_mesh(String name, MeshDataHandle mesh_data_handle, MaterialHandle material_handle = MaterialHandle::get_default());
 
+	// Should be called whenever the position, rotation or scale of a Mesh is modified
+	void mark_mesh_dirty(int mesh_index);
+
 	void check_materials();
 
 	void update(float delta);
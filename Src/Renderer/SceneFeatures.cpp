@@ -0,0 +1,69 @@
+#include "SceneFeatures.h"
+
+#include "Core/Format.h"
+
+#include "Util/Util.h"
+
+struct FeatureName {
+	SceneFeatures::Feature feature;
+	const char *           name;
+};
+
+static constexpr FeatureName feature_names[] = {
+	{ SceneFeatures::DIFFUSE,    "DIFFUSE" },
+	{ SceneFeatures::PLASTIC,    "PLASTIC" },
+	{ SceneFeatures::DIELECTRIC, "DIELECTRIC" },
+	{ SceneFeatures::CONDUCTOR,  "CONDUCTOR" },
+	{ SceneFeatures::LIGHTS,     "LIGHTS" },
+	{ SceneFeatures::MEDIA,      "MEDIA" },
+	{ SceneFeatures::TEXTURES,   "TEXTURES" }
+};
+
+unsigned SceneFeatures::get(const Array<Material> & materials) {
+	unsigned features = NONE;
+
+	for (size_t i = 0; i < materials.size(); i++) {
+		const Material & material = materials[i];
+
+		switch (material.type) {
+			case Material::Type::LIGHT:      features |= LIGHTS;     break;
+			case Material::Type::DIFFUSE:    features |= DIFFUSE;    break;
+			case Material::Type::PLASTIC:    features |= PLASTIC;    break;
+			case Material::Type::DIELECTRIC: features |= DIELECTRIC; break;
+			case Material::Type::CONDUCTOR:  features |= CONDUCTOR;  break;
+			default: ASSERT_UNREACHABLE();
+		}
+
+		// Only these Material types read their texture_id / medium_id on the Device
+		bool uses_texture = material.type == Material::Type::DIFFUSE || material.type == Material::Type::PLASTIC;
+		bool uses_medium  = material.type == Material::Type::DIELECTRIC;
+
+		if (uses_texture && material.texture_handle.handle != INVALID) features |= TEXTURES;
+		if (uses_medium  && material.medium_handle .handle != INVALID) features |= MEDIA;
+	}
+
+	return features;
+}
+
+void SceneFeatures::to_defines(unsigned features, Array<String> & defines) {
+	for (int i = 0; i < Util::array_count(feature_names); i++) {
+		bool has_feature = (features & feature_names[i].feature) != 0;
+		defines.push_back(Format().format("-DSCENE_HAS_{}={}"_sv, feature_names[i].name, int(has_feature)));
+	}
+}
+
+String SceneFeatures::to_string(unsigned features, Allocator * allocator) {
+	if (features == NONE) return String("NONE", allocator);
+
+	Array<char> str(allocator);
+
+	for (int i = 0; i < Util::array_count(feature_names); i++) {
+		if ((features & feature_names[i].feature) == 0) continue;
+
+		if (str.size() > 0) str.push_back(' ');
+		str.push_back(feature_names[i].name, strlen(feature_names[i].name));
+	}
+	str.push_back('\0');
+
+	return String(std::move(str));
+}
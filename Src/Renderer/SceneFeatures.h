@@ -0,0 +1,31 @@
+#pragma once
+#include "Core/Array.h"
+#include "Core/String.h"
+
+#include "Renderer/Material.h"
+
+// Bitmask of the features a Scene uses. The Pathtracer kernels are compiled with a SCENE_HAS_<FEATURE> define per feature
+// (see CUDA/Config.h), so that code paths for features the Scene does not use are removed at compile time
+namespace SceneFeatures {
+	enum Feature : unsigned {
+		DIFFUSE    = 1u << 0,
+		PLASTIC    = 1u << 1,
+		DIELECTRIC = 1u << 2,
+		CONDUCTOR  = 1u << 3,
+		LIGHTS     = 1u << 4,
+		MEDIA      = 1u << 5, // Dielectrics that contain a Medium
+		TEXTURES   = 1u << 6,
+
+		NONE = 0,
+		ALL  = (1u << 7) - 1
+	};
+
+	// Features used by the given Materials
+	unsigned get(const Array<Material> & materials);
+
+	// Appends a "-DSCENE_HAS_<FEATURE>=0" or "=1" option for every feature
+	void to_defines(unsigned features, Array<String> & defines);
+
+	// Space separated names of the features that are set, for logging
+	String to_string(unsigned features, Allocator * allocator = nullptr);
+}
@@ -7,9 +7,18 @@
 #include <stb_image.h>
 
 #include "Core/IO.h"
+#include "Core/Random.h"
 #include "Core/String.h"
+#include "Core/Timer.h"
 
-void Sky::load(const String & filename) {
+#include "Math/Math.h"
+
+#include "Util/Util.h"
+#include "Util/Check.h"
+#include "Util/ThreadPool.h"
+#include "Util/AliasTable.h"
+
+void Sky::load(const String & filename, ThreadPool & thread_pool) {
 	int channels;
 	float * hdr = stbi_loadf(filename.data(), &width, &height, &channels, STBI_rgb);
 
@@ -23,4 +32,251 @@ void Sky::load(const String & filename) {
 	memcpy(data.data(), hdr, width * height * sizeof(Vector3));
 
 	stbi_image_free(hdr);
+
+	init_distribution(thread_pool);
+}
+
+// Solid angle covered by a texel in the given row
+static double row_solid_angle(int y, int width, int height) {
+	double theta_0 = double(y)     * double(PI) / double(height);
+	double theta_1 = double(y + 1) * double(PI) / double(height);
+
+	return double(TWO_PI) / double(width) * (cos(theta_0) - cos(theta_1));
+}
+
+void Sky::init_distribution(ThreadPool & thread_pool) {
+	int texel_count = width * height;
+
+	Array<double> weights(texel_count);
+	Array<double> row_weights(height);
+
+	alias_table.resize(texel_count);
+
+	// Every row covers the same range of theta, so its texels share the same solid angle (proportional to sin(theta))
+	thread_pool.parallel_for(0, height, 16, [&](int y) {
+		double solid_angle = row_solid_angle(y, width, height);
+		double row_weight  = 0.0;
+
+		for (int x = 0; x < width; x++) {
+			int index = x + y * width;
+
+			weights[index] = double(Math::max(Math::luminance(data[index]), 0.0f)) * solid_angle;
+			row_weight += weights[index];
+		}
+
+		row_weights[y] = row_weight;
+	});
+
+	double weight = 0.0;
+	for (int y = 0; y < height; y++) {
+		weight += row_weights[y];
+	}
+	total_weight = float(weight);
+
+	if (total_weight > 0.0f) {
+		AliasTable::build(weights.data(), texel_count, alias_table.data(), &thread_pool);
+	}
+}
+
+int Sky::get_index(const Vector3 & direction) const {
+	// Convert direction to spherical coordinates
+	float phi   = atan2f(-direction.z, direction.x);
+	float theta = acosf(Math::clamp(direction.y, -1.0f, 1.0f));
+
+	float u = phi   * ONE_OVER_TWO_PI;
+	float v = theta * ONE_OVER_PI;
+
+	// atan2 returns angles in [-pi, pi]
+	if (u < 0.0f) u += 1.0f;
+
+	// Convert to pixel coordinates
+	int x = Math::min(int(u * width),  width  - 1);
+	int y = Math::min(int(v * height), height - 1);
+
+	return x + y * width;
+}
+
+Vector3 Sky::sample(float u_index, float u_coin, float u_phi, float u_theta) const {
+	int index = AliasTable::sample(alias_table.data(), width * height, u_index, u_coin);
+
+	int x = index % width;
+	int y = index / width;
+
+	// Sample uniformly in phi and cos(theta), which is uniform in solid angle within the texel
+	float phi = (float(x) + u_phi) * TWO_PI / float(width);
+
+	float cos_theta_0 = cosf(float(y)     * PI / float(height));
+	float cos_theta_1 = cosf(float(y + 1) * PI / float(height));
+
+	float cos_theta = cos_theta_0 + u_theta * (cos_theta_1 - cos_theta_0);
+	float sin_theta = sqrtf(Math::max(1.0f - cos_theta * cos_theta, 0.0f));
+
+	return Vector3(cosf(phi) * sin_theta, cos_theta, -sinf(phi) * sin_theta);
+}
+
+float Sky::pdf(const Vector3 & direction) const {
+	return Math::max(Math::luminance(data[get_index(direction)]), 0.0f) / total_weight;
+}
+
+static bool check_sky(StringView name, const Sky & sky, RNG & rng) {
+	constexpr int NUM_SAMPLES = 4000000;
+
+	if (sky.total_weight == 0.0f) {
+		IO::print("OK      Sky '{}': black, sampling disabled\n"_sv, name);
+		return true;
+	}
+
+	int texel_count = sky.width * sky.height;
+
+	bool success = true;
+
+	// The probabilities of all texels, the pdf integrated over their solid angle, should sum to one
+	Array<double> probabilities(texel_count);
+	double sum_probabilities = 0.0;
+
+	for (int y = 0; y < sky.height; y++) {
+		double solid_angle = row_solid_angle(y, sky.width, sky.height);
+
+		for (int x = 0; x < sky.width; x++) {
+			int index = x + y * sky.width;
+
+			probabilities[index] = double(Math::max(Math::luminance(sky.data[index]), 0.0f)) / double(sky.total_weight) * solid_angle;
+			sum_probabilities += probabilities[index];
+		}
+	}
+
+	if (fabs(sum_probabilities - 1.0) > 1e-3) {
+		IO::print("FAILED  Sky '{}': probabilities sum to {}\n"_sv, name, float(sum_probabilities));
+		return false;
+	}
+
+	// Sampled directions are binned by the same lookup the renderer uses to find their radiance
+	Array<int> observed(texel_count);
+	for (int i = 0; i < texel_count; i++) {
+		observed[i] = 0;
+	}
+
+	// Irradiance onto an upward facing surface. Its exact value follows from integrating cos(theta) over every row
+	double irradiance = 0.0;
+	for (int y = 0; y < sky.height; y++) {
+		double cos_theta_0 = Math::max(cos(double(y)     * double(PI) / double(sky.height)), 0.0);
+		double cos_theta_1 = Math::max(cos(double(y + 1) * double(PI) / double(sky.height)), 0.0);
+
+		double row_integral = double(TWO_PI) / double(sky.width) * 0.5 * (cos_theta_0 * cos_theta_0 - cos_theta_1 * cos_theta_1);
+
+		for (int x = 0; x < sky.width; x++) {
+			irradiance += double(Math::max(Math::luminance(sky.data[x + y * sky.width]), 0.0f)) * row_integral;
+		}
+	}
+
+	double estimate_sum                 = 0.0;
+	double estimate_sum_squared         = 0.0;
+	double estimate_uniform_sum         = 0.0;
+	double estimate_uniform_sum_squared = 0.0;
+
+	int invalid_pdf_count = 0;
+
+	for (int s = 0; s < NUM_SAMPLES; s++) {
+		Vector3 direction = sky.sample(Check::random_float(rng), Check::random_float(rng), Check::random_float(rng), Check::random_float(rng));
+
+		int   index = sky.get_index(direction);
+		float pdf   = sky.pdf(direction);
+
+		observed[index]++;
+
+		if (!(pdf > 0.0f)) {
+			invalid_pdf_count++;
+			continue;
+		}
+
+		double estimate = double(Math::max(Math::luminance(sky.data[index]), 0.0f)) * double(Math::max(direction.y, 0.0f)) / double(pdf);
+		estimate_sum         += estimate;
+		estimate_sum_squared += estimate * estimate;
+
+		// Reference: uniform sphere sampling, which is what BSDF sampling amounts to for bright features much smaller than the lobe
+		Vector3 direction_uniform = Check::random_direction(rng);
+
+		double estimate_uniform = double(Math::max(Math::luminance(sky.data[sky.get_index(direction_uniform)]), 0.0f)) * double(Math::max(direction_uniform.y, 0.0f)) * 4.0 * double(PI);
+		estimate_uniform_sum         += estimate_uniform;
+		estimate_uniform_sum_squared += estimate_uniform * estimate_uniform;
+	}
+
+	if (invalid_pdf_count > 0) {
+		IO::print("FAILED  Sky '{}': {} sampled directions have zero pdf according to the lookup\n"_sv, name, invalid_pdf_count);
+		success = false;
+	}
+
+	Array<double> expected(texel_count);
+	for (int i = 0; i < texel_count; i++) {
+		expected[i] = probabilities[i] * double(NUM_SAMPLES);
+	}
+	success &= Check::chi_squared("Sky"_sv, name, observed, expected);
+
+	// The estimator of the irradiance should be unbiased, its mean should be within a few standard errors of the exact value
+	double mean           = estimate_sum / double(NUM_SAMPLES);
+	double variance       = Math::max(estimate_sum_squared / double(NUM_SAMPLES) - mean * mean, 0.0);
+	double standard_error = sqrt(variance / double(NUM_SAMPLES));
+
+	double mean_uniform     = estimate_uniform_sum / double(NUM_SAMPLES);
+	double variance_uniform = Math::max(estimate_uniform_sum_squared / double(NUM_SAMPLES) - mean_uniform * mean_uniform, 0.0);
+
+	bool unbiased = fabs(mean - irradiance) <= 5.0 * standard_error + 1e-4 * irradiance;
+	success &= unbiased;
+
+	IO::print("{} Sky '{}': mean {} vs exact {} (standard error {}), variance {} vs {} with uniform sampling\n"_sv,
+		unbiased ? "OK     "_sv : "FAILED "_sv, name, float(mean), float(irradiance), float(standard_error), float(variance), float(variance_uniform)
+	);
+
+	return success;
+}
+
+bool Sky::run_check(const String & file_name) {
+	RNG rng(1234);
+
+	bool success = true;
+
+	// Synthetic Sky: a smooth gradient with a small and very bright sun, and a black region below the horizon
+	{
+		Sky sky = { };
+		sky.width  = 256;
+		sky.height = 128;
+		sky.data.resize(sky.width * sky.height);
+
+		for (int y = 0; y < sky.height; y++) {
+			for (int x = 0; x < sky.width; x++) {
+				Vector3 & texel = sky.data[x + y * sky.width];
+
+				if (y >= sky.height * 3 / 4) {
+					texel = Vector3(0.0f);
+				} else {
+					float t = float(y) / float(sky.height);
+					texel = Vector3(0.3f + t, 0.5f + t, 1.0f);
+				}
+			}
+		}
+
+		constexpr int SUN_X = 37;
+		constexpr int SUN_Y = 21;
+		for (int y = SUN_Y - 1; y <= SUN_Y + 1; y++) {
+			for (int x = SUN_X - 1; x <= SUN_X + 1; x++) {
+				sky.data[x + y * sky.width] = Vector3(50000.0f, 45000.0f, 40000.0f);
+			}
+		}
+
+		sky.init_distribution(ThreadPool::get_shared());
+		success &= check_sky("synthetic"_sv, sky, rng);
+	}
+
+	// Sky from file, if one was provided
+	if (!file_name.is_empty()) {
+		Sky sky = { };
+		{
+			ScopeTimer timer("Sky load"_sv);
+			sky.load(file_name, ThreadPool::get_shared());
+		}
+		success &= check_sky(file_name.view(), sky, rng);
+	}
+
+	IO::print(success ? "All Sky sampling checks passed\n"_sv : "WARNING: Some Sky sampling checks failed!\n"_sv);
+	return success;
 }
@@ -1,12 +1,34 @@
 #pragma once
+#include "CUDA/Common.h"
+
 #include "Math/Vector3.h"
 
+#include "Core/Array.h"
 #include "Core/String.h"
 
+struct ThreadPool;
+
 struct Sky {
 	int width;
 	int height;
 	Array<Vector3> data;
 
-	void load(const String & file_name);
+	// Distribution over the texels proportional to their luminance times the solid angle they cover, used for Next Event Estimation.
+	// Within a texel directions are sampled uniformly, so the pdf of a direction is simply its luminance divided by total_weight
+	Array<AliasEntry> alias_table;
+	float             total_weight; // Luminance integrated over the sphere, zero if the Sky is black and can not be sampled
+
+	void load(const String & file_name, ThreadPool & thread_pool);
+
+	// Builds the alias table over the texels, called by load
+	void init_distribution(ThreadPool & thread_pool);
+
+	// Host equivalents of the routines in CUDA/Sky.h
+	int     get_index(const Vector3 & direction) const;
+	Vector3 sample   (float u_index, float u_coin, float u_phi, float u_theta) const;
+	float   pdf      (const Vector3 & direction) const;
+
+	// Checks that the sampled directions are distributed according to the pdf, using the texel lookup as bins for a chi-squared test,
+	// and that the resulting irradiance estimate is unbiased. Runs on a synthetic Sky with a small sun and on the given Sky file if it is not empty
+	static bool run_check(const String & file_name);
 };
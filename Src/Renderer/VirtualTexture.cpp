@@ -0,0 +1,281 @@
+#include "VirtualTexture.h"
+
+#include <string.h>
+
+#include "Core/Sort.h"
+
+#include "Math/Math.h"
+
+using namespace VirtualTexture;
+
+TileLayout TileLayout::from_texture(const Texture & texture, Allocator * allocator) {
+	TileLayout layout(allocator);
+	layout.format   = texture.format;
+	layout.channels = texture.channels;
+	layout.width    = texture.width;
+	layout.height   = texture.height;
+
+	if (texture.format == Texture::Format::RGBA) {
+		layout.tile_dim   = TILE_SIZE;
+		layout.unit_bytes = sizeof(unsigned);
+	} else {
+		// Block compressed Textures store their dimensions in 4x4 blocks
+		layout.tile_dim   = TILE_SIZE / 4;
+		layout.unit_bytes = texture.channels * 4;
+	}
+	layout.tile_bytes = layout.tile_dim * layout.tile_dim * layout.unit_bytes;
+
+	layout.num_tiles = 0;
+	layout.levels.reserve(texture.mip_levels());
+
+	for (int level = 0; level < texture.mip_levels(); level++) {
+		LevelLayout level_layout = { };
+		level_layout.width_in_tiles  = Math::divide_round_up(layout.level_width_in_units (level), layout.tile_dim);
+		level_layout.height_in_tiles = Math::divide_round_up(layout.level_height_in_units(level), layout.tile_dim);
+		level_layout.first_tile      = layout.num_tiles;
+
+		layout.levels.push_back(level_layout);
+		layout.num_tiles += level_layout.width_in_tiles * level_layout.height_in_tiles;
+	}
+
+	return layout;
+}
+
+int TileLayout::level_width_in_units(int level) const {
+	return Math::max(width >> level, 1);
+}
+
+int TileLayout::level_height_in_units(int level) const {
+	return Math::max(height >> level, 1);
+}
+
+void TileLayout::extract_tile(const Texture & texture, int level, int x, int y, unsigned char * dst) const {
+	int level_width  = level_width_in_units (level);
+	int level_height = level_height_in_units(level);
+
+	const unsigned char * level_data = texture.data.data() + texture.mip_offsets[level];
+
+	int row_bytes = tile_dim * unit_bytes;
+
+	for (int j = 0; j < tile_dim; j++) {
+		int src_y = Math::min(y * tile_dim + j, level_height - 1);
+		const unsigned char * src_row = level_data + src_y * level_width * unit_bytes;
+
+		unsigned char * dst_row = dst + j * row_bytes;
+
+		int src_x_start = x * tile_dim;
+		int num_inside  = Math::clamp(level_width - src_x_start, 0, tile_dim);
+
+		memcpy(dst_row, src_row + src_x_start * unit_bytes, num_inside * unit_bytes);
+
+		// Pad by repeating the last unit in the row
+		for (int i = num_inside; i < tile_dim; i++) {
+			memcpy(dst_row + i * unit_bytes, src_row + (level_width - 1) * unit_bytes, unit_bytes);
+		}
+	}
+}
+
+TileCache::TileCache(size_t budget_in_bytes, TileLoader loader, Allocator * allocator) :
+	layouts(allocator),
+	texture_tile_offsets(allocator),
+	page_table(allocator),
+	page_requested_frame(allocator),
+	entries(allocator),
+	free_entries(allocator),
+	pending_requests(allocator),
+	budget_in_bytes(budget_in_bytes),
+	loader(std::move(loader)),
+	allocator(allocator) { }
+
+int TileCache::add_texture(TileLayout layout) {
+	int texture_index = layouts.size();
+	int tile_offset   = page_table.size();
+
+	texture_tile_offsets.push_back(tile_offset);
+
+	page_table          .resize(tile_offset + layout.num_tiles);
+	page_requested_frame.resize(tile_offset + layout.num_tiles);
+	for (int i = tile_offset; i < page_table.size(); i++) {
+		page_table          [i] = INVALID;
+		page_requested_frame[i] = INVALID;
+	}
+
+	layouts.push_back(std::move(layout));
+
+	return texture_index;
+}
+
+int TileCache::global_tile_index(TileID tile_id) const {
+	const TileLayout & layout = layouts[tile_id.texture];
+
+	ASSERT(tile_id.level >= 0 && tile_id.level < layout.levels.size());
+	ASSERT(tile_id.x >= 0 && tile_id.x < layout.levels[tile_id.level].width_in_tiles);
+	ASSERT(tile_id.y >= 0 && tile_id.y < layout.levels[tile_id.level].height_in_tiles);
+
+	return texture_tile_offsets[tile_id.texture] + layout.tile_index(tile_id.level, tile_id.x, tile_id.y);
+}
+
+bool TileCache::request(TileID tile_id) {
+	stats.num_requests++;
+
+	int tile_index  = global_tile_index(tile_id);
+	int entry_index = page_table[tile_index];
+
+	if (entry_index != INVALID) {
+		stats.num_hits++;
+
+		Entry & entry = entries[entry_index];
+		if (entry.last_used_frame != frame) {
+			entry.last_used_frame = frame;
+
+			lru_unlink   (entry_index);
+			lru_push_head(entry_index);
+		}
+		return true;
+	}
+
+	stats.num_misses++;
+
+	// Only queue the first request for a given tile in a frame
+	if (page_requested_frame[tile_index] != frame) {
+		page_requested_frame[tile_index] = frame;
+		pending_requests.push_back(tile_id);
+	}
+	return false;
+}
+
+void TileCache::update(int max_loads) {
+	// Service coarser mips first, these cover the largest area and serve as fallback for finer levels
+	Sort::quick_sort(pending_requests.begin(), pending_requests.end(), [](const TileID & a, const TileID & b) {
+		return a.level > b.level;
+	});
+
+	int num_loads = pending_requests.size();
+	if (max_loads != INVALID) {
+		num_loads = Math::min(num_loads, max_loads);
+	}
+
+	for (int i = 0; i < num_loads; i++) {
+		const TileID & tile_id = pending_requests[i];
+
+		int tile_bytes = layouts[tile_id.texture].tile_bytes;
+
+		bool fits = true;
+		while (resident_bytes + tile_bytes > budget_in_bytes) {
+			if (!evict_lru()) {
+				// All resident tiles are in use this frame, the working set exceeds the budget
+				fits = false;
+				break;
+			}
+		}
+		if (!fits) break;
+
+		load(tile_id, global_tile_index(tile_id));
+	}
+
+	// Requests that could not be serviced are dropped, if still needed they will be requested again next frame
+	pending_requests.clear();
+	frame++;
+}
+
+const unsigned char * TileCache::find_resident(TileID & tile_id) const {
+	const TileLayout & layout = layouts[tile_id.texture];
+
+	while (true) {
+		int entry_index = page_table[global_tile_index(tile_id)];
+		if (entry_index != INVALID) {
+			return entries[entry_index].data.data();
+		}
+
+		if (tile_id.level + 1 >= layout.levels.size()) return nullptr;
+
+		// Move to the parent tile in the next coarser level
+		tile_id.level += 1;
+		tile_id.x = Math::min(tile_id.x / 2, layout.levels[tile_id.level].width_in_tiles  - 1);
+		tile_id.y = Math::min(tile_id.y / 2, layout.levels[tile_id.level].height_in_tiles - 1);
+	}
+}
+
+bool TileCache::is_resident(TileID tile_id) const {
+	return page_table[global_tile_index(tile_id)] != INVALID;
+}
+
+void TileCache::load(TileID tile_id, int tile_index) {
+	int entry_index;
+	if (free_entries.size() > 0) {
+		entry_index = free_entries.back();
+		free_entries.pop_back();
+	} else {
+		entry_index = entries.size();
+		entries.emplace_back();
+		entries[entry_index].data = Array<unsigned char>(allocator);
+	}
+
+	int tile_bytes = layouts[tile_id.texture].tile_bytes;
+
+	Entry & entry = entries[entry_index];
+	entry.tile_id         = tile_id;
+	entry.tile_index      = tile_index;
+	entry.last_used_frame = frame;
+	entry.data.resize(tile_bytes);
+
+	loader(tile_id, entry.data.data());
+
+	page_table[tile_index] = entry_index;
+	resident_bytes += tile_bytes;
+
+	lru_push_head(entry_index);
+
+	stats.num_loads++;
+}
+
+bool TileCache::evict_lru() {
+	int entry_index = lru_tail;
+	if (entry_index == INVALID) return false;
+
+	Entry & entry = entries[entry_index];
+	if (entry.last_used_frame == frame) return false;
+
+	lru_unlink(entry_index);
+
+	page_table[entry.tile_index] = INVALID;
+	resident_bytes -= entry.data.size();
+
+	entry.data = Array<unsigned char>(allocator); // Release tile memory so that the budget is respected
+	free_entries.push_back(entry_index);
+
+	stats.num_evictions++;
+	return true;
+}
+
+void TileCache::lru_unlink(int entry_index) {
+	Entry & entry = entries[entry_index];
+
+	if (entry.lru_prev != INVALID) {
+		entries[entry.lru_prev].lru_next = entry.lru_next;
+	} else {
+		lru_head = entry.lru_next;
+	}
+
+	if (entry.lru_next != INVALID) {
+		entries[entry.lru_next].lru_prev = entry.lru_prev;
+	} else {
+		lru_tail = entry.lru_prev;
+	}
+
+	entry.lru_prev = INVALID;
+	entry.lru_next = INVALID;
+}
+
+void TileCache::lru_push_head(int entry_index) {
+	Entry & entry = entries[entry_index];
+	entry.lru_prev = INVALID;
+	entry.lru_next = lru_head;
+
+	if (lru_head != INVALID) {
+		entries[lru_head].lru_prev = entry_index;
+	} else {
+		lru_tail = entry_index;
+	}
+	lru_head = entry_index;
+}
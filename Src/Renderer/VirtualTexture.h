@@ -0,0 +1,145 @@
+#pragma once
+#include "Core/Array.h"
+#include "Core/Function.h"
+
+#include "Renderer/Texture.h"
+
+// Virtual texturing splits every mip level of a Texture into fixed size square tiles.
+// Only the tiles that are actually requested by the renderer need to be resident in memory,
+// the rest stay on disk in a page file (see Assets/PageFile.h)
+namespace VirtualTexture {
+	inline constexpr int TILE_SIZE = 128; // Tile width/height in texels
+
+	struct TileID {
+		int texture;
+		int level;
+		int x, y; // In tiles
+	};
+
+	struct LevelLayout {
+		int width_in_tiles;
+		int height_in_tiles;
+		int first_tile; // Index of the first tile of this level within the Texture
+	};
+
+	struct TileLayout {
+		Texture::Format format;
+		int channels;
+		int width, height;
+
+		int tile_dim;   // Tile width/height in units (texels for RGBA, 4x4 blocks for BC formats)
+		int unit_bytes; // Size in bytes of one unit
+		int tile_bytes; // Size in bytes of one tile
+
+		Array<LevelLayout> levels;
+		int                num_tiles;
+
+		TileLayout(Allocator * allocator = nullptr) : levels(allocator) { }
+
+		static TileLayout from_texture(const Texture & texture, Allocator * allocator = nullptr);
+
+		int level_width_in_units (int level) const;
+		int level_height_in_units(int level) const;
+
+		// Maps a (level, x, y) tile coordinate to a linear index within the Texture, tiles are ordered by level, then row major
+		inline int tile_index(int level, int x, int y) const {
+			const LevelLayout & layout = levels[level];
+			return layout.first_tile + y * layout.width_in_tiles + x;
+		}
+
+		// Copies a single tile out of the Texture's data, borders are padded by clamping to the edge of the level
+		void extract_tile(const Texture & texture, int level, int x, int y, unsigned char * dst) const;
+	};
+
+	// Loads the tile with the given ID into dst, which has room for exactly one tile of the corresponding TileLayout
+	using TileLoader = Function<void(TileID tile_id, unsigned char * dst)>;
+
+	// Host side LRU cache of tiles, bounded by a memory budget in bytes.
+	// Usage per frame: call request() for every tile the renderer needs (e.g. as read back from a feedback buffer),
+	// then call update() to stream in missing tiles, evicting the least recently used tiles if the budget is exceeded
+	struct TileCache {
+		struct Stats {
+			size_t num_requests;
+			size_t num_hits;
+			size_t num_misses;
+			size_t num_loads;
+			size_t num_evictions;
+
+			inline float hit_rate() const {
+				return num_requests > 0 ? float(num_hits) / float(num_requests) : 0.0f;
+			}
+		};
+
+		struct Entry {
+			TileID tile_id;
+			int    tile_index; // Global tile index, index into page_table
+
+			Array<unsigned char> data;
+
+			int last_used_frame;
+
+			int lru_prev;
+			int lru_next;
+		};
+
+		Array<TileLayout> layouts;
+		Array<int>        texture_tile_offsets; // Global tile index of the first tile of every Texture
+
+		Array<int> page_table;           // Maps global tile index to Entry index, or INVALID if not resident
+		Array<int> page_requested_frame; // Frame in which a missing tile was last requested, used to deduplicate requests
+
+		Array<Entry> entries;
+		Array<int>   free_entries;
+
+		// Intrusive doubly linked list through entries, head is most recently used
+		int lru_head = INVALID;
+		int lru_tail = INVALID;
+
+		Array<TileID> pending_requests;
+
+		size_t budget_in_bytes;
+		size_t resident_bytes = 0;
+
+		TileLoader loader;
+
+		Allocator * allocator;
+
+		int   frame = 0;
+		Stats stats = { };
+
+		TileCache(size_t budget_in_bytes, TileLoader loader, Allocator * allocator = nullptr);
+
+		NON_COPYABLE(TileCache);
+		DEFAULT_MOVEABLE(TileCache);
+
+		~TileCache() = default;
+
+		// Registers a Texture with the cache and returns its index to be used in TileIDs
+		int add_texture(TileLayout layout);
+
+		// Marks a tile as used this frame, returns whether it is currently resident
+		bool request(TileID tile_id);
+
+		// Services at most max_loads pending requests (coarsest mips first) and advances to the next frame
+		void update(int max_loads = INVALID);
+
+		// Returns the resident data of the tile, or of the closest coarser mip that is resident.
+		// On return tile_id is updated to refer to the tile that was actually found
+		const unsigned char * find_resident(TileID & tile_id) const;
+
+		bool is_resident(TileID tile_id) const;
+
+		inline int num_resident_tiles() const { return entries.size() - free_entries.size(); }
+
+		void reset_stats() { stats = { }; }
+
+	private:
+		int global_tile_index(TileID tile_id) const;
+
+		void load(TileID tile_id, int tile_index);
+		bool evict_lru();
+
+		void lru_unlink   (int entry_index);
+		void lru_push_head(int entry_index);
+	};
+}
@@ -0,0 +1,390 @@
+#include "AliasTable.h"
+
+#include <math.h>
+
+#include "Core/IO.h"
+#include "Core/Array.h"
+#include "Core/Random.h"
+#include "Core/Timer.h"
+
+#include "Math/Math.h"
+
+#include "Util/Check.h"
+#include "Util/ThreadPool.h"
+
+static constexpr int CHUNK_SIZE = 16384;
+
+template<typename Func>
+static void for_each_chunk(ThreadPool * thread_pool, int num_chunks, Func && func) {
+	if (thread_pool && num_chunks > 1) {
+		thread_pool->parallel_for(0, num_chunks, 1, func);
+	} else {
+		for (int c = 0; c < num_chunks; c++) {
+			func(c);
+		}
+	}
+}
+
+// Index of the last element in [first, first + count) that is smaller than or equal to value, -1 if there is none
+static int find_last_less_equal(const double * first, int count, double value) {
+	int lo = 0;
+	int hi = count;
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if (first[mid] <= value) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo - 1;
+}
+
+// Index of the last element in [first, first + count) that is strictly smaller than value, -1 if there is none
+static int find_last_less(const double * first, int count, double value) {
+	int lo = 0;
+	int hi = count;
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if (first[mid] < value) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo - 1;
+}
+
+/*
+	With the weights normalized to an average of 1, every light entry (weight < 1) has a deficit of 1 - weight,
+	and every heavy entry (weight >= 1) has an excess of weight - 1. Laying out the deficits of the light entries
+	and the excesses of the heavy entries on two lines (in index order), Vose's sweep assigns every light entry
+	to the heavy entry whose excess covers the start of its deficit. Once a heavy entry runs out of excess in the
+	middle of a deficit, the remainder (the overdraft) is covered by the next heavy entry, which becomes its alias.
+	Both only depend on prefix sums, so every entry can be computed independently
+*/
+void AliasTable::build(const double weights[], int count, AliasEntry table[], ThreadPool * thread_pool, Allocator * allocator) {
+	if (count <= 0) return;
+
+	struct Chunk {
+		int first;
+		int last;
+
+		double total_weight;
+
+		int    num_light;
+		int    num_heavy;
+		double sum_deficit;
+		double sum_excess;
+
+		// Exclusive prefix sums over the preceding Chunks
+		int    offset_light;
+		int    offset_heavy;
+		double offset_deficit;
+		double offset_excess;
+	};
+
+	int num_chunks = (count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+	Array<Chunk> chunks(num_chunks, allocator);
+	for (int c = 0; c < num_chunks; c++) {
+		chunks[c] = { };
+		chunks[c].first = c * CHUNK_SIZE;
+		chunks[c].last  = Math::min(chunks[c].first + CHUNK_SIZE, count);
+	}
+
+	for_each_chunk(thread_pool, num_chunks, [&](int c) {
+		Chunk & chunk = chunks[c];
+		for (int i = chunk.first; i < chunk.last; i++) {
+			chunk.total_weight += weights[i];
+		}
+	});
+
+	double total_weight = 0.0;
+	for (int c = 0; c < num_chunks; c++) {
+		total_weight += chunks[c].total_weight;
+	}
+
+	if (!(total_weight > 0.0)) {
+		// Degenerate distribution, fall back to uniform
+		for (int i = 0; i < count; i++) {
+			table[i] = { 1.0f, i };
+		}
+		return;
+	}
+
+	double scale = double(count) / total_weight;
+
+	for_each_chunk(thread_pool, num_chunks, [&](int c) {
+		Chunk & chunk = chunks[c];
+		for (int i = chunk.first; i < chunk.last; i++) {
+			double weight = weights[i] * scale;
+			if (weight < 1.0) {
+				chunk.num_light++;
+				chunk.sum_deficit += 1.0 - weight;
+			} else {
+				chunk.num_heavy++;
+				chunk.sum_excess += weight - 1.0;
+			}
+		}
+	});
+
+	int    num_light = 0;
+	int    num_heavy = 0;
+	double total_deficit = 0.0;
+	double total_excess  = 0.0;
+	for (int c = 0; c < num_chunks; c++) {
+		chunks[c].offset_light   = num_light;
+		chunks[c].offset_heavy   = num_heavy;
+		chunks[c].offset_deficit = total_deficit;
+		chunks[c].offset_excess  = total_excess;
+
+		num_light     += chunks[c].num_light;
+		num_heavy     += chunks[c].num_heavy;
+		total_deficit += chunks[c].sum_deficit;
+		total_excess  += chunks[c].sum_excess;
+	}
+
+	if (num_heavy == 0) {
+		// All weights are equal up to rounding
+		for (int i = 0; i < count; i++) {
+			table[i] = { 1.0f, i };
+		}
+		return;
+	}
+
+	Array<int>    light_indices(num_light,     allocator);
+	Array<int>    heavy_indices(num_heavy,     allocator);
+	Array<double> light_starts (num_light + 1, allocator); // Start of the deficit of every light entry on the deficit line
+	Array<double> heavy_starts (num_heavy + 1, allocator); // Start of the excess of every heavy entry on the excess line
+
+	for_each_chunk(thread_pool, num_chunks, [&](int c) {
+		const Chunk & chunk = chunks[c];
+
+		int    index_light = chunk.offset_light;
+		int    index_heavy = chunk.offset_heavy;
+		double deficit = chunk.offset_deficit;
+		double excess  = chunk.offset_excess;
+
+		for (int i = chunk.first; i < chunk.last; i++) {
+			double weight = weights[i] * scale;
+			if (weight < 1.0) {
+				light_indices[index_light] = i;
+				light_starts [index_light] = deficit;
+				index_light++;
+				deficit += 1.0 - weight;
+			} else {
+				heavy_indices[index_heavy] = i;
+				heavy_starts [index_heavy] = excess;
+				index_heavy++;
+				excess += weight - 1.0;
+			}
+		}
+	});
+	light_starts[num_light] = total_deficit;
+	heavy_starts[num_heavy] = total_excess;
+
+	for_each_chunk(thread_pool, num_chunks, [&](int c) {
+		const Chunk & chunk = chunks[c];
+
+		int index_light = chunk.offset_light;
+		int index_heavy = chunk.offset_heavy;
+
+		for (int i = chunk.first; i < chunk.last; i++) {
+			double weight = weights[i] * scale;
+			if (weight < 1.0) {
+				// The alias is the heavy entry whose excess covers the start of the deficit
+				int heavy = find_last_less_equal(heavy_starts.data(), num_heavy, light_starts[index_light]);
+				heavy = Math::clamp(heavy, 0, num_heavy - 1);
+
+				table[i] = { float(weight), heavy_indices[heavy] };
+				index_light++;
+			} else {
+				int heavy = index_heavy++;
+				if (heavy == num_heavy - 1) {
+					table[i] = { 1.0f, i };
+					continue;
+				}
+
+				// Find the last light entry whose deficit starts before the excess of this heavy entry runs out,
+				// the part of that deficit beyond the end of the excess is covered by the next heavy entry
+				double excess_end = heavy_starts[heavy + 1];
+				int    light      = find_last_less(light_starts.data(), num_light, excess_end);
+
+				double overdraft = light >= 0 ? light_starts[light + 1] - excess_end : 0.0;
+				overdraft = Math::clamp(overdraft, 0.0, 1.0);
+
+				if (overdraft > 0.0) {
+					table[i] = { float(1.0 - overdraft), heavy_indices[heavy + 1] };
+				} else {
+					table[i] = { 1.0f, i };
+				}
+			}
+		}
+	});
+}
+
+int AliasTable::sample(const AliasEntry table[], int count, float u_index, float u_coin) {
+	int index = Math::min(int(u_index * float(count)), count - 1);
+
+	const AliasEntry & entry = table[index];
+	return u_coin < entry.probability ? index : entry.alias;
+}
+
+int AliasTable::sample_and_remap(const AliasEntry table[], int count, float & u) {
+	float u_scaled = u * float(count);
+	int   index    = Math::min(int(u_scaled), count - 1);
+
+	u = Math::min(u_scaled - float(index), ONE_MINUS_EPSILON);
+
+	const AliasEntry & entry = table[index];
+	if (u < entry.probability) {
+		u = Math::min(u / entry.probability, ONE_MINUS_EPSILON);
+		return index;
+	} else {
+		u = Math::min((u - entry.probability) / (1.0f - entry.probability), ONE_MINUS_EPSILON);
+		return entry.alias;
+	}
+}
+
+// Compares the distribution implied by the table to the target distribution. Errors are relative to the target mass of the entry,
+// but at least the mass of a single bin (1/count), as entries with large weights accumulate the rounding errors of many float probabilities
+static bool check_exact(StringView name, const Array<double> & weights, ThreadPool * thread_pool) {
+	int count = int(weights.size());
+
+	Array<AliasEntry> table(count);
+	AliasTable::build(weights.data(), count, table.data(), thread_pool);
+
+	double total_weight = 0.0;
+	for (int i = 0; i < count; i++) {
+		total_weight += weights[i];
+	}
+
+	Array<double> implied(count);
+	for (int i = 0; i < count; i++) {
+		if (table[i].probability < 0.0f || table[i].probability > 1.0f || table[i].alias < 0 || table[i].alias >= count) {
+			IO::print("WARNING: Alias table check '{}' failed, entry {} is invalid!\n"_sv, name, i);
+			return false;
+		}
+		implied[i]              += double(table[i].probability);
+		implied[table[i].alias] += 1.0 - double(table[i].probability);
+	}
+
+	double max_error = 0.0;
+	for (int i = 0; i < count; i++) {
+		double target = total_weight > 0.0 ? weights[i] / total_weight * double(count) : 1.0;
+		max_error = Math::max(max_error, fabs(implied[i] - target) / Math::max(target, 1.0));
+	}
+
+	bool success = max_error < 1e-4;
+	IO::print("{} Alias table '{}' ({} entries): max error {}\n"_sv, success ? "OK     "_sv : "FAILED "_sv, name, count, float(max_error));
+	return success;
+}
+
+bool AliasTable::run_check() {
+	ThreadPool & thread_pool = ThreadPool::get_shared();
+	RNG rng(1234);
+
+	bool success = true;
+
+	auto make_weights = [&rng](int count, int distribution) {
+		Array<double> weights(count);
+		for (int i = 0; i < count; i++) {
+			switch (distribution) {
+				case 0: weights[i] = 1.0; break;                                                             // Uniform
+				case 1: weights[i] = double(Check::random_float(rng));  break;                               // Random
+				case 2: weights[i] = rng.get_uint32(4) == 0 ? 0.0 : double(Check::random_float(rng)); break; // Random with zeros
+				case 3: weights[i] = i == count / 2 ? 1e6 : 1.0; break;                                      // Single dominant entry
+				case 4: weights[i] = 1.0 / Math::max(double(Check::random_float(rng)), 1e-4); break;         // Heavy tailed
+			}
+		}
+		return weights;
+	};
+
+	constexpr StringView distribution_names[] = { "uniform"_sv, "random"_sv, "zeros"_sv, "dominant"_sv, "heavy tailed"_sv };
+
+	{
+		ScopeTimer timer("Alias table exactness"_sv);
+
+		int counts[] = { 1, 2, 3, 1000, 1 << 21 };
+		for (int count : counts) {
+			for (int distribution = 0; distribution < 5; distribution++) {
+				success &= check_exact(distribution_names[distribution], make_weights(count, distribution), &thread_pool);
+			}
+		}
+	}
+
+	constexpr int NUM_SAMPLES = 10000000;
+
+	// Single level, independent random numbers for the bin and the coin
+	{
+		constexpr int COUNT = 1000;
+		Array<double> weights = make_weights(COUNT, 2);
+
+		Array<AliasEntry> table(COUNT);
+		build(weights.data(), COUNT, table.data());
+
+		double total_weight = 0.0;
+		for (int i = 0; i < COUNT; i++) total_weight += weights[i];
+
+		Array<int>    observed(COUNT);
+		Array<double> expected(COUNT);
+		for (int i = 0; i < COUNT; i++) {
+			observed[i] = 0;
+			expected[i] = weights[i] / total_weight * double(NUM_SAMPLES);
+		}
+
+		for (int s = 0; s < NUM_SAMPLES; s++) {
+			float u_index = Check::random_float(rng);
+			float u_coin  = Check::random_float(rng);
+			observed[sample(table.data(), COUNT, u_index, u_coin)]++;
+		}
+
+		success &= Check::chi_squared("Alias table"_sv, "single level"_sv, observed, expected);
+	}
+
+	// Two levels, the way lights are sampled: the random number used for the first level is remapped and reused as the coin of the second level
+	{
+		constexpr int COUNT_OUTER = 16;
+		constexpr int COUNT_INNER = 64;
+
+		Array<double> weights_outer = make_weights(COUNT_OUTER, 4);
+		Array<double> weights_inner = make_weights(COUNT_OUTER * COUNT_INNER, 2);
+
+		Array<AliasEntry> table_outer(COUNT_OUTER);
+		Array<AliasEntry> table_inner(COUNT_OUTER * COUNT_INNER);
+		build(weights_outer.data(), COUNT_OUTER, table_outer.data());
+		for (int o = 0; o < COUNT_OUTER; o++) {
+			build(weights_inner.data() + o * COUNT_INNER, COUNT_INNER, table_inner.data() + o * COUNT_INNER);
+		}
+
+		double total_outer = 0.0;
+		for (int o = 0; o < COUNT_OUTER; o++) total_outer += weights_outer[o];
+
+		Array<int>    observed(COUNT_OUTER * COUNT_INNER);
+		Array<double> expected(COUNT_OUTER * COUNT_INNER);
+		for (int o = 0; o < COUNT_OUTER; o++) {
+			double total_inner = 0.0;
+			for (int i = 0; i < COUNT_INNER; i++) total_inner += weights_inner[o * COUNT_INNER + i];
+
+			for (int i = 0; i < COUNT_INNER; i++) {
+				observed[o * COUNT_INNER + i] = 0;
+				expected[o * COUNT_INNER + i] = weights_outer[o] / total_outer * weights_inner[o * COUNT_INNER + i] / total_inner * double(NUM_SAMPLES);
+			}
+		}
+
+		for (int s = 0; s < NUM_SAMPLES; s++) {
+			float u1 = Check::random_float(rng);
+			float u2 = Check::random_float(rng);
+
+			int o = sample_and_remap(table_outer.data(), COUNT_OUTER, u1);
+			int i = sample(table_inner.data() + o * COUNT_INNER, COUNT_INNER, u2, u1);
+			observed[o * COUNT_INNER + i]++;
+		}
+
+		success &= Check::chi_squared("Alias table"_sv, "two level"_sv, observed, expected);
+	}
+
+	IO::print(success ? "All alias table checks passed\n"_sv : "WARNING: Some alias table checks failed!\n"_sv);
+	return success;
+}
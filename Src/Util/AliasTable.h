@@ -0,0 +1,24 @@
+#pragma once
+#include "CUDA/Common.h"
+
+#include "Core/Allocators/Allocator.h"
+
+struct ThreadPool;
+
+// Alias tables allow sampling from a discrete distribution in O(1), see AliasEntry
+namespace AliasTable {
+	// Builds an alias table for count entries with probabilities proportional to the given non-negative weights.
+	// Every entry of the table is computed independently from prefix sums over the deficits and excesses of the weights
+	// (Vose's sweep in closed form), which allows the construction to be spread over the ThreadPool if one is provided
+	void build(const double weights[], int count, AliasEntry table[], ThreadPool * thread_pool = nullptr, Allocator * allocator = nullptr);
+
+	// Host equivalents of the sampling routines in CUDA/Sampling.h
+	// Selects a bin using u_index and decides between the bin and its alias using u_coin
+	int sample(const AliasEntry table[], int count, float u_index, float u_coin);
+	// Uses u for both decisions and afterwards remaps it to a uniform random number that can be reused
+	int sample_and_remap(const AliasEntry table[], int count, float & u);
+
+	// Checks that the constructed tables reproduce the target distributions exactly,
+	// and that sampled frequencies match the target distribution using a chi-squared test
+	bool run_check();
+}
@@ -0,0 +1,130 @@
+#include "Check.h"
+
+#include <math.h>
+
+#include "Config.h"
+
+#include "Math/Math.h"
+
+#include "BVH/LightBVH.h"
+
+#include "Assets/AssetManager.h"
+
+#include "Device/KernelCache.h"
+#include "Device/MemoryPool.h"
+
+#include "Renderer/Sky.h"
+#include "Renderer/Integrators/BatchSize.h"
+#include "Renderer/Integrators/RayReorder.h"
+
+#include "Util/PMJ02.h"
+#include "Util/AliasTable.h"
+#include "Util/ThreadPool.h"
+
+struct CheckEntry {
+	StringView name;
+	StringView description;
+
+	bool (* run)();
+};
+
+static constexpr CheckEntry checks[] = {
+	{ "batch"_sv,        "Automatically chosen batch sizes cover the frame and respect the memory budget"_sv,                        BatchSize::run_check },
+	{ "pool"_sv,         "Fuzzes the Device memory pool against a fake heap and verifies that resizing reuses memory"_sv,           MemoryPool::run_check },
+	{ "kernel-cache"_sv, "Kernel cache key construction, lookup, eviction and serialization"_sv,                                    KernelCache::run_check },
+	{ "reorder"_sv,      "Ray reordering key and sort against an emulation of the Device passes"_sv,                                RayReorder::run_check },
+	{ "pmj"_sv,          "Stratification of every sequence in the shuffled table of PMJ02 sequences (see --pmj)"_sv,                [] { PMJ02::init(cpu_config.pmj_filename, ThreadPool::get_shared()); return PMJ02::check_table(PMJ02::table, ThreadPool::get_shared()); } },
+	{ "alias"_sv,        "Alias tables used for light sampling against their target distributions"_sv,                              AliasTable::run_check },
+	{ "light-bvh"_sv,    "Sampling lights using the light BVH is unbiased, reports its variance compared to sampling by area"_sv, LightBVH::run_check },
+	{ "sky"_sv,          "Importance sampling of a synthetic Sky and of the Sky file (see --sky) against the pdf used for MIS"_sv, [] { return Sky::run_check(cpu_config.sky_filename); } },
+	{ "assets"_sv,       "The completion queue of background asset loading yields every asset exactly once"_sv,                    AssetManager::run_check },
+};
+
+bool Check::Checker::report(StringView name) const {
+	IO::print("{} checks: {}\n"_sv, name, num_failed == 0 ? "OK"_sv : "FAILED"_sv);
+	return num_failed == 0;
+}
+
+float Check::random_float(RNG & rng) {
+	return float(rng.get_uint32() >> 8) * (1.0f / float(1 << 24));
+}
+
+Vector3 Check::random_direction(RNG & rng) {
+	float z   = 2.0f * random_float(rng) - 1.0f;
+	float phi = TWO_PI * random_float(rng);
+	float r   = sqrtf(Math::max(1.0f - z*z, 0.0f));
+	return Vector3(r * cosf(phi), r * sinf(phi), z);
+}
+
+bool Check::chi_squared(StringView subject, StringView name, const Array<int> & observed, const Array<double> & expected) {
+	double chi_squared = 0.0;
+	int    num_bins    = 0;
+
+	int    pooled_observed = 0;
+	double pooled_expected = 0.0;
+
+	for (size_t i = 0; i < observed.size(); i++) {
+		if (expected[i] == 0.0) {
+			if (observed[i] != 0) {
+				IO::print("FAILED  {} '{}': bin {} has zero probability but was sampled {} times\n"_sv, subject, name, i, observed[i]);
+				return false;
+			}
+			continue;
+		}
+
+		if (expected[i] < 5.0) {
+			pooled_observed += observed[i];
+			pooled_expected += expected[i];
+			continue;
+		}
+
+		double difference = double(observed[i]) - expected[i];
+		chi_squared += difference * difference / expected[i];
+		num_bins++;
+	}
+
+	if (pooled_expected > 0.0) {
+		double difference = double(pooled_observed) - pooled_expected;
+		chi_squared += difference * difference / pooled_expected;
+		num_bins++;
+	}
+
+	double degrees_of_freedom = double(Math::max(num_bins - 1, 1));
+	double threshold = degrees_of_freedom + 5.0 * sqrt(2.0 * degrees_of_freedom);
+
+	bool success = chi_squared < threshold;
+	IO::print("{} {} '{}': chi squared {} (threshold {}, {} bins)\n"_sv, success ? "OK     "_sv : "FAILED "_sv, subject, name, float(chi_squared), float(threshold), num_bins);
+	return success;
+}
+
+bool Check::run(StringView name) {
+	bool run_all = name == "all"_sv;
+
+	int num_run    = 0;
+	int num_failed = 0;
+
+	for (const CheckEntry & check : checks) {
+		if (!run_all && !(check.name == name)) continue;
+
+		IO::print("== Check '{}'\n"_sv, check.name);
+		if (!check.run()) num_failed++;
+		num_run++;
+	}
+
+	if (num_run == 0) {
+		IO::print("'{}' is not a recognized check! Use --check-list for a list of checks\n"_sv, name);
+		return false;
+	}
+
+	if (run_all) {
+		IO::print("{} out of {} checks passed\n"_sv, num_run - num_failed, num_run);
+	}
+	return num_failed == 0;
+}
+
+void Check::print_checks() {
+	for (const CheckEntry & check : checks) {
+		IO::print("\t{:16}{}\n"_sv, check.name, check.description);
+	}
+	IO::print("\t{:16}{}\n"_sv, "all"_sv, "Runs every check"_sv);
+}
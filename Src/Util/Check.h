@@ -0,0 +1,52 @@
+#pragma once
+#include "Core/IO.h"
+#include "Core/Array.h"
+#include "Core/Random.h"
+#include "Core/String.h"
+#include "Core/StringView.h"
+
+#include "Math/Vector3.h"
+
+// Self checks of CPU side algorithms, run through --check. None of them require a GPU
+namespace Check {
+	// Counts failed conditions of a check, only the first few failures are printed
+	struct Checker {
+		static constexpr int MAX_PRINTED_FAILURES = 10;
+
+		int num_failed = 0;
+
+		bool operator()(bool condition, const char * what) {
+			return (*this)(condition, "{}"_sv, StringView::from_c_str(what));
+		}
+
+		template<typename ... Args>
+		bool operator()(bool condition, StringView fmt, const Args & ... args) {
+			if (condition) return true;
+
+			if (num_failed++ < MAX_PRINTED_FAILURES) {
+				String what = Format().format(fmt, args ...);
+				IO::print("FAILED: {}\n"_sv, what);
+			}
+			return false;
+		}
+
+		// Prints whether all conditions held and returns it
+		bool report(StringView name) const;
+	};
+
+	// Uniform float in [0, 1) with 24 bits of precision
+	float random_float(RNG & rng);
+
+	// Uniformly distributed direction on the unit sphere
+	Vector3 random_direction(RNG & rng);
+
+	// Pearson's chi-squared test between observed sample counts and expected counts, bins with small expected counts are pooled together.
+	// Accepts if the statistic is within 5 standard deviations of its mean (the number of degrees of freedom). Prints the result as '<subject> '<name>''
+	bool chi_squared(StringView subject, StringView name, const Array<int> & observed, const Array<double> & expected);
+
+	// Runs the check with the given name, or all of them if the name is 'all'
+	bool run(StringView name);
+
+	// Prints the name and description of every check
+	void print_checks();
+}
@@ -0,0 +1,107 @@
+#include "HashMapBenchmark.h"
+
+#include "Core/IO.h"
+#include "Core/Timer.h"
+#include "Core/Random.h"
+#include "Core/String.h"
+#include "Core/HashMap.h"
+#include "Core/RobinHoodHashMap.h"
+
+static constexpr int NUM_KEYS = 1000000;
+
+static volatile size_t sink = 0; // Prevents lookups from being optimized away
+
+template<typename Map>
+static void benchmark_int_keys(StringView name, const Array<int> & keys, const Array<int> & missing_keys) {
+	IO::print("{}:\n"_sv, name);
+
+	Map map;
+	{
+		ScopeTimer timer("\tInsert"_sv);
+		for (int i = 0; i < keys.size(); i++) {
+			map.insert(keys[i], i);
+		}
+	}
+	{
+		ScopeTimer timer("\tLookup (hits)"_sv);
+		size_t sum = 0;
+		for (int i = 0; i < keys.size(); i++) {
+			sum += *map.try_get(keys[i]);
+		}
+		sink = sum;
+	}
+	{
+		ScopeTimer timer("\tLookup (misses)"_sv);
+		size_t num_found = 0;
+		for (int i = 0; i < missing_keys.size(); i++) {
+			num_found += map.try_get(missing_keys[i]) != nullptr;
+		}
+		sink = num_found;
+	}
+}
+
+template<typename Map, typename LookupKey>
+static void benchmark_string_keys(StringView name, const Array<String> & keys) {
+	IO::print("{}:\n"_sv, name);
+
+	Map map;
+	{
+		ScopeTimer timer("\tInsert"_sv);
+		for (int i = 0; i < keys.size(); i++) {
+			map.insert(keys[i], i);
+		}
+	}
+	{
+		ScopeTimer timer("\tLookup"_sv);
+		size_t sum = 0;
+		for (int i = 0; i < keys.size(); i++) {
+			LookupKey key = keys[i].view(); // When LookupKey is String this constructs a temporary, like calling try_get with a StringView used to
+			sum += *map.try_get(key);
+		}
+		sink = sum;
+	}
+}
+
+static void print_probe_stats(StringView name, const RobinHoodHashMap<int, int>::ProbeStats & stats) {
+	IO::print("{}: {} elements, capacity {}, load factor {}, avg probe length {}, max probe length {}\n"_sv,
+		name, stats.count, stats.capacity, stats.load_factor, stats.avg_probe_length, stats.max_probe_length
+	);
+}
+
+void HashMapBenchmark::run() {
+	RNG rng(1337);
+
+	Array<int> keys        (NUM_KEYS);
+	Array<int> missing_keys(NUM_KEYS);
+	for (int i = 0; i < NUM_KEYS; i++) {
+		keys        [i] = 2 * int(rng.get_uint32() >> 2);
+		missing_keys[i] = 2 * int(rng.get_uint32() >> 2) + 1;
+	}
+
+	Array<String> string_keys(NUM_KEYS / 10);
+	for (int i = 0; i < string_keys.size(); i++) {
+		string_keys[i] = Format().format("Data/Textures/texture_{}.png"_sv, i);
+	}
+
+	benchmark_int_keys<HashMap         <int, int>>("HashMap (int keys)"_sv,          keys, missing_keys);
+	benchmark_int_keys<RobinHoodHashMap<int, int>>("RobinHoodHashMap (int keys)"_sv, keys, missing_keys);
+
+	benchmark_string_keys<HashMap         <String, int>, String>    ("HashMap (String keys, lookup by String)"_sv,              string_keys);
+	benchmark_string_keys<RobinHoodHashMap<String, int>, StringView>("RobinHoodHashMap (String keys, lookup by StringView)"_sv, string_keys);
+
+	// Probe lengths after inserts, and after erasing half of the elements
+	RobinHoodHashMap<int, int> map;
+	map.reserve(keys.size());
+	for (int i = 0; i < keys.size(); i++) {
+		map.insert(keys[i], i);
+	}
+	print_probe_stats("RobinHoodHashMap probe stats"_sv, map.get_probe_stats());
+
+	{
+		ScopeTimer timer("RobinHoodHashMap erase"_sv);
+		for (int i = 0; i < keys.size(); i += 2) {
+			map.erase(keys[i]);
+		}
+	}
+	print_probe_stats("RobinHoodHashMap probe stats after erase"_sv, map.get_probe_stats());
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+// Microbenchmark comparing HashMap (linear probing) with RobinHoodHashMap
+namespace HashMapBenchmark {
+	void run();
+}
@@ -0,0 +1,99 @@
+#include "LogBenchmark.h"
+
+#include <stdio.h>
+#include <thread>
+
+#include "Core/IO.h"
+#include "Core/Log.h"
+#include "Core/Array.h"
+#include "Core/Timer.h"
+
+#include "Math/Math.h"
+
+static constexpr int NUM_MESSAGES_PER_THREAD = 100000;
+
+static constexpr const char * OUTPUT_FILENAME = "log_benchmark.tmp";
+
+template<typename Func>
+static size_t run_threads(int num_threads, Func func) {
+	Array<std::thread> threads(num_threads);
+
+	Timer timer;
+	timer.start();
+
+	for (int t = 0; t < num_threads; t++) {
+		threads[t] = std::thread(func, t);
+	}
+	for (int t = 0; t < num_threads; t++) {
+		threads[t].join();
+	}
+
+	return timer.stop();
+}
+
+// The way IO::print used to work: format using a LinearAllocator constructed for each message and write the result directly
+static size_t benchmark_direct(FILE * file, int num_threads) {
+	return run_threads(num_threads, [file](int thread_index) {
+		for (int i = 0; i < NUM_MESSAGES_PER_THREAD; i++) {
+			LinearAllocator<KILOBYTES(4)> allocator;
+			String string = Format(&allocator).format("Thread {} processed item {} of {} ({})\n"_sv, thread_index, i, NUM_MESSAGES_PER_THREAD, 0.5f);
+			fwrite(string.data(), sizeof(char), string.size(), file);
+		}
+	});
+}
+
+static size_t benchmark_log(FILE * file, int num_threads, size_t & time_flush, uint64_t & num_dropped) {
+	uint64_t num_dropped_before = Log::get_stats().num_dropped;
+
+	Log::set_output(file);
+
+	size_t time_submit = run_threads(num_threads, [](int thread_index) {
+		for (int i = 0; i < NUM_MESSAGES_PER_THREAD; i++) {
+			Log::info(Log::Category::GENERAL, "Thread {} processed item {} of {} ({})\n"_sv, thread_index, i, NUM_MESSAGES_PER_THREAD, 0.5f);
+		}
+	});
+
+	Timer timer;
+	timer.start();
+	Log::flush();
+	time_flush = timer.stop();
+
+	Log::set_output(stdout);
+
+	num_dropped = Log::get_stats().num_dropped - num_dropped_before;
+	return time_submit;
+}
+
+void LogBenchmark::run() {
+	FILE * file = nullptr;
+	fopen_s(&file, OUTPUT_FILENAME, "wb");
+	if (!file) {
+		IO::print("WARNING: Unable to open '{}' for the log benchmark!\n"_sv, OUTPUT_FILENAME);
+		return;
+	}
+
+	Log::init();
+
+	int max_threads = Math::max(int(std::thread::hardware_concurrency()), 1);
+
+	for (int num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+		int num_messages = num_threads * NUM_MESSAGES_PER_THREAD;
+
+		size_t   time_direct = benchmark_direct(file, num_threads);
+		size_t   time_flush  = 0;
+		uint64_t num_dropped = 0;
+		size_t   time_log    = benchmark_log(file, num_threads, time_flush, num_dropped);
+
+		IO::print("{} messages on {} threads:\n"_sv, num_messages, num_threads);
+		Timer::print_named_duration("\tDirect           "_sv, time_direct);
+		Timer::print_named_duration("\tLog (submit)     "_sv, time_log);
+		Timer::print_named_duration("\tLog (flush)      "_sv, time_flush);
+		IO::print("\tLog dropped {} messages\n"_sv, num_dropped);
+		Log::flush();
+	}
+
+	Log::shutdown();
+
+	fclose(file);
+	remove(OUTPUT_FILENAME);
+}
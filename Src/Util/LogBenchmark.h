@@ -0,0 +1,6 @@
+#pragma once
+
+// Benchmark comparing the throughput of the asynchronous Log against formatting and writing every message directly on the calling thread
+namespace LogBenchmark {
+	void run();
+}
@@ -0,0 +1,59 @@
+#include "MappedFile.h"
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+
+#include "Core/IO.h"
+
+bool MappedFile::open(const String & filename) {
+	close();
+
+	HANDLE file = CreateFileA(filename.data(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		IO::print("WARNING: Unable to open file '{}' for mapping!\n"_sv, filename);
+		return false;
+	}
+	file_handle = file;
+
+	LARGE_INTEGER file_size = { };
+	if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+		IO::print("WARNING: Unable to map empty file '{}'!\n"_sv, filename);
+		close();
+		return false;
+	}
+	size = size_t(file_size.QuadPart);
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr) {
+		IO::print("WARNING: Unable to create file mapping for '{}'!\n"_sv, filename);
+		close();
+		return false;
+	}
+	mapping_handle = mapping;
+
+	data = reinterpret_cast<const char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (data == nullptr) {
+		IO::print("WARNING: Unable to map view of file '{}'!\n"_sv, filename);
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void MappedFile::close() {
+	if (data) {
+		UnmapViewOfFile(data);
+		data = nullptr;
+	}
+	if (mapping_handle) {
+		CloseHandle(mapping_handle);
+		mapping_handle = nullptr;
+	}
+	if (file_handle) {
+		CloseHandle(file_handle);
+		file_handle = nullptr;
+	}
+	size = 0;
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include "Core/String.h"
+
+// Read-only memory mapped file
+// Pages are only brought into memory by the OS when accessed, and since they are never written to they can be discarded under memory pressure
+struct MappedFile {
+	void * file_handle    = nullptr;
+	void * mapping_handle = nullptr;
+
+	const char * data = nullptr;
+	size_t       size = 0;
+
+	MappedFile() = default;
+
+	NON_COPYABLE(MappedFile);
+	NON_MOVEABLE(MappedFile);
+
+	~MappedFile() {
+		close();
+	}
+
+	bool open(const String & filename);
+	void close();
+
+	inline bool is_open() const { return data != nullptr; }
+};
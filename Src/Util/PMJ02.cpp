@@ -0,0 +1,290 @@
+#include "PMJ02.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "Core/IO.h"
+#include "Core/Log.h"
+#include "Core/Random.h"
+#include "Core/Timer.h"
+
+#include "Math/Math.h"
+
+#include "Util/Util.h"
+#include "Util/ThreadPool.h"
+
+PMJ02::Table PMJ02::table;
+
+static constexpr char PMJ_FILETYPE_VERSION = 1;
+
+struct PMJFileHeader {
+	char filetype_identifier[4];
+	char filetype_version;
+
+	int num_sequences;
+	int num_samples_per_sequence;
+};
+
+static unsigned reverse_bits(unsigned x) {
+	x = ((x & 0xaaaaaaaa) >> 1) | ((x & 0x55555555) << 1);
+	x = ((x & 0xcccccccc) >> 2) | ((x & 0x33333333) << 2);
+	x = ((x & 0xf0f0f0f0) >> 4) | ((x & 0x0f0f0f0f) << 4);
+	x = ((x & 0xff00ff00) >> 8) | ((x & 0x00ff00ff) << 8);
+	return (x >> 16) | (x << 16);
+}
+
+static unsigned hash(unsigned x) {
+	x ^= x >> 16;
+	x *= 0x7feb352d;
+	x ^= x >> 15;
+	x *= 0x846ca68b;
+	x ^= x >> 16;
+	return x;
+}
+
+// Every bit of the result only depends on the seed and on the bits of x at the same or lower positions
+// Based on: Burley - Practical Hash-based Owen Scrambling (2020)
+static unsigned laine_karras_permutation(unsigned x, unsigned seed) {
+	x += seed;
+	x ^= x * 0x6c50b47c;
+	x ^= x * 0xb82f1e52;
+	x ^= x * 0xc7afe638;
+	x ^= x * 0x8d22f6e6;
+	return x;
+}
+
+// Flips every bit of the num_bits bit value based on the bits above it (nested uniform scrambling)
+static unsigned nested_uniform_scramble(unsigned value, int num_bits, unsigned seed) {
+	if (num_bits == 0) return 0;
+
+	unsigned x = reverse_bits(value << (32 - num_bits));
+	x = laine_karras_permutation(x, seed);
+	return reverse_bits(x) >> (32 - num_bits);
+}
+
+// Second dimension of the Sobol sequence, together with the van der Corput sequence this forms a (0,2)-sequence in base 2
+static unsigned sobol_2(unsigned index) {
+	unsigned result = 0;
+	for (unsigned v = 1u << 31; index != 0; index >>= 1, v ^= v >> 1) {
+		if (index & 1) result ^= v;
+	}
+	return result;
+}
+
+// Maps a 32 bit fixed point number in [0, 1) to a float in [0, 1), the 24 most significant bits are kept exactly
+static unsigned fixed_point_to_float_bits(unsigned x) {
+	return Util::bit_cast<unsigned>(float(x >> 8) * (1.0f / float(1 << 24)));
+}
+
+static unsigned float_bits_to_fixed_point(unsigned x) {
+	return unsigned(double(Util::bit_cast<float>(x)) * 4294967296.0);
+}
+
+void PMJ02::init(const String & filename, ThreadPool & thread_pool) {
+	if (filename.is_empty() || !IO::file_exists(filename.view()) || !table_load(filename, table)) {
+		table.num_sequences            = PMJ_NUM_SEQUENCES;
+		table.num_samples_per_sequence = PMJ_NUM_SAMPLES_PER_SEQUENCE;
+		table.samples.resize(PMJ_NUM_SEQUENCES * PMJ_NUM_SAMPLES_PER_SEQUENCE);
+		memcpy(table.samples.data(), PMJ::samples, table.samples.size() * sizeof(PMJ::Point));
+	}
+
+	// The first sequence is left in its original order
+	thread_pool.parallel_for(1, table.num_sequences, 1, [](int sequence_index) {
+		shuffle(table.get_sequence(sequence_index), table.num_samples_per_sequence, hash(unsigned(sequence_index)));
+	});
+}
+
+void PMJ02::generate(PMJ::Point sequence[], int num_samples, unsigned seed) {
+	RNG rng(seed);
+	unsigned seed_x = rng.get_uint32();
+	unsigned seed_y = rng.get_uint32();
+
+	for (int i = 0; i < num_samples; i++) {
+		unsigned x = reverse_bits(unsigned(i));
+		unsigned y = sobol_2     (unsigned(i));
+
+		// Owen scrambling randomizes the sequence while preserving its stratification
+		x = reverse_bits(laine_karras_permutation(reverse_bits(x), seed_x));
+		y = reverse_bits(laine_karras_permutation(reverse_bits(y), seed_y));
+
+		sequence[i].x = fixed_point_to_float_bits(x);
+		sequence[i].y = fixed_point_to_float_bits(y);
+	}
+}
+
+void PMJ02::shuffle(PMJ::Point sequence[], int num_samples, unsigned seed) {
+	ASSERT(Math::is_power_of_two(num_samples));
+
+	Array<PMJ::Point> shuffled(num_samples);
+	shuffled[0] = sequence[0];
+
+	// Samples are only reordered within each octave [2^k, 2^(k+1)). The order within an octave is permuted using
+	// nested uniform scrambling of the index, so that aligned sub-blocks of the octave map to aligned sub-blocks
+	for (int octave = 0; (1 << octave) < num_samples; octave++) {
+		unsigned first = 1u << octave;
+		unsigned octave_seed = hash(seed ^ hash(unsigned(octave)));
+
+		for (unsigned i = 0; i < first; i++) {
+			shuffled[first + i] = sequence[first + nested_uniform_scramble(i, octave, octave_seed)];
+		}
+	}
+
+	memcpy(sequence, shuffled.data(), num_samples * sizeof(PMJ::Point));
+}
+
+bool PMJ02::check_stratification(const PMJ::Point sequence[], int num_samples) {
+	Array<unsigned> xs(num_samples);
+	Array<unsigned> ys(num_samples);
+	for (int i = 0; i < num_samples; i++) {
+		xs[i] = float_bits_to_fixed_point(sequence[i].x);
+		ys[i] = float_bits_to_fixed_point(sequence[i].y);
+	}
+
+	Array<bool> occupied(num_samples);
+
+	for (int m = 0; (1 << m) <= num_samples; m++) {
+		int count = 1 << m;
+
+		// Check every elementary interval shape of area 2^-m, 2^a by 2^b cells with a + b = m
+		for (int a = 0; a <= m; a++) {
+			int b = m - a;
+
+			memset(occupied.data(), 0, count * sizeof(bool));
+
+			for (int i = 0; i < count; i++) {
+				unsigned cell_x = unsigned(uint64_t(xs[i]) >> (32 - a));
+				unsigned cell_y = unsigned(uint64_t(ys[i]) >> (32 - b));
+				unsigned cell   = (cell_x << b) | cell_y;
+
+				if (occupied[cell]) {
+					Log::warning(Log::Category::GENERAL, "PMJ02 samples [0, {}) have more than one sample in a {}x{} elementary interval!\n"_sv, count, 1 << a, 1 << b);
+					return false;
+				}
+				occupied[cell] = true;
+			}
+		}
+	}
+
+	return true;
+}
+
+bool PMJ02::check_table(const Table & table, ThreadPool & thread_pool) {
+	std::atomic<int> num_failed = 0;
+	{
+		ScopeTimer timer("PMJ02 stratification check"_sv);
+
+		thread_pool.parallel_for(0, table.num_sequences, 1, [&table, &num_failed](int sequence_index) {
+			if (!check_stratification(table.get_sequence(sequence_index), table.num_samples_per_sequence)) {
+				Log::warning(Log::Category::GENERAL, "PMJ02 sequence {} is not stratified!\n"_sv, sequence_index);
+				num_failed++;
+			}
+		});
+	}
+
+	if (num_failed > 0) {
+		Log::warning(Log::Category::GENERAL, "{} out of {} PMJ02 sequences failed the stratification check!\n"_sv, num_failed.load(), table.num_sequences);
+		return false;
+	}
+
+	IO::print("All {} PMJ02 sequences of {} samples are stratified\n"_sv, table.num_sequences, table.num_samples_per_sequence);
+	return true;
+}
+
+bool PMJ02::generate_table(const String & filename, int num_samples_per_sequence, ThreadPool & thread_pool) {
+	if (!Math::is_power_of_two(num_samples_per_sequence) || num_samples_per_sequence < PMJ_NUM_SAMPLES_PER_SEQUENCE) {
+		Log::warning(Log::Category::GENERAL, "The number of PMJ02 samples per sequence should be a power of two of at least {}, got {}!\n"_sv, PMJ_NUM_SAMPLES_PER_SEQUENCE, num_samples_per_sequence);
+		return false;
+	}
+
+	Table generated_table;
+	generated_table.num_sequences            = PMJ_NUM_SEQUENCES;
+	generated_table.num_samples_per_sequence = num_samples_per_sequence;
+	generated_table.samples.resize(size_t(PMJ_NUM_SEQUENCES) * size_t(num_samples_per_sequence));
+
+	{
+		ScopeTimer timer("PMJ02 generation"_sv);
+
+		thread_pool.parallel_for(0, PMJ_NUM_SEQUENCES, 1, [&generated_table](int sequence_index) {
+			generate(generated_table.get_sequence(sequence_index), generated_table.num_samples_per_sequence, hash(unsigned(sequence_index) + 0x9e3779b9));
+		});
+	}
+
+	if (!table_save(filename, generated_table)) return false;
+
+	IO::print("Wrote {} PMJ02 sequences of {} samples to '{}'\n"_sv, PMJ_NUM_SEQUENCES, num_samples_per_sequence, filename);
+	return true;
+}
+
+bool PMJ02::table_load(const String & filename, Table & table) {
+	FILE * file = nullptr;
+	fopen_s(&file, filename.data(), "rb");
+
+	if (!file) {
+		Log::warning(Log::Category::GENERAL, "Unable to open PMJ02 file '{}'!\n"_sv, filename);
+		return false;
+	}
+
+	PMJFileHeader header = { };
+	if (fread(&header, sizeof(header), 1, file) != 1 || strcmp(header.filetype_identifier, "PMJ") != 0) {
+		Log::warning(Log::Category::GENERAL, "PMJ02 file '{}' has an invalid header!\n"_sv, filename);
+		fclose(file);
+		return false;
+	}
+
+	// The renderer indexes sequences modulo PMJ_NUM_SEQUENCES and permutes indices assuming a power of two length.
+	// Tables shorter than the built-in sequences are rejected, so that loading a file never reduces the sample count
+	if (header.filetype_version != PMJ_FILETYPE_VERSION || header.num_sequences != PMJ_NUM_SEQUENCES ||
+		!Math::is_power_of_two(header.num_samples_per_sequence) || header.num_samples_per_sequence < PMJ_NUM_SAMPLES_PER_SEQUENCE
+	) {
+		Log::warning(Log::Category::GENERAL, "PMJ02 file '{}' has an unsupported version or layout!\n"_sv, filename);
+		fclose(file);
+		return false;
+	}
+
+	table.num_sequences            = header.num_sequences;
+	table.num_samples_per_sequence = header.num_samples_per_sequence;
+	table.samples.resize(size_t(header.num_sequences) * size_t(header.num_samples_per_sequence));
+
+	size_t num_samples_read = fread(table.samples.data(), sizeof(PMJ::Point), table.samples.size(), file);
+	fclose(file);
+
+	if (num_samples_read < table.samples.size()) {
+		Log::warning(Log::Category::GENERAL, "PMJ02 file '{}' is truncated!\n"_sv, filename);
+		return false;
+	}
+
+	IO::print("Loaded {} PMJ02 sequences of {} samples from '{}'\n"_sv, table.num_sequences, table.num_samples_per_sequence, filename);
+	return true;
+}
+
+bool PMJ02::table_save(const String & filename, const Table & table) {
+	FILE * file = nullptr;
+	fopen_s(&file, filename.data(), "wb");
+
+	if (!file) {
+		Log::warning(Log::Category::GENERAL, "Unable to open PMJ02 file '{}' for writing!\n"_sv, filename);
+		return false;
+	}
+
+	PMJFileHeader header = { };
+	header.filetype_identifier[0] = 'P';
+	header.filetype_identifier[1] = 'M';
+	header.filetype_identifier[2] = 'J';
+	header.filetype_identifier[3] = '\0';
+	header.filetype_version = PMJ_FILETYPE_VERSION;
+
+	header.num_sequences            = table.num_sequences;
+	header.num_samples_per_sequence = table.num_samples_per_sequence;
+
+	size_t header_written      = fwrite(&header, sizeof(header), 1, file);
+	size_t num_samples_written = fwrite(table.samples.data(), sizeof(PMJ::Point), table.samples.size(), file);
+
+	fclose(file);
+
+	if (!header_written || num_samples_written < table.samples.size()) {
+		Log::warning(Log::Category::GENERAL, "Unable to successfully write to PMJ02 file '{}'!\n"_sv, filename);
+		return false;
+	}
+
+	return true;
+}
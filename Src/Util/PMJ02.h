@@ -0,0 +1,51 @@
+#pragma once
+#include "CUDA/Common.h"
+
+#include "Core/Array.h"
+#include "Core/String.h"
+
+#include "Util/PMJ.h"
+
+struct ThreadPool;
+
+// Runtime table of PMJ02 sequences used by the renderer
+// The table is either loaded from a binary file produced by PMJ02::generate_table (which allows more than
+// PMJ_NUM_SAMPLES_PER_SEQUENCE samples per sequence) or copied from the built-in PMJ::samples if no such file exists
+namespace PMJ02 {
+	struct Table {
+		int num_sequences            = 0;
+		int num_samples_per_sequence = 0; // Always a power of two
+
+		Array<PMJ::Point> samples;
+
+		PMJ::Point       * get_sequence(int index)       { return samples.data() + size_t(index) * num_samples_per_sequence; }
+		const PMJ::Point * get_sequence(int index) const { return samples.data() + size_t(index) * num_samples_per_sequence; }
+	};
+
+	extern Table table;
+
+	// Loads the table from the given file if it exists, falls back to the built-in samples otherwise,
+	// and shuffles all sequences except the first one in parallel
+	void init(const String & filename, ThreadPool & thread_pool);
+
+	// Fills the sequence with an Owen scrambled (0,2)-sequence in base 2.
+	// Every prefix of a power of two length 2^m forms a (0,m,2)-net, which is the stratification PMJ02 sequences guarantee
+	void generate(PMJ::Point sequence[], int num_samples, unsigned seed);
+
+	// Reorders the samples of the sequence, the set of samples in every prefix of a power of two length is left unchanged,
+	// so that the stratification of those prefixes is preserved
+	void shuffle(PMJ::Point sequence[], int num_samples, unsigned seed);
+
+	// Checks that every prefix of a power of two length 2^m has exactly one sample in every elementary interval of area 2^-m
+	bool check_stratification(const PMJ::Point sequence[], int num_samples);
+
+	// Checks the stratification of every sequence in the table
+	bool check_table(const Table & table, ThreadPool & thread_pool);
+
+	// Generates PMJ_NUM_SEQUENCES sequences and writes them to the given file.
+	// The number of samples per sequence should be a power of two of at least PMJ_NUM_SAMPLES_PER_SEQUENCE
+	bool generate_table(const String & filename, int num_samples_per_sequence, ThreadPool & thread_pool);
+
+	bool table_load(const String & filename, Table & table);
+	bool table_save(const String & filename, const Table & table);
+}
@@ -0,0 +1,199 @@
+#pragma once
+#include "Core/Sort.h"
+
+#include "Util/ThreadPool.h"
+
+// Multithreaded versions of the sorts in Core/Sort.h
+namespace ParallelSort {
+	// Stable parallel LSD radix sort, see Sort::radix_sort.
+	// Every pass, each chunk of the input computes a local histogram in parallel. A prefix sum over all (digit, chunk) pairs
+	// then gives every chunk its own output range per digit, so that all chunks can scatter in parallel without synchronization
+	template<typename Value>
+	void radix_sort(ThreadPool & thread_pool, unsigned * keys, Value * values, unsigned * tmp_keys, Value * tmp_values, size_t count) {
+		constexpr size_t MIN_CHUNK_SIZE = 1 << 16;
+
+		int num_chunks = int(Math::min(size_t(4 * thread_pool.thread_count()), Math::divide_round_up(count, MIN_CHUNK_SIZE)));
+		if (num_chunks <= 1) {
+			Sort::radix_sort(keys, values, tmp_keys, tmp_values, count);
+			return;
+		}
+		size_t chunk_size = Math::divide_round_up(count, size_t(num_chunks));
+
+		Array<size_t> histograms(num_chunks * Sort::RADIX_NUM_DIGITS);
+
+		unsigned * src_keys   = keys;
+		Value    * src_values = values;
+		unsigned * dst_keys   = tmp_keys;
+		Value    * dst_values = tmp_values;
+
+		for (int pass = 0; pass < Sort::RADIX_NUM_PASSES; pass++) {
+			thread_pool.parallel_for(0, num_chunks, 1, [&](int chunk) {
+				size_t * histogram = histograms.data() + chunk * Sort::RADIX_NUM_DIGITS;
+				memset(histogram, 0, Sort::RADIX_NUM_DIGITS * sizeof(size_t));
+
+				size_t first = chunk * chunk_size;
+				size_t last  = Math::min(first + chunk_size, count);
+				for (size_t i = first; i < last; i++) {
+					histogram[Sort::radix_digit(src_keys[i], pass)]++;
+				}
+			});
+
+			// Exclusive prefix sum, digit major so that the output of each chunk follows the output of the previous chunk for the same digit
+			bool skip_pass = false;
+			size_t sum = 0;
+			for (int d = 0; d < Sort::RADIX_NUM_DIGITS; d++) {
+				size_t digit_start = sum;
+
+				for (int chunk = 0; chunk < num_chunks; chunk++) {
+					size_t & offset = histograms[chunk * Sort::RADIX_NUM_DIGITS + d];
+					size_t chunk_digit_count = offset;
+					offset = sum;
+					sum += chunk_digit_count;
+				}
+
+				if (sum - digit_start == count) {
+					skip_pass = true; // All keys have the same digit
+					break;
+				}
+			}
+			if (skip_pass) continue;
+
+			thread_pool.parallel_for(0, num_chunks, 1, [&](int chunk) {
+				size_t * offsets = histograms.data() + chunk * Sort::RADIX_NUM_DIGITS;
+
+				size_t first = chunk * chunk_size;
+				size_t last  = Math::min(first + chunk_size, count);
+				for (size_t i = first; i < last; i++) {
+					size_t index = offsets[Sort::radix_digit(src_keys[i], pass)]++;
+
+					dst_keys[index] = src_keys[i];
+					if (values) dst_values[index] = std::move(src_values[i]);
+				}
+			});
+
+			Util::swap(src_keys,   dst_keys);
+			Util::swap(src_values, dst_values);
+		}
+
+		// Copy back if the final result ended up in the temporary buffers
+		if (src_keys != keys) {
+			thread_pool.parallel_for(0, num_chunks, 1, [&](int chunk) {
+				size_t first = chunk * chunk_size;
+				size_t last  = Math::min(first + chunk_size, count);
+				for (size_t i = first; i < last; i++) {
+					keys[i] = src_keys[i];
+					if (values) values[i] = std::move(src_values[i]);
+				}
+			});
+		}
+	}
+
+	template<typename T, typename Cmp>
+	void merge_recursive(ThreadPool::TaskGroup & group, T * first_a, T * last_a, T * first_b, T * last_b, T * dst, Cmp & cmp) {
+		constexpr ptrdiff_t MIN_MERGE_SIZE = 1 << 14;
+
+		ptrdiff_t count_a = last_a - first_a;
+		ptrdiff_t count_b = last_b - first_b;
+
+		if (count_a + count_b <= MIN_MERGE_SIZE) {
+			// Sequential merge, ties are resolved in favour of a to keep the sort stable
+			while (first_a != last_a && first_b != last_b) {
+				if (cmp(*first_b, *first_a)) {
+					*dst++ = std::move(*first_b++);
+				} else {
+					*dst++ = std::move(*first_a++);
+				}
+			}
+			while (first_a != last_a) *dst++ = std::move(*first_a++);
+			while (first_b != last_b) *dst++ = std::move(*first_b++);
+			return;
+		}
+
+		// Split the larger input in half and find the corresponding split point in the other input using binary search
+		T * split_a;
+		T * split_b;
+		if (count_a >= count_b) {
+			split_a = first_a + count_a / 2;
+
+			// First element in b that is not less than *split_a, equal elements from b go after those from a
+			T * lo = first_b;
+			T * hi = last_b;
+			while (lo < hi) {
+				T * mid = lo + (hi - lo) / 2;
+				if (cmp(*mid, *split_a)) lo = mid + 1; else hi = mid;
+			}
+			split_b = lo;
+		} else {
+			split_b = first_b + count_b / 2;
+
+			// First element in a that is greater than *split_b, equal elements from a go before those from b
+			T * lo = first_a;
+			T * hi = last_a;
+			while (lo < hi) {
+				T * mid = lo + (hi - lo) / 2;
+				if (cmp(*split_b, *mid)) hi = mid; else lo = mid + 1;
+			}
+			split_a = lo;
+		}
+
+		T * dst_right = dst + (split_a - first_a) + (split_b - first_b);
+
+		group.run([&group, first_a, split_a, first_b, split_b, dst, &cmp]() {
+			merge_recursive(group, first_a, split_a, first_b, split_b, dst, cmp);
+		});
+		merge_recursive(group, split_a, last_a, split_b, last_b, dst_right, cmp);
+	}
+
+	// Stable parallel merge sort. tmp should have room for last - first elements
+	// Chunks are sorted independently using Sort::stable_sort, after which they are merged pairwise in rounds.
+	// Every merge is itself split into independent pieces, so that the final rounds also use all threads
+	template<typename T, typename Cmp>
+	void merge_sort(ThreadPool & thread_pool, T * first, T * last, T * tmp, Cmp cmp = Compare::LessThan<T>()) {
+		constexpr ptrdiff_t MIN_CHUNK_SIZE = 1 << 14;
+
+		ptrdiff_t count = last - first;
+
+		int num_chunks = int(Math::min(ptrdiff_t(4 * thread_pool.thread_count()), Math::divide_round_up(count, MIN_CHUNK_SIZE)));
+		if (num_chunks <= 1) {
+			Sort::stable_sort(first, last, tmp, cmp);
+			return;
+		}
+		ptrdiff_t chunk_size = Math::divide_round_up(count, ptrdiff_t(num_chunks));
+
+		thread_pool.parallel_for(0, num_chunks, 1, [&](int chunk) {
+			ptrdiff_t chunk_first = chunk * chunk_size;
+			ptrdiff_t chunk_last  = Math::min(chunk_first + chunk_size, count);
+			Sort::stable_sort(first + chunk_first, first + chunk_last, tmp + chunk_first, cmp);
+		});
+
+		T * src = first;
+		T * dst = tmp;
+
+		for (ptrdiff_t width = chunk_size; width < count; width *= 2) {
+			ThreadPool::TaskGroup group(thread_pool);
+
+			for (ptrdiff_t offset = 0; offset < count; offset += 2 * width) {
+				ptrdiff_t middle = Math::min(offset + width,     count);
+				ptrdiff_t end    = Math::min(offset + 2 * width, count);
+
+				group.run([&group, src, dst, offset, middle, end, &cmp]() {
+					merge_recursive(group, src + offset, src + middle, src + middle, src + end, dst + offset, cmp);
+				});
+			}
+
+			group.wait();
+			Util::swap(src, dst);
+		}
+
+		// Copy back if the final result ended up in the temporary buffer
+		if (src != first) {
+			thread_pool.parallel_for(0, num_chunks, 1, [&](int chunk) {
+				ptrdiff_t chunk_first = chunk * chunk_size;
+				ptrdiff_t chunk_last  = Math::min(chunk_first + chunk_size, count);
+				for (ptrdiff_t i = chunk_first; i < chunk_last; i++) {
+					first[i] = std::move(src[i]);
+				}
+			});
+		}
+	}
+}
@@ -0,0 +1,106 @@
+#include "SortBenchmark.h"
+
+#include "Core/IO.h"
+#include "Core/Sort.h"
+#include "Core/Timer.h"
+#include "Core/Random.h"
+
+#include "Util/ParallelSort.h"
+
+static bool is_sorted(const float * data, size_t count) {
+	for (size_t i = 1; i < count; i++) {
+		if (data[i] < data[i - 1]) return false;
+	}
+	return true;
+}
+
+static void benchmark_size(ThreadPool & thread_pool, size_t count) {
+	IO::print("{} elements:\n"_sv, count);
+
+	RNG rng(1337);
+
+	Array<float> input(count);
+	for (size_t i = 0; i < count; i++) {
+		input[i] = rng.get_float() * 2000.0f - 1000.0f;
+	}
+
+	Array<float> data(count);
+	Array<float> tmp (count);
+
+	auto check = [&data, count](StringView name) {
+		if (!is_sorted(data.data(), count)) {
+			IO::print("WARNING: {} did not produce sorted output!\n"_sv, name);
+		}
+	};
+
+	memcpy(data.data(), input.data(), count * sizeof(float));
+	{
+		ScopeTimer timer("\tquick_sort"_sv);
+		Sort::quick_sort(data.begin(), data.end(), Compare::LessThan<float>());
+	}
+	check("quick_sort"_sv);
+
+	// Already sorted input, used to degrade quick_sort before it had median of three pivots and a depth limit
+	{
+		ScopeTimer timer("\tquick_sort (sorted input)"_sv);
+		Sort::quick_sort(data.begin(), data.end(), Compare::LessThan<float>());
+	}
+	check("quick_sort (sorted input)"_sv);
+
+	memcpy(data.data(), input.data(), count * sizeof(float));
+	{
+		ScopeTimer timer("\tstable_sort"_sv);
+		Sort::stable_sort(data.begin(), data.end(), tmp.data(), Compare::LessThan<float>());
+	}
+	check("stable_sort"_sv);
+
+	memcpy(data.data(), input.data(), count * sizeof(float));
+	{
+		ScopeTimer timer("\tParallelSort::merge_sort"_sv);
+		ParallelSort::merge_sort(thread_pool, data.begin(), data.end(), tmp.data(), Compare::LessThan<float>());
+	}
+	check("ParallelSort::merge_sort"_sv);
+
+	// Radix sort on key-index pairs, as used to sort primitives by centroid
+	Array<unsigned> keys      (count);
+	Array<unsigned> tmp_keys  (count);
+	Array<int>      indices   (count);
+	Array<int>      tmp_indices(count);
+
+	auto init_keys = [&]() {
+		for (size_t i = 0; i < count; i++) {
+			keys   [i] = Sort::float_to_radix_key(input[i]);
+			indices[i] = int(i);
+		}
+	};
+	auto check_keys = [&](StringView name) {
+		for (size_t i = 0; i < count; i++) {
+			data[i] = input[indices[i]];
+		}
+		check(name);
+	};
+
+	init_keys();
+	{
+		ScopeTimer timer("\tradix_sort"_sv);
+		Sort::radix_sort(keys.data(), indices.data(), tmp_keys.data(), tmp_indices.data(), count);
+	}
+	check_keys("radix_sort"_sv);
+
+	init_keys();
+	{
+		ScopeTimer timer("\tParallelSort::radix_sort"_sv);
+		ParallelSort::radix_sort(thread_pool, keys.data(), indices.data(), tmp_keys.data(), tmp_indices.data(), count);
+	}
+	check_keys("ParallelSort::radix_sort"_sv);
+}
+
+void SortBenchmark::run() {
+	ThreadPool thread_pool;
+
+	IO::print("Sort benchmark on {} threads\n"_sv, thread_pool.thread_count());
+
+	benchmark_size(thread_pool, 1000000);
+	benchmark_size(thread_pool, 10000000);
+	benchmark_size(thread_pool, 100000000);
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+// Benchmark comparing the sorting algorithms in Core/Sort.h and Util/ParallelSort.h on 1M to 100M elements
+namespace SortBenchmark {
+	void run();
+}
@@ -194,3 +194,27 @@ String Util::to_string(double value, Allocator * allocator) {
 
 	return String(buf, offset, allocator);
 }
+
+void Util::append_json_escaped(Array<char> & json, StringView str) {
+	constexpr char HEX[] = "0123456789abcdef";
+
+	for (size_t i = 0; i < str.length(); i++) {
+		char c = str[i];
+		switch (c) {
+			case '"':  json.push_back('\\'); json.push_back('"');  break;
+			case '\\': json.push_back('\\'); json.push_back('\\'); break;
+			case '\n': json.push_back('\\'); json.push_back('n');  break;
+			case '\r': json.push_back('\\'); json.push_back('r');  break;
+			case '\t': json.push_back('\\'); json.push_back('t');  break;
+			default: {
+				if ((unsigned char)(c) < 0x20) {
+					json.push_back("\\u00", 4);
+					json.push_back(HEX[(c >> 4) & 0xf]);
+					json.push_back(HEX[ c       & 0xf]);
+				} else {
+					json.push_back(c);
+				}
+			}
+		}
+	}
+}
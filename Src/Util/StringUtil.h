@@ -1,6 +1,7 @@
 #pragma once
 #include <stdint.h>
 
+#include "Core/Array.h"
 #include "Core/String.h"
 #include "Core/StringView.h"
 #include "Core/Allocators/LinearAllocator.h"
@@ -23,4 +24,7 @@ namespace Util {
 	String to_string(int64_t  value, int64_t  base = 10, Allocator * allocator = nullptr);
 	String to_string(uint64_t value, uint64_t base = 10, Allocator * allocator = nullptr);
 	String to_string(double   value,                     Allocator * allocator = nullptr);
+
+	// Appends the string as the contents of a JSON string literal, escaping quotes, backslashes and control characters
+	void append_json_escaped(Array<char> & json, StringView str);
 }
@@ -1,53 +1,187 @@
 #include "ThreadPool.h"
 
-ThreadPool::ThreadPool(int thread_count) : threads(thread_count) {
-	for (size_t i = 0; i < threads.size(); i++) {
-		threads[i] = std::thread([this]() {
-			while (true) {
-				Work work;
-				{
-					std::unique_lock<std::mutex> lock(signal_submit.mutex);
-					signal_submit.condition.wait(lock, [this]{ return !work_queue.is_empty() || is_done; });
-
-					if (is_done) return;
-
-					work = work_queue.pop();
-				}
-				work();
-
-				num_done++;
-				signal_done.condition.notify_one();
-			}
-		});
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+
+// Identifies the worker (if any) that the current thread belongs to
+static thread_local ThreadPool * current_thread_pool  = nullptr;
+static thread_local int          current_worker_index = INVALID;
+static thread_local int          current_work_depth   = 0; // Greater than 1 when running Work while waiting inside other Work
+
+ThreadPool::ThreadPool(int thread_count, bool pin_threads) : workers(thread_count) {
+	for (int i = 0; i < workers.size(); i++) {
+		workers[i] = make_owned<Worker>();
 	}
 
-	num_submitted = 0;
-	num_done      = 0;
+	// Start threads only after all Workers exist, since workers may steal from each other immediately
+	for (int i = 0; i < workers.size(); i++) {
+		workers[i]->thread = std::thread([this, i]() {
+			worker_loop(i);
+		});
+
+		if (pin_threads) {
+			DWORD_PTR affinity_mask = DWORD_PTR(1) << (i % (sizeof(DWORD_PTR) * 8));
+			SetThreadAffinityMask(workers[i]->thread.native_handle(), affinity_mask);
+		}
+	}
 }
 
 ThreadPool::~ThreadPool() {
 	{
-		std::lock_guard<std::mutex> lock(signal_submit.mutex);
+		std::lock_guard<std::mutex> lock(sleep_mutex);
 		is_done = true;
 	}
-	signal_submit.condition.notify_all();
+	sleep_condition.notify_all();
+
+	for (int i = 0; i < workers.size(); i++) {
+		workers[i]->thread.join();
+	}
+}
+
+void ThreadPool::worker_loop(int worker_index) {
+	current_thread_pool  = this;
+	current_worker_index = worker_index;
+
+	while (true) {
+		if (try_run_one()) continue;
+
+		std::unique_lock<std::mutex> lock(sleep_mutex);
+
+		num_sleeping++;
+		sleep_condition.wait(lock, [this]{ return num_queued > 0 || is_done; });
+		num_sleeping--;
 
-	for (size_t i = 0; i < threads.size(); i++) {
-		threads[i].join();
+		if (is_done) return;
 	}
 }
 
 void ThreadPool::submit(Work && work) {
 	num_submitted++;
 
+	// Work submitted from a worker goes to the back of its own deque, other threads distribute Work round robin
+	int worker_index;
+	if (current_thread_pool == this) {
+		worker_index = current_worker_index;
+	} else {
+		worker_index = next_worker++ % workers.size();
+	}
+
+	Worker & worker = *workers[worker_index].get();
 	{
-		std::lock_guard<std::mutex> lock(signal_submit.mutex);
-		work_queue.push(std::move(work));
+		std::lock_guard<std::mutex> lock(worker.mutex);
+		worker.deque.push(std::move(work));
+	}
+	num_queued++;
+
+	// Only touch the sleep mutex if there is a thread that could be woken up
+	if (num_sleeping > 0) {
+		{
+			std::lock_guard<std::mutex> lock(sleep_mutex);
+		}
+		sleep_condition.notify_one();
+	}
+
+	// Threads blocked in wait_until may be the only ones able to run this Work, for example when every worker is waiting on nested Work
+	notify_waiting();
+}
+
+bool ThreadPool::try_run_one() {
+	if (num_queued == 0) return false;
+
+	Work work;
+	bool found = false;
+
+	int self = current_thread_pool == this ? current_worker_index : INVALID;
+
+	// Pop from the back of our own deque first, most recently pushed Work is most likely to be hot in cache
+	if (self != INVALID) {
+		Worker & worker = *workers[self].get();
+
+		std::lock_guard<std::mutex> lock(worker.mutex);
+		if (!worker.deque.is_empty()) {
+			work  = worker.deque.pop_back();
+			found = true;
+		}
+	}
+
+	// Steal from the front of other deques
+	if (!found) {
+		int start = self != INVALID ? self + 1 : int(next_worker % workers.size());
+
+		for (int i = 0; i < workers.size(); i++) {
+			int victim = (start + i) % workers.size();
+			if (victim == self) continue;
+
+			Worker & worker = *workers[victim].get();
+
+			std::lock_guard<std::mutex> lock(worker.mutex);
+			if (!worker.deque.is_empty()) {
+				work  = worker.deque.pop();
+				found = true;
+				break;
+			}
+		}
+	}
+
+	if (!found) return false;
+
+	num_queued--;
+
+	current_work_depth++;
+	work();
+	current_work_depth--;
+
+	// Nested Work shares the arena with the Work that is waiting on it, so only reset once the outermost Work is done
+	if (self != INVALID && current_work_depth == 0) {
+		workers[self]->arena.reset();
+	}
+
+	num_done++;
+	notify_waiting();
+
+	return true;
+}
+
+ThreadPool & ThreadPool::get_shared() {
+	static ThreadPool shared_thread_pool;
+	return shared_thread_pool;
+}
+
+Allocator * ThreadPool::get_worker_arena() {
+	if (current_thread_pool == nullptr) return nullptr;
+
+	return &current_thread_pool->workers[current_worker_index]->arena;
+}
+
+template<typename Condition>
+void ThreadPool::wait_until(Condition && condition) {
+	while (!condition()) {
+		if (try_run_one()) continue;
+
+		// No Work left to help with, block until Work completes or new Work is submitted
+		std::unique_lock<std::mutex> lock(sleep_mutex);
+
+		num_waiting++;
+		wait_condition.wait(lock, [this, &condition]{ return num_queued > 0 || condition(); });
+		num_waiting--;
+	}
+}
+
+void ThreadPool::notify_waiting() {
+	// Waiters register under the sleep mutex before checking their condition, so locking it here prevents lost wake ups
+	if (num_waiting > 0) {
+		{
+			std::lock_guard<std::mutex> lock(sleep_mutex);
+		}
+		wait_condition.notify_all();
 	}
-	signal_submit.condition.notify_one();
 }
 
 void ThreadPool::sync() {
-	std::unique_lock<std::mutex> lock(signal_done.mutex);
-	signal_done.condition.wait(lock, [this]{ return num_done == num_submitted; });
+	wait_until([this]() { return num_done == num_submitted; });
+}
+
+void ThreadPool::TaskGroup::wait() {
+	thread_pool.wait_until([this]() { return num_pending == 0; });
 }
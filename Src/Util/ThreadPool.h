@@ -1,37 +1,143 @@
 #pragma once
 #include <thread>
 #include <mutex>
+#include <atomic>
+#include <condition_variable>
 
 #include "Core/Array.h"
 #include "Core/Queue.h"
+#include "Core/OwnPtr.h"
 #include "Core/Function.h"
+#include "Core/Allocators/LinearAllocator.h"
 
+#include "Math/Math.h"
+
+// Work stealing ThreadPool
+// Every worker thread has its own deque of Work. Workers push and pop Work at the back of their own deque,
+// when it runs empty they steal from the front of the deques of other workers.
+// Threads that wait on Work (sync, TaskGroup::wait, parallel_for) execute other Work while waiting,
+// which means Work is allowed to spawn and wait on nested Work without deadlocking the pool.
+// Once there is no Work left to run, waiting threads block until Work completes or new Work is submitted
 struct ThreadPool {
 	using Work = Function<void()>;
 
+	static constexpr size_t ARENA_BLOCK_SIZE = MEGABYTES(4);
+
+	// Group of Work that can be waited on independently of other Work in the pool
+	struct TaskGroup {
+		ThreadPool & thread_pool;
+
+		std::atomic<int> num_pending = 0;
+
+		TaskGroup(ThreadPool & thread_pool) : thread_pool(thread_pool) { }
+
+		NON_COPYABLE(TaskGroup);
+		NON_MOVEABLE(TaskGroup);
+
+		~TaskGroup() {
+			wait();
+		}
+
+		// Templated rather than taking Work, so that the bookkeeping wrapper does not wrap a Function in another Function
+		template<typename Func>
+		void run(Func && func) {
+			num_pending++;
+
+			thread_pool.submit([this, func = std::forward<Func>(func)]() mutable {
+				func();
+				num_pending--;
+			});
+		}
+
+		void wait();
+	};
+
 private:
-	Array<std::thread> threads;
+	struct Worker {
+		std::thread thread;
 
-	Queue<Work> work_queue;
+		std::mutex  mutex; // Protects deque
+		Queue<Work> deque;
 
-	struct Signal {
-		std::condition_variable condition;
-		std::mutex              mutex;
+		// Scratch memory for the Work executed by this worker, reset after every (outermost) Work item.
+		// Grows by chaining blocks, allocations of ARENA_BLOCK_SIZE or larger go to the heap
+		LinearAllocator<ARENA_BLOCK_SIZE> arena;
 	};
 
-	Signal signal_submit;
-	Signal signal_done;
+	Array<OwnPtr<Worker>> workers;
 
-	int              num_submitted = 0;
+	std::atomic<int> num_queued = 0; // Number of Work items currently in any deque
+
+	std::atomic<int> num_submitted = 0;
 	std::atomic<int> num_done      = 0;
 
-	std::atomic<bool> is_done;
+	std::atomic<unsigned> next_worker = 0; // Round robin index used by threads outside of the pool to distribute Work
+
+	std::mutex              sleep_mutex;
+	std::condition_variable sleep_condition;
+	std::atomic<int>        num_sleeping = 0;
+
+	std::condition_variable wait_condition; // Wakes threads blocked in wait_until, shares sleep_mutex
+	std::atomic<int>        num_waiting = 0;
+
+	std::atomic<bool> is_done = false;
+
+	void worker_loop(int worker_index);
+
+	// Pops Work from the current thread's own deque, or steals from another deque. Returns false if no Work was found
+	bool try_run_one();
+
+	// Runs Work until the condition holds, blocks whenever there is no Work to run
+	template<typename Condition>
+	void wait_until(Condition && condition);
+
+	void notify_waiting();
 
 public:
-	ThreadPool(int thread_count = std::thread::hardware_concurrency());
+	ThreadPool(int thread_count = std::thread::hardware_concurrency(), bool pin_threads = false);
 	~ThreadPool();
 
 	void submit(Work && work);
 
+	// Waits until all submitted Work is done
 	void sync();
+
+	// Calls func(i) for every i in [first, last), in chunks of grain_size indices per Work item
+	template<typename Func>
+	void parallel_for(int first, int last, int grain_size, Func && func) {
+		if (first >= last) return;
+		grain_size = Math::max(grain_size, 1);
+
+		// Single chunk, avoid scheduling overhead
+		if (last - first <= grain_size) {
+			for (int i = first; i < last; i++) {
+				func(i);
+			}
+			return;
+		}
+
+		TaskGroup group(*this);
+
+		for (int begin = first; begin < last; begin += grain_size) {
+			int end = Math::min(begin + grain_size, last);
+
+			group.run([&func, begin, end]() {
+				for (int i = begin; i < end; i++) {
+					func(i);
+				}
+			});
+		}
+
+		group.wait();
+	}
+
+	inline int thread_count() const { return int(workers.size()); }
+
+	// Long-lived pool for CPU side preprocessing (PMJ02 tables, Sky and light distributions, geometry aggregation) and checks,
+	// created on first use, so that these do not each spin up and join their own threads. Asset loading keeps its own pool in the AssetManager
+	static ThreadPool & get_shared();
+
+	// Returns the arena of the worker that is executing the calling Work, or nullptr when called from outside a worker thread.
+	// Memory from the arena is only valid until the Work returns, results that outlive the Work must use a different Allocator
+	static Allocator * get_worker_arena();
 };
@@ -0,0 +1,191 @@
+#include "ThreadPoolBenchmark.h"
+
+#include "Core/IO.h"
+#include "Core/OwnPtr.h"
+#include "Core/Timer.h"
+#include "Core/String.h"
+#include "Math/Vector3.h"
+
+#include "Util/ThreadPool.h"
+
+static constexpr int NUM_TASKS = 1000000;
+
+static std::atomic<unsigned> sink = 0; // Prevents the busy work from being optimized away
+
+// Performs roughly one microsecond of work
+static void busy_work(int seed) {
+	unsigned x = unsigned(seed) + 1;
+	for (int i = 0; i < 256; i++) {
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+	}
+	if (x == 0) sink++;
+}
+
+template<typename> struct HeapFunction;
+
+// Reference Function that always stores its callable on the heap, used as the baseline for the small buffer optimization of Function
+template<typename Result, typename ... Args>
+struct HeapFunction<Result(Args ...)> {
+	struct CallableBase {
+		virtual ~CallableBase() = default;
+
+		virtual Result call(Args ... args) = 0;
+	};
+
+	template<typename T>
+	struct Callable final : CallableBase {
+		T impl;
+
+		Callable(T impl) : impl(std::move(impl)) { }
+
+		Result call(Args ... args) override {
+			return impl(std::forward<Args>(args) ...);
+		}
+	};
+
+	mutable OwnPtr<CallableBase> callable;
+
+	template<typename T>
+	HeapFunction(T impl) : callable(make_owned<Callable<T>>(std::move(impl))) { }
+
+	NON_COPYABLE(HeapFunction);
+	DEFAULT_MOVEABLE(HeapFunction);
+
+	~HeapFunction() = default;
+
+	Result operator()(Args ... args) const {
+		return callable->call(std::forward<Args>(args) ...);
+	}
+
+	inline bool is_inline() const {
+		return false;
+	}
+};
+
+// Measures the cost of constructing, moving, calling, and destroying a FunctionType with a capture of the given size
+template<typename FunctionType, int CAPTURE_SIZE>
+static void benchmark_function_type(StringView name) {
+	struct Capture { char bytes[CAPTURE_SIZE]; };
+	Capture capture = { };
+
+	size_t num_heap_allocations = 0;
+	{
+		ScopeTimer timer(name);
+
+		for (int i = 0; i < NUM_TASKS; i++) {
+			FunctionType function = [capture, i]() {
+				if (capture.bytes[i % CAPTURE_SIZE] != 0) sink++;
+			};
+			FunctionType moved = std::move(function); // ThreadPool moves Work in and out of its deques
+
+			if (!moved.is_inline()) num_heap_allocations++;
+			moved();
+		}
+	}
+	IO::print("  {} heap allocations for {} calls\n"_sv, num_heap_allocations, NUM_TASKS);
+}
+
+// Compares Function against the heap only HeapFunction for a capture of the given size
+template<int CAPTURE_SIZE>
+static void benchmark_function() {
+	struct Capture { char bytes[CAPTURE_SIZE]; };
+	Capture capture = { };
+
+	Function<void()> probe = [capture]() { if (capture.bytes[0] != 0) sink++; };
+	bool is_inline = probe.is_inline();
+
+	IO::print("{} byte capture ({}):\n"_sv, CAPTURE_SIZE, is_inline ? "stored inline by Function"_sv : "heap allocated by Function"_sv);
+	benchmark_function_type<HeapFunction<void()>, CAPTURE_SIZE>("  HeapFunction"_sv);
+	benchmark_function_type<Function<void()>,     CAPTURE_SIZE>("  Function"_sv);
+}
+
+static void benchmark_serial() {
+	ScopeTimer timer("Serial"_sv);
+
+	for (int i = 0; i < NUM_TASKS; i++) {
+		busy_work(i);
+	}
+}
+
+static void benchmark_submit(ThreadPool & thread_pool) {
+	ScopeTimer timer("Submit + sync"_sv);
+
+	for (int i = 0; i < NUM_TASKS; i++) {
+		thread_pool.submit([i]() { busy_work(i); });
+	}
+	thread_pool.sync();
+}
+
+static void benchmark_parallel_for(ThreadPool & thread_pool, int grain_size, StringView name) {
+	ScopeTimer timer(name);
+
+	thread_pool.parallel_for(0, NUM_TASKS, grain_size, [](int i) {
+		busy_work(i);
+	});
+}
+
+static void benchmark_nested(ThreadPool & thread_pool) {
+	ScopeTimer timer("Nested task groups"_sv);
+
+	constexpr int NUM_OUTER = 1000;
+
+	// Every outer task spawns and waits on its own inner tasks, this would deadlock a pool whose threads block while waiting
+	thread_pool.parallel_for(0, NUM_OUTER, 1, [&thread_pool](int outer) {
+		thread_pool.parallel_for(0, NUM_TASKS / NUM_OUTER, 16, [outer](int inner) {
+			busy_work(outer * (NUM_TASKS / NUM_OUTER) + inner);
+		});
+	});
+}
+
+// Mimics the scratch allocations of an asset loader job: growing Arrays and many small Strings,
+// allocated either from the heap or from the arena of the worker executing the job
+static void benchmark_loader_scratch(ThreadPool & thread_pool, bool use_arena, StringView name) {
+	ScopeTimer timer(name);
+
+	constexpr int NUM_JOBS         = 2000;
+	constexpr int NUM_ELEMENTS     = 20000;
+	constexpr int NUM_SMALL_ALLOCS = 2000;
+
+	for (int job = 0; job < NUM_JOBS; job++) {
+		thread_pool.submit([use_arena, job]() {
+			Allocator * allocator = use_arena ? ThreadPool::get_worker_arena() : nullptr;
+
+			Array<Vector3> positions(allocator);
+			Array<int>     indices  (allocator);
+			for (int i = 0; i < NUM_ELEMENTS; i++) {
+				positions.emplace_back(float(i), float(job), 0.0f);
+				indices.push_back(i);
+			}
+
+			for (int i = 0; i < NUM_SMALL_ALLOCS; i++) {
+				String name("a_name_long_enough_to_not_fit_in_sso", allocator);
+				if (name.data()[i % name.size()] == 0) sink++;
+			}
+
+			if (positions[job % NUM_ELEMENTS].y != float(job) || indices.size() != NUM_ELEMENTS) sink++;
+		});
+	}
+	thread_pool.sync();
+}
+
+void ThreadPoolBenchmark::run() {
+	ThreadPool thread_pool;
+
+	IO::print("ThreadPool benchmark: {} tasks of ~1us on {} threads\n"_sv, NUM_TASKS, thread_pool.thread_count());
+
+	benchmark_function<8>();
+	benchmark_function<32>();
+	benchmark_function<64>();
+
+	benchmark_serial();
+	benchmark_submit(thread_pool);
+	benchmark_parallel_for(thread_pool, 1,    "parallel_for (grain size 1)"_sv);
+	benchmark_parallel_for(thread_pool, 64,   "parallel_for (grain size 64)"_sv);
+	benchmark_parallel_for(thread_pool, 1024, "parallel_for (grain size 1024)"_sv);
+	benchmark_nested(thread_pool);
+
+	benchmark_loader_scratch(thread_pool, false, "Loader scratch (heap)"_sv);
+	benchmark_loader_scratch(thread_pool, true,  "Loader scratch (worker arena)"_sv);
+}
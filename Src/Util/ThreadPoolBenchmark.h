@@ -0,0 +1,6 @@
+#pragma once
+
+// Microbenchmark measuring the overhead of Function and the scheduling overhead of the ThreadPool using very small (~1 microsecond) tasks
+namespace ThreadPoolBenchmark {
+	void run();
+}
@@ -0,0 +1,148 @@
+#include "VirtualTextureBenchmark.h"
+
+#include <math.h>
+#include <stdio.h>
+
+#include "Core/IO.h"
+#include "Core/Timer.h"
+
+#include "Assets/PageFile.h"
+
+#include "Math/Math.h"
+
+static constexpr int TEXTURE_SIZE = 2048;
+static constexpr int NUM_SURFACES = 4; // Every surface maps the same page file, but occupies its own tiles in the cache
+
+static constexpr int NUM_FRAMES          = 600;
+static constexpr int VIEW_WIDTH_IN_TILES  = 6;
+static constexpr int VIEW_HEIGHT_IN_TILES = 4;
+static constexpr int MAX_LOADS_PER_FRAME = 32; // Models a limited streaming bandwidth
+
+static constexpr const char * PAGE_FILE_NAME = "vt_benchmark";
+
+// Fills a Texture with a pattern that differs per level, so that tiles read back from the page file can be told apart
+static Texture make_texture() {
+	Texture texture;
+	texture.format   = Texture::Format::RGBA;
+	texture.channels = 4;
+	texture.width    = TEXTURE_SIZE;
+	texture.height   = TEXTURE_SIZE;
+
+	size_t num_bytes = 0;
+	for (int size = TEXTURE_SIZE; size > 0; size /= 2) {
+		texture.mip_offsets.push_back(int(num_bytes));
+		num_bytes += size * size * sizeof(unsigned);
+	}
+
+	texture.data.resize(num_bytes);
+	for (int level = 0; level < texture.mip_levels(); level++) {
+		int size = TEXTURE_SIZE >> level;
+
+		unsigned * level_data = reinterpret_cast<unsigned *>(texture.data.data() + texture.mip_offsets[level]);
+		for (int y = 0; y < size; y++) {
+			for (int x = 0; x < size; x++) {
+				level_data[x + y * size] = unsigned(level << 24) | unsigned((x ^ y) & 0xffffff);
+			}
+		}
+	}
+
+	return texture;
+}
+
+// Every frame each surface is viewed through a window of tiles at a fixed mip level, the windows pan along circles
+// so that consecutive frames mostly reuse tiles, while over the whole trace the view visits most of level 0.
+// The coarsest level is requested every frame as well, as it serves as fallback for all other tiles
+static void generate_trace(const VirtualTexture::TileLayout & layout, Array<VirtualTexture::TileID> & trace, Array<int> & frame_offsets) {
+	int coarsest_level = layout.levels.size() - 1;
+
+	for (int frame = 0; frame < NUM_FRAMES; frame++) {
+		frame_offsets.push_back(trace.size());
+
+		for (int surface = 0; surface < NUM_SURFACES; surface++) {
+			int level = surface % 3; // Surfaces at different distances from the camera
+
+			const VirtualTexture::LevelLayout & level_layout = layout.levels[level];
+
+			float angle = TWO_PI * float(frame) / float(NUM_FRAMES) + float(surface);
+			float center_x = (0.5f + 0.4f * cosf(angle)) * float(level_layout.width_in_tiles);
+			float center_y = (0.5f + 0.4f * sinf(angle)) * float(level_layout.height_in_tiles);
+
+			int x0 = Math::clamp(int(center_x) - VIEW_WIDTH_IN_TILES  / 2, 0, Math::max(level_layout.width_in_tiles  - VIEW_WIDTH_IN_TILES,  0));
+			int y0 = Math::clamp(int(center_y) - VIEW_HEIGHT_IN_TILES / 2, 0, Math::max(level_layout.height_in_tiles - VIEW_HEIGHT_IN_TILES, 0));
+			int x1 = Math::min(x0 + VIEW_WIDTH_IN_TILES,  level_layout.width_in_tiles);
+			int y1 = Math::min(y0 + VIEW_HEIGHT_IN_TILES, level_layout.height_in_tiles);
+
+			for (int y = y0; y < y1; y++) {
+				for (int x = x0; x < x1; x++) {
+					trace.push_back({ surface, level, x, y });
+				}
+			}
+			trace.push_back({ surface, coarsest_level, 0, 0 });
+		}
+	}
+	frame_offsets.push_back(trace.size());
+}
+
+static void replay_trace(PageFile::Reader & reader, const Array<VirtualTexture::TileID> & trace, const Array<int> & frame_offsets, size_t budget_in_bytes) {
+	int num_failed_reads = 0;
+
+	VirtualTexture::TileCache cache(budget_in_bytes, [&reader, &num_failed_reads](VirtualTexture::TileID tile_id, unsigned char * dst) {
+		if (!reader.read_tile(tile_id.level, tile_id.x, tile_id.y, dst)) {
+			num_failed_reads++;
+		}
+	});
+
+	for (int surface = 0; surface < NUM_SURFACES; surface++) {
+		VirtualTexture::TileLayout layout = reader.layout;
+		cache.add_texture(std::move(layout));
+	}
+
+	Timer timer;
+	timer.start();
+
+	for (int frame = 0; frame < NUM_FRAMES; frame++) {
+		for (int i = frame_offsets[frame]; i < frame_offsets[frame + 1]; i++) {
+			cache.request(trace[i]);
+		}
+		cache.update(MAX_LOADS_PER_FRAME);
+	}
+
+	size_t duration = timer.stop();
+
+	const VirtualTexture::TileCache::Stats & stats = cache.stats;
+	IO::print("Budget {} MB: hit rate {}%, {} requests, {} loads, {} evictions, {} tiles resident\n"_sv,
+		budget_in_bytes >> 20, 100.0f * stats.hit_rate(), stats.num_requests, stats.num_loads, stats.num_evictions, cache.num_resident_tiles());
+	Timer::print_named_duration("\tReplay"_sv, duration);
+
+	if (num_failed_reads > 0) {
+		IO::print("WARNING: {} tiles could not be read from the page file!\n"_sv, num_failed_reads);
+	}
+}
+
+void VirtualTextureBenchmark::run() {
+	String page_filename = PageFile::get_page_filename(StringView::from_c_str(PAGE_FILE_NAME), nullptr);
+
+	{
+		Texture texture = make_texture();
+		if (!PageFile::save(page_filename, texture)) return;
+	}
+
+	PageFile::Reader reader;
+	if (!reader.open(page_filename)) return;
+
+	Array<VirtualTexture::TileID> trace;
+	Array<int>                    frame_offsets;
+	generate_trace(reader.layout, trace, frame_offsets);
+
+	int tiles_per_frame = trace.size() / NUM_FRAMES;
+	IO::print("TileCache benchmark: {} frames of {} tile requests on {} surfaces of {}x{} texels, {} KB per tile, at most {} loads per frame\n"_sv,
+		NUM_FRAMES, tiles_per_frame, NUM_SURFACES, TEXTURE_SIZE, TEXTURE_SIZE, reader.layout.tile_bytes >> 10, MAX_LOADS_PER_FRAME);
+
+	// Budgets from below the per frame working set up to enough room for every tile the trace touches
+	for (size_t budget_in_mb = 2; budget_in_mb <= 64; budget_in_mb *= 2) {
+		replay_trace(reader, trace, frame_offsets, budget_in_mb << 20);
+	}
+
+	reader.close();
+	remove(page_filename.data());
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+// Benchmark that replays a synthetic tile access trace against the TileCache (see Renderer/VirtualTexture.h)
+// with tiles streamed from a page file (see Assets/PageFile.h), and reports the hit rate for several memory budgets
+namespace VirtualTextureBenchmark {
+	void run();
+}